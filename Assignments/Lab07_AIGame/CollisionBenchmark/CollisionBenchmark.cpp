@@ -0,0 +1,554 @@
+#include "CollisionBenchmark.h"
+#include "CollisionQueryStats.h"
+#include "GameLogger.h"
+#include "ConfigReader.h"
+#include "StringFuncs.h"
+#include "MathUtility.h"
+#include "ShapeGenerator.h"
+#include "RenderEngine.h"
+#include "WorldFileIO.h"
+#include "Mesh.h"
+#include <fstream>
+#include <chrono>
+#include <cfloat>
+#include <cstdlib>
+
+// agent
+// 10/17/2026
+// CollisionBenchmark.cpp
+// Loads a world file without a window and times the same ray sets against every collision backend and grid setting
+
+// everything in the world goes in one layer, the same way the games load it
+const Engine::CollisionLayer WORLD_LAYER = Engine::CollisionLayer::STATIC_GEOMETRY;
+
+// mouse picks come in bursts from one camera, like a player sweeping the mouse over a frame or two
+const int PICKS_PER_CAMERA = 16;
+const float PICK_FIELD_OF_VIEW = 60.0f;
+const float PICK_ASPECT_RATIO = 16.0f / 9.0f;
+const float PICK_MIN_PITCH = -45.0f;
+const float PICK_MAX_PITCH = 15.0f;
+
+// shorter sight lines than this are regenerated, they say nothing about the structure
+const float MIN_SIGHT_LINE_LENGTH = 1.0f;
+
+bool CollisionBenchmark::Initialize(int argc, char ** argv)
+{
+	// the grid the games run with, then one setting changed at a time, then the bvh, -scale adds more after these
+	if (!AddVariant("grid", Engine::CollisionBackend::SPATIAL_GRID, 0.0f, true, true, true)) { return false; }
+	if (!AddVariant("grid dense cells", Engine::CollisionBackend::SPATIAL_GRID, 0.0f, false, true, true)) { return false; }
+	if (!AddVariant("grid box binning", Engine::CollisionBackend::SPATIAL_GRID, 0.0f, true, false, true)) { return false; }
+	if (!AddVariant("bvh", Engine::CollisionBackend::BVH, 0.0f, true, true, true)) { return false; }
+
+	if (!ReadConfigValues()) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not ReadConfigValues!\n"); return false; }
+	if (!ReadArguments(argc, argv)) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not ReadArguments!\n"); return false; }
+
+	// there is no window, so meshes stay on the cpu where the collision code reads them anyway
+	Engine::RenderEngine::SetHeadless(true);
+	if (!Engine::ShapeGenerator::Initialize(0, 0, 0)) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not initialize ShapeGenerator!\n"); return false; }
+	if (m_workerThreads > 0 && !Engine::CollisionTester::InitializeRayWorkers(m_workerThreads)) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not start [%d] ray workers!\n", m_workerThreads); return false; }
+
+	if (!LoadWorld()) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not load world [%s]!\n", m_worldFile); return false; }
+
+	// recorded rays are replayed as they are, so runs on different machines or builds cast exactly the same rays
+	if (m_rayFileToRead[0] != '\0' && !ReadRayFile(m_rayFileToRead)) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not read rays from [%s]!\n", m_rayFileToRead); return false; }
+	if (m_rayFileToRead[0] == '\0' && !MakeRaySets()) { Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to initialize! Could not make ray sets!\n"); return false; }
+	if (m_rayFileToWrite[0] != '\0' && !WriteRayFile(m_rayFileToWrite)) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not write rays to [%s]! Continuing without recording them!\n", m_rayFileToWrite); }
+
+	// one set of outputs big enough for the biggest set
+	for (int s = 0; s < NUM_RAY_SETS; ++s) { if (m_raySetCounts[s] > m_outputCapacity) { m_outputCapacity = m_raySetCounts[s]; } }
+	m_pOutputs = new Engine::RayCastingOutput[m_outputCapacity > 0 ? m_outputCapacity : 1];
+	m_pOccluded = new bool[m_outputCapacity > 0 ? m_outputCapacity : 1];
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark initialized successfully!\n");
+	return true;
+}
+
+bool CollisionBenchmark::Shutdown()
+{
+	CleanUp();
+	Engine::CollisionTester::ShutdownRayWorkers();
+	if (!Engine::ShapeGenerator::Shutdown()) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark failed to shut down! Could not shut down ShapeGenerator!\n"); return false; }
+	Engine::RenderEngine::SetHeadless(false);
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark shutdown successfully!\n");
+	return true;
+}
+
+bool CollisionBenchmark::RunBenchmarks()
+{
+	Engine::GameLogger::Log(Engine::MessageType::cInfo, "World [%s]: [%d] objects, [%d] triangles, bounds (%.1f, %.1f, %.1f) to (%.1f, %.1f, %.1f)\n",
+		m_worldFile, m_worldObjs.GetCount(), m_worldTriangleCount, m_worldMin.GetX(), m_worldMin.GetY(), m_worldMin.GetZ(), m_worldMax.GetX(), m_worldMax.GetY(), m_worldMax.GetZ());
+	Engine::GameLogger::Log(Engine::MessageType::cInfo, "Best of [%d] passes, cells are the occupied grid cells searched or the bvh nodes visited, batches run on the ray workers\n", m_passes);
+
+	bool allSucceeded = true;
+	for (int v = 0; v < m_variantCount; ++v)
+	{
+		if (!RunVariant(m_variants[v]))
+		{
+			Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark failed to run variant [%s]!\n", m_variants[v].m_name);
+			allSucceeded = false;
+		}
+	}
+
+	return allSucceeded;
+}
+
+bool CollisionBenchmark::ReadConfigValues()
+{
+	if (!Engine::ConfigReader::pReader->GetStringForKey("CollisionBenchmark.World.InputFileName", m_worldFile))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get string value for key CollisionBenchmark.World.InputFileName!\n");
+		return false;
+	}
+
+	if (!Engine::ConfigReader::pReader->GetClampedIntForKey("CollisionBenchmark.RaysPerSet", m_raysPerSet, 1, 10000000))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get int value for key CollisionBenchmark.RaysPerSet!\n");
+		return false;
+	}
+
+	if (!Engine::ConfigReader::pReader->GetIntForKey("CollisionBenchmark.Seed", m_seed))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get int value for key CollisionBenchmark.Seed!\n");
+		return false;
+	}
+
+	if (!Engine::ConfigReader::pReader->GetClampedIntForKey("CollisionBenchmark.Passes", m_passes, 1, 100))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get int value for key CollisionBenchmark.Passes!\n");
+		return false;
+	}
+
+	if (!Engine::ConfigReader::pReader->GetClampedFloatForKey("CollisionBenchmark.FloorProbeDistance", m_floorProbeDistance, 0.001f, FLT_MAX))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get float value for key CollisionBenchmark.FloorProbeDistance!\n");
+		return false;
+	}
+
+	if (!Engine::ConfigReader::pReader->GetClampedFloatForKey("CollisionBenchmark.PickDistance", m_pickDistance, 0.001f, FLT_MAX))
+	{
+		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "CollisionBenchmark failed to ReadConfigValues! Failed to get float value for key CollisionBenchmark.PickDistance!\n");
+		return false;
+	}
+
+	return true;
+}
+
+// CollisionBenchmark [world file] [-rays count] [-seed seed] [-passes count] [-threads count] [-read rayFile] [-write rayFile] [-scale cellSize]...
+bool CollisionBenchmark::ReadArguments(int argc, char ** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *const arg = argv[i];
+		if (arg[0] != '-') { Engine::StringFuncs::StringCopy(arg, m_worldFile, MAX_CHARS); continue; }
+
+		// every option takes a value
+		if (i + 1 >= argc) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark option [%s] is missing its value!\n", arg); return false; }
+		const char *const value = argv[++i];
+
+		bool parsed = true;
+		if (Engine::StringFuncs::StringsAreEqual(arg, "-rays")) { parsed = Engine::StringFuncs::GetSingleIntFromString(value, m_raysPerSet) && m_raysPerSet > 0; }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-seed")) { parsed = Engine::StringFuncs::GetSingleIntFromString(value, m_seed); }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-passes")) { parsed = Engine::StringFuncs::GetSingleIntFromString(value, m_passes) && m_passes > 0; }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-threads")) { parsed = Engine::StringFuncs::GetSingleIntFromString(value, m_workerThreads); }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-read")) { Engine::StringFuncs::StringCopy(value, m_rayFileToRead, MAX_CHARS); }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-write")) { Engine::StringFuncs::StringCopy(value, m_rayFileToWrite, MAX_CHARS); }
+		else if (Engine::StringFuncs::StringsAreEqual(arg, "-scale"))
+		{
+			// each scale adds a fixed cell size grid on top of the usual variants
+			float scale = 0.0f;
+			char name[MAX_CHARS]{ '\0' };
+			parsed = Engine::StringFuncs::GetSingleFloatFromString(value, scale) && scale > 0.0f;
+			sprintf_s(name, MAX_CHARS, "grid scale %g", scale);
+			if (parsed && !AddVariant(name, Engine::CollisionBackend::SPATIAL_GRID, scale, true, true, true)) { return false; }
+		}
+		else
+		{
+			Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark does not know option [%s]! Options are -rays, -seed, -passes, -threads, -read, -write and -scale\n", arg);
+			return false;
+		}
+
+		if (!parsed) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not use value [%s] for option [%s]!\n", value, arg); return false; }
+	}
+
+	return true;
+}
+
+bool CollisionBenchmark::AddVariant(const char * const name, Engine::CollisionBackend backend, float gridScale, bool sparseCells, bool exactBinning, bool autoFit)
+{
+	if (m_variantCount >= MAX_VARIANTS) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not add variant [%s]! Maximum of [%d] variants would be exceeded!\n", name, MAX_VARIANTS); return false; }
+
+	Variant& variant = m_variants[m_variantCount++];
+	Engine::StringFuncs::StringCopy(name, variant.m_name, MAX_CHARS);
+	variant.m_backend = backend;
+	variant.m_gridScale = gridScale;
+	variant.m_sparseCells = sparseCells;
+	variant.m_exactBinning = exactBinning;
+	variant.m_autoFit = autoFit;
+	return true;
+}
+
+bool CollisionBenchmark::LoadWorld()
+{
+	if (!Engine::WorldFileIO::ReadGobFile(m_worldFile, &m_worldObjs, 0, CollisionBenchmark::InitWorldObj, this)) { return false; }
+	if (m_worldObjs.GetCount() == 0) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not load world [%s]! It has no objects!\n", m_worldFile); return false; }
+
+	// rays are made inside the box around everything in the world
+	m_worldMin = Engine::Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	m_worldMax = Engine::Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	m_worldTriangleCount = 0;
+	m_worldObjs.WalkList(CollisionBenchmark::GrowWorldBounds, this);
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark loaded [%d] objects from [%s]!\n", m_worldObjs.GetCount(), m_worldFile);
+	return true;
+}
+
+bool CollisionBenchmark::MakeRaySets()
+{
+	srand((unsigned)m_seed);
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		m_pRaySets[s] = new Engine::RayCastingInput[m_raysPerSet];
+		m_raySetCounts[s] = m_raysPerSet;
+	}
+
+	MakeRandomRays(m_pRaySets[(int)RaySet::RANDOM], m_raysPerSet);
+	MakeFloorProbes(m_pRaySets[(int)RaySet::FLOOR_PROBES], m_raysPerSet);
+	MakeSightLines(m_pRaySets[(int)RaySet::SIGHT_LINES], m_raysPerSet);
+	MakeMousePicks(m_pRaySets[(int)RaySet::MOUSE_PICKS], m_raysPerSet);
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark made [%d] rays per set from seed [%d]!\n", m_raysPerSet, m_seed);
+	return true;
+}
+
+// anywhere in the world, any direction, long enough to cross all of it
+void CollisionBenchmark::MakeRandomRays(Engine::RayCastingInput * pRays, int rayCount)
+{
+	float worldDiagonal = (m_worldMax - m_worldMin).Length();
+	for (int i = 0; i < rayCount; ++i)
+	{
+		pRays[i].m_rayPosition = Engine::MathUtility::Rand(m_worldMin, m_worldMax);
+		pRays[i].m_rayDirection = RandomDirection();
+		pRays[i].m_checkDist = worldDiagonal;
+		pRays[i].m_layerMask = Engine::CollisionTester::LayerBit(WORLD_LAYER);
+	}
+}
+
+// short rays straight down, like the ground checks made every frame for the camera and npcs
+void CollisionBenchmark::MakeFloorProbes(Engine::RayCastingInput * pRays, int rayCount)
+{
+	for (int i = 0; i < rayCount; ++i)
+	{
+		pRays[i].m_rayPosition = Engine::MathUtility::Rand(m_worldMin, m_worldMax);
+		pRays[i].m_rayDirection = Engine::Vec3(0.0f, -1.0f, 0.0f);
+		pRays[i].m_checkDist = m_floorProbeDistance;
+		pRays[i].m_layerMask = Engine::CollisionTester::LayerBit(WORLD_LAYER);
+	}
+}
+
+// occlusion checks between two points, like line of sight and node map connection tests
+void CollisionBenchmark::MakeSightLines(Engine::RayCastingInput * pRays, int rayCount)
+{
+	for (int i = 0; i < rayCount; ++i)
+	{
+		Engine::Vec3 from, to;
+		do
+		{
+			from = Engine::MathUtility::Rand(m_worldMin, m_worldMax);
+			to = Engine::MathUtility::Rand(m_worldMin, m_worldMax);
+		} while ((to - from).LengthSquared() < MIN_SIGHT_LINE_LENGTH * MIN_SIGHT_LINE_LENGTH);
+
+		pRays[i].m_rayPosition = from;
+		pRays[i].m_rayDirection = (to - from).Normalize();
+		pRays[i].m_checkDist = (to - from).Length();
+		pRays[i].m_layerMask = Engine::CollisionTester::LayerBit(WORLD_LAYER);
+	}
+}
+
+// rays through random pixels of a camera placed somewhere in the world, the way FindFromMousePos builds them
+void CollisionBenchmark::MakeMousePicks(Engine::RayCastingInput * pRays, int rayCount)
+{
+	float tanHalfFov = tanf(0.5f * Engine::MathUtility::ToRadians(PICK_FIELD_OF_VIEW));
+	Engine::Vec3 eye, forward, right, up;
+	for (int i = 0; i < rayCount; ++i)
+	{
+		if (i % PICKS_PER_CAMERA == 0)
+		{
+			float yaw = Engine::MathUtility::Rand(0.0f, 2.0f * Engine::MathUtility::PI);
+			float pitch = Engine::MathUtility::ToRadians(Engine::MathUtility::Rand(PICK_MIN_PITCH, PICK_MAX_PITCH));
+			eye = Engine::MathUtility::Rand(m_worldMin, m_worldMax);
+			forward = Engine::Vec3(cosf(pitch) * cosf(yaw), sinf(pitch), cosf(pitch) * sinf(yaw));
+			right = forward.Cross(Engine::Vec3(0.0f, 1.0f, 0.0f)).Normalize();
+			up = right.Cross(forward);
+		}
+
+		float ndcX = Engine::MathUtility::Rand(-1.0f, 1.0f);
+		float ndcY = Engine::MathUtility::Rand(-1.0f, 1.0f);
+		pRays[i].m_rayPosition = eye;
+		pRays[i].m_rayDirection = (forward + (ndcX * tanHalfFov * PICK_ASPECT_RATIO) * right + (ndcY * tanHalfFov) * up).Normalize();
+		pRays[i].m_checkDist = m_pickDistance;
+		pRays[i].m_layerMask = Engine::CollisionTester::LayerBit(WORLD_LAYER);
+	}
+}
+
+// version, set count, then for each set its ray count and each ray's position, direction and check distance
+bool CollisionBenchmark::WriteRayFile(const char * const filePath)
+{
+	std::ofstream outFile(filePath, std::ios::binary | std::ios::out);
+	if (!outFile) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to write ray file [%s]! Could not open file!\n", filePath); return false; }
+
+	int version = RAY_FILE_VERSION, setCount = NUM_RAY_SETS;
+	outFile.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	outFile.write(reinterpret_cast<const char*>(&setCount), sizeof(setCount));
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		outFile.write(reinterpret_cast<const char*>(&m_raySetCounts[s]), sizeof(int));
+		for (int i = 0; i < m_raySetCounts[s]; ++i)
+		{
+			const Engine::RayCastingInput& ray = m_pRaySets[s][i];
+			float values[7]{ ray.m_rayPosition.GetX(), ray.m_rayPosition.GetY(), ray.m_rayPosition.GetZ(), ray.m_rayDirection.GetX(), ray.m_rayDirection.GetY(), ray.m_rayDirection.GetZ(), ray.m_checkDist };
+			outFile.write(reinterpret_cast<const char*>(&values[0]), sizeof(values));
+		}
+	}
+
+	if (!outFile) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to write ray file [%s]! Write failed!\n", filePath); return false; }
+	outFile.close();
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark recorded its rays to [%s]!\n", filePath);
+	return true;
+}
+
+bool CollisionBenchmark::ReadRayFile(const char * const filePath)
+{
+	std::ifstream inFile(filePath, std::ios::binary | std::ios::in);
+	if (!inFile) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to read ray file [%s]! Could not open file!\n", filePath); return false; }
+
+	int version = -1, setCount = 0;
+	inFile.read(reinterpret_cast<char*>(&version), sizeof(version));
+	inFile.read(reinterpret_cast<char*>(&setCount), sizeof(setCount));
+	if (!inFile || version != RAY_FILE_VERSION || setCount != NUM_RAY_SETS) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to read ray file [%s]! Found version [%d] with [%d] sets, expected version [%d] with [%d] sets!\n", filePath, version, setCount, RAY_FILE_VERSION, NUM_RAY_SETS); return false; }
+
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		int rayCount = 0;
+		inFile.read(reinterpret_cast<char*>(&rayCount), sizeof(rayCount));
+		if (!inFile || rayCount < 0) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to read ray file [%s]! Set [%s] has a bad ray count!\n", filePath, GetRaySetName((RaySet)s)); return false; }
+
+		m_pRaySets[s] = new Engine::RayCastingInput[rayCount > 0 ? rayCount : 1];
+		m_raySetCounts[s] = rayCount;
+		for (int i = 0; i < rayCount; ++i)
+		{
+			float values[7]{ 0.0f };
+			inFile.read(reinterpret_cast<char*>(&values[0]), sizeof(values));
+			m_pRaySets[s][i].m_rayPosition = Engine::Vec3(values[0], values[1], values[2]);
+			m_pRaySets[s][i].m_rayDirection = Engine::Vec3(values[3], values[4], values[5]);
+			m_pRaySets[s][i].m_checkDist = values[6];
+			m_pRaySets[s][i].m_layerMask = Engine::CollisionTester::LayerBit(WORLD_LAYER);
+		}
+
+		if (!inFile) { Engine::GameLogger::Log(Engine::MessageType::cError, "Failed to read ray file [%s]! It ends part way through set [%s]!\n", filePath, GetRaySetName((RaySet)s)); return false; }
+	}
+
+	Engine::GameLogger::Log(Engine::MessageType::cProcess, "CollisionBenchmark replaying rays from [%s]!\n", filePath);
+	return true;
+}
+
+bool CollisionBenchmark::RunVariant(const Variant & variant)
+{
+	// auto fit goes first since turning it off recenters the grid at the current scale
+	Engine::CollisionTester::SetAutoFitGrids(variant.m_autoFit);
+	Engine::CollisionTester::SetGridScale(variant.m_gridScale);
+	Engine::CollisionTester::SetSparseGrids(variant.m_sparseCells);
+	Engine::CollisionTester::SetExactGridBinning(variant.m_exactBinning);
+	Engine::CollisionTester::SetLayerBackend(WORLD_LAYER, variant.m_backend);
+
+	double buildStart = GetSeconds();
+	if (!Engine::CollisionTester::CalculateGrid(WORLD_LAYER)) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not build variant [%s]!\n", variant.m_name); return false; }
+	double buildSeconds = GetSeconds() - buildStart;
+
+	Engine::GameLogger::Log(Engine::MessageType::cInfo, "==================== [%s] built in [%.2f] ms ====================\n", variant.m_name, 1000.0 * buildSeconds);
+	Engine::GameLogger::Log(Engine::MessageType::cInfo, "%-14s %14s %14s %10s %10s %8s\n", "rays", "rays/s", "batch rays/s", "cells/ray", "tris/ray", "hits");
+
+	bool allSucceeded = true;
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		if (m_raySetCounts[s] == 0) { continue; }
+		if (!TimeRaySet(variant, (RaySet)s)) { allSucceeded = false; }
+	}
+
+	if (variant.m_backend == Engine::CollisionBackend::SPATIAL_GRID && !CheckGridTraversal(variant)) { allSucceeded = false; }
+	return allSucceeded;
+}
+
+// the early out grid walk has to find the same walls as walking every cell to the end of each ray, any ray that disagrees fails the run
+bool CollisionBenchmark::CheckGridTraversal(const Variant & variant)
+{
+	int mismatchCount = 0;
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		if (m_raySetCounts[s] == 0) { continue; }
+
+		int setMismatches = Engine::CollisionTester::CheckGridTraversal(m_pRaySets[s], m_raySetCounts[s]);
+		if (setMismatches < 0) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not check grid traversal of [%s] rays for variant [%s]!\n", GetRaySetName((RaySet)s), variant.m_name); return false; }
+		mismatchCount += setMismatches;
+	}
+
+	if (mismatchCount > 0) { Engine::GameLogger::Log(Engine::MessageType::cError, "Variant [%s] grid traversal disagreed with walking every cell for [%d] rays!\n", variant.m_name, mismatchCount); return false; }
+	return true;
+}
+
+bool CollisionBenchmark::TimeRaySet(const Variant & variant, RaySet raySet)
+{
+	int rayCount = m_raySetCounts[(int)raySet];
+
+	// keep the best pass, anything slower was the machine doing something else
+	double bestSingle = DBL_MAX, bestBatch = DBL_MAX;
+	int singleHits = 0;
+	for (int p = 0; p < m_passes; ++p)
+	{
+		double start = GetSeconds();
+		singleHits = CastSingleRays(raySet);
+		double singleSeconds = GetSeconds() - start;
+
+		start = GetSeconds();
+		if (!CastRayBatch(raySet)) { Engine::GameLogger::Log(Engine::MessageType::cError, "CollisionBenchmark could not cast [%s] rays as a batch for variant [%s]!\n", GetRaySetName(raySet), variant.m_name); return false; }
+		double batchSeconds = GetSeconds() - start;
+
+		if (singleSeconds < bestSingle) { bestSingle = singleSeconds; }
+		if (batchSeconds < bestBatch) { bestBatch = batchSeconds; }
+	}
+
+	int batchHits = 0;
+	for (int i = 0; i < rayCount; ++i)
+	{
+		batchHits += (IsOcclusionSet(raySet) ? m_pOccluded[i] : m_pOutputs[i].m_didIntersect) ? 1 : 0;
+	}
+
+	if (batchHits != singleHits) { Engine::GameLogger::Log(Engine::MessageType::cWarning, "Variant [%s] hit [%d] [%s] rays one at a time but [%d] as a batch!\n", variant.m_name, singleHits, GetRaySetName(raySet), batchHits); }
+
+	// counting is a pass of its own so the timed passes do not pay for the stats
+	const char *const tag = GetRaySetName(raySet);
+	Engine::CollisionQueryStats::SetEnabled(true);
+	const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(tag);
+	CastSingleRays(raySet);
+	Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
+	Engine::CollisionQueryStats::SetEnabled(false);
+	Engine::CollisionQueryStats::EndFrame();
+
+	Engine::CollisionQueryHistogram histogram;
+	Engine::CollisionQueryStats::GetLastFrameForTag(tag, &histogram);
+	float queries = histogram.m_queryCount > 0 ? (float)histogram.m_queryCount : 1.0f;
+
+	Engine::GameLogger::Log(Engine::MessageType::cInfo, "%-14s %14.0f %14.0f %10.1f %10.1f %7.1f%%\n", GetRaySetName(raySet),
+		rayCount / bestSingle, rayCount / bestBatch, histogram.m_cellsVisited / queries, histogram.m_trianglesTested / queries, 100.0f * singleHits / (float)rayCount);
+	return true;
+}
+
+// returns how many rays hit something, or were blocked for occlusion sets
+int CollisionBenchmark::CastSingleRays(RaySet raySet)
+{
+	const Engine::RayCastingInput *pRays = m_pRaySets[(int)raySet];
+	int rayCount = m_raySetCounts[(int)raySet];
+	int hits = 0;
+
+	if (IsOcclusionSet(raySet))
+	{
+		for (int i = 0; i < rayCount; ++i)
+		{
+			if (Engine::CollisionTester::IsRayOccluded(pRays[i].m_rayPosition, pRays[i].m_rayDirection, pRays[i].m_checkDist, pRays[i].m_layerMask)) { hits++; }
+		}
+	}
+	else
+	{
+		for (int i = 0; i < rayCount; ++i)
+		{
+			if (Engine::CollisionTester::FindWallInLayers(pRays[i].m_rayPosition, pRays[i].m_rayDirection, pRays[i].m_checkDist, pRays[i].m_layerMask).m_didIntersect) { hits++; }
+		}
+	}
+
+	return hits;
+}
+
+bool CollisionBenchmark::CastRayBatch(RaySet raySet)
+{
+	if (IsOcclusionSet(raySet)) { return Engine::CollisionTester::FindOcclusions(m_pRaySets[(int)raySet], m_pOccluded, m_raySetCounts[(int)raySet]); }
+	return Engine::CollisionTester::FindWalls(m_pRaySets[(int)raySet], m_pOutputs, m_raySetCounts[(int)raySet]);
+}
+
+void CollisionBenchmark::CleanUp()
+{
+	for (int s = 0; s < NUM_RAY_SETS; ++s)
+	{
+		delete[] m_pRaySets[s];
+		m_pRaySets[s] = nullptr;
+		m_raySetCounts[s] = 0;
+	}
+
+	delete[] m_pOutputs;
+	delete[] m_pOccluded;
+	m_pOutputs = nullptr;
+	m_pOccluded = nullptr;
+	m_outputCapacity = 0;
+
+	m_worldObjs.WalkList(CollisionBenchmark::DestroyWorldObj, this);
+	m_worldObjs.ClearList();
+}
+
+const char * CollisionBenchmark::GetRaySetName(RaySet raySet)
+{
+	switch (raySet)
+	{
+	case RaySet::RANDOM: return "random";
+	case RaySet::FLOOR_PROBES: return "floor probes";
+	case RaySet::SIGHT_LINES: return "sight lines";
+	case RaySet::MOUSE_PICKS: return "mouse picks";
+	default: return "unknown";
+	}
+}
+
+// sight lines only care whether anything is in the way, the rest want the closest hit
+bool CollisionBenchmark::IsOcclusionSet(RaySet raySet)
+{
+	return raySet == RaySet::SIGHT_LINES;
+}
+
+Engine::Vec3 CollisionBenchmark::RandomDirection()
+{
+	// picked inside the unit sphere so every direction is as likely as any other
+	Engine::Vec3 direction;
+	do
+	{
+		direction = Engine::MathUtility::Rand(Engine::Vec3(-1.0f, -1.0f, -1.0f), Engine::Vec3(1.0f, 1.0f, 1.0f));
+	} while (direction.LengthSquared() > 1.0f || direction.LengthSquared() < 0.0001f);
+
+	return direction.Normalize();
+}
+
+double CollisionBenchmark::GetSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CollisionBenchmark::InitWorldObj(Engine::GraphicalObject * pObj, void * /*pClass*/)
+{
+	Engine::CollisionTester::AddGraphicalObjectToLayer(pObj, WORLD_LAYER);
+}
+
+bool CollisionBenchmark::GrowWorldBounds(Engine::GraphicalObject * pObj, void * pClass)
+{
+	CollisionBenchmark *pBenchmark = reinterpret_cast<CollisionBenchmark*>(pClass);
+
+	Engine::Vec3 objMin, objMax;
+	pObj->GetWorldBounds(&objMin, &objMax);
+	pBenchmark->m_worldMin = Engine::MathUtility::Min(pBenchmark->m_worldMin, objMin);
+	pBenchmark->m_worldMax = Engine::MathUtility::Max(pBenchmark->m_worldMax, objMax);
+	if (pObj->GetMeshPointer()) { pBenchmark->m_worldTriangleCount += pObj->GetMeshPointer()->GetTriangleCount(); }
+	return true;
+}
+
+bool CollisionBenchmark::DestroyWorldObj(Engine::GraphicalObject * pObj, void * /*pClass*/)
+{
+	Engine::CollisionTester::RemoveGraphicalObjectFromLayer(pObj, WORLD_LAYER);
+	delete pObj;
+	return true;
+}
@@ -0,0 +1,100 @@
+#ifndef COLLISIONBENCHMARK_H
+#define COLLISIONBENCHMARK_H
+
+#include "CollisionTester.h"
+#include "GraphicalObject.h"
+#include "LinkedList.h"
+#include "Vec3.h"
+
+// agent
+// 10/17/2026
+// CollisionBenchmark.h
+// Loads a world file without a window and times the same ray sets against every collision backend and grid setting
+
+class CollisionBenchmark
+{
+public:
+	bool Initialize(int argc, char **argv);
+	bool Shutdown();
+	bool RunBenchmarks();
+
+private:
+	// the kinds of ray the games cast, timed separately since each favors a different structure
+	enum class RaySet
+	{
+		RANDOM = 0,
+		FLOOR_PROBES,
+		SIGHT_LINES,
+		MOUSE_PICKS,
+
+		NUM_RAY_SETS // LAST ON PURPOSE
+	};
+
+	static const int MAX_CHARS = 256;
+	static const int MAX_VARIANTS = 16;
+	static const int NUM_RAY_SETS = (int)RaySet::NUM_RAY_SETS;
+	static const int RAY_FILE_VERSION = 1;
+
+	// one backend and grid setup to build and time every ray set against
+	struct Variant
+	{
+		char m_name[MAX_CHARS]{ '\0' };
+		Engine::CollisionBackend m_backend{ Engine::CollisionBackend::SPATIAL_GRID };
+		float m_gridScale{ 0.0f }; // zero lets the grid pick its cell size by cost
+		bool m_sparseCells{ true };
+		bool m_exactBinning{ true };
+		bool m_autoFit{ true };
+	};
+
+	bool ReadConfigValues();
+	bool ReadArguments(int argc, char **argv);
+	bool AddVariant(const char *const name, Engine::CollisionBackend backend, float gridScale, bool sparseCells, bool exactBinning, bool autoFit);
+	bool LoadWorld();
+	bool MakeRaySets();
+	void MakeRandomRays(Engine::RayCastingInput *pRays, int rayCount);
+	void MakeFloorProbes(Engine::RayCastingInput *pRays, int rayCount);
+	void MakeSightLines(Engine::RayCastingInput *pRays, int rayCount);
+	void MakeMousePicks(Engine::RayCastingInput *pRays, int rayCount);
+	bool WriteRayFile(const char *const filePath);
+	bool ReadRayFile(const char *const filePath);
+	bool RunVariant(const Variant& variant);
+	bool TimeRaySet(const Variant& variant, RaySet raySet);
+	bool CheckGridTraversal(const Variant& variant);
+	int CastSingleRays(RaySet raySet);
+	bool CastRayBatch(RaySet raySet);
+	void CleanUp();
+	static const char *GetRaySetName(RaySet raySet);
+	static bool IsOcclusionSet(RaySet raySet);
+	static Engine::Vec3 RandomDirection();
+	static double GetSeconds();
+	static void InitWorldObj(Engine::GraphicalObject *pObj, void *pClass);
+	static bool GrowWorldBounds(Engine::GraphicalObject *pObj, void *pClass);
+	static bool DestroyWorldObj(Engine::GraphicalObject *pObj, void *pClass);
+
+	// data
+	char m_worldFile[MAX_CHARS]{ '\0' };
+	char m_rayFileToRead[MAX_CHARS]{ '\0' };
+	char m_rayFileToWrite[MAX_CHARS]{ '\0' };
+	int m_raysPerSet{ 20000 };
+	int m_seed{ 1 };
+	int m_passes{ 3 };
+	int m_workerThreads{ -1 };
+	float m_floorProbeDistance{ 250.0f };
+	float m_pickDistance{ 2000.0f };
+
+	Engine::LinkedList<Engine::GraphicalObject*> m_worldObjs;
+	int m_worldTriangleCount{ 0 };
+	Engine::Vec3 m_worldMin{ 0.0f, 0.0f, 0.0f };
+	Engine::Vec3 m_worldMax{ 0.0f, 0.0f, 0.0f };
+
+	Engine::RayCastingInput *m_pRaySets[NUM_RAY_SETS]{ nullptr };
+	int m_raySetCounts[NUM_RAY_SETS]{ 0 };
+	Engine::RayCastingOutput *m_pOutputs{ nullptr };
+	bool *m_pOccluded{ nullptr };
+	int m_outputCapacity{ 0 };
+
+	Variant m_variants[MAX_VARIANTS];
+	int m_variantCount{ 0 };
+};
+
+#endif // ifndef COLLISIONBENCHMARK_H
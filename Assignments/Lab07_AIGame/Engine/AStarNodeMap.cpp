@@ -1,6 +1,7 @@
 #include "AStarNodeMap.h"
 #include "ShapeGenerator.h"
 #include "RenderEngine.h"
+#include "CollisionQueryStats.h"
 #include <fstream>
 
 // Justin Furtado
@@ -14,8 +15,11 @@ namespace Engine
 	const Vec3 UP(0.0f, 1.0f, 0.0f);
 	const float RADIUS_MULTIPLIER = 1.9f; // TODO: adjust this to match display object
 
+	unsigned int AStarNodeMap::s_nextVersion = 0;
+
 	AStarNodeMap::AStarNodeMap()
 	{
+		BumpVersion();
 	}
 
 
@@ -43,6 +47,8 @@ namespace Engine
 			m_numNodes = 0; // update count to reflect full clear
 			m_pNodesWithConnections = nullptr; // if and nullptr allow calling this method multiple times to be safe
 		}
+
+		BumpVersion();
 	}
 
 	void AStarNodeMap::RemoveConnection(LinkedList<GraphicalObject*>* pObjs, GraphicalObject * pConnectionToRemove, DestroyObjectCallback destroyCallback, void * pDestructionInstance, int * /*outCountToUpdate*/)
@@ -75,6 +81,7 @@ namespace Engine
 		if (!MakeAutomagicNodeConnections(pObjs, connectionLayer, geometryLayer, outCountToUpdate, uniformCallback, uniformInstance)) { GameLogger::Log(MessageType::cError, "Failed to CalculateNodeMap! Could not MakeAutomagicNodeConnections!\n"); return false; }
 
 		// HOOORRRAY ITS FINALLY OVER!!!!!!!!!!!
+		BumpVersion();
 		return true;
 	}
 
@@ -212,6 +219,9 @@ namespace Engine
 		// read in connections into whole array
 		inFile.read(reinterpret_cast<char *>(&pMap->m_pConnectionsTo[0]), sizeof(pMap->m_pConnectionsTo[0]) * pMap->m_numConnections);
 
+		// paths found on whatever the map held before are no good now
+		pMap->BumpVersion();
+
 		// load the map from a file (VALIDATE VERSION, log error accordingly)
 		return true;
 	}
@@ -405,17 +415,27 @@ namespace Engine
 		// variable to track the start indices for each node
 		int nextStartIndex = 0;
 
+		// center, right and left rays from one node to every other node, cast together as one batch
+		const int RAYS_PER_CONNECTION = 3;
+		RayCastingInput *pRays = new RayCastingInput[RAYS_PER_CONNECTION * m_numNodes];
+		bool *pRayBlocked = new bool[RAYS_PER_CONNECTION * m_numNodes];
+		if (!pRays || !pRayBlocked) { GameLogger::Log(MessageType::cError, "Failed to MakeAutomagicNodeConnections! Failed to allocate rays!\n"); delete[] pRays; delete[] pRayBlocked; return false; }
+
 		// for each node
 		for (unsigned i = 0; i < m_numNodes; ++i)
 		{
 			// how many nodes this node can see
 			int numICanSee = 0;
 
-			// compare to each other node
+			// build the rays to each other node
 			for (unsigned j = 0; j < m_numNodes; ++j)
 			{
-				// don't ever raycast to self
-				if (j == i) { continue; }
+				RayCastingInput *pCenterRay = &pRays[RAYS_PER_CONNECTION * j + 0];
+				RayCastingInput *pRightRay = &pRays[RAYS_PER_CONNECTION * j + 1];
+				RayCastingInput *pLeftRay = &pRays[RAYS_PER_CONNECTION * j + 2];
+
+				// don't ever raycast to self, an empty mask makes the batch skip it
+				if (j == i) { pCenterRay->m_layerMask = pRightRay->m_layerMask = pLeftRay->m_layerMask = 0; continue; }
 
 				// centers of objects
 				Vec3 iCenter = m_pNodesWithConnections[i].m_pNode->GetPosition();
@@ -438,10 +458,30 @@ namespace Engine
 				Vec3 iToJRight = jRight - iRight;
 				Vec3 iToJLeft = jLeft - iLeft;
 
-				// only check other points if the first path is clear, because raycasting is very expensive (will only do subsequent raycasts if the previous are a clear path
-				if (PathClear(CollisionTester::FindWall(iCenter, iToJCenter.Normalize(), iToJCenter.Length(), geometryLayer), m_pNodesWithConnections[j].m_pNodeOrigin, iToJCenter.Length())
-					&& PathClear(CollisionTester::FindWall(iRight, iToJRight.Normalize(), iToJRight.Length(), geometryLayer), m_pNodesWithConnections[j].m_pNodeOrigin, iToJRight.Length())
-					&& PathClear(CollisionTester::FindWall(iLeft, iToJLeft.Normalize(), iToJLeft.Length(), geometryLayer), m_pNodesWithConnections[j].m_pNodeOrigin, iToJLeft.Length()))
+				pCenterRay->m_rayPosition = iCenter; pCenterRay->m_rayDirection = iToJCenter.Normalize(); pCenterRay->m_checkDist = iToJCenter.Length(); pCenterRay->m_layerMask = CollisionTester::LayerBit(geometryLayer);
+				pRightRay->m_rayPosition = iRight; pRightRay->m_rayDirection = iToJRight.Normalize(); pRightRay->m_checkDist = iToJRight.Length(); pRightRay->m_layerMask = CollisionTester::LayerBit(geometryLayer);
+				pLeftRay->m_rayPosition = iLeft; pLeftRay->m_rayDirection = iToJLeft.Normalize(); pLeftRay->m_checkDist = iToJLeft.Length(); pLeftRay->m_layerMask = CollisionTester::LayerBit(geometryLayer);
+
+				// running into the node being looked at does not block the path to it
+				pCenterRay->m_pIgnoredObject = pRightRay->m_pIgnoredObject = pLeftRay->m_pIgnoredObject = m_pNodesWithConnections[j].m_pNodeOrigin;
+			}
+
+			// raycasting is very expensive, so all of the rays for this node are spread over the worker threads and each stops at the first thing in the way
+			const char *pPreviousTag = CollisionQueryStats::SetQueryTag("node map connections");
+			bool foundOcclusions = CollisionTester::FindOcclusions(pRays, pRayBlocked, RAYS_PER_CONNECTION * m_numNodes);
+			CollisionQueryStats::SetQueryTag(pPreviousTag);
+			if (!foundOcclusions) { GameLogger::Log(MessageType::cError, "Failed to MakeAutomagicNodeConnections! Failed to FindOcclusions!\n"); delete[] pRays; delete[] pRayBlocked; return false; }
+
+			// compare to each other node
+			for (unsigned j = 0; j < m_numNodes; ++j)
+			{
+				// don't ever connect to self
+				if (j == i) { continue; }
+
+				const RayCastingInput& rightRay = pRays[RAYS_PER_CONNECTION * j + 1];
+
+				// connected only if all three paths are clear
+				if (!pRayBlocked[RAYS_PER_CONNECTION * j + 0] && !pRayBlocked[RAYS_PER_CONNECTION * j + 1] && !pRayBlocked[RAYS_PER_CONNECTION * j + 2])
 				{
 					// the index in the array is the start plus the num seen so far
 					int arrayIndex = nextStartIndex + numICanSee;
@@ -450,7 +490,7 @@ namespace Engine
 					m_pConnectionsTo[arrayIndex] = j;
 
 					// make the arrow gob
-					AddArrowGobToList(iRight, iToJRight, i, j, pObjs, connectionLayer, outCountToUpdate, uniformCallback, uniformInstance);
+					AddArrowGobToList(rightRay.m_rayPosition, rightRay.m_rayDirection * rightRay.m_checkDist, i, j, pObjs, connectionLayer, outCountToUpdate, uniformCallback, uniformInstance);
 
 					// update counts
 					numICanSee++;
@@ -463,6 +503,9 @@ namespace Engine
 			nextStartIndex += numICanSee;
 		}
 
+		delete[] pRays;
+		delete[] pRayBlocked;
+
 		// set the number of connections we have so far removed (0 to start)
 		m_numRemoved = 0;
 
@@ -472,12 +515,6 @@ namespace Engine
 	}
 
 	// returns false if a ray cast from one object to another hit anything in between
-	bool AStarNodeMap::PathClear(const RayCastingOutput & rco, const GraphicalObject *pDestObj, float dist)
-	{
-		// the path is clear if we hit the destination object or it hit nothing withinthe distance
-		return (rco.m_didIntersect && rco.m_belongsTo == pDestObj) || !(rco.m_didIntersect) || (rco.m_distance > dist);
-	}
-
 	// iterates through array, condensing and updating nodes with connections
 	void AStarNodeMap::RemoveConnectionAndCondense(int fromIndex, int toIndex)
 	{
@@ -514,6 +551,7 @@ namespace Engine
 		// update our conter, we removed a connection
 		m_numConnections--;
 		m_numRemoved++;
+		BumpVersion();
 	}
 
 	// returns true if an object is in the collision layer, altered to be match signature for linked list walk callback
@@ -574,11 +612,22 @@ namespace Engine
 		return m_pConnectionsTo;
 	}
 
+	unsigned int AStarNodeMap::GetVersion() const
+	{
+		return m_version;
+	}
+
 	int AStarNodeMap::GetNumNodes() const
 	{
 		return m_numNodes;
 	}
 
+	// game thread only, like every other change to the map
+	void AStarNodeMap::BumpVersion()
+	{
+		m_version = ++s_nextVersion;
+	}
+
 	bool AStarNodeMap::DoMakeNodesFromGobs(GraphicalObject * pObj, void * pClass)
 	{
 		// get pointer to our map
@@ -589,7 +638,6 @@ namespace Engine
 		
 		// set it up based on our gob
 		pNewNode->SetPosition(pObj->GetPos());
-		pNewNode->SetParent(nullptr);
 		pNewNode->SetRadius(pObj->GetScaleMatPtr()->GetAddress()[0] * RADIUS_MULTIPLIER);
 		pNewNode->SetNodeEnabled(true);
 
@@ -60,6 +60,9 @@ namespace Engine
 		const int *GetConnections() const;
 		int GetNumNodes() const;
 
+		// changes whenever nodes or connections do, never repeats across maps, so a path found at one version is only good while it still matches
+		unsigned int GetVersion() const;
+
 		friend class AStarPathFinder;
 
 	private:
@@ -68,9 +71,9 @@ namespace Engine
 		bool ResetPreCalculation(LinkedList<GraphicalObject*> *pObjs, CollisionLayer connectionLayer, DestroyObjectCallback destroyCallback, void * pDestructionInstance, int *outCountToUpdate);
 		bool MakeNodesWithNoConnections(LinkedList<GraphicalObject*> *pObjs, CollisionLayer nodeLayer);
 		bool MakeAutomagicNodeConnections(LinkedList<GraphicalObject*> *pObjs, CollisionLayer connectionLayer, CollisionLayer geometryLayer, int *outCountToUpdate, SetUniformCallback uniformCallback, void *uniformInstance);
-		static bool PathClear(const RayCastingOutput& rco, const GraphicalObject *pDestObj, float dist);
 		void RemoveConnectionAndCondense(int fromIndex, int toIndex);
 		static bool DoMakeNodesFromGobs(GraphicalObject *pObj, void *pClass);
+		void BumpVersion();
 
 		static const int NODE_MAP_FILE_VERSION = 3;
 		int *m_pConnectionsTo{ nullptr };
@@ -79,6 +82,8 @@ namespace Engine
 		unsigned int m_numNodes{ 0 };
 		unsigned int m_nextWalkIndex{ 0 };
 		unsigned int m_numRemoved{ 0 };
+		unsigned int m_version{ 0 };
+		static unsigned int s_nextVersion;
 	};
 }
 
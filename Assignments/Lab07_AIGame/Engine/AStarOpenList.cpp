@@ -0,0 +1,149 @@
+#include "AStarOpenList.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// AStarOpenList.cpp
+// Binary min heap of node indices keyed by cost, with each node's place in the heap tracked so its cost can be lowered in place
+
+namespace Engine
+{
+	AStarOpenList::AStarOpenList()
+	{
+	}
+
+	AStarOpenList::~AStarOpenList()
+	{
+		CleanUp();
+	}
+
+	bool AStarOpenList::Initialize(int nodeCount)
+	{
+		if (nodeCount < 0) { GameLogger::Log(MessageType::cError, "Failed to initialize AStarOpenList! Node count [%d] was negative!\n", nodeCount); return false; }
+
+		// reuse what is already there when it is big enough
+		if (nodeCount <= m_capacity) { Clear(); return true; }
+
+		CleanUp();
+		m_pHeapNodes = new int[nodeCount];
+		m_pHeapCosts = new float[nodeCount];
+		m_pNodeSlots = new int[nodeCount];
+		if (!m_pHeapNodes || !m_pHeapCosts || !m_pNodeSlots) { GameLogger::Log(MessageType::cError, "Failed to allocate AStarOpenList for [%d] nodes!\n", nodeCount); CleanUp(); return false; }
+
+		for (int i = 0; i < nodeCount; ++i) { m_pNodeSlots[i] = -1; }
+		m_capacity = nodeCount;
+		return true;
+	}
+
+	// only the nodes still in the heap have a slot to forget, so this is as cheap as what is left
+	void AStarOpenList::Clear()
+	{
+		for (int i = 0; i < m_count; ++i) { m_pNodeSlots[m_pHeapNodes[i]] = -1; }
+		m_count = 0;
+	}
+
+	bool AStarOpenList::IsEmpty() const
+	{
+		return m_count == 0;
+	}
+
+	int AStarOpenList::GetCount() const
+	{
+		return m_count;
+	}
+
+	bool AStarOpenList::Contains(int nodeIndex) const
+	{
+		return nodeIndex >= 0 && nodeIndex < m_capacity && m_pNodeSlots[nodeIndex] >= 0;
+	}
+
+	bool AStarOpenList::Push(int nodeIndex, float cost)
+	{
+		if (nodeIndex < 0 || nodeIndex >= m_capacity) { GameLogger::Log(MessageType::cError, "Failed to push node [%d] onto AStarOpenList! Only [%d] nodes fit!\n", nodeIndex, m_capacity); return false; }
+		if (m_pNodeSlots[nodeIndex] >= 0) { return DecreaseCost(nodeIndex, cost); }
+
+		PlaceAt(m_count++, nodeIndex, cost);
+		SiftUp(m_count - 1);
+		return true;
+	}
+
+	// a cost that is not lower leaves the node where it is
+	bool AStarOpenList::DecreaseCost(int nodeIndex, float newCost)
+	{
+		if (!Contains(nodeIndex)) { GameLogger::Log(MessageType::cError, "Failed to decrease cost of node [%d]! It was not in the AStarOpenList!\n", nodeIndex); return false; }
+
+		int slot = m_pNodeSlots[nodeIndex];
+		if (newCost >= m_pHeapCosts[slot]) { return true; }
+
+		m_pHeapCosts[slot] = newCost;
+		SiftUp(slot);
+		return true;
+	}
+
+	// returns -1 when empty
+	int AStarOpenList::PopCheapest()
+	{
+		if (m_count == 0) { return -1; }
+
+		int cheapest = m_pHeapNodes[0];
+		m_pNodeSlots[cheapest] = -1;
+		if (--m_count > 0)
+		{
+			PlaceAt(0, m_pHeapNodes[m_count], m_pHeapCosts[m_count]);
+			SiftDown(0);
+		}
+
+		return cheapest;
+	}
+
+	void AStarOpenList::SiftUp(int slot)
+	{
+		int nodeIndex = m_pHeapNodes[slot];
+		float cost = m_pHeapCosts[slot];
+		while (slot > 0)
+		{
+			int parent = (slot - 1) / 2;
+			if (m_pHeapCosts[parent] <= cost) { break; }
+			PlaceAt(slot, m_pHeapNodes[parent], m_pHeapCosts[parent]);
+			slot = parent;
+		}
+
+		PlaceAt(slot, nodeIndex, cost);
+	}
+
+	void AStarOpenList::SiftDown(int slot)
+	{
+		int nodeIndex = m_pHeapNodes[slot];
+		float cost = m_pHeapCosts[slot];
+		for (;;)
+		{
+			int child = 2 * slot + 1;
+			if (child >= m_count) { break; }
+			if (child + 1 < m_count && m_pHeapCosts[child + 1] < m_pHeapCosts[child]) { child++; }
+			if (m_pHeapCosts[child] >= cost) { break; }
+			PlaceAt(slot, m_pHeapNodes[child], m_pHeapCosts[child]);
+			slot = child;
+		}
+
+		PlaceAt(slot, nodeIndex, cost);
+	}
+
+	void AStarOpenList::PlaceAt(int slot, int nodeIndex, float cost)
+	{
+		m_pHeapNodes[slot] = nodeIndex;
+		m_pHeapCosts[slot] = cost;
+		m_pNodeSlots[nodeIndex] = slot;
+	}
+
+	void AStarOpenList::CleanUp()
+	{
+		delete[] m_pHeapNodes;
+		delete[] m_pHeapCosts;
+		delete[] m_pNodeSlots;
+		m_pHeapNodes = nullptr;
+		m_pHeapCosts = nullptr;
+		m_pNodeSlots = nullptr;
+		m_count = 0;
+		m_capacity = 0;
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef ASTAROPENLIST_H
+#define ASTAROPENLIST_H
+
+// agent
+// 10/17/2026
+// AStarOpenList.h
+// Binary min heap of node indices keyed by cost, with each node's place in the heap tracked so its cost can be lowered in place
+
+#include "ExportHeader.h"
+
+namespace Engine
+{
+	class ENGINE_SHARED AStarOpenList
+	{
+	public:
+		AStarOpenList();
+		~AStarOpenList();
+
+		// node indices must stay below nodeCount, memory is only reallocated when nodeCount grows
+		bool Initialize(int nodeCount);
+		void Clear();
+		bool IsEmpty() const;
+		int GetCount() const;
+		bool Contains(int nodeIndex) const;
+		bool Push(int nodeIndex, float cost);
+		bool DecreaseCost(int nodeIndex, float newCost);
+		int PopCheapest();
+
+	private:
+		void SiftUp(int slot);
+		void SiftDown(int slot);
+		void PlaceAt(int slot, int nodeIndex, float cost);
+		void CleanUp();
+
+		// heap slots hold a node and its cost side by side, m_pNodeSlots maps a node back to its slot or -1 when it is not in the heap
+		int *m_pHeapNodes{ nullptr };
+		float *m_pHeapCosts{ nullptr };
+		int *m_pNodeSlots{ nullptr };
+		int m_count{ 0 };
+		int m_capacity{ 0 };
+	};
+}
+
+#endif // ifndef ASTAROPENLIST_H
@@ -0,0 +1,236 @@
+#include "AStarPathCache.h"
+#include "AStarNodeMap.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// AStarPathCache.cpp
+// Keeps the most recently used solved paths by their from and to nodes so the same search is not run again until the map changes
+
+namespace Engine
+{
+	AStarPathCache::AStarPathCache()
+	{
+	}
+
+	AStarPathCache::~AStarPathCache()
+	{
+		Clear();
+		delete[] m_pBuckets;
+		m_pBuckets = nullptr;
+	}
+
+	void AStarPathCache::SetCapacity(int capacity)
+	{
+		m_capacity = (capacity < 1) ? 1 : ((capacity > MAX_CAPACITY) ? MAX_CAPACITY : capacity);
+		while (m_count > m_capacity) { m_evictionCount++; Forget(m_pOldest); }
+
+		// buckets are sized on the first insert, after that they follow the capacity
+		if (m_pBuckets) { Rehash(); }
+	}
+
+	int AStarPathCache::GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+	int AStarPathCache::GetCount() const
+	{
+		return m_count;
+	}
+
+	const AStarPath * AStarPathCache::Acquire(const AStarNodeMap * pNodeMap, int fromNodeIndex, int toNodeIndex)
+	{
+		if (!pNodeMap) { return nullptr; }
+		MatchMap(pNodeMap);
+
+		Entry *pEntry = Find(fromNodeIndex, toNodeIndex);
+		if (!pEntry) { return nullptr; }
+
+		m_hitCount++;
+		pEntry->refCount++;
+		MakeNewest(pEntry);
+		return pEntry;
+	}
+
+	const AStarPath * AStarPathCache::Insert(const AStarNodeMap * pNodeMap, unsigned int mapVersion, int fromNodeIndex, int toNodeIndex, int * pNodes, int nodeCount)
+	{
+		Entry *pEntry = new Entry();
+		if (!pEntry) { GameLogger::Log(MessageType::cError, "Failed to allocate AStarPathCache entry for path from node [%d] to node [%d]!\n", fromNodeIndex, toNodeIndex); delete[] pNodes; return nullptr; }
+
+		pEntry->m_pNodes = pNodes;
+		pEntry->m_nodeCount = pNodes ? nodeCount : 0;
+		pEntry->fromNodeIndex = fromNodeIndex;
+		pEntry->toNodeIndex = toNodeIndex;
+		pEntry->refCount = 1;
+		m_missCount++;
+
+		if (!pNodeMap) { return pEntry; }
+		MatchMap(pNodeMap);
+		if (mapVersion != m_mapVersion) { return pEntry; }
+
+		if (!m_pBuckets && !Rehash()) { return pEntry; }
+
+		Entry *pOld = Find(fromNodeIndex, toNodeIndex);
+		if (pOld) { Forget(pOld); }
+		while (m_count >= m_capacity) { m_evictionCount++; Forget(m_pOldest); }
+
+		Entry *&pBucket = m_pBuckets[BucketFor(fromNodeIndex, toNodeIndex)];
+		pEntry->pHashNext = pBucket;
+		pBucket = pEntry;
+		pEntry->cached = true;
+		m_count++;
+		MakeNewest(pEntry);
+		return pEntry;
+	}
+
+	void AStarPathCache::Retain(const AStarPath * pPath)
+	{
+		if (pPath) { static_cast<Entry*>(const_cast<AStarPath*>(pPath))->refCount++; }
+	}
+
+	void AStarPathCache::Release(const AStarPath * pPath)
+	{
+		if (!pPath) { return; }
+
+		Entry *pEntry = static_cast<Entry*>(const_cast<AStarPath*>(pPath));
+		if (pEntry->refCount <= 0) { GameLogger::Log(MessageType::cError, "Failed to release path from node [%d] to node [%d]! It was not held!\n", pEntry->fromNodeIndex, pEntry->toNodeIndex); return; }
+		if (--pEntry->refCount == 0 && !pEntry->cached) { FreeEntry(pEntry); }
+	}
+
+	void AStarPathCache::Clear()
+	{
+		while (m_pOldest) { Forget(m_pOldest); }
+	}
+
+	long long AStarPathCache::GetHitCount() const
+	{
+		return m_hitCount;
+	}
+
+	long long AStarPathCache::GetMissCount() const
+	{
+		return m_missCount;
+	}
+
+	long long AStarPathCache::GetEvictionCount() const
+	{
+		return m_evictionCount;
+	}
+
+	int AStarPathCache::GetFlushCount() const
+	{
+		return m_flushCount;
+	}
+
+	float AStarPathCache::GetHitRate() const
+	{
+		long long lookups = m_hitCount + m_missCount;
+		return lookups ? (float)m_hitCount / (float)lookups : 0.0f;
+	}
+
+	void AStarPathCache::ResetCounters()
+	{
+		m_hitCount = 0;
+		m_missCount = 0;
+		m_evictionCount = 0;
+		m_flushCount = 0;
+	}
+
+	void AStarPathCache::LogStats() const
+	{
+		GameLogger::Log(MessageType::ConsoleOnly, "Path cache holds [%d] of [%d] paths, [%lld] hits and [%lld] misses for a hit rate of [%.1f%%], [%lld] evicted, flushed [%d] times for map changes\n",
+			m_count, m_capacity, m_hitCount, m_missCount, GetHitRate() * 100.0f, m_evictionCount, m_flushCount);
+	}
+
+	void AStarPathCache::MatchMap(const AStarNodeMap * pNodeMap)
+	{
+		unsigned int version = pNodeMap->GetVersion();
+		if (pNodeMap == m_pNodeMap && version == m_mapVersion) { return; }
+
+		if (m_count) { m_flushCount++; }
+		Clear();
+		m_pNodeMap = pNodeMap;
+		m_mapVersion = version;
+	}
+
+	// twice as many buckets as paths keeps the chains short
+	bool AStarPathCache::Rehash()
+	{
+		int bucketCount = 1;
+		while (bucketCount < m_capacity * 2) { bucketCount <<= 1; }
+
+		delete[] m_pBuckets;
+		m_pBuckets = new Entry*[bucketCount]();
+		if (!m_pBuckets) { GameLogger::Log(MessageType::cError, "Failed to allocate [%d] AStarPathCache buckets!\n", bucketCount); m_bucketMask = 0; Clear(); return false; }
+		m_bucketMask = bucketCount - 1;
+
+		for (Entry *pWalk = m_pOldest; pWalk; pWalk = pWalk->pNewer)
+		{
+			Entry *&pBucket = m_pBuckets[BucketFor(pWalk->fromNodeIndex, pWalk->toNodeIndex)];
+			pWalk->pHashNext = pBucket;
+			pBucket = pWalk;
+		}
+
+		return true;
+	}
+
+	AStarPathCache::Entry * AStarPathCache::Find(int fromNodeIndex, int toNodeIndex) const
+	{
+		if (!m_pBuckets) { return nullptr; }
+
+		Entry *pEntry = m_pBuckets[BucketFor(fromNodeIndex, toNodeIndex)];
+		while (pEntry && (pEntry->fromNodeIndex != fromNodeIndex || pEntry->toNodeIndex != toNodeIndex)) { pEntry = pEntry->pHashNext; }
+		return pEntry;
+	}
+
+	int AStarPathCache::BucketFor(int fromNodeIndex, int toNodeIndex) const
+	{
+		unsigned int hash = (unsigned int)fromNodeIndex * 2654435761u ^ (unsigned int)toNodeIndex * 40503u;
+		return (int)((hash ^ (hash >> 15)) & (unsigned int)m_bucketMask);
+	}
+
+	// takes an entry out of the cache, it lives on until whoever still holds it lets go
+	void AStarPathCache::Forget(Entry * pEntry)
+	{
+		if (m_pBuckets)
+		{
+			Entry **ppWalk = &m_pBuckets[BucketFor(pEntry->fromNodeIndex, pEntry->toNodeIndex)];
+			while (*ppWalk && *ppWalk != pEntry) { ppWalk = &(*ppWalk)->pHashNext; }
+			if (*ppWalk) { *ppWalk = pEntry->pHashNext; }
+		}
+
+		if (pEntry->pOlder) { pEntry->pOlder->pNewer = pEntry->pNewer; } else { m_pOldest = pEntry->pNewer; }
+		if (pEntry->pNewer) { pEntry->pNewer->pOlder = pEntry->pOlder; } else { m_pNewest = pEntry->pOlder; }
+		pEntry->pHashNext = nullptr;
+		pEntry->pOlder = nullptr;
+		pEntry->pNewer = nullptr;
+		pEntry->cached = false;
+		m_count--;
+
+		if (pEntry->refCount == 0) { FreeEntry(pEntry); }
+	}
+
+	void AStarPathCache::MakeNewest(Entry * pEntry)
+	{
+		if (pEntry == m_pNewest) { return; }
+
+		// unlink, unless it is new and was never linked
+		if (pEntry->pOlder || pEntry->pNewer || pEntry == m_pOldest)
+		{
+			if (pEntry->pOlder) { pEntry->pOlder->pNewer = pEntry->pNewer; } else { m_pOldest = pEntry->pNewer; }
+			pEntry->pNewer->pOlder = pEntry->pOlder;
+		}
+
+		pEntry->pOlder = m_pNewest;
+		pEntry->pNewer = nullptr;
+		if (m_pNewest) { m_pNewest->pNewer = pEntry; } else { m_pOldest = pEntry; }
+		m_pNewest = pEntry;
+	}
+
+	void AStarPathCache::FreeEntry(Entry * pEntry)
+	{
+		delete[] pEntry->m_pNodes;
+		delete pEntry;
+	}
+}
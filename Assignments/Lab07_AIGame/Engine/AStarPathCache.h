@@ -0,0 +1,94 @@
+#ifndef ASTARPATHCACHE_H
+#define ASTARPATHCACHE_H
+
+// agent
+// 10/17/2026
+// AStarPathCache.h
+// Keeps the most recently used solved paths by their from and to nodes so the same search is not run again until the map changes
+
+#include "ExportHeader.h"
+
+namespace Engine
+{
+	class AStarNodeMap;
+
+	// a solved path shared read only by the cache and everyone following it, zero nodes means there was no path
+	struct ENGINE_SHARED AStarPath
+	{
+		const int *m_pNodes{ nullptr };
+		int m_nodeCount{ 0 };
+	};
+
+	class ENGINE_SHARED AStarPathCache
+	{
+	public:
+		static const int DEFAULT_CAPACITY = 256;
+		static const int MAX_CAPACITY = 4096;
+
+		AStarPathCache();
+		~AStarPathCache();
+
+		// paths over the new capacity are dropped least recently used first
+		void SetCapacity(int capacity);
+		int GetCapacity() const;
+		int GetCount() const;
+
+		// only remembers one map at a time, asking about another map or a changed one forgets everything first
+		// a hit is held for the caller until it is released and costs no allocation, nullptr on a miss
+		const AStarPath *Acquire(const AStarNodeMap *pNodeMap, int fromNodeIndex, int toNodeIndex);
+
+		// takes over pNodes (allocated with new[], nullptr when there was no path) and returns the path held once for the caller
+		// a path searched at an older version of the map is handed back but never remembered
+		const AStarPath *Insert(const AStarNodeMap *pNodeMap, unsigned int mapVersion, int fromNodeIndex, int toNodeIndex, int *pNodes, int nodeCount);
+		void Retain(const AStarPath *pPath);
+		void Release(const AStarPath *pPath);
+
+		// forgets every path, ones still held are freed by their last release
+		void Clear();
+
+		// misses count searches that had to be inserted, so hit rate is how many asked for paths skipped searching
+		long long GetHitCount() const;
+		long long GetMissCount() const;
+		long long GetEvictionCount() const;
+		int GetFlushCount() const;
+		float GetHitRate() const;
+		void ResetCounters();
+		void LogStats() const;
+
+	private:
+		// pHashNext chains entries in the same bucket, pOlder and pNewer keep the least recently used order
+		struct Entry : public AStarPath
+		{
+			int fromNodeIndex{ -1 };
+			int toNodeIndex{ -1 };
+			int refCount{ 0 };
+			bool cached{ false };
+			Entry *pHashNext{ nullptr };
+			Entry *pOlder{ nullptr };
+			Entry *pNewer{ nullptr };
+		};
+
+		void MatchMap(const AStarNodeMap *pNodeMap);
+		bool Rehash();
+		Entry *Find(int fromNodeIndex, int toNodeIndex) const;
+		int BucketFor(int fromNodeIndex, int toNodeIndex) const;
+		void Forget(Entry *pEntry);
+		void MakeNewest(Entry *pEntry);
+		void FreeEntry(Entry *pEntry);
+
+		Entry **m_pBuckets{ nullptr };
+		int m_bucketMask{ 0 };
+		Entry *m_pOldest{ nullptr };
+		Entry *m_pNewest{ nullptr };
+		int m_count{ 0 };
+		int m_capacity{ DEFAULT_CAPACITY };
+		const AStarNodeMap *m_pNodeMap{ nullptr };
+		unsigned int m_mapVersion{ 0 };
+		long long m_hitCount{ 0 };
+		long long m_missCount{ 0 };
+		long long m_evictionCount{ 0 };
+		int m_flushCount{ 0 };
+	};
+}
+
+#endif // ifndef ASTARPATHCACHE_H
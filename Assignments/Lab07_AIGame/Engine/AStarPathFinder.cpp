@@ -1,4 +1,6 @@
 #include "AStarPathFinder.h"
+#include "AStarOpenList.h"
+#include "GameLogger.h"
 
 // Justin Furtado
 // 5/13/2017
@@ -7,75 +9,65 @@
 
 namespace Engine
 {
-	int * AStarPathFinder::FindPath(const AStarNodeMap * pNodeMap, const Vec3 & fromLocation, const Vec3 & toLocation, int *outNumNodes)
+	int * AStarPathFinder::FindPath(const AStarNodeMap * pNodeMap, const Vec3 & fromLocation, const Vec3 & toLocation, int *outNumNodes, AStarSearchContext *pContext)
 	{
-		return FindPath(pNodeMap, pNodeMap->FindNearestNodeIndex(fromLocation), pNodeMap->FindNearestNodeIndex(toLocation), outNumNodes);
+		return FindPath(pNodeMap, pNodeMap->FindNearestNodeIndex(fromLocation), pNodeMap->FindNearestNodeIndex(toLocation), outNumNodes, pContext);
 	}
 
-	int * AStarPathFinder::FindPath(const AStarNodeMap * pNodeMap, int fromNodeIndex, int toNodeIndex, int *outNumNodes)
+	int * AStarPathFinder::FindPath(const AStarNodeMap * pNodeMap, int fromNodeIndex, int toNodeIndex, int *outNumNodes, AStarSearchContext *pContext)
 	{
-		// start and end nodes
-		AStarNodeMap::NodeWithConnections *pStartNode = &pNodeMap->m_pNodesWithConnections[fromNodeIndex];
-		AStarNodeMap::NodeWithConnections *pEndNode = &pNodeMap->m_pNodesWithConnections[toNodeIndex];
+		int nodeCount = (int)pNodeMap->m_numNodes;
+		if (fromNodeIndex < 0 || fromNodeIndex >= nodeCount || toNodeIndex < 0 || toNodeIndex >= nodeCount) { GameLogger::Log(MessageType::cError, "Failed to find path from node [%d] to node [%d]! Map only has [%d] nodes!\n", fromNodeIndex, toNodeIndex, nodeCount); *outNumNodes = 0; return nullptr; }
 
 		// if they are trying to pathfind from a node to itself... they needn't move!
-		if (pStartNode == pEndNode) { *outNumNodes = 0; return nullptr; }
+		if (fromNodeIndex == toNodeIndex) { *outNumNodes = 0; return nullptr; }
 
-		// make the open and closed lists
-		LinkedList<AStarNodeMap::NodeWithConnections*> openList;
-		LinkedList<AStarNodeMap::NodeWithConnections*> closedList;
+		// each thread keeps one around for callers that do not bring their own, so searching never allocates once it has seen the biggest map
+		static thread_local AStarSearchContext s_threadContext;
+		AStarSearchContext *pSearch = pContext ? pContext : &s_threadContext;
+		if (!pSearch->BeginSearch(nodeCount)) { *outNumNodes = 0; return nullptr; }
+		AStarOpenList *pOpenList = pSearch->GetOpenList();
 
-		// add the start node to the open list
-		openList.AddToListFront(pStartNode); // no need for callback as it should be the only node in the list right now
-		pStartNode->m_pNode->m_cost = (pStartNode->m_pNode->m_position - pEndNode->m_pNode->m_position).Length(); // set the total cost of the start node... just the h cost????
-		pStartNode->m_pNode->m_pParent = nullptr; // prevent circular path
+		// add the start node to the open list, its total cost is all guess since it has not walked anywhere
+		Vec3 endPosition = pNodeMap->m_pNodesWithConnections[toNodeIndex].m_pNode->m_position;
+		pSearch->Visit(fromNodeIndex, 0.0f, -1);
+		pOpenList->Push(fromNodeIndex, (pNodeMap->m_pNodesWithConnections[fromNodeIndex].m_pNode->m_position - endPosition).Length());
 
 		// keep going so long as we have nodes in our open list
-		while (openList.GetCount() > 0)
+		while (!pOpenList->IsEmpty())
 		{
-			// THE FIRST NODE IN OUR LIST HAS THE LOWEST COST BECAUSE WE SORT IT AS WE PLACE NODES IN THE LISTS
-			AStarNodeMap::NodeWithConnections *pCurrentNode = openList.GetFirstObjectData(); // get the node with the lowest cost in the list
-			openList.RemoveFirstFromList(pCurrentNode); // remove the current node from the list
-			closedList.AddToListWhere(pCurrentNode, AStarPathFinder::NodeGreaterThan, pCurrentNode); // add to the closed list, in order
+			// the top of the heap has the lowest total cost
+			int currentIndex = pOpenList->PopCheapest();
+			pSearch->Close(currentIndex);
 
 			// if the current node is the end node, we are done pathfinding as we have reached out destination
-			if (pCurrentNode == pEndNode)
+			if (currentIndex == toNodeIndex)
 			{
 				// allocate memory and return the path to this node
-				return GetPathFromAncestors(pNodeMap, pCurrentNode->m_pNode, outNumNodes);
+				return GetPathFromParents(*pSearch, currentIndex, outNumNodes);
 			}
 
 			// for each neighbor node/connected node of the current node
+			const AStarNodeMap::NodeWithConnections *pCurrentNode = &pNodeMap->m_pNodesWithConnections[currentIndex];
+			float currentWalkedCost = pSearch->GetWalkedCost(currentIndex);
 			int end = pCurrentNode->m_connectionIndex + pCurrentNode->m_connectionCount;
 			for (int i = pCurrentNode->m_connectionIndex; i < end; ++i)
 			{
-				// find out neighbor
-				AStarNodeMap::NodeWithConnections *pNeighbor = &pNodeMap->m_pNodesWithConnections[pNodeMap->m_pConnectionsTo[i]];
-
-				// see if its closed or not traversable
-				if (closedList.Contains(pNeighbor) /* || not traversable!!!*/) { continue; }
-
-				// if the new path is shorter or the neighbor is not in the open list
-				if (pNeighbor->m_pNode->m_cost < pCurrentNode->m_pNode->m_cost || !openList.Contains(pNeighbor)) // TODO CHECK COST COMPARE...
-				{
-					// set the cost of the neighbor
-					float parentHCost = (pCurrentNode->m_pNode->m_position - pEndNode->m_pNode->m_position).Length();
-					float myHCost = (pNeighbor->m_pNode->m_position - pEndNode->m_pNode->m_position).Length();
-					float gCostOffset = (pCurrentNode->m_pNode->m_position - pNeighbor->m_pNode->m_position).Length();
-
-					// should give us currect AStarCost!?!?!?!?
-					pNeighbor->m_pNode->m_cost = pCurrentNode->m_pNode->m_cost + gCostOffset + (myHCost - parentHCost);
-
-					// set the parent of the neighbor
-					pNeighbor->m_pNode->m_pParent = pCurrentNode->m_pNode;
-
-					// add the neighbor to the open list, if it is not already in the list
-					if (!openList.Contains(pNeighbor))
-					{
-						// add it in order so we do not need to search to find the lowest cost node
-						openList.AddToListWhere(pNeighbor, AStarPathFinder::NodeGreaterThan, pNeighbor);
-					}
-				}
+				// straight line distances never overestimate, so a closed node already has its shortest path
+				int neighborIndex = pNodeMap->m_pConnectionsTo[i];
+				if (pSearch->IsClosed(neighborIndex) /* || not traversable!!!*/) { continue; }
+
+				// only keep the new path if the neighbor is new or this way is shorter
+				const Vec3& neighborPosition = pNodeMap->m_pNodesWithConnections[neighborIndex].m_pNode->m_position;
+				float walkedCost = currentWalkedCost + (pCurrentNode->m_pNode->m_position - neighborPosition).Length();
+				bool isOpen = pOpenList->Contains(neighborIndex);
+				if (isOpen && walkedCost >= pSearch->GetWalkedCost(neighborIndex)) { continue; }
+
+				// total cost is the distance walked plus the straight line guess for the rest
+				pSearch->Visit(neighborIndex, walkedCost, currentIndex);
+				float totalCost = walkedCost + (neighborPosition - endPosition).Length();
+				if (isOpen) { pOpenList->DecreaseCost(neighborIndex, totalCost); }
+				else { pOpenList->Push(neighborIndex, totalCost); }
 			}
 		}
 
@@ -83,45 +75,18 @@ namespace Engine
 		return nullptr;
 	}
 
-	bool AStarPathFinder::NodeGreaterThan(AStarNodeMap::NodeWithConnections * pNode, void * pCheckNode)
+	int * AStarPathFinder::GetPathFromParents(const AStarSearchContext & context, int endNodeIndex, int *outNumNodes)
 	{
-		// cast the node we're comparing
-		AStarNodeMap::NodeWithConnections *pNodeCompare = reinterpret_cast<AStarNodeMap::NodeWithConnections*>(pCheckNode);
-
-		// return true (meaning stop in the case we're passing this method to) when the cost of the node in the list is greater than the cost of the node we are going to add
-		// should place the node in ascending cost order
-		return pNode->m_pNode->m_cost > pNodeCompare->m_pNode->m_cost;
-	}
-
-	int * AStarPathFinder::GetPathFromAncestors(const AStarNodeMap *pNodeMap, AStarNode * pNode, int *outNumNodes)
-	{
-		// start at the node
-		AStarNode *pCurrentNode = pNode;
-
-		// initialize counter
-		int numSteps = 0;
-
 		// loop through all the ancestors, counting them
-		while (pCurrentNode)
-		{
-			++numSteps; // add one to counter
-			pCurrentNode = pCurrentNode->m_pParent; // move up an ancestor
-		}
+		int numSteps = 0;
+		for (int i = endNodeIndex; i >= 0; i = context.GetParentIndex(i)) { ++numSteps; }
 
 		// allocate only the amount of memory we need
 		int *pPath = new int[numSteps]; // how many nodes we need
 		*outNumNodes = numSteps; // set out variable
 
-		// start back at the bottom node
-		pCurrentNode = pNode;
-
-		// loop up
-		while (pCurrentNode)
-		{
-			// backwards-fill the array with node indices so we can access them
-			pPath[--numSteps] = pNodeMap->NodeIndex(pCurrentNode);
-			pCurrentNode = pCurrentNode->m_pParent; // move up a parent
-		}
+		// backwards-fill the array with node indices so we can access them
+		for (int i = endNodeIndex; i >= 0; i = context.GetParentIndex(i)) { pPath[--numSteps] = i; }
 
 		// return the path
 		return pPath;
@@ -10,6 +10,7 @@
 #include "AStarNodeMap.h"
 #include "LinkedList.h"
 #include "AStarNode.h"
+#include "AStarSearchContext.h"
 
 namespace Engine
 {
@@ -17,12 +18,13 @@ namespace Engine
 	{
 	public:
 		// WARNING, MEMORY ALLOCATED AND RETURNED, CALLER RESPONSIBILITY TO DELETE
-		static int *FindPath(const AStarNodeMap *pNodeMap, const Vec3& fromLocation, const Vec3& toLocation, int *outNumNodes);
-		static int *FindPath(const AStarNodeMap *pNodeMap, int fromNodeIndex, int toNodeIndex, int *outNumNodes);
-		static bool NodeGreaterThan(AStarNodeMap::NodeWithConnections *pNode, void *pCheckNode);
+		// the node map is only read, so any number of threads can search the same map at once as long as no two share a context
+		// without a context the search uses one kept for the calling thread
+		static int *FindPath(const AStarNodeMap *pNodeMap, const Vec3& fromLocation, const Vec3& toLocation, int *outNumNodes, AStarSearchContext *pContext = nullptr);
+		static int *FindPath(const AStarNodeMap *pNodeMap, int fromNodeIndex, int toNodeIndex, int *outNumNodes, AStarSearchContext *pContext = nullptr);
 
 	private:
-		static int *GetPathFromAncestors(const AStarNodeMap *pNodeMap, AStarNode *pNode, int *outNumNodes);
+		static int *GetPathFromParents(const AStarSearchContext& context, int endNodeIndex, int *outNumNodes);
 
 	};
 }
@@ -24,7 +24,8 @@ namespace Engine
 
 	AStarPathFollowComponent::~AStarPathFollowComponent()
 	{
-		if (followingPath) { delete[] followingPath; }
+		DropPath();
+		AStarPathRequests::Cancel(m_pathRequest);
 	}
 
 	bool AStarPathFollowComponent::Initialize()
@@ -44,11 +45,14 @@ namespace Engine
 	{
 		Vec3 pos = m_pSpatialComp->GetPosition();
 
+		// a path asked for on an earlier frame takes over as soon as it has been found
+		CollectRequestedPath();
+
 		if (m_nextPathIndex >= m_pathSize)
 		{
 			if (m_randomTargetNode)
 			{
-				delete[] followingPath; followingPath = nullptr;
+				m_wantsNewPath = true;
 			}
 			else
 			{
@@ -57,16 +61,7 @@ namespace Engine
 			}
 		 }
 		
-		if (!followingPath)
-		{ 
-			int toPos = m_randomTargetNode ? MathUtility::Rand(0, m_pNodeMap->GetNumNodes()) : m_closestToTarget;
-			int fromPos = m_pNodeMap->FindNearestNodeIndex(pos);
-			if (fromPos != toPos)
-			{
-				followingPath = AStarPathFinder::FindPath(m_pNodeMap, fromPos, toPos, &m_pathSize);
-				m_nextPathIndex = 0;
-			}
-		}
+		if (m_wantsNewPath) { RequestPath(pos); }
 
 		if (followingPath && m_nextPathIndex < m_pathSize)
 		{
@@ -124,11 +119,15 @@ namespace Engine
 
 	void AStarPathFollowComponent::ForceRecalc(const Vec3 & followPos)
 	{
-		if (followingPath) { delete[] followingPath; followingPath = nullptr; }
+		DropPath();
+		AStarPathRequests::Cancel(m_pathRequest);
+		m_pathRequest = NO_PATH_REQUEST;
+		m_wantsNewPath = false;
 		m_recalcAtNextNode = false;
 		m_closestToTarget = m_pNodeMap->FindNearestNodeIndex(followPos);
+		m_forcedNode = m_closestToTarget;
 		m_pathSize = 1;
-		followingPath = new int[1]{m_closestToTarget};
+		followingPath = &m_forcedNode;
 		m_nextPathIndex = 0;
 	}
 
@@ -141,11 +140,50 @@ namespace Engine
 	{
 		if (m_recalcAtNextNode)
 		{
-			if (followingPath) { delete[] followingPath; followingPath = nullptr; }
+			m_wantsNewPath = true;
 			m_recalcAtNextNode = false;
 		}
 	}
 
+	// only one request at a time, a target that changes while one is out is picked up by the next
+	void AStarPathFollowComponent::RequestPath(const Vec3 & pos)
+	{
+		if (m_pathRequest != NO_PATH_REQUEST) { return; }
+
+		int toPos = m_randomTargetNode ? MathUtility::Rand(0, m_pNodeMap->GetNumNodes()) : m_closestToTarget;
+		int fromPos = m_pNodeMap->FindNearestNodeIndex(pos);
+		if (fromPos != toPos) { m_pathRequest = AStarPathRequests::Submit(m_pNodeMap, fromPos, toPos); }
+	}
+
+	void AStarPathFollowComponent::CollectRequestedPath()
+	{
+		if (m_pathRequest == NO_PATH_REQUEST) { return; }
+
+		PathRequestStatus status = AStarPathRequests::GetStatus(m_pathRequest);
+		if (status == PathRequestStatus::PENDING) { return; }
+
+		// no path leaves the old one to finish, and asks again next frame
+		const AStarPath *pPath = (status == PathRequestStatus::UNKNOWN) ? nullptr : AStarPathRequests::TakePath(m_pathRequest);
+		m_pathRequest = NO_PATH_REQUEST;
+		if (!pPath) { return; }
+
+		DropPath();
+		m_pSharedPath = pPath;
+		followingPath = pPath->m_pNodes;
+		m_pathSize = pPath->m_nodeCount;
+		m_nextPathIndex = 0;
+		m_wantsNewPath = false;
+	}
+
+	// the path may still be followed by others, so it is only let go of, never deleted here
+	void AStarPathFollowComponent::DropPath()
+	{
+		AStarPathRequests::ReleasePath(m_pSharedPath);
+		m_pSharedPath = nullptr;
+		followingPath = nullptr;
+		m_pathSize = 0;
+	}
+
 	void AStarPathFollowComponent::SetColorFromState()
 	{
 		// only need to change color on state change
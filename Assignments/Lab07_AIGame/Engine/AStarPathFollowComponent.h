@@ -9,6 +9,7 @@
 #include "ExportHeader.h"
 #include "Component.h"
 #include "AStarPathFinder.h"
+#include "AStarPathRequests.h"
 #include "CollisionTester.h"
 
 namespace Engine
@@ -32,9 +33,15 @@ namespace Engine
 
 	private:
 		void HandleRecalcAtNext();
+		void RequestPath(const Vec3& pos);
+		void CollectRequestedPath();
+		void DropPath();
 		void SetColorFromState();
 		
-		int *followingPath = nullptr;
+		// points into the shared path being followed, or at the one node ForceRecalc heads for
+		const int *followingPath = nullptr;
+		const AStarPath *m_pSharedPath{ nullptr };
+		int m_forcedNode{ 0 };
 		int m_pathSize = 0;
 		int m_nextPathIndex = 0;
 		AStarNodeMap *m_pNodeMap;
@@ -43,6 +50,10 @@ namespace Engine
 		int m_closestToTarget{ 0 };
 		bool m_randomTargetNode{ true };
 		bool m_recalcAtNextNode{ false };
+
+		// a new path is asked for instead of searched right away, the old one is followed until the answer comes back
+		bool m_wantsNewPath{ true };
+		PathRequestHandle m_pathRequest{ NO_PATH_REQUEST };
 		GraphicalObjectComponent *m_pGobComp{ nullptr };
 		SpatialComponent *m_pSpatialComp{ nullptr };
 		float m_speed{ 50.0f };
@@ -0,0 +1,231 @@
+#include "AStarPathRequests.h"
+#include "AStarPathFinder.h"
+#include "AStarNodeMap.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// AStarPathRequests.cpp
+// Queues A* searches from anyone during a frame and solves them together on worker threads at one point in the next
+
+namespace Engine
+{
+	// a handle is the slot plus one in the low bits and the slot's generation above them
+	const int HANDLE_SLOT_BITS = 16;
+	const unsigned HANDLE_SLOT_MASK = (1u << HANDLE_SLOT_BITS) - 1u;
+	const int DEFAULT_SEARCHES_PER_FRAME = 32;
+
+	AStarPathRequests::PathRequest AStarPathRequests::s_requests[AStarPathRequests::MAX_REQUESTS];
+	int AStarPathRequests::s_pendingSlots[AStarPathRequests::MAX_REQUESTS];
+	int AStarPathRequests::s_pendingCount = 0;
+	int AStarPathRequests::s_answeredSlots[AStarPathRequests::MAX_REQUESTS];
+	int AStarPathRequests::s_nextFreeSlot = 0;
+	AStarPathRequests::PathSearch AStarPathRequests::s_searches[AStarPathRequests::MAX_SEARCHES_PER_FRAME];
+	int AStarPathRequests::s_searchesPerFrame = DEFAULT_SEARCHES_PER_FRAME;
+	WorkerPool AStarPathRequests::s_pathWorkers;
+	AStarPathCache AStarPathRequests::s_pathCache;
+
+	PathRequestHandle AStarPathRequests::Submit(const AStarNodeMap * pNodeMap, int fromNodeIndex, int toNodeIndex)
+	{
+		if (!pNodeMap) { GameLogger::Log(MessageType::cError, "Failed to submit path request! Node map was nullptr!\n"); return NO_PATH_REQUEST; }
+
+		// slots are handed out round robin so a freed one rests a while before it is reused
+		for (int i = 0; i < MAX_REQUESTS; ++i)
+		{
+			int slot = (s_nextFreeSlot + i) % MAX_REQUESTS;
+			PathRequest& request = s_requests[slot];
+			if (request.status != PathRequestStatus::UNKNOWN || request.queued) { continue; }
+
+			request.pNodeMap = pNodeMap;
+			request.fromNodeIndex = fromNodeIndex;
+			request.toNodeIndex = toNodeIndex;
+			request.status = PathRequestStatus::PENDING;
+			request.queued = true;
+			request.searchIndex = -1;
+			s_pendingSlots[s_pendingCount++] = slot;
+			s_nextFreeSlot = (slot + 1) % MAX_REQUESTS;
+			return ((request.generation & HANDLE_SLOT_MASK) << HANDLE_SLOT_BITS) | (unsigned)(slot + 1);
+		}
+
+		GameLogger::Log(MessageType::cWarning, "Failed to submit path request from node [%d] to node [%d]! All [%d] requests are in use!\n", fromNodeIndex, toNodeIndex, MAX_REQUESTS);
+		return NO_PATH_REQUEST;
+	}
+
+	PathRequestStatus AStarPathRequests::GetStatus(PathRequestHandle handle)
+	{
+		int slot = SlotFromHandle(handle);
+		return (slot < 0) ? PathRequestStatus::UNKNOWN : s_requests[slot].status;
+	}
+
+	const AStarPath * AStarPathRequests::TakePath(PathRequestHandle handle)
+	{
+		int slot = SlotFromHandle(handle);
+		if (slot < 0) { GameLogger::Log(MessageType::cError, "Failed to take path! Path request handle [%u] is not a request!\n", handle); return nullptr; }
+
+		PathRequest& request = s_requests[slot];
+		if (request.status == PathRequestStatus::PENDING) { GameLogger::Log(MessageType::cError, "Failed to take path! Path request from node [%d] to node [%d] has not been searched yet!\n", request.fromNodeIndex, request.toNodeIndex); return nullptr; }
+
+		// a request that found nothing still holds the cached "no path" until its slot is freed
+		const AStarPath *pPath = (request.status == PathRequestStatus::FOUND) ? request.pPath : nullptr;
+		if (pPath) { request.pPath = nullptr; }
+		FreeSlot(slot);
+		return pPath;
+	}
+
+	void AStarPathRequests::ReleasePath(const AStarPath * pPath)
+	{
+		s_pathCache.Release(pPath);
+	}
+
+	void AStarPathRequests::Cancel(PathRequestHandle handle)
+	{
+		int slot = SlotFromHandle(handle);
+		if (slot >= 0) { FreeSlot(slot); }
+	}
+
+	bool AStarPathRequests::DeliverResults()
+	{
+		if (!s_pendingCount) { return true; }
+		if (!s_pathWorkers.IsInitialized() && !InitializePathWorkers()) { return false; }
+
+		// oldest first, requests for a path already being searched this frame just wait on that search
+		int searchCount = 0;
+		int answeredCount = 0;
+		int stillPending = 0;
+		for (int p = 0; p < s_pendingCount; ++p)
+		{
+			int slot = s_pendingSlots[p];
+			PathRequest& request = s_requests[slot];
+			if (request.status != PathRequestStatus::PENDING) { request.queued = false; continue; }
+
+			int search = 0;
+			while (search < searchCount && (s_searches[search].pNodeMap != request.pNodeMap || s_searches[search].fromNodeIndex != request.fromNodeIndex || s_searches[search].toNodeIndex != request.toNodeIndex)) { ++search; }
+
+			if (search == searchCount)
+			{
+				// a path still cached for the map as it is now is answered without searching or counting against the budget
+				const AStarPath *pCached = s_pathCache.Acquire(request.pNodeMap, request.fromNodeIndex, request.toNodeIndex);
+				if (pCached) { AnswerRequest(request, pCached); request.queued = false; continue; }
+
+				if (searchCount >= s_searchesPerFrame) { s_pendingSlots[stillPending++] = slot; continue; }
+
+				PathSearch& newSearch = s_searches[searchCount++];
+				newSearch.pNodeMap = request.pNodeMap;
+				newSearch.mapVersion = request.pNodeMap->GetVersion();
+				newSearch.fromNodeIndex = request.fromNodeIndex;
+				newSearch.toNodeIndex = request.toNodeIndex;
+				newSearch.pNodes = nullptr;
+				newSearch.nodeCount = 0;
+				newSearch.pPath = nullptr;
+			}
+
+			request.searchIndex = search;
+			request.queued = false;
+			s_answeredSlots[answeredCount++] = slot;
+		}
+
+		s_pendingCount = stillPending;
+		bool success = s_pathWorkers.RunJobs(searchCount, AStarPathRequests::SearchJobPassThrough, nullptr);
+
+		// no path is cached too, so an unreachable target is not searched again every frame
+		for (int i = 0; i < searchCount; ++i)
+		{
+			PathSearch& search = s_searches[i];
+			search.pPath = s_pathCache.Insert(search.pNodeMap, search.mapVersion, search.fromNodeIndex, search.toNodeIndex, search.pNodes, search.nodeCount);
+			search.pNodes = nullptr;
+		}
+
+		for (int a = 0; a < answeredCount; ++a)
+		{
+			PathRequest& request = s_requests[s_answeredSlots[a]];
+			const AStarPath *pPath = s_searches[request.searchIndex].pPath;
+			s_pathCache.Retain(pPath);
+			AnswerRequest(request, pPath);
+		}
+
+		for (int i = 0; i < searchCount; ++i)
+		{
+			s_pathCache.Release(s_searches[i].pPath);
+			s_searches[i].pPath = nullptr;
+		}
+
+		return success;
+	}
+
+	void AStarPathRequests::SetSearchesPerFrame(int searchesPerFrame)
+	{
+		s_searchesPerFrame = (searchesPerFrame < 1) ? 1 : ((searchesPerFrame > MAX_SEARCHES_PER_FRAME) ? MAX_SEARCHES_PER_FRAME : searchesPerFrame);
+	}
+
+	int AStarPathRequests::GetPendingCount()
+	{
+		return s_pendingCount;
+	}
+
+	void AStarPathRequests::SetCacheCapacity(int capacity)
+	{
+		s_pathCache.SetCapacity(capacity);
+	}
+
+	const AStarPathCache * AStarPathRequests::GetPathCache()
+	{
+		return &s_pathCache;
+	}
+
+	bool AStarPathRequests::InitializePathWorkers(int workerThreadCount)
+	{
+		return s_pathWorkers.Initialize(workerThreadCount);
+	}
+
+	bool AStarPathRequests::ShutdownPathWorkers()
+	{
+		ClearRequests();
+		s_pathCache.Clear();
+		return s_pathWorkers.Shutdown();
+	}
+
+	int AStarPathRequests::SlotFromHandle(PathRequestHandle handle)
+	{
+		int slot = (int)(handle & HANDLE_SLOT_MASK) - 1;
+		if (slot < 0 || slot >= MAX_REQUESTS) { return -1; }
+
+		const PathRequest& request = s_requests[slot];
+		if (request.status == PathRequestStatus::UNKNOWN || (request.generation & HANDLE_SLOT_MASK) != (handle >> HANDLE_SLOT_BITS)) { return -1; }
+		return slot;
+	}
+
+	// a request still in the pending list keeps the slot until DeliverResults sees it was cancelled
+	void AStarPathRequests::FreeSlot(int slot)
+	{
+		PathRequest& request = s_requests[slot];
+		s_pathCache.Release(request.pPath);
+		request.pPath = nullptr;
+		request.status = PathRequestStatus::UNKNOWN;
+		request.generation++;
+	}
+
+	void AStarPathRequests::ClearRequests()
+	{
+		for (int i = 0; i < MAX_REQUESTS; ++i)
+		{
+			if (s_requests[i].status != PathRequestStatus::UNKNOWN) { FreeSlot(i); }
+			s_requests[i].queued = false;
+		}
+
+		s_pendingCount = 0;
+	}
+
+	void AStarPathRequests::SearchJobPassThrough(int jobIndex, void * /*pJobData*/)
+	{
+		// each worker searches with its own thread's context, the node map is only read
+		PathSearch& search = s_searches[jobIndex];
+		search.pNodes = AStarPathFinder::FindPath(search.pNodeMap, search.fromNodeIndex, search.toNodeIndex, &search.nodeCount);
+	}
+
+	// takes over the hold the caller has on pPath, a path that could not be kept reads as no path
+	void AStarPathRequests::AnswerRequest(PathRequest & request, const AStarPath * pPath)
+	{
+		request.pPath = pPath;
+		request.status = (pPath && pPath->m_nodeCount > 0) ? PathRequestStatus::FOUND : PathRequestStatus::NO_PATH;
+	}
+}
@@ -0,0 +1,107 @@
+#ifndef ASTARPATHREQUESTS_H
+#define ASTARPATHREQUESTS_H
+
+// agent
+// 10/17/2026
+// AStarPathRequests.h
+// Queues A* searches from anyone during a frame and solves them together on worker threads at one point in the next
+
+#include "ExportHeader.h"
+#include "WorkerPool.h"
+#include "AStarPathCache.h"
+
+namespace Engine
+{
+	class AStarNodeMap;
+
+	// zero never names a request
+	typedef unsigned PathRequestHandle;
+	const PathRequestHandle NO_PATH_REQUEST = 0;
+
+	enum class ENGINE_SHARED PathRequestStatus
+	{
+		UNKNOWN = 0, // never submitted, already taken or cancelled
+		PENDING,
+		FOUND,
+		NO_PATH
+	};
+
+	class ENGINE_SHARED AStarPathRequests
+	{
+	public:
+		static const int MAX_REQUESTS = 1024;
+		static const int MAX_SEARCHES_PER_FRAME = 256;
+
+		// everything here belongs to the game thread, only the searches themselves run on the workers
+		static PathRequestHandle Submit(const AStarNodeMap *pNodeMap, int fromNodeIndex, int toNodeIndex);
+		static PathRequestStatus GetStatus(PathRequestHandle handle);
+
+		// hands over a finished request's path and forgets the request, nullptr when there was no path
+		// the path is shared with the cache and anyone else following it, hand it to ReleasePath once done with it
+		static const AStarPath *TakePath(PathRequestHandle handle);
+		static void ReleasePath(const AStarPath *pPath);
+		static void Cancel(PathRequestHandle handle);
+
+		// the sync point, call once a frame before updating whoever submits: paths still cached are answered right away,
+		// the oldest other waiting requests are searched on the workers, requests for the same path share one search,
+		// and anything past the frame's budget of searches waits for the next call
+		static bool DeliverResults();
+		static void SetSearchesPerFrame(int searchesPerFrame);
+		static int GetPendingCount();
+
+		// how many solved paths are kept for requests to come, the hit and miss counters on the cache say whether that is enough
+		static void SetCacheCapacity(int capacity);
+		static const AStarPathCache *GetPathCache();
+		static bool InitializePathWorkers(int workerThreadCount = -1);
+		static bool ShutdownPathWorkers();
+
+	private:
+		struct PathRequest
+		{
+			const AStarNodeMap *pNodeMap{ nullptr };
+			int fromNodeIndex{ -1 };
+			int toNodeIndex{ -1 };
+			PathRequestStatus status{ PathRequestStatus::UNKNOWN };
+
+			// still listed in s_pendingSlots, a cancelled request keeps its slot until DeliverResults drops it from the list
+			bool queued{ false };
+
+			// bumped whenever the slot is freed so an old handle never reaches whoever gets the slot next
+			unsigned generation{ 0 };
+			int searchIndex{ -1 };
+
+			// held once for this request until it is taken or freed
+			const AStarPath *pPath{ nullptr };
+		};
+
+		// one distinct search of a frame and what it found, every request it answers holds the same cached path
+		struct PathSearch
+		{
+			const AStarNodeMap *pNodeMap{ nullptr };
+			unsigned int mapVersion{ 0 };
+			int fromNodeIndex{ -1 };
+			int toNodeIndex{ -1 };
+			int *pNodes{ nullptr };
+			int nodeCount{ 0 };
+			const AStarPath *pPath{ nullptr };
+		};
+
+		static int SlotFromHandle(PathRequestHandle handle);
+		static void FreeSlot(int slot);
+		static void ClearRequests();
+		static void SearchJobPassThrough(int jobIndex, void *pJobData);
+		static void AnswerRequest(PathRequest& request, const AStarPath *pPath);
+
+		static PathRequest s_requests[MAX_REQUESTS];
+		static int s_pendingSlots[MAX_REQUESTS];
+		static int s_pendingCount;
+		static int s_answeredSlots[MAX_REQUESTS];
+		static int s_nextFreeSlot;
+		static PathSearch s_searches[MAX_SEARCHES_PER_FRAME];
+		static int s_searchesPerFrame;
+		static WorkerPool s_pathWorkers;
+		static AStarPathCache s_pathCache;
+	};
+}
+
+#endif // ifndef ASTARPATHREQUESTS_H
@@ -0,0 +1,89 @@
+#include "AStarSearchContext.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// AStarSearchContext.cpp
+// Everything one A* search writes as it goes, kept out of the node map so searches against the same map can run at once
+
+namespace Engine
+{
+	AStarSearchContext::AStarSearchContext()
+	{
+	}
+
+	AStarSearchContext::~AStarSearchContext()
+	{
+		CleanUp();
+	}
+
+	bool AStarSearchContext::BeginSearch(int nodeCount)
+	{
+		if (nodeCount < 0) { GameLogger::Log(MessageType::cError, "Failed to begin A* search! Node count [%d] was negative!\n", nodeCount); return false; }
+		if (!m_openList.Initialize(nodeCount)) { return false; }
+
+		if (nodeCount > m_capacity)
+		{
+			CleanUp();
+			m_pNodeStates = new NodeState[nodeCount];
+			if (!m_pNodeStates) { GameLogger::Log(MessageType::cError, "Failed to allocate A* search state for [%d] nodes!\n", nodeCount); return false; }
+			m_capacity = nodeCount;
+			m_generation = 0;
+		}
+
+		// once in four billion searches the stamps wrap around and have to really be cleared
+		if (++m_generation == 0)
+		{
+			for (int i = 0; i < m_capacity; ++i) { m_pNodeStates[i] = NodeState(); }
+			m_generation = 1;
+		}
+
+		return true;
+	}
+
+	bool AStarSearchContext::HasVisited(int nodeIndex) const
+	{
+		return m_pNodeStates[nodeIndex].m_visitedGeneration == m_generation;
+	}
+
+	bool AStarSearchContext::IsClosed(int nodeIndex) const
+	{
+		return m_pNodeStates[nodeIndex].m_closedGeneration == m_generation;
+	}
+
+	void AStarSearchContext::Visit(int nodeIndex, float walkedCost, int parentIndex)
+	{
+		NodeState& state = m_pNodeStates[nodeIndex];
+		state.m_visitedGeneration = m_generation;
+		state.m_walkedCost = walkedCost;
+		state.m_parentIndex = parentIndex;
+	}
+
+	void AStarSearchContext::Close(int nodeIndex)
+	{
+		m_pNodeStates[nodeIndex].m_closedGeneration = m_generation;
+	}
+
+	float AStarSearchContext::GetWalkedCost(int nodeIndex) const
+	{
+		return m_pNodeStates[nodeIndex].m_walkedCost;
+	}
+
+	int AStarSearchContext::GetParentIndex(int nodeIndex) const
+	{
+		return m_pNodeStates[nodeIndex].m_parentIndex;
+	}
+
+	AStarOpenList * AStarSearchContext::GetOpenList()
+	{
+		return &m_openList;
+	}
+
+	void AStarSearchContext::CleanUp()
+	{
+		delete[] m_pNodeStates;
+		m_pNodeStates = nullptr;
+		m_capacity = 0;
+		m_generation = 0;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef ASTARSEARCHCONTEXT_H
+#define ASTARSEARCHCONTEXT_H
+
+// agent
+// 10/17/2026
+// AStarSearchContext.h
+// Everything one A* search writes as it goes, kept out of the node map so searches against the same map can run at once
+
+#include "ExportHeader.h"
+#include "AStarOpenList.h"
+
+namespace Engine
+{
+	class ENGINE_SHARED AStarSearchContext
+	{
+	public:
+		AStarSearchContext();
+		~AStarSearchContext();
+
+		// starts a fresh search against a map with nodeCount nodes, only reallocates when nodeCount is bigger than any search before it
+		bool BeginSearch(int nodeCount);
+
+		// a node nothing has reached this search reads as unvisited, whatever an earlier search left in its slot
+		bool HasVisited(int nodeIndex) const;
+		bool IsClosed(int nodeIndex) const;
+		void Visit(int nodeIndex, float walkedCost, int parentIndex);
+		void Close(int nodeIndex);
+		float GetWalkedCost(int nodeIndex) const;
+		int GetParentIndex(int nodeIndex) const;
+		AStarOpenList *GetOpenList();
+
+	private:
+		// a slot only counts for the search whose generation it was stamped with, so starting a new search is just bumping the generation
+		struct NodeState
+		{
+			unsigned m_visitedGeneration{ 0 };
+			unsigned m_closedGeneration{ 0 };
+			float m_walkedCost{ 0.0f };
+			int m_parentIndex{ -1 };
+		};
+
+		void CleanUp();
+
+		NodeState *m_pNodeStates{ nullptr };
+		int m_capacity{ 0 };
+		unsigned m_generation{ 0 };
+		AStarOpenList m_openList;
+	};
+}
+
+#endif // ifndef ASTARSEARCHCONTEXT_H
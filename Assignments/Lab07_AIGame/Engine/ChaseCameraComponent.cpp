@@ -4,6 +4,7 @@
 #include "SpatialComponent.h"
 #include "MathUtility.h"
 #include "CollisionTester.h"
+#include "CollisionQueryStats.h"
 
 // Justin Furtado
 // 8/16/2016
@@ -49,7 +50,9 @@ namespace Engine
 		float checkDist = m_distanceMultiplier * (m_positionOffset.Length());
 		if (m_collide)
 		{
-			RayCastingOutput output = CollisionTester::FindWall(m_followTargetPosition, (m_position)-m_followTargetPosition, checkDist, m_collideLayer);
+			const char *pPreviousTag = CollisionQueryStats::SetQueryTag("chase camera");
+			RayCastingOutput output = CollisionTester::FindWall(m_followTargetPosition, (m_position)-m_followTargetPosition, checkDist, m_collideLayer, &m_probeCache);
+			CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 			m_currentDistanceMultiplier = (output.m_didIntersect && output.m_distance < checkDist) ? 0.99f * output.m_distance / (checkDist)* m_distanceMultiplier : m_distanceMultiplier;
 			m_currentDistanceMultiplier = MathUtility::Clamp(m_currentDistanceMultiplier, 0.5f, 5.0f);
@@ -54,6 +54,9 @@ namespace Engine
 	private:
 		CollisionLayer m_collideLayer;
 		bool m_collide;
+
+		// the camera casts nearly the same ray every frame
+		RayProbeCache m_probeCache;
 		Vec3 m_up;
 		Vec3 m_viewDir;
 		Vec3 m_positionOffset;
@@ -0,0 +1,235 @@
+#include "CollisionQueryStats.h"
+#include "GameLogger.h"
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+
+// agent
+// 10/17/2026
+// CollisionQueryStats.cpp
+// Opt in counters for every CollisionTester query, gathered per caller into one histogram per frame
+
+namespace Engine
+{
+	struct CollisionQueryStats::TagTotals
+	{
+		std::atomic<const char *> tag;
+		std::atomic<int> queryCount;
+		std::atomic<int> hitCount;
+		std::atomic<long long> cellsVisited;
+		std::atomic<long long> trianglesTested;
+		std::atomic<long long> nanoseconds;
+		std::atomic<int> cellBuckets[CollisionQueryHistogram::BUCKET_COUNT];
+		std::atomic<int> triangleBuckets[CollisionQueryHistogram::BUCKET_COUNT];
+		std::atomic<int> nanosecondBuckets[CollisionQueryHistogram::BUCKET_COUNT];
+	};
+
+	const char *const CollisionQueryStats::UNTAGGED = "untagged";
+
+	// slot zero is always the untagged queries, and takes any tag that comes after the table is full
+	CollisionQueryStats::TagTotals CollisionQueryStats::s_tagTotals[CollisionQueryStats::MAX_TAGS];
+	std::atomic<int> s_queryTagCount{ 0 };
+	std::mutex s_queryTagMutex;
+	std::atomic<bool> s_queryStatsEnabled{ false };
+
+	// each thread names its own caller, a batch hands its caller's tag to the worker threads running it
+	thread_local const char *s_threadQueryTag = nullptr;
+
+	// the frame the getters read, only touched by EndFrame and the getters
+	CollisionQueryHistogram s_lastQueryFrame[CollisionQueryStats::MAX_TAGS];
+	int s_lastQueryFrameTagCount = 0;
+	int s_lastQueryFrameNumber = 0;
+	std::mutex s_lastQueryFrameMutex;
+
+	void CollisionQueryStats::SetEnabled(bool enabled)
+	{
+		s_queryStatsEnabled = enabled;
+	}
+
+	bool CollisionQueryStats::IsEnabled()
+	{
+		return s_queryStatsEnabled.load(std::memory_order_relaxed);
+	}
+
+	const char * CollisionQueryStats::SetQueryTag(const char * tag)
+	{
+		const char *pPreviousTag = s_threadQueryTag;
+		s_threadQueryTag = tag;
+		return pPreviousTag;
+	}
+
+	const char * CollisionQueryStats::GetQueryTag()
+	{
+		return s_threadQueryTag;
+	}
+
+	long long CollisionQueryStats::BeginQuery()
+	{
+		if (!IsEnabled()) { return 0; }
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void CollisionQueryStats::EndQuery(long long startTime, const CollisionQueryCounts & counts, bool hit)
+	{
+		if (startTime == 0) { return; }
+		long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - startTime;
+
+		TagTotals *pTotals = FindOrAddTag(s_threadQueryTag ? s_threadQueryTag : UNTAGGED);
+		pTotals->queryCount.fetch_add(1, std::memory_order_relaxed);
+		if (hit) { pTotals->hitCount.fetch_add(1, std::memory_order_relaxed); }
+		pTotals->cellsVisited.fetch_add(counts.m_cellsVisited, std::memory_order_relaxed);
+		pTotals->trianglesTested.fetch_add(counts.m_trianglesTested, std::memory_order_relaxed);
+		pTotals->nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+		pTotals->cellBuckets[GetBucket(counts.m_cellsVisited)].fetch_add(1, std::memory_order_relaxed);
+		pTotals->triangleBuckets[GetBucket(counts.m_trianglesTested)].fetch_add(1, std::memory_order_relaxed);
+		pTotals->nanosecondBuckets[GetBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// a query still running on another thread can land in either frame, the totals are only ever off by that query
+	void CollisionQueryStats::EndFrame()
+	{
+		int tagCount = s_queryTagCount.load(std::memory_order_acquire);
+		if (tagCount == 0) { return; }
+
+		std::lock_guard<std::mutex> lock(s_lastQueryFrameMutex);
+		s_lastQueryFrameTagCount = tagCount;
+		s_lastQueryFrameNumber++;
+		for (int t = 0; t < tagCount; ++t)
+		{
+			TagTotals& totals = s_tagTotals[t];
+			CollisionQueryHistogram& histogram = s_lastQueryFrame[t];
+			histogram.m_tag = totals.tag.load(std::memory_order_relaxed);
+			histogram.m_queryCount = totals.queryCount.exchange(0, std::memory_order_relaxed);
+			histogram.m_hitCount = totals.hitCount.exchange(0, std::memory_order_relaxed);
+			histogram.m_cellsVisited = totals.cellsVisited.exchange(0, std::memory_order_relaxed);
+			histogram.m_trianglesTested = totals.trianglesTested.exchange(0, std::memory_order_relaxed);
+			histogram.m_nanoseconds = totals.nanoseconds.exchange(0, std::memory_order_relaxed);
+			for (int b = 0; b < CollisionQueryHistogram::BUCKET_COUNT; ++b)
+			{
+				histogram.m_cellBuckets[b] = totals.cellBuckets[b].exchange(0, std::memory_order_relaxed);
+				histogram.m_triangleBuckets[b] = totals.triangleBuckets[b].exchange(0, std::memory_order_relaxed);
+				histogram.m_nanosecondBuckets[b] = totals.nanosecondBuckets[b].exchange(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// returns how many histograms were written, one per tag seen so far, including tags with no queries last frame
+	int CollisionQueryStats::GetLastFrame(CollisionQueryHistogram * outHistograms, int maxHistograms)
+	{
+		if (!outHistograms) { GameLogger::Log(MessageType::cError, "Failed to GetLastFrame of CollisionQueryStats! Output was nullptr!\n"); return 0; }
+
+		std::lock_guard<std::mutex> lock(s_lastQueryFrameMutex);
+		int count = (s_lastQueryFrameTagCount < maxHistograms) ? s_lastQueryFrameTagCount : maxHistograms;
+		for (int t = 0; t < count; ++t) { outHistograms[t] = s_lastQueryFrame[t]; }
+		return count;
+	}
+
+	bool CollisionQueryStats::GetLastFrameForTag(const char * tag, CollisionQueryHistogram * pOutHistogram)
+	{
+		if (!tag || !pOutHistogram) { GameLogger::Log(MessageType::cError, "Failed to GetLastFrameForTag of CollisionQueryStats! Tag or output was nullptr!\n"); return false; }
+
+		std::lock_guard<std::mutex> lock(s_lastQueryFrameMutex);
+		for (int t = 0; t < s_lastQueryFrameTagCount; ++t)
+		{
+			if (s_lastQueryFrame[t].m_tag == tag || strcmp(s_lastQueryFrame[t].m_tag, tag) == 0) { *pOutHistogram = s_lastQueryFrame[t]; return true; }
+		}
+
+		return false;
+	}
+
+	int CollisionQueryStats::GetLastFrameNumber()
+	{
+		std::lock_guard<std::mutex> lock(s_lastQueryFrameMutex);
+		return s_lastQueryFrameNumber;
+	}
+
+	void CollisionQueryStats::LogLastFrame()
+	{
+		CollisionQueryHistogram histograms[MAX_TAGS];
+		int count = GetLastFrame(&histograms[0], MAX_TAGS);
+
+		GameLogger::Log(MessageType::cDebug, "========================== Collision queries in frame [%d] ==========================\n", GetLastFrameNumber());
+		for (int t = 0; t < count; ++t)
+		{
+			const CollisionQueryHistogram& histogram = histograms[t];
+			if (histogram.m_queryCount == 0) { continue; }
+
+			float queries = (float)histogram.m_queryCount;
+			GameLogger::Log(MessageType::cDebug, "[%s]: [%d] queries, [%d] hits, [%.1f] cells, [%.1f] triangles and [%.2f] us per query, [%.3f] ms total\n",
+				histogram.m_tag, histogram.m_queryCount, histogram.m_hitCount, histogram.m_cellsVisited / queries, histogram.m_trianglesTested / queries,
+				0.001f * histogram.m_nanoseconds / queries, 0.000001f * histogram.m_nanoseconds);
+
+			const int BUFFER_SIZE = 512;
+			char buffer[BUFFER_SIZE];
+			FormatBuckets(buffer, BUFFER_SIZE, "cells", histogram.m_cellBuckets);
+			GameLogger::Log(MessageType::cDebug, "%s\n", buffer);
+			FormatBuckets(buffer, BUFFER_SIZE, "triangles", histogram.m_triangleBuckets);
+			GameLogger::Log(MessageType::cDebug, "%s\n", buffer);
+			FormatBuckets(buffer, BUFFER_SIZE, "ns", histogram.m_nanosecondBuckets);
+			GameLogger::Log(MessageType::cDebug, "%s\n", buffer);
+		}
+	}
+
+	CollisionQueryStats::TagTotals * CollisionQueryStats::FindOrAddTag(const char * tag)
+	{
+		// tags are almost always the same literal, so the pointer is enough without taking the lock
+		int tagCount = s_queryTagCount.load(std::memory_order_acquire);
+		for (int t = 0; t < tagCount; ++t)
+		{
+			if (s_tagTotals[t].tag.load(std::memory_order_relaxed) == tag) { return &s_tagTotals[t]; }
+		}
+
+		std::lock_guard<std::mutex> lock(s_queryTagMutex);
+		tagCount = s_queryTagCount.load(std::memory_order_relaxed);
+		if (tagCount == 0)
+		{
+			s_tagTotals[0].tag = UNTAGGED;
+			s_queryTagCount.store(++tagCount, std::memory_order_release);
+		}
+
+		for (int t = 0; t < tagCount; ++t)
+		{
+			if (strcmp(s_tagTotals[t].tag.load(std::memory_order_relaxed), tag) == 0) { return &s_tagTotals[t]; }
+		}
+
+		if (tagCount == MAX_TAGS)
+		{
+			GameLogger::Log(MessageType::cWarning, "CollisionQueryStats has no room for tag [%s], counting it as [%s]!\n", tag, UNTAGGED);
+			return &s_tagTotals[0];
+		}
+
+		s_tagTotals[tagCount].tag = tag;
+		s_queryTagCount.store(tagCount + 1, std::memory_order_release);
+		return &s_tagTotals[tagCount];
+	}
+
+	int CollisionQueryStats::GetBucket(long long value)
+	{
+		int bucket = 0;
+		while (value > 0 && bucket < CollisionQueryHistogram::BUCKET_COUNT - 1)
+		{
+			value >>= 1;
+			bucket++;
+		}
+
+		return bucket;
+	}
+
+	// lists the non empty buckets by their smallest value, "cells: 0:12 1+:3 4+:40" means 40 queries visited 4 to 7 cells
+	int CollisionQueryStats::FormatBuckets(char * buffer, int bufferSize, const char * label, const int * pBuckets)
+	{
+		int length = sprintf_s(buffer, bufferSize, "    %s:", label);
+		for (int b = 0; b < CollisionQueryHistogram::BUCKET_COUNT && length > 0 && length < bufferSize; ++b)
+		{
+			if (pBuckets[b] == 0) { continue; }
+
+			long long lowest = (b == 0) ? 0 : (1ll << (b - 1));
+			int written = sprintf_s(buffer + length, bufferSize - length, (b == 0) ? " %lld:%d" : " %lld+:%d", lowest, pBuckets[b]);
+			if (written < 0) { break; }
+			length += written;
+		}
+
+		return length;
+	}
+}
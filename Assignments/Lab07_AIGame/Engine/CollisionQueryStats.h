@@ -0,0 +1,72 @@
+#ifndef COLLISIONQUERYSTATS_H
+#define COLLISIONQUERYSTATS_H
+
+// agent
+// 10/17/2026
+// CollisionQueryStats.h
+// Opt in counters for every CollisionTester query, gathered per caller into one histogram per frame
+
+#include "ExportHeader.h"
+
+namespace Engine
+{
+	// what one query did, filled in by whichever backend answered it
+	struct ENGINE_SHARED CollisionQueryCounts
+	{
+		int m_cellsVisited{ 0 }; // grid cells, or bvh nodes
+		int m_trianglesTested{ 0 }; // real triangles only, never the empty lanes padding out a block
+	};
+
+	// every query one caller made in a frame, bucket 0 counts zeroes and bucket b counts values in [2^(b-1), 2^b), the last bucket takes everything bigger
+	struct ENGINE_SHARED CollisionQueryHistogram
+	{
+		static const int BUCKET_COUNT = 20;
+		const char *m_tag{ nullptr };
+		int m_queryCount{ 0 };
+		int m_hitCount{ 0 };
+		long long m_cellsVisited{ 0 };
+		long long m_trianglesTested{ 0 };
+		long long m_nanoseconds{ 0 };
+		int m_cellBuckets[BUCKET_COUNT]{};
+		int m_triangleBuckets[BUCKET_COUNT]{};
+		int m_nanosecondBuckets[BUCKET_COUNT]{};
+	};
+
+	class ENGINE_SHARED CollisionQueryStats
+	{
+	public:
+		static const int MAX_TAGS = 32;
+		static const char *const UNTAGGED;
+
+		// off by default, a query costs one extra branch until turned on
+		static void SetEnabled(bool enabled);
+		static bool IsEnabled();
+
+		// names the caller of queries made on this thread until changed, returns the old tag so it can be put back
+		// tags are compared by pointer first, so pass the same string literal every time
+		static const char *SetQueryTag(const char *tag);
+		static const char *GetQueryTag();
+
+		// returns a start time to hand to EndQuery, zero when stats are off
+		static long long BeginQuery();
+		static void EndQuery(long long startTime, const CollisionQueryCounts& counts, bool hit);
+
+		// call once a frame, what was gathered since the last call becomes the frame the getters and LogLastFrame see
+		static void EndFrame();
+		static int GetLastFrame(CollisionQueryHistogram *outHistograms, int maxHistograms);
+		static bool GetLastFrameForTag(const char *tag, CollisionQueryHistogram *pOutHistogram);
+		static int GetLastFrameNumber();
+		static void LogLastFrame();
+
+	private:
+		// the running totals of one tag, defined in the cpp so the atomics stay out of the header
+		struct TagTotals;
+		static TagTotals s_tagTotals[MAX_TAGS];
+
+		static TagTotals *FindOrAddTag(const char *tag);
+		static int GetBucket(long long value);
+		static int FormatBuckets(char *buffer, int bufferSize, const char *label, const int *pBuckets);
+	};
+}
+
+#endif // ifndef COLLISIONQUERYSTATS_H
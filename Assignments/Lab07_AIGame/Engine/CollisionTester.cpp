@@ -8,6 +8,17 @@
 #include "GameLogger.h"
 #include "MousePicker.h"
 #include "ShapeGenerator.h"
+#include "CollisionQueryStats.h"
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <climits>
+
+// every x86 target this builds for has at least sse, anything else falls back to the scalar lanes
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define COLLISION_TESTER_USE_SSE
+#include <xmmintrin.h>
+#endif
 
 // Justin Furtado
 // 8/21/2016
@@ -32,173 +43,1409 @@ namespace Engine
 	};
 
 	SpatialGrid CollisionTester::s_spatialGrids[(unsigned)CollisionLayer::NUM_LAYERS];
+	TriangleBVH CollisionTester::s_bvhs[(unsigned)CollisionLayer::NUM_LAYERS];
+	CollisionBackend CollisionTester::s_layerBackends[(unsigned)CollisionLayer::NUM_LAYERS]{ CollisionBackend::SPATIAL_GRID };
+	WorkerPool CollisionTester::s_rayWorkers;
+
+	// big enough to amortize handing out a job, small enough that uneven rays still spread over every thread
+	const int RAYS_PER_BATCH_JOB = 32;
+
+	// totals over every grid query, added to once per query so concurrent queries barely touch them
+	std::atomic<long long> s_mailboxTrianglesTested{ 0 };
+	std::atomic<long long> s_mailboxTestsSkipped{ 0 };
+
+	// the enabled state version every grid and bvh owner bit was last refreshed for
+	std::atomic<unsigned> s_syncedEnabledStateVersion{ 0 };
+	std::mutex s_enabledStateMutex;
+
+	// a bit per layer whose bvh could not be refit, built once by the next query however many objects moved before it
+	std::atomic<unsigned> s_pendingBVHBuilds{ 0 };
 
 	const char * CollisionTester::LayerString(CollisionLayer layer)
 	{
 		return collisionLayerStrings[(int)layer];
 	}
 
-	bool CollisionTester::InitializeGridDebugShapes(CollisionLayer layer, Vec3 color, void *pCamMat, void *pPerspMat, int tintIntensityLoc, int tintColorLoc, int modelToWorldMatLoc, int worldToViewMatLoc, int perspectiveMatLoc, unsigned pShaderID)
+	bool CollisionTester::InitializeGridDebugShapes(CollisionLayer layer, Vec3 color, void *pCamMat, void *pPerspMat, int tintIntensityLoc, int tintColorLoc, int modelToWorldMatLoc, int worldToViewMatLoc, int perspectiveMatLoc, unsigned pShaderID)
+	{
+		return s_spatialGrids[(unsigned)layer].InitializeDisplayGrid(color, pCamMat, pPerspMat, tintIntensityLoc, tintColorLoc, modelToWorldMatLoc, worldToViewMatLoc, perspectiveMatLoc, pShaderID);
+	}
+
+	void CollisionTester::DrawGrid(CollisionLayer layer, const Vec3& centerPos)
+	{
+		s_spatialGrids[(unsigned)layer].DrawDebugShapes(centerPos); // TEMPORARY TODO REPLACE
+	}
+
+	void CollisionTester::ConsoleLogOutput()
+	{
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			GameLogger::Log(MessageType::cDebug, "========================== Begin Spatial grid [%s] ==========================\n", LayerString((CollisionLayer)i));
+			if (s_layerBackends[i] == CollisionBackend::BVH)
+			{
+				s_bvhs[i].ConsoleLogStats();
+			}
+			else
+			{
+				s_spatialGrids[i].CalculateStatisticsFromCounts();
+				s_spatialGrids[i].ConsoleLogStats();
+			}
+			GameLogger::Log(MessageType::cDebug, "========================== End Spatial grid [%s] ==========================\n\n", LayerString((CollisionLayer)i));
+		}
+
+		long long tested = 0, skipped = 0;
+		GetMailboxStats(&tested, &skipped);
+		GameLogger::Log(MessageType::cDebug, "Grid queries tested [%lld] triangles and skipped [%lld] repeat tests of triangles spanning several cells (%.2f%% saved)\n", tested, skipped, (tested + skipped) ? 100.0f * skipped / (float)(tested + skipped) : 0.0f);
+		if (CollisionQueryStats::IsEnabled()) { CollisionQueryStats::LogLastFrame(); }
+	}
+
+	void CollisionTester::GetMailboxStats(long long * pOutTrianglesTested, long long * pOutTestsSkipped)
+	{
+		if (pOutTrianglesTested) { *pOutTrianglesTested = s_mailboxTrianglesTested.load(); }
+		if (pOutTestsSkipped) { *pOutTestsSkipped = s_mailboxTestsSkipped.load(); }
+	}
+
+	void CollisionTester::ResetMailboxStats()
+	{
+		s_mailboxTrianglesTested = 0;
+		s_mailboxTestsSkipped = 0;
+	}
+
+	// returns true the first time the query sees this triangle, false when it has already been tested
+	bool CollisionTester::MarkTriangleTested(TriangleMailbox * pMailbox, unsigned ownerKey, int vertexIndex)
+	{
+		unsigned hash = ownerKey * 2654435761u ^ (unsigned)vertexIndex * 40503u;
+		for (int probe = 0; probe < TriangleMailbox::SLOT_COUNT; ++probe)
+		{
+			int slot = (int)((hash + probe) & (TriangleMailbox::SLOT_COUNT - 1));
+			if (!pMailbox->ownerKeys[slot])
+			{
+				// kept at most half full so misses stay short, past that triangles are tested without being remembered
+				if (pMailbox->used < TriangleMailbox::SLOT_COUNT / 2)
+				{
+					pMailbox->ownerKeys[slot] = ownerKey;
+					pMailbox->vertexIndices[slot] = vertexIndex;
+					pMailbox->used++;
+				}
+
+				pMailbox->tested++;
+				return true;
+			}
+
+			if (pMailbox->ownerKeys[slot] == ownerKey && pMailbox->vertexIndices[slot] == vertexIndex) { pMailbox->skipped++; return false; }
+		}
+
+		pMailbox->tested++;
+		return true;
+	}
+
+	// returns a bit for each of the block's lanes that is enabled and still needs testing, everything it reads lives in the block
+	int CollisionTester::MarkBlockTested(TriangleMailbox * pMailbox, const SpatialTriangleBlock * pBlock, int triangleCount, const unsigned * pEnabledOwnerBits, unsigned gridKey, int candidateLanes)
+	{
+		int laneMask = 0;
+		int laneCount = (triangleCount < SpatialTriangleBlock::TRIANGLES_PER_BLOCK) ? triangleCount : SpatialTriangleBlock::TRIANGLES_PER_BLOCK;
+		for (int lane = 0; lane < laneCount; ++lane)
+		{
+			if (!(candidateLanes & (1 << lane))) { continue; }
+
+			int ownerIndex = pBlock->ownerIndex[lane];
+			if (ownerIndex < 0 || !(pEnabledOwnerBits[ownerIndex >> 5] & (1u << (ownerIndex & 31)))) { continue; }
+			if (MarkTriangleTested(pMailbox, gridKey | (unsigned)ownerIndex, pBlock->vertexIndex[lane])) { laneMask |= (1 << lane); }
+		}
+
+		return laneMask;
+	}
+
+	// returns a bit for each lane whose owner's box the ray enters before reachDistance, each owner's box is tested once per ray
+	int CollisionTester::BroadphaseBlockLanes(GridWalk * pWalk, const SpatialTriangleBlock * pBlock, const SpatialGrid::OwnerBounds * pOwnerBounds, unsigned gridKey, float reachDistance)
+	{
+		int laneMask = 0;
+		int lastOwnerIndex = -1;
+		bool lastOwnerReached = false;
+		for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+		{
+			int ownerIndex = pBlock->ownerIndex[lane];
+			if (ownerIndex < 0) { continue; }
+
+			// cells keep each object's triangles together, so neighbouring lanes almost always share an owner
+			if (ownerIndex != lastOwnerIndex)
+			{
+				unsigned ownerKey = gridKey | (unsigned)ownerIndex;
+				int slot = (int)((ownerKey * 2654435761u) >> 27) & (OwnerBroadphase::SLOT_COUNT - 1);
+				OwnerBroadphase& broadphase = pWalk->broadphase;
+				if (broadphase.ownerKeys[slot] != ownerKey)
+				{
+					const SpatialGrid::OwnerBounds& bounds = pOwnerBounds[ownerIndex];
+					broadphase.ownerKeys[slot] = ownerKey;
+					broadphase.entryDistances[slot] = MathUtility::RayBoxEntryDistance(*pWalk->pRayPosition, pWalk->inverseDirection, bounds.m_min, bounds.m_max, pWalk->checkDist);
+				}
+
+				lastOwnerIndex = ownerIndex;
+				lastOwnerReached = broadphase.entryDistances[slot] <= reachDistance;
+			}
+
+			if (lastOwnerReached) { laneMask |= (1 << lane); }
+		}
+
+		return laneMask;
+	}
+
+	// returns a bit for each lane whose owner's box overlaps the given box
+	int CollisionTester::OverlappingBlockLanes(const SpatialTriangleBlock * pBlock, const SpatialGrid::OwnerBounds * pOwnerBounds, const Vec3 & boxMin, const Vec3 & boxMax)
+	{
+		int laneMask = 0;
+		for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+		{
+			int ownerIndex = pBlock->ownerIndex[lane];
+			if (ownerIndex < 0) { continue; }
+
+			const SpatialGrid::OwnerBounds& bounds = pOwnerBounds[ownerIndex];
+			if (bounds.m_min.GetX() <= boxMax.GetX() && bounds.m_max.GetX() >= boxMin.GetX()
+				&& bounds.m_min.GetY() <= boxMax.GetY() && bounds.m_max.GetY() >= boxMin.GetY()
+				&& bounds.m_min.GetZ() <= boxMax.GetZ() && bounds.m_max.GetZ() >= boxMin.GetZ())
+			{
+				laneMask |= (1 << lane);
+			}
+		}
+
+		return laneMask;
+	}
+
+	// owner indices are only unique within one grid, so the grid goes in the top bits, never zero so an empty slot stays zero
+	unsigned CollisionTester::GridMailboxKey(int gridSlot)
+	{
+		return (unsigned)(gridSlot + 1) << 24;
+	}
+
+	// copies every object's enabled state into the owner bits the queries read, only does any work after something was enabled or disabled
+	// also builds any bvh a refit gave up on, batches call this before handing rays out so the workers never build one under each other
+	void CollisionTester::SyncEnabledOwners()
+	{
+		unsigned version = GraphicalObject::GetEnabledStateVersion();
+		if (version == s_syncedEnabledStateVersion.load() && s_pendingBVHBuilds.load() == 0) { return; }
+
+		std::lock_guard<std::mutex> lock(s_enabledStateMutex);
+		unsigned pendingBuilds = s_pendingBVHBuilds.exchange(0);
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			if ((pendingBuilds & (1u << i)) && s_layerBackends[i] == CollisionBackend::BVH) { s_bvhs[i].Build(s_spatialGrids[i].GetObjectList()); }
+		}
+
+		if (version == s_syncedEnabledStateVersion.load()) { return; }
+
+		// a query racing this one may see an object's old state for a moment, the same as if it had run first
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			s_spatialGrids[i].RefreshEnabledOwners();
+			s_bvhs[i].RefreshEnabledOwners();
+		}
+
+		s_syncedEnabledStateVersion = version;
+	}
+
+	void CollisionTester::RecordMailboxStats(const TriangleMailbox & mailbox)
+	{
+		if (mailbox.tested) { s_mailboxTrianglesTested += mailbox.tested; }
+		if (mailbox.skipped) { s_mailboxTestsSkipped += mailbox.skipped; }
+	}
+
+	void CollisionTester::AddQueryCounts(CollisionQueryCounts * pTotal, const CollisionQueryCounts & counts)
+	{
+		pTotal->m_cellsVisited += counts.m_cellsVisited;
+		pTotal->m_trianglesTested += counts.m_trianglesTested;
+	}
+
+	RayCastingOutput CollisionTester::FindWall(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, CollisionLayer layer, RayProbeCache * pCache)
+	{
+		return FindWallInLayers(rayPosition, rayDirection, checkDist, LayerBit(layer), pCache);
+	}
+
+	// rayDirection must already be normalized, and every layer in the mask must line up with the others (see DoGridsLineUp)
+	void CollisionTester::WalkGridCells(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, unsigned layerMask, GridCellCallback callback, GridWalk * pWalk)
+	{
+		// gather the grids once so each cell only looks at the layers asked for
+		pWalk->pRayPosition = &rayPosition;
+		pWalk->pRayDirection = &rayDirection;
+		pWalk->checkDist = checkDist;
+		pWalk->inverseDirection = Vec3(1.0f / rayDirection.GetX(), 1.0f / rayDirection.GetY(), 1.0f / rayDirection.GetZ());
+		pWalk->gridCount = 0;
+		for (unsigned int l = 0; l < (unsigned)CollisionLayer::NUM_LAYERS; ++l)
+		{
+			if (layerMask & LayerBit((CollisionLayer)l)) { pWalk->pGrids[pWalk->gridCount++] = &s_spatialGrids[l]; }
+		}
+
+		if (pWalk->gridCount == 0) { return; }
+
+		// grab scale and calculate end position, the grids all match so the first one stands in for the rest
+		SpatialGrid *pFirstGrid = pWalk->pGrids[0];
+		float gridScale = pFirstGrid->GetGridScale();
+		Vec3 gridMin = pFirstGrid->GetGridOrigin();
+		Vec3 gridMax = gridMin + gridScale * Vec3((float)pFirstGrid->GetGridWidth(), (float)pFirstGrid->GetGridDepth(), (float)pFirstGrid->GetGridHeight());
+
+		// only walk the part of the ray inside the grid, with half a cell to spare on each end for rounding
+		// the exit is where the ray entering from the far end would come in
+		float walkStart = MathUtility::RayBoxEntryDistance(rayPosition, pWalk->inverseDirection, gridMin, gridMax, checkDist);
+		if (walkStart == FLT_MAX) { RecordMailboxStats(pWalk->mailbox); return; }
+		Vec3 inverseBackwards = -pWalk->inverseDirection;
+		float backwardsEntry = MathUtility::RayBoxEntryDistance(rayPosition + rayDirection * checkDist, inverseBackwards, gridMin, gridMax, checkDist);
+		float walkEnd = (backwardsEntry == FLT_MAX) ? checkDist : checkDist - backwardsEntry;
+		walkStart = MathUtility::Max(walkStart - 0.5f * gridScale, 0.0f);
+		walkEnd = MathUtility::Min(walkEnd + 0.5f * gridScale, checkDist);
+		float walkLength = walkEnd - walkStart;
+
+		Vec3 rp = rayPosition + rayDirection * walkStart - gridMin;
+		Vec3 endPosition = rp + rayDirection * walkLength;
+
+		// x, y and z of the walk are the grid's x, y and z cells
+		GridWalkAxis axes[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			InitWalkAxis(&axes[a], rp[a], endPosition[a], gridScale);
+		}
+
+		// what the grids being walked hold in the brick the ray is in, looked up again only when it moves to another brick
+		int brickX = INT_MIN, brickY = INT_MIN, brickZ = INT_MIN;
+		unsigned long long occupancy = 0;
+		for (;;)
+		{
+			// shifting floors the cells just outside the grid too, their bricks are always empty
+			int x = axes[0].cell, y = axes[1].cell, z = axes[2].cell;
+			if ((x >> SpatialGrid::OCCUPANCY_BRICK_SHIFT) != brickX || (y >> SpatialGrid::OCCUPANCY_BRICK_SHIFT) != brickY || (z >> SpatialGrid::OCCUPANCY_BRICK_SHIFT) != brickZ)
+			{
+				brickX = x >> SpatialGrid::OCCUPANCY_BRICK_SHIFT;
+				brickY = y >> SpatialGrid::OCCUPANCY_BRICK_SHIFT;
+				brickZ = z >> SpatialGrid::OCCUPANCY_BRICK_SHIFT;
+				occupancy = 0;
+				for (int g = 0; g < pWalk->gridCount; ++g) { occupancy |= pWalk->pGrids[g]->GetOccupancyMask(brickX, brickY, brickZ); }
+			}
+
+			if (!occupancy)
+			{
+				if (!SkipEmptyBrick(axes)) { break; }
+				continue;
+			}
+
+			// the callback decides from what it found whether the rest of the ray still matters, empty cells have nothing to find
+			if (occupancy & SpatialGrid::GetOccupancyBit(x, y, z))
+			{
+				float cellExit = MathUtility::Min(MathUtility::Min(axes[0].nextBoundary, axes[1].nextBoundary), axes[2].nextBoundary);
+				pWalk->counts.m_cellsVisited++;
+				if (!callback(x, y, z, walkStart + walkLength * cellExit, pWalk)) { break; }
+			}
+
+			if (!StepWalkAxis(&axes[NextWalkAxis(axes)])) { break; }
+		}
+
+		pWalk->counts.m_trianglesTested += pWalk->mailbox.tested;
+		RecordMailboxStats(pWalk->mailbox);
+	}
+
+	// start and end are relative to the grid origin, boundaries are measured as fractions of the way from start to end
+	void CollisionTester::InitWalkAxis(GridWalkAxis * pAxis, float start, float end, float gridScale)
+	{
+		pAxis->cell = (int)floorf(start / gridScale);
+		pAxis->end = (int)floorf(end / gridScale);
+		pAxis->step = (start < end) ? 1 : ((start > end) ? -1 : 0);
+
+		// MATHS!!! an axis the ray does not move along never reaches a boundary
+		float cellMin = gridScale * floorf(start / gridScale);
+		float cellMax = cellMin + gridScale;
+		pAxis->nextBoundary = ((start > end) ? (start - cellMin) : (cellMax - start)) / fabsf(end - start);
+		pAxis->boundaryStep = gridScale / fabsf(end - start);
+	}
+
+	// the axis whose next boundary comes first, ties go to x then y then z
+	int CollisionTester::NextWalkAxis(const GridWalkAxis * pAxes)
+	{
+		if (pAxes[0].nextBoundary <= pAxes[1].nextBoundary && pAxes[0].nextBoundary <= pAxes[2].nextBoundary) { return 0; }
+		return (pAxes[1].nextBoundary <= pAxes[2].nextBoundary) ? 1 : 2;
+	}
+
+	// returns false when the axis is already in its last cell, which ends the walk
+	bool CollisionTester::StepWalkAxis(GridWalkAxis * pAxis)
+	{
+		if (pAxis->cell == pAxis->end) { return false; }
+		pAxis->nextBoundary += pAxis->boundaryStep;
+		pAxis->cell += pAxis->step;
+		return true;
+	}
+
+	// moves the walk to the first cell past the brick it is in, taking the same steps in the same order a cell at a time walk would
+	bool CollisionTester::SkipEmptyBrick(GridWalkAxis * pAxes)
+	{
+		// where the ray leaves the brick through each axis' far side
+		const int cellMask = SpatialGrid::OCCUPANCY_BRICK_SIZE - 1;
+		int stepsToLeave[3];
+		float leaveBoundary[3];
+		for (int a = 0; a < 3; ++a)
+		{
+			stepsToLeave[a] = (pAxes[a].step > 0) ? (SpatialGrid::OCCUPANCY_BRICK_SIZE - (pAxes[a].cell & cellMask)) : ((pAxes[a].cell & cellMask) + 1);
+			leaveBoundary[a] = (pAxes[a].step == 0) ? pAxes[a].nextBoundary : pAxes[a].nextBoundary + pAxes[a].boundaryStep * (float)(stepsToLeave[a] - 1);
+		}
+
+		int exitAxis = (leaveBoundary[0] <= leaveBoundary[1] && leaveBoundary[0] <= leaveBoundary[2]) ? 0 : ((leaveBoundary[1] <= leaveBoundary[2]) ? 1 : 2);
+		float exitBoundary = leaveBoundary[exitAxis];
+
+		// the other axes cross every boundary that comes before the exit, or ties it and would have gone first
+		for (int a = 0; a < 3; ++a)
+		{
+			if (a == exitAxis) { continue; }
+			while (pAxes[a].nextBoundary < exitBoundary || (pAxes[a].nextBoundary == exitBoundary && a < exitAxis))
+			{
+				if (!StepWalkAxis(&pAxes[a])) { return false; }
+			}
+		}
+
+		for (int s = 0; s < stepsToLeave[exitAxis]; ++s)
+		{
+			if (!StepWalkAxis(&pAxes[exitAxis])) { return false; }
+		}
+
+		return true;
+	}
+
+	bool CollisionTester::ClosestHitCellCallback(int gridX, int gridY, int gridZ, float cellExitDistance, GridWalk * pWalk)
+	{
+		for (int g = 0; g < pWalk->gridCount; ++g)
+		{
+			SpatialGrid *pGrid = pWalk->pGrids[g];
+			int triangleCount = 0;
+			SpatialTriangleBlock *pBlocks = pGrid->GetTriangleBlocksByGrid(gridX, gridY, gridZ, &triangleCount);
+			if (!pBlocks) { continue; }
+
+			// cells are padded to whole blocks, so four triangles are tested at a time
+			int blockCount = (triangleCount + SpatialTriangleBlock::TRIANGLES_PER_BLOCK - 1) / SpatialTriangleBlock::TRIANGLES_PER_BLOCK;
+			for (int b = 0; b < blockCount; ++b)
+			{
+				// nothing on an object can be closer than where the ray enters its box
+				float reachDistance = pWalk->pClosest->m_didIntersect ? pWalk->pClosest->m_distance : pWalk->checkDist;
+				int candidateLanes = BroadphaseBlockLanes(pWalk, pBlocks + b, pGrid->GetOwnerBounds(), GridMailboxKey(g), reachDistance);
+				if (!candidateLanes) { continue; }
+
+				// a triangle that already missed, or already hit, gives the same answer in this cell
+				int laneMask = MarkBlockTested(&pWalk->mailbox, pBlocks + b, triangleCount - b * SpatialTriangleBlock::TRIANGLES_PER_BLOCK, pGrid->GetEnabledOwnerBits(), GridMailboxKey(g), candidateLanes);
+				if (laneMask) { RayTriangleBlockIntersect(*pWalk->pRayPosition, *pWalk->pRayDirection, pBlocks + b, pGrid->GetOwners(), pWalk->pClosest, laneMask); }
+			}
+		}
+
+		// a triangle spanning several cells can be hit beyond this one, but nothing in a later cell can be closer than where this cell ends
+		return !(pWalk->stopAtNearestHit && pWalk->pClosest->m_didIntersect && pWalk->pClosest->m_distance <= cellExitDistance);
+	}
+
+	bool CollisionTester::OcclusionCellCallback(int gridX, int gridY, int gridZ, float /*cellExitDistance*/, GridWalk * pWalk)
+	{
+		for (int g = 0; g < pWalk->gridCount; ++g)
+		{
+			SpatialGrid *pGrid = pWalk->pGrids[g];
+			int triangleCount = 0;
+			SpatialTriangleBlock *pBlocks = pGrid->GetTriangleBlocksByGrid(gridX, gridY, gridZ, &triangleCount);
+			if (!pBlocks) { continue; }
+
+			int blockCount = (triangleCount + SpatialTriangleBlock::TRIANGLES_PER_BLOCK - 1) / SpatialTriangleBlock::TRIANGLES_PER_BLOCK;
+			for (int b = 0; b < blockCount; ++b)
+			{
+				int candidateLanes = BroadphaseBlockLanes(pWalk, pBlocks + b, pGrid->GetOwnerBounds(), GridMailboxKey(g), pWalk->checkDist);
+				if (!candidateLanes) { continue; }
+
+				int laneMask = MarkBlockTested(&pWalk->mailbox, pBlocks + b, triangleCount - b * SpatialTriangleBlock::TRIANGLES_PER_BLOCK, pGrid->GetEnabledOwnerBits(), GridMailboxKey(g), candidateLanes);
+				if (!laneMask) { continue; }
+
+				// any hit at all ends the walk
+				if (RayTriangleBlockOccluded(*pWalk->pRayPosition, *pWalk->pRayDirection, pBlocks + b, pGrid->GetOwners(), pWalk->checkDist, pWalk->pIgnoredObject, laneMask)) { pWalk->occluded = true; return false; }
+			}
+		}
+
+		return true;
+	}
+
+	// the cells from where the ray starts to where the caller's last probe stopped make up one box per group of grids that line up
+	// when the point the ray stops at is inside every box the whole ray up to there is too, so nothing outside them could be closer
+	// returns false when a layer uses a bvh, a box is too big, or the ray may leave a box before it stops
+	bool CollisionTester::ProbeCachedCells(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, unsigned layerMask, const RayProbeCache & cache, RayCastingOutput * pOutput, CollisionQueryCounts * pCounts)
+	{
+		if (!cache.m_hasProbeEnd || cache.m_layerMask != layerMask) { return false; }
+
+		unsigned gridMask = 0;
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			if (!(layerMask & LayerBit((CollisionLayer)i))) { continue; }
+			if (s_layerBackends[i] != CollisionBackend::SPATIAL_GRID) { return false; }
+			if (s_spatialGrids[i].GetObjectList()->GetCount() > 0) { gridMask |= LayerBit((CollisionLayer)i); }
+		}
+
+		if (!gridMask) { return false; }
+
+		// grouped the same way FindWallInLayers walks them
+		Vec3 boxMins[(unsigned)CollisionLayer::NUM_LAYERS];
+		Vec3 boxMaxs[(unsigned)CollisionLayer::NUM_LAYERS];
+		int boxCount = 0;
+		while (gridMask)
+		{
+			unsigned first = 0;
+			while (!(gridMask & LayerBit((CollisionLayer)first))) { first++; }
+
+			unsigned walkMask = 0;
+			for (unsigned int i = first; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+			{
+				if ((gridMask & LayerBit((CollisionLayer)i)) && DoGridsLineUp((CollisionLayer)first, (CollisionLayer)i)) { walkMask |= LayerBit((CollisionLayer)i); }
+			}
+
+			if (!ProbeCellRange(rayPosition, rayDirection, checkDist, walkMask, cache.m_probeEnd, pOutput, pCounts, &boxMins[boxCount], &boxMaxs[boxCount])) { return false; }
+			boxCount++;
+			gridMask &= ~walkMask;
+		}
+
+		// a triangle in one of the cells can be hit past checkDist, what a walk returns then depends on which cells it reached so that is left to the walk
+		if (pOutput->m_didIntersect && pOutput->m_distance > checkDist) { *pOutput = RayCastingOutput(); return false; }
+
+		Vec3 stopPoint = rayPosition + rayDirection * (pOutput->m_didIntersect ? pOutput->m_distance : checkDist);
+		for (int b = 0; b < boxCount; ++b)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				if (stopPoint[a] < boxMins[b][a] || stopPoint[a] > boxMaxs[b][a]) { return false; }
+			}
+		}
+
+		return true;
+	}
+
+	// tests every occupied cell between the ray start and the cached point in grids that line up, the cached point's cell first so its triangles set the distance the rest have to beat
+	bool CollisionTester::ProbeCellRange(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, unsigned walkMask, const Vec3 & cachedEnd, RayCastingOutput * pOutput, CollisionQueryCounts * pCounts, Vec3 * pOutBoxMin, Vec3 * pOutBoxMax)
+	{
+		GridWalk walk;
+		walk.pClosest = pOutput;
+		walk.stopAtNearestHit = false;
+		walk.pRayPosition = &rayPosition;
+		walk.pRayDirection = &rayDirection;
+		walk.checkDist = checkDist;
+		walk.inverseDirection = Vec3(1.0f / rayDirection.GetX(), 1.0f / rayDirection.GetY(), 1.0f / rayDirection.GetZ());
+		for (unsigned int l = 0; l < (unsigned)CollisionLayer::NUM_LAYERS; ++l)
+		{
+			if (walkMask & LayerBit((CollisionLayer)l)) { walk.pGrids[walk.gridCount++] = &s_spatialGrids[l]; }
+		}
+
+		SpatialGrid *pGrid = walk.pGrids[0];
+		int start[3] = { pGrid->GetGridIndexFromXPos(rayPosition.GetX()), pGrid->GetGridIndexFromYPos(rayPosition.GetY()), pGrid->GetGridIndexFromZPos(rayPosition.GetZ()) };
+		int cached[3] = { pGrid->GetGridIndexFromXPos(cachedEnd.GetX()), pGrid->GetGridIndexFromYPos(cachedEnd.GetY()), pGrid->GetGridIndexFromZPos(cachedEnd.GetZ()) };
+		int cellsPerAxis[3] = { pGrid->GetGridWidth(), pGrid->GetGridDepth(), pGrid->GetGridHeight() };
+		int low[3], high[3], testLow[3], span[3];
+		bool cachedInGrid = true;
+		int cellCount = 1;
+		for (int a = 0; a < 3; ++a)
+		{
+			low[a] = (start[a] < cached[a]) ? start[a] : cached[a];
+			high[a] = (start[a] < cached[a]) ? cached[a] : start[a];
+
+			// cells outside the grid hold nothing, so only the part of the box inside it is tested but the whole box still counts
+			testLow[a] = (low[a] < 0) ? 0 : low[a];
+			int testHigh = (high[a] >= cellsPerAxis[a]) ? cellsPerAxis[a] - 1 : high[a];
+			span[a] = (testHigh >= testLow[a]) ? testHigh - testLow[a] + 1 : 0;
+			cellCount *= span[a];
+			if (cached[a] < 0 || cached[a] >= cellsPerAxis[a]) { cachedInGrid = false; }
+		}
+
+		if (cellCount > MAX_PROBE_CACHE_CELLS) { return false; }
+
+		for (int c = cachedInGrid ? -1 : 0; c < cellCount; ++c)
+		{
+			int x = cached[0], y = cached[1], z = cached[2];
+			if (c >= 0)
+			{
+				x = testLow[0] + c % span[0];
+				y = testLow[1] + (c / span[0]) % span[1];
+				z = testLow[2] + c / (span[0] * span[1]);
+				if (cachedInGrid && x == cached[0] && y == cached[1] && z == cached[2]) { continue; }
+			}
+
+			unsigned long long occupancy = 0;
+			for (int g = 0; g < walk.gridCount; ++g) { occupancy |= walk.pGrids[g]->GetOccupancyMask(x >> SpatialGrid::OCCUPANCY_BRICK_SHIFT, y >> SpatialGrid::OCCUPANCY_BRICK_SHIFT, z >> SpatialGrid::OCCUPANCY_BRICK_SHIFT); }
+			if (!(occupancy & SpatialGrid::GetOccupancyBit(x, y, z))) { continue; }
+
+			walk.counts.m_cellsVisited++;
+			ClosestHitCellCallback(x, y, z, checkDist, &walk);
+		}
+
+		walk.counts.m_trianglesTested += walk.mailbox.tested;
+		RecordMailboxStats(walk.mailbox);
+		AddQueryCounts(pCounts, walk.counts);
+
+		float scale = pGrid->GetGridScale();
+		*pOutBoxMin = pGrid->GetGridOrigin() + scale * Vec3((float)low[0], (float)low[1], (float)low[2]);
+		*pOutBoxMax = pGrid->GetGridOrigin() + scale * Vec3((float)(high[0] + 1), (float)(high[1] + 1), (float)(high[2] + 1));
+		return true;
+	}
+
+	// compares the early out walk against walking every cell to the end of each ray, returns how many rays disagree
+	int CollisionTester::CheckGridTraversal(const RayCastingInput * pRays, int rayCount)
+	{
+		if (!pRays) { GameLogger::Log(MessageType::cError, "Failed to check grid traversal! Rays were nullptr!\n"); return -1; }
+		SyncEnabledOwners();
+
+		int mismatchCount = 0;
+		for (int r = 0; r < rayCount; ++r)
+		{
+			Vec3 rd = pRays[r].m_rayDirection.Normalize();
+			for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+			{
+				if (!(pRays[r].m_layerMask & LayerBit((CollisionLayer)i)) || s_layerBackends[i] != CollisionBackend::SPATIAL_GRID) { continue; }
+
+				RayCastingOutput earlyOut;
+				GridWalk earlyOutWalk;
+				earlyOutWalk.pClosest = &earlyOut;
+				WalkGridCells(pRays[r].m_rayPosition, rd, pRays[r].m_checkDist, LayerBit((CollisionLayer)i), CollisionTester::ClosestHitCellCallback, &earlyOutWalk);
+
+				RayCastingOutput exhaustive;
+				GridWalk exhaustiveWalk;
+				exhaustiveWalk.pClosest = &exhaustive;
+				exhaustiveWalk.stopAtNearestHit = false;
+				WalkGridCells(pRays[r].m_rayPosition, rd, pRays[r].m_checkDist, LayerBit((CollisionLayer)i), CollisionTester::ClosestHitCellCallback, &exhaustiveWalk);
+
+				// two triangles can tie for closest, so only the distance has to agree
+				if (earlyOut.m_didIntersect == exhaustive.m_didIntersect && (!earlyOut.m_didIntersect || fabsf(earlyOut.m_distance - exhaustive.m_distance) <= 0.0001f * (1.0f + exhaustive.m_distance))) { continue; }
+
+				mismatchCount++;
+				GameLogger::Log(MessageType::cWarning, "Grid traversal mismatch in layer [%s] for ray from (%.3f, %.3f, %.3f) along (%.3f, %.3f, %.3f)! Early out hit [%s] at [%.3f], exhaustive hit [%s] at [%.3f]\n",
+					LayerString((CollisionLayer)i), pRays[r].m_rayPosition.GetX(), pRays[r].m_rayPosition.GetY(), pRays[r].m_rayPosition.GetZ(), rd.GetX(), rd.GetY(), rd.GetZ(),
+					earlyOut.m_didIntersect ? "true" : "false", earlyOut.m_distance, exhaustive.m_didIntersect ? "true" : "false", exhaustive.m_distance);
+			}
+		}
+
+		GameLogger::Log(mismatchCount ? MessageType::cWarning : MessageType::Process, "Checked grid traversal for [%d] rays, [%d] mismatches\n", rayCount, mismatchCount);
+		return mismatchCount;
+	}
+
+	RayCastingOutput CollisionTester::FindWall(Entity * pEntity, float checkDist, CollisionLayer layer)
+	{
+		if (!pEntity) { GameLogger::Log(MessageType::cError, "Failed to find wall for entity! Entity passed was nullptr!\n"); return RayCastingOutput(); }
+
+		SpatialComponent *pSpatial = pEntity->GetComponentByType<SpatialComponent>();
+		if (!pSpatial) { GameLogger::Log(MessageType::cError, "Failed to find wall for entity! Entity has no spatial component!\n"); return RayCastingOutput(); }
+
+		return FindWall(pSpatial->GetPosition(), pSpatial->GetForward(), checkDist, layer);
+	}
+
+	RayCastingOutput CollisionTester::FindWallInLayers(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, unsigned layerMask, RayProbeCache * pCache)
+	{
+		// normalize input for future ray casts
+		Vec3 rd = rayDirection.Normalize();
+		SyncEnabledOwners();
+		long long queryStart = CollisionQueryStats::BeginQuery();
+		CollisionQueryCounts counts;
+
+		// create variable to hold output
+		RayCastingOutput finalOutput;
+
+		// a hit found in the cached cells that could not be proven nearest is still a real hit, so the walk starts out having to beat it
+		if (pCache && ProbeCachedCells(rayPosition, rd, checkDist, layerMask, *pCache, &finalOutput, &counts))
+		{
+			pCache->m_provenCount++;
+			pCache->m_hasProbeEnd = true;
+			pCache->m_probeEnd = rayPosition + rd * (finalOutput.m_didIntersect ? finalOutput.m_distance : checkDist);
+			pCache->m_layerMask = layerMask;
+			CollisionQueryStats::EndQuery(queryStart, counts, finalOutput.m_didIntersect);
+			return finalOutput;
+		}
+
+		// layers using a bvh do not walk the grid at all, and their hits cut the grid walk short
+		unsigned gridMask = 0;
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			if (!(layerMask & LayerBit((CollisionLayer)i))) { continue; }
+
+			if (s_layerBackends[i] == CollisionBackend::BVH) { s_bvhs[i].RayCast(rayPosition, rd, checkDist, &finalOutput, &counts); }
+			else if (s_spatialGrids[i].GetObjectList()->GetCount() > 0) { gridMask |= LayerBit((CollisionLayer)i); }
+		}
+
+		// one walk for every group of grids that line up, which is normally all of them
+		while (gridMask)
+		{
+			unsigned first = 0;
+			while (!(gridMask & LayerBit((CollisionLayer)first))) { first++; }
+
+			unsigned walkMask = 0;
+			for (unsigned int i = first; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+			{
+				if ((gridMask & LayerBit((CollisionLayer)i)) && DoGridsLineUp((CollisionLayer)first, (CollisionLayer)i)) { walkMask |= LayerBit((CollisionLayer)i); }
+			}
+
+			GridWalk walk;
+			walk.pClosest = &finalOutput;
+			WalkGridCells(rayPosition, rd, checkDist, walkMask, CollisionTester::ClosestHitCellCallback, &walk);
+			AddQueryCounts(&counts, walk.counts);
+			gridMask &= ~walkMask;
+		}
+
+		if (pCache)
+		{
+			pCache->m_fallbackCount++;
+			pCache->m_hasProbeEnd = true;
+			pCache->m_probeEnd = rayPosition + rd * (finalOutput.m_didIntersect ? finalOutput.m_distance : checkDist);
+			pCache->m_layerMask = layerMask;
+		}
+
+		CollisionQueryStats::EndQuery(queryStart, counts, finalOutput.m_didIntersect);
+		return finalOutput;
+	}
+
+	bool CollisionTester::IsSegmentOccluded(const Vec3 & segmentStart, const Vec3 & segmentEnd, unsigned layerMask, const GraphicalObject * pIgnoredObject)
+	{
+		Vec3 startToEnd = segmentEnd - segmentStart;
+		return IsRayOccluded(segmentStart, startToEnd, startToEnd.Length(), layerMask, pIgnoredObject);
+	}
+
+	// same layers and culling as FindWallInLayers, but any triangle within checkDist is enough so nothing past the first one is tested
+	bool CollisionTester::IsRayOccluded(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, unsigned layerMask, const GraphicalObject * pIgnoredObject)
+	{
+		Vec3 rd = rayDirection.Normalize();
+		SyncEnabledOwners();
+		long long queryStart = CollisionQueryStats::BeginQuery();
+		CollisionQueryCounts counts;
+		bool occluded = false;
+
+		unsigned gridMask = 0;
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS && !occluded; ++i)
+		{
+			if (!(layerMask & LayerBit((CollisionLayer)i))) { continue; }
+
+			if (s_layerBackends[i] == CollisionBackend::BVH) { occluded = s_bvhs[i].IsOccluded(rayPosition, rd, checkDist, pIgnoredObject, &counts); }
+			else if (s_spatialGrids[i].GetObjectList()->GetCount() > 0) { gridMask |= LayerBit((CollisionLayer)i); }
+		}
+
+		while (gridMask && !occluded)
+		{
+			unsigned first = 0;
+			while (!(gridMask & LayerBit((CollisionLayer)first))) { first++; }
+
+			unsigned walkMask = 0;
+			for (unsigned int i = first; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+			{
+				if ((gridMask & LayerBit((CollisionLayer)i)) && DoGridsLineUp((CollisionLayer)first, (CollisionLayer)i)) { walkMask |= LayerBit((CollisionLayer)i); }
+			}
+
+			GridWalk walk;
+			walk.pIgnoredObject = pIgnoredObject;
+			WalkGridCells(rayPosition, rd, checkDist, walkMask, CollisionTester::OcclusionCellCallback, &walk);
+			AddQueryCounts(&counts, walk.counts);
+			occluded = walk.occluded;
+			gridMask &= ~walkMask;
+		}
+
+		CollisionQueryStats::EndQuery(queryStart, counts, occluded);
+		return occluded;
+	}
+
+	bool CollisionTester::FindOcclusions(const RayCastingInput * pRays, bool * pOutOccluded, int rayCount)
+	{
+		if (!pRays || !pOutOccluded) { GameLogger::Log(MessageType::cError, "Failed to FindOcclusions! Rays or outputs were nullptr!\n"); return false; }
+		if (rayCount <= 0) { return true; }
+		if (!s_rayWorkers.IsInitialized() && !InitializeRayWorkers()) { return false; }
+		SyncEnabledOwners();
+
+		RayBatch batch{ pRays, nullptr, pOutOccluded, rayCount, CollisionQueryStats::GetQueryTag() };
+		int jobCount = (rayCount + RAYS_PER_BATCH_JOB - 1) / RAYS_PER_BATCH_JOB;
+		return s_rayWorkers.RunJobs(jobCount, CollisionTester::FindOcclusionsJobPassThrough, &batch);
+	}
+
+	bool CollisionTester::FindWalls(const RayCastingInput * pRays, RayCastingOutput * pOutputs, int rayCount)
+	{
+		if (!pRays || !pOutputs) { GameLogger::Log(MessageType::cError, "Failed to FindWalls! Rays or outputs were nullptr!\n"); return false; }
+		if (rayCount <= 0) { return true; }
+		if (!s_rayWorkers.IsInitialized() && !InitializeRayWorkers()) { return false; }
+		SyncEnabledOwners();
+
+		// every ray writes only its own output, so the results come back in the same order no matter which thread ran them
+		RayBatch batch{ pRays, pOutputs, nullptr, rayCount, CollisionQueryStats::GetQueryTag() };
+		int jobCount = (rayCount + RAYS_PER_BATCH_JOB - 1) / RAYS_PER_BATCH_JOB;
+		return s_rayWorkers.RunJobs(jobCount, CollisionTester::FindWallsJobPassThrough, &batch);
+	}
+
+	RayCastingOutput CollisionTester::SphereCast(const Vec3 & sphereCenter, float radius, const Vec3 & direction, float checkDist, unsigned layerMask)
+	{
+		return CapsuleCast(sphereCenter, sphereCenter, radius, direction, checkDist, layerMask);
+	}
+
+	// m_distance is how far the shape travels before touching, m_intersectionPoint is the contact on the triangle and m_triangleNormal points from it back at the shape
+	RayCastingOutput CollisionTester::CapsuleCast(const Vec3 & capsuleStart, const Vec3 & capsuleEnd, float radius, const Vec3 & direction, float checkDist, unsigned layerMask)
+	{
+		RayCastingOutput finalOutput;
+		SyncEnabledOwners();
+		long long queryStart = CollisionQueryStats::BeginQuery();
+
+		ShapeSweep sweep;
+		sweep.start = capsuleStart;
+		sweep.end = capsuleEnd;
+		sweep.radius = radius;
+		sweep.direction = direction.Normalize();
+		sweep.checkDist = checkDist;
+		sweep.pClosest = &finalOutput;
+
+		TriangleMailbox mailbox;
+
+		// every triangle the shape could touch lies in the box around where it starts and where it stops
+		Vec3 stopStart = capsuleStart + sweep.direction * checkDist;
+		Vec3 stopEnd = capsuleEnd + sweep.direction * checkDist;
+		sweep.sweptMin = MathUtility::Min(MathUtility::Min(capsuleStart, capsuleEnd), MathUtility::Min(stopStart, stopEnd)) - Vec3(radius);
+		sweep.sweptMax = MathUtility::Max(MathUtility::Max(capsuleStart, capsuleEnd), MathUtility::Max(stopStart, stopEnd)) + Vec3(radius);
+
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		{
+			if (!(layerMask & LayerBit((CollisionLayer)i))) { continue; }
+
+			if (s_layerBackends[i] == CollisionBackend::BVH) { s_bvhs[i].WalkTrianglesInBox(sweep.sweptMin, sweep.sweptMax, CollisionTester::SweepTrianglePassThrough, &sweep); continue; }
+
+			SpatialGrid& grid = s_spatialGrids[i];
+			if (grid.GetObjectList()->GetCount() == 0) { continue; }
+			SweepGridCells(&sweep, &grid, GridMailboxKey((int)i), &mailbox);
+		}
+
+		RecordMailboxStats(mailbox);
+		CollisionQueryStats::EndQuery(queryStart, sweep.counts, finalOutput.m_didIntersect);
+		return finalOutput;
+	}
+
+	// walks the grid a slab of bricks at a time along whichever axis the sweep covers most, so only the cells near the shape's path are looked at
+	void CollisionTester::SweepGridCells(ShapeSweep * pSweep, SpatialGrid * pGrid, unsigned gridKey, TriangleMailbox * pMailbox)
 	{
-		return s_spatialGrids[(unsigned)layer].InitializeDisplayGrid(color, pCamMat, pPerspMat, tintIntensityLoc, tintColorLoc, modelToWorldMatLoc, worldToViewMatLoc, perspectiveMatLoc, pShaderID);
+		float gridScale = pGrid->GetGridScale();
+		Vec3 gridOrigin = pGrid->GetGridOrigin();
+		int cellsPerAxis[3]{ pGrid->GetGridWidth(), pGrid->GetGridDepth(), pGrid->GetGridHeight() };
+		int low[3], high[3];
+		int longestAxis = 0;
+		for (int a = 0; a < 3; ++a)
+		{
+			// cells outside the grid never hold anything
+			low[a] = MathUtility::Clamp((int)floorf((pSweep->sweptMin[a] - gridOrigin[a]) / gridScale), 0, cellsPerAxis[a] - 1);
+			high[a] = MathUtility::Clamp((int)floorf((pSweep->sweptMax[a] - gridOrigin[a]) / gridScale), 0, cellsPerAxis[a] - 1);
+			if (high[a] - low[a] > high[longestAxis] - low[longestAxis]) { longestAxis = a; }
+		}
+
+		// a cell can only hold something the shape touches if its center is within the radius plus half its diagonal of the swept area
+		float cellReach = pSweep->radius + 0.8660254f * gridScale;
+		float cellReachSquared = cellReach * cellReach;
+		GraphicalObject **pOwners = pGrid->GetOwners();
+		const SpatialGrid::OwnerBounds *pOwnerBounds = pGrid->GetOwnerBounds();
+		const unsigned *pEnabledOwnerBits = pGrid->GetEnabledOwnerBits();
+		const int cellMask = SpatialGrid::OCCUPANCY_BRICK_SIZE - 1;
+
+		int u = longestAxis, v = (longestAxis + 1) % 3, w = (longestAxis + 2) % 3;
+		for (int slab = low[u] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; slab <= high[u] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++slab)
+		{
+			// the part of the swept area inside this slab of bricks, grown by the radius
+			int slabLow = MathUtility::Max(slab << SpatialGrid::OCCUPANCY_BRICK_SHIFT, low[u]);
+			int slabHigh = MathUtility::Min((slab << SpatialGrid::OCCUPANCY_BRICK_SHIFT) + cellMask, high[u]);
+			float slabMin = gridOrigin[u] + gridScale * (float)slabLow - pSweep->radius;
+			float slabMax = gridOrigin[u] + gridScale * (float)(slabHigh + 1) + pSweep->radius;
+			Vec3 pieceMin, pieceMax;
+			if (!ClipSweptArea(*pSweep, u, slabMin, slabMax, &pieceMin, &pieceMax)) { continue; }
+
+			int cellLow[3], cellHigh[3];
+			cellLow[u] = slabLow;
+			cellHigh[u] = slabHigh;
+			for (int a = v; a != u; a = (a + 1) % 3)
+			{
+				cellLow[a] = MathUtility::Max((int)floorf((pieceMin[a] - pSweep->radius - gridOrigin[a]) / gridScale), low[a]);
+				cellHigh[a] = MathUtility::Min((int)floorf((pieceMax[a] + pSweep->radius - gridOrigin[a]) / gridScale), high[a]);
+			}
+
+			if (cellLow[v] > cellHigh[v] || cellLow[w] > cellHigh[w]) { continue; }
+
+			for (int brickV = cellLow[v] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; brickV <= cellHigh[v] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++brickV)
+			{
+				for (int brickW = cellLow[w] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; brickW <= cellHigh[w] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++brickW)
+				{
+					int brick[3];
+					brick[u] = slab;
+					brick[v] = brickV;
+					brick[w] = brickW;
+					unsigned long long occupancy = pGrid->GetOccupancyMask(brick[0], brick[1], brick[2]);
+					if (!occupancy) { continue; }
+
+					// only the occupied cells of the brick that fall in this slab's range
+					for (; occupancy; occupancy &= occupancy - 1)
+					{
+						int bit = 0;
+						while (!(occupancy & (1ull << bit))) { ++bit; }
+
+						int cell[3];
+						cell[0] = (brick[0] << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | (bit & cellMask);
+						cell[1] = (brick[1] << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | ((bit >> SpatialGrid::OCCUPANCY_BRICK_SHIFT) & cellMask);
+						cell[2] = (brick[2] << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | (bit >> (2 * SpatialGrid::OCCUPANCY_BRICK_SHIFT));
+						if (cell[v] < cellLow[v] || cell[v] > cellHigh[v] || cell[w] < cellLow[w] || cell[w] > cellHigh[w] || cell[u] < cellLow[u] || cell[u] > cellHigh[u]) { continue; }
+
+						Vec3 cellCenter = gridOrigin + gridScale * Vec3((float)cell[0] + 0.5f, (float)cell[1] + 0.5f, (float)cell[2] + 0.5f);
+						if (SweptAreaDistanceSquared(*pSweep, cellCenter) > cellReachSquared) { continue; }
+
+						int triangleCount = 0;
+						SpatialTriangleBlock *pBlocks = pGrid->GetTriangleBlocksByGrid(cell[0], cell[1], cell[2], &triangleCount);
+						if (!pBlocks) { continue; }
+						pSweep->counts.m_cellsVisited++;
+
+						// the block lanes say whether each triangle is enabled and new without touching its owner
+						for (int b = 0; b * SpatialTriangleBlock::TRIANGLES_PER_BLOCK < triangleCount; ++b)
+						{
+							int candidateLanes = OverlappingBlockLanes(pBlocks + b, pOwnerBounds, pSweep->sweptMin, pSweep->sweptMax);
+							if (!candidateLanes) { continue; }
+
+							int laneMask = MarkBlockTested(pMailbox, pBlocks + b, triangleCount - b * SpatialTriangleBlock::TRIANGLES_PER_BLOCK, pEnabledOwnerBits, gridKey, candidateLanes);
+							for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+							{
+								if (!(laneMask & (1 << lane))) { continue; }
+
+								// rebuilt from the lane, the same corners the ray tests see
+								const SpatialTriangleBlock& block = pBlocks[b];
+								SpatialTriangleData triangle;
+								triangle.p0 = Vec3(block.p0x[lane], block.p0y[lane], block.p0z[lane]);
+								triangle.p1 = triangle.p0 + Vec3(block.e1x[lane], block.e1y[lane], block.e1z[lane]);
+								triangle.p2 = triangle.p0 + Vec3(block.e2x[lane], block.e2y[lane], block.e2z[lane]);
+								triangle.m_pTriangleOwner = pOwners[block.ownerIndex[lane]];
+								triangle.m_triangleVertexZeroIndex = block.vertexIndex[lane];
+								SweepTrianglePassThrough(&triangle, block.doubleSided[lane] != 0.0f, pSweep);
+							}
+						}
+					}
+				}
+			}
+		}
 	}
 
-	void CollisionTester::DrawGrid(CollisionLayer layer, const Vec3& centerPos)
+	// the box around the part of the area the capsule's axis sweeps through that lies between two planes across the given axis, false if none of it does
+	bool CollisionTester::ClipSweptArea(const ShapeSweep & sweep, int axis, float planeMin, float planeMax, Vec3 * pOutMin, Vec3 * pOutMax)
 	{
-		s_spatialGrids[(unsigned)layer].DrawDebugShapes(centerPos); // TEMPORARY TODO REPLACE
+		// the area is the parallelogram between where the axis starts and where it stops, every edge crossing a plane adds a corner
+		Vec3 travel = sweep.direction * sweep.checkDist;
+		Vec3 corners[4]{ sweep.start, sweep.end, sweep.end + travel, sweep.start + travel };
+		bool found = false;
+		Vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+		for (int i = 0; i < 4; ++i)
+		{
+			const Vec3& a = corners[i];
+			const Vec3& b = corners[(i + 1) % 4];
+			float planes[2]{ planeMin, planeMax };
+			Vec3 points[3]{ a, a, a };
+			int pointCount = 0;
+			if (a[axis] >= planeMin && a[axis] <= planeMax) { points[pointCount++] = a; }
+			for (int p = 0; p < 2; ++p)
+			{
+				if ((a[axis] < planes[p]) == (b[axis] < planes[p])) { continue; }
+				Vec3 crossing = a + (b - a) * ((planes[p] - a[axis]) / (b[axis] - a[axis]));
+				points[pointCount++] = crossing;
+			}
+
+			for (int p = 0; p < pointCount; ++p)
+			{
+				boxMin = MathUtility::Min(boxMin, points[p]);
+				boxMax = MathUtility::Max(boxMax, points[p]);
+				found = true;
+			}
+		}
+
+		*pOutMin = boxMin;
+		*pOutMax = boxMax;
+		return found;
 	}
 
-	void CollisionTester::ConsoleLogOutput()
+	// squared distance from a point to the parallelogram the capsule's axis sweeps, the shape touches the point if it is within the radius
+	float CollisionTester::SweptAreaDistanceSquared(const ShapeSweep & sweep, const Vec3 & point)
 	{
-		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+		Vec3 axis = sweep.end - sweep.start;
+		Vec3 travel = sweep.direction * sweep.checkDist;
+		Vec3 relative = point - sweep.start;
+
+		// straight down onto the face when that lands inside it
+		float aa = axis.Dot(axis), at = axis.Dot(travel), tt = travel.Dot(travel);
+		float denominator = aa * tt - at * at;
+		if (denominator > 0.000001f * aa * tt)
 		{
-			GameLogger::Log(MessageType::cDebug, "========================== Begin Spatial grid [%s] ==========================\n", LayerString((CollisionLayer)i));
-			s_spatialGrids[i].CalculateStatisticsFromCounts();
-			s_spatialGrids[i].ConsoleLogStats();
-			GameLogger::Log(MessageType::cDebug, "========================== End Spatial grid [%s] ==========================\n\n", LayerString((CollisionLayer)i));
+			float ra = relative.Dot(axis), rt = relative.Dot(travel);
+			float s = (ra * tt - rt * at) / denominator;
+			float t = (rt * aa - ra * at) / denominator;
+			if (s >= 0.0f && s <= 1.0f && t >= 0.0f && t <= 1.0f) { return (relative - axis * s - travel * t).LengthSquared(); }
 		}
+
+		// otherwise the closest point is on an edge, which also covers a sphere or a sweep along the axis
+		float s, t;
+		float best = MathUtility::ClosestPointsOnSegments(point, point, sweep.start, sweep.end, &s, &t);
+		best = MathUtility::Min(best, MathUtility::ClosestPointsOnSegments(point, point, sweep.start + travel, sweep.end + travel, &s, &t));
+		best = MathUtility::Min(best, MathUtility::ClosestPointsOnSegments(point, point, sweep.start, sweep.start + travel, &s, &t));
+		best = MathUtility::Min(best, MathUtility::ClosestPointsOnSegments(point, point, sweep.end, sweep.end + travel, &s, &t));
+		return best;
+	}
+
+	Vec3 CollisionTester::SlideSphere(const Vec3 & sphereCenter, float radius, const Vec3 & movement, unsigned layerMask, int maxSlides)
+	{
+		return SlideCapsule(sphereCenter, sphereCenter, radius, movement, layerMask, maxSlides);
 	}
 
-	RayCastingOutput CollisionTester::FindWall(const Vec3 & rayPosition, const Vec3 & rayDirection, float checkDist, CollisionLayer layer)
+	// moves until something is in the way, then keeps whatever part of the remaining movement runs along it, returns how far the shape actually moved
+	Vec3 CollisionTester::SlideCapsule(const Vec3 & capsuleStart, const Vec3 & capsuleEnd, float radius, const Vec3 & movement, unsigned layerMask, int maxSlides)
 	{
-		if (layer == CollisionLayer::NUM_LAYERS) 
+		// stopping just short keeps the shape from starting the next sweep already touching
+		const float SLIDE_SKIN = 0.01f;
+
+		Vec3 moved(0.0f);
+		Vec3 remaining = movement;
+		for (int i = 0; i < maxSlides; ++i)
 		{
-			RayCastingOutput multiLayerOutput = CollisionTester::FindWall(rayPosition, rayDirection, checkDist, CollisionLayer::STATIC_GEOMETRY);
+			float length = remaining.Length();
+			if (!(length > 0.0f)) { return moved; }
 
-			for (unsigned int i = 1; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
-			{
-				float cd = (multiLayerOutput.m_didIntersect && multiLayerOutput.m_distance < checkDist) ? multiLayerOutput.m_distance : checkDist;
-				RayCastingOutput thisLayerOutput = CollisionTester::FindWall(rayPosition, rayDirection, cd, (CollisionLayer)i);
-				if ((thisLayerOutput.m_didIntersect && thisLayerOutput.m_distance < multiLayerOutput.m_distance) || !multiLayerOutput.m_didIntersect) { multiLayerOutput = thisLayerOutput; }
-			}
+			Vec3 direction = remaining / length;
+			RayCastingOutput contact = CapsuleCast(capsuleStart + moved, capsuleEnd + moved, radius, direction, length + SLIDE_SKIN, layerMask);
+			if (!contact.m_didIntersect) { return moved + remaining; }
+
+			float travel = MathUtility::Max(contact.m_distance - SLIDE_SKIN, 0.0f);
+			moved = moved + direction * travel;
+			remaining = remaining - direction * travel;
 
-			return multiLayerOutput;
+			// take away the part heading into the surface
+			float into = remaining.Dot(contact.m_triangleNormal);
+			if (into < 0.0f) { remaining = remaining - contact.m_triangleNormal * into; }
 		}
 
-		// normalize input for future ray casts
-		Vec3 rd = rayDirection.Normalize();
+		return moved;
+	}
 
-		// create variable to hold output
-		RayCastingOutput finalOutput;
+	// writes each enabled object whose own bounds overlap the box once, returns how many were written
+	int CollisionTester::QueryAABB(const Vec3 & boxMin, const Vec3 & boxMax, GraphicalObject ** outObjects, int maxObjects, unsigned layerMask)
+	{
+		ObjectQuery query;
+		query.boxMin = boxMin;
+		query.boxMax = boxMax;
+		query.outObjects = outObjects;
+		query.maxObjects = maxObjects;
+
+		long long queryStart = CollisionQueryStats::BeginQuery();
+		int count = QueryObjects(&query, layerMask);
+		CollisionQueryStats::EndQuery(queryStart, query.counts, count > 0);
+		return count;
+	}
+
+	// the same as QueryAABB, but the objects' bounds have to reach into the sphere
+	int CollisionTester::QuerySphere(const Vec3 & sphereCenter, float radius, GraphicalObject ** outObjects, int maxObjects, unsigned layerMask)
+	{
+		ObjectQuery query;
+		query.boxMin = sphereCenter - Vec3(radius);
+		query.boxMax = sphereCenter + Vec3(radius);
+		query.isSphere = true;
+		query.sphereCenter = sphereCenter;
+		query.radiusSquared = radius * radius;
+		query.outObjects = outObjects;
+		query.maxObjects = maxObjects;
+
+		long long queryStart = CollisionQueryStats::BeginQuery();
+		int count = QueryObjects(&query, layerMask);
+		CollisionQueryStats::EndQuery(queryStart, query.counts, count > 0);
+		return count;
+	}
 
-		// grab scale and calculate end position
-		float gridScale = s_spatialGrids[(unsigned)layer].GetGridScale();
-		Vec3 rp = rayPosition + Vec3(0.5f * gridScale* s_spatialGrids[(unsigned)layer].GetGridWidth(), 0.5f * gridScale* s_spatialGrids[(unsigned)layer].GetGridDepth(), 0.5f*gridScale*s_spatialGrids[(unsigned)layer].GetGridHeight());
-		Vec3 endPosition = rp + rd*checkDist;
-
-		/// calculate the begining and end grid indices from the positions
-		int i = (int)floorf(rp.GetX() / gridScale);
-		int j = (int)floorf(rp.GetZ() / gridScale);
-		int k = (int)floorf(rp.GetY() / gridScale);
-		int iEnd = (int)floorf(endPosition.GetX() / gridScale);
-		int jEnd = (int)floorf(endPosition.GetZ() / gridScale);
-		int kEnd = (int)floorf(endPosition.GetY() / gridScale);
-
-		// pick the directions to step in
-		int deltaI = ((rp.GetX() < endPosition.GetX()) ? 1 : ((rp.GetX() > endPosition.GetX()) ? -1 : 0));
-		int deltaJ = ((rp.GetZ() < endPosition.GetZ()) ? 1 : ((rp.GetZ() > endPosition.GetZ()) ? -1 : 0));
-		int deltaK = ((rp.GetY() < endPosition.GetY()) ? 1 : ((rp.GetY() > endPosition.GetY()) ? -1 : 0));
-
-		// MATHS!!! 
-		float minX = gridScale * floorf(rp.GetX() / gridScale);
-		float maxX = minX + gridScale;
-		float tx = ((rp.GetX() > endPosition.GetX()) ? (rp.GetX() - minX) : (maxX - rp.GetX())) / fabsf(endPosition.GetX() - rp.GetX());
-		float minZ = gridScale * floorf(rp.GetZ() / gridScale);
-		float maxZ = gridScale + minZ;
-		float tz = ((rp.GetZ() > endPosition.GetZ()) ? (rp.GetZ() - minZ) : (maxZ - rp.GetZ())) / fabsf(endPosition.GetZ() - rp.GetZ());
-		float minY = gridScale * floorf(rp.GetY() / gridScale);
-		float maxY = minY + gridScale;
-		float ty = ((rp.GetY() > endPosition.GetY()) ? (rp.GetY() - minY) : (maxY - rp.GetY())) / fabsf(endPosition.GetY() - rp.GetY());
-
-		// calculate more things
-		float dx = gridScale / fabsf(endPosition.GetX() - rp.GetX());
-		float dz = gridScale / fabsf(endPosition.GetZ() - rp.GetZ());
-		float dy = gridScale / fabsf(endPosition.GetY() - rp.GetY());
+	int CollisionTester::QueryObjects(ObjectQuery * pQuery, unsigned layerMask)
+	{
+		if (!pQuery->outObjects || pQuery->maxObjects <= 0) { return 0; }
+		SyncEnabledOwners();
 
+		// the mailbox is keyed by the object itself, so one added to more than one layer is still only written once
+		for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS && pQuery->count < pQuery->maxObjects; ++i)
+		{
+			if (!(layerMask & LayerBit((CollisionLayer)i))) { continue; }
 
-		for (;;)
+			if (s_layerBackends[i] == CollisionBackend::BVH) { s_bvhs[i].WalkTrianglesInBox(pQuery->boxMin, pQuery->boxMax, CollisionTester::QueryTrianglePassThrough, pQuery); }
+			else if (s_spatialGrids[i].GetObjectList()->GetCount() > 0) { QueryGridCells(pQuery, &s_spatialGrids[i]); }
+		}
+
+		return pQuery->count;
+	}
+
+	// only the occupied cells under the box are read, and only the owner of each lane, never the triangle itself
+	void CollisionTester::QueryGridCells(ObjectQuery * pQuery, SpatialGrid * pGrid)
+	{
+		float gridScale = pGrid->GetGridScale();
+		Vec3 gridOrigin = pGrid->GetGridOrigin();
+		int cellsPerAxis[3]{ pGrid->GetGridWidth(), pGrid->GetGridDepth(), pGrid->GetGridHeight() };
+		int low[3], high[3];
+		for (int a = 0; a < 3; ++a)
 		{
-			SpatialTriangleData *pFirst = s_spatialGrids[(unsigned)layer].GetTriangleDataByGrid(i, k, j);
+			// cells outside the grid never hold anything
+			low[a] = MathUtility::Clamp((int)floorf((pQuery->boxMin[a] - gridOrigin[a]) / gridScale), 0, cellsPerAxis[a] - 1);
+			high[a] = MathUtility::Clamp((int)floorf((pQuery->boxMax[a] - gridOrigin[a]) / gridScale), 0, cellsPerAxis[a] - 1);
+		}
+
+		GraphicalObject **pOwners = pGrid->GetOwners();
+		const SpatialGrid::OwnerBounds *pOwnerBounds = pGrid->GetOwnerBounds();
+		const unsigned *pEnabledOwnerBits = pGrid->GetEnabledOwnerBits();
+		const int cellMask = SpatialGrid::OCCUPANCY_BRICK_SIZE - 1;
 
-			if (pFirst)
+		for (int brickX = low[0] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; brickX <= high[0] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++brickX)
+		{
+			for (int brickY = low[1] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; brickY <= high[1] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++brickY)
 			{
-				for (int c = 0; c < s_spatialGrids[(unsigned)layer].GetGridTriangleCount(i, k, j); ++c)
+				for (int brickZ = low[2] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; brickZ <= high[2] >> SpatialGrid::OCCUPANCY_BRICK_SHIFT; ++brickZ)
 				{
-					SpatialTriangleData *pCurrent = pFirst + c;
-					if (pCurrent)
+					unsigned long long occupancy = pGrid->GetOccupancyMask(brickX, brickY, brickZ);
+					for (; occupancy; occupancy &= occupancy - 1)
 					{
-						if (pCurrent->m_pTriangleOwner->IsEnabled())
+						int bit = 0;
+						while (!(occupancy & (1ull << bit))) { ++bit; }
+
+						int cellX = (brickX << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | (bit & cellMask);
+						int cellY = (brickY << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | ((bit >> SpatialGrid::OCCUPANCY_BRICK_SHIFT) & cellMask);
+						int cellZ = (brickZ << SpatialGrid::OCCUPANCY_BRICK_SHIFT) | (bit >> (2 * SpatialGrid::OCCUPANCY_BRICK_SHIFT));
+						if (cellX < low[0] || cellX > high[0] || cellY < low[1] || cellY > high[1] || cellZ < low[2] || cellZ > high[2]) { continue; }
+
+						int triangleCount = 0;
+						SpatialTriangleBlock *pBlocks = pGrid->GetTriangleBlocksByGrid(cellX, cellY, cellZ, &triangleCount);
+						if (!pBlocks) { continue; }
+						pQuery->counts.m_cellsVisited++;
+
+						// an object's triangles sit next to each other in a cell, so most repeats are the lane just read
+						int lastOwnerIndex = -1;
+						for (int t = 0; t < triangleCount; ++t)
 						{
-							RayCastingOutput output = RayTriangleIntersect(rayPosition, rd, pCurrent->p0, pCurrent->p1, pCurrent->p2, finalOutput.m_distance);
-							if (output.m_didIntersect && output.m_distance < finalOutput.m_distance) { finalOutput = output; finalOutput.m_belongsTo = pCurrent->m_pTriangleOwner; finalOutput.m_vertexIndex = pCurrent->m_triangleVertexZeroIndex; }
+							int ownerIndex = pBlocks[t / SpatialTriangleBlock::TRIANGLES_PER_BLOCK].ownerIndex[t % SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+							if (ownerIndex < 0 || ownerIndex == lastOwnerIndex) { continue; }
+							lastOwnerIndex = ownerIndex;
 
-							if (!pCurrent->m_pTriangleOwner->GetMeshPointer()->IsCullingEnabledForObject())
-							{
-								RayCastingOutput output2 = RayTriangleIntersect(rayPosition, rd, pCurrent->p2, pCurrent->p1, pCurrent->p0, finalOutput.m_distance);
-								if (output2.m_didIntersect && output2.m_distance < finalOutput.m_distance) { finalOutput = output2; finalOutput.m_belongsTo = pCurrent->m_pTriangleOwner; finalOutput.m_vertexIndex = pCurrent->m_triangleVertexZeroIndex; }
-							}
+							if (!(pEnabledOwnerBits[ownerIndex >> 5] & (1u << (ownerIndex & 31)))) { continue; }
+							if (!MarkOwnerQueried(pQuery, pOwners[ownerIndex])) { continue; }
+							if (!AddQueriedObject(pQuery, pOwners[ownerIndex], pOwnerBounds[ownerIndex].m_min, pOwnerBounds[ownerIndex].m_max)) { return; }
 						}
 					}
-
 				}
 			}
-			
-			// checking further is irrelevant because a triangle has been hit in the closest partition
-			//if (finalOutput.m_didIntersect) { return finalOutput; }
-			// TODO: BETTER FIX FOR BUG WITH TRIANGLE COMPARISON ORDER
+		}
+	}
 
+	bool CollisionTester::QueryTrianglePassThrough(const SpatialTriangleData * pTriangle, bool /*doubleSided*/, void * pQueryData)
+	{
+		// disabled objects were already skipped by the bvh
+		ObjectQuery *pQuery = reinterpret_cast<ObjectQuery *>(pQueryData);
+		if (!MarkOwnerQueried(pQuery, pTriangle->m_pTriangleOwner)) { return true; }
 
-			if (tx <= tz && tx <= ty)
-			{
-				if (i == iEnd) { break; }
-				tx += dx;
-				i += deltaI;
-			}
-			else if (ty <= tx && ty <= tz) 
+		Vec3 boundsMin, boundsMax;
+		pTriangle->m_pTriangleOwner->GetWorldBounds(&boundsMin, &boundsMax);
+		return AddQueriedObject(pQuery, pTriangle->m_pTriangleOwner, boundsMin, boundsMax);
+	}
+
+	// returns false if the query has already checked the object
+	bool CollisionTester::MarkOwnerQueried(ObjectQuery * pQuery, const GraphicalObject * pObj)
+	{
+		OwnerMailbox *pMailbox = &pQuery->mailbox;
+		unsigned hash = (unsigned)((size_t)pObj >> 4) * 2654435761u;
+		for (int probe = 0; probe < OwnerMailbox::SLOT_COUNT; ++probe)
+		{
+			int slot = (int)((hash + probe) & (OwnerMailbox::SLOT_COUNT - 1));
+			if (pMailbox->pOwners[slot] == pObj) { return false; }
+			if (pMailbox->pOwners[slot]) { continue; }
+
+			// kept at most half full so misses stay short
+			if (pMailbox->used < OwnerMailbox::SLOT_COUNT / 2)
 			{
-				if (k == kEnd) { break; }
-				ty += dy;
-				k += deltaK;
+				pMailbox->pOwners[slot] = pObj;
+				pMailbox->used++;
+				return true;
 			}
-			else
+
+			break;
+		}
+
+		// objects past a full mailbox are checked again, only the ones already written out have to be kept from repeating
+		for (int i = 0; i < pQuery->count; ++i)
+		{
+			if (pQuery->outObjects[i] == pObj) { return false; }
+		}
+
+		return true;
+	}
+
+	// returns false once the output is full
+	bool CollisionTester::AddQueriedObject(ObjectQuery * pQuery, GraphicalObject * pObj, const Vec3 & boundsMin, const Vec3 & boundsMax)
+	{
+		if (boundsMin.GetX() > pQuery->boxMax.GetX() || boundsMax.GetX() < pQuery->boxMin.GetX()) { return true; }
+		if (boundsMin.GetY() > pQuery->boxMax.GetY() || boundsMax.GetY() < pQuery->boxMin.GetY()) { return true; }
+		if (boundsMin.GetZ() > pQuery->boxMax.GetZ() || boundsMax.GetZ() < pQuery->boxMin.GetZ()) { return true; }
+		if (pQuery->isSphere && (MathUtility::Clamp(pQuery->sphereCenter, boundsMin, boundsMax) - pQuery->sphereCenter).LengthSquared() > pQuery->radiusSquared) { return true; }
+
+		pQuery->outObjects[pQuery->count++] = pObj;
+		return pQuery->count < pQuery->maxObjects;
+	}
+
+	bool CollisionTester::SweepTrianglePassThrough(const SpatialTriangleData * pTriangle, bool doubleSided, void * pSweepData)
+	{
+		// disabled objects were already skipped by whatever found the triangle
+		ShapeSweep *pSweep = reinterpret_cast<ShapeSweep *>(pSweepData);
+		pSweep->counts.m_trianglesTested++;
+
+		// cheap box reject before the real test
+		if (MathUtility::Max(MathUtility::Max(pTriangle->p0.GetX(), pTriangle->p1.GetX()), pTriangle->p2.GetX()) < pSweep->sweptMin.GetX()) { return true; }
+		if (MathUtility::Max(MathUtility::Max(pTriangle->p0.GetY(), pTriangle->p1.GetY()), pTriangle->p2.GetY()) < pSweep->sweptMin.GetY()) { return true; }
+		if (MathUtility::Max(MathUtility::Max(pTriangle->p0.GetZ(), pTriangle->p1.GetZ()), pTriangle->p2.GetZ()) < pSweep->sweptMin.GetZ()) { return true; }
+		if (MathUtility::Min(MathUtility::Min(pTriangle->p0.GetX(), pTriangle->p1.GetX()), pTriangle->p2.GetX()) > pSweep->sweptMax.GetX()) { return true; }
+		if (MathUtility::Min(MathUtility::Min(pTriangle->p0.GetY(), pTriangle->p1.GetY()), pTriangle->p2.GetY()) > pSweep->sweptMax.GetY()) { return true; }
+		if (MathUtility::Min(MathUtility::Min(pTriangle->p0.GetZ(), pTriangle->p1.GetZ()), pTriangle->p2.GetZ()) > pSweep->sweptMax.GetZ()) { return true; }
+
+		float maxDist = pSweep->pClosest->m_didIntersect ? pSweep->pClosest->m_distance : pSweep->checkDist;
+		float distance;
+		Vec3 contactPoint;
+		if (!SweepCapsuleTriangle(*pSweep, pTriangle, doubleSided, maxDist, &distance, &contactPoint)) { return true; }
+
+		// closer, or the first hit found
+		if (pSweep->pClosest->m_didIntersect && !(distance < pSweep->pClosest->m_distance)) { return true; }
+
+		// the normal runs from the contact to the closest point of the shape where it stopped
+		Vec3 axis = pSweep->end - pSweep->start;
+		Vec3 stoppedStart = pSweep->start + pSweep->direction * distance;
+		float axisLengthSquared = axis.LengthSquared();
+		float along = (axisLengthSquared > 0.0f) ? MathUtility::Clamp((contactPoint - stoppedStart).Dot(axis) / axisLengthSquared, 0.0f, 1.0f) : 0.0f;
+		Vec3 normal = (stoppedStart + axis * along) - contactPoint;
+		if (normal.LengthSquared() > 0.0f) { normal = normal.Normalize(); }
+		else
+		{
+			normal = (pTriangle->p1 - pTriangle->p0).Cross(pTriangle->p2 - pTriangle->p0).Normalize();
+			if (normal.Dot(pSweep->direction) > 0.0f) { normal = -normal; }
+		}
+
+		pSweep->pClosest->m_didIntersect = true;
+		pSweep->pClosest->m_distance = distance;
+		pSweep->pClosest->m_intersectionPoint = contactPoint;
+		pSweep->pClosest->m_triangleNormal = normal;
+		pSweep->pClosest->m_belongsTo = pTriangle->m_pTriangleOwner;
+		pSweep->pClosest->m_vertexIndex = pTriangle->m_triangleVertexZeroIndex;
+		return true;
+	}
+
+	// the earliest of the ends of the capsule touching the triangle, the triangle's corners touching its side, or its edges crossing the side
+	bool CollisionTester::SweepCapsuleTriangle(const ShapeSweep & sweep, const SpatialTriangleData * pTriangle, bool doubleSided, float maxDist, float * pOutDistance, Vec3 * pOutContactPoint)
+	{
+		const Vec3& d = sweep.direction;
+		const Vec3 *pCorners[3]{ &pTriangle->p0, &pTriangle->p1, &pTriangle->p2 };
+
+		Vec3 faceNormal = (pTriangle->p1 - pTriangle->p0).Cross(pTriangle->p2 - pTriangle->p0);
+		if (!(faceNormal.LengthSquared() > 0.0f)) { return false; }
+		faceNormal = faceNormal.Normalize();
+
+		// same culling as the rays, a single sided triangle only stops things moving against its front
+		if (!doubleSided && !(d.Dot(faceNormal) < 0.0f)) { return false; }
+
+		// already touching counts only if the shape is moving further in, so things can always get back out
+		Vec3 segmentPoint, trianglePoint;
+		if (MathUtility::ClosestPointsSegmentTriangle(sweep.start, sweep.end, pTriangle->p0, pTriangle->p1, pTriangle->p2, &segmentPoint, &trianglePoint) <= sweep.radius * sweep.radius)
+		{
+			Vec3 away = segmentPoint - trianglePoint;
+			if (!(away.LengthSquared() > 0.0f)) { away = (d.Dot(faceNormal) < 0.0f) ? faceNormal : -faceNormal; }
+			if (!(d.Dot(away) < 0.0f)) { return false; }
+
+			*pOutDistance = 0.0f;
+			*pOutContactPoint = trianglePoint;
+			return true;
+		}
+
+		bool found = false;
+		float best = maxDist;
+		float t;
+		Vec3 contact;
+
+		// the rounded ends
+		if (SweepSphereTriangle(sweep.start, sweep.radius, d, best, pTriangle, faceNormal, doubleSided, &t, &contact)) { best = t; *pOutContactPoint = contact; found = true; }
+		Vec3 axis = sweep.end - sweep.start;
+		if (!(axis.LengthSquared() > 0.0f)) { if (found) { *pOutDistance = best; } return found; }
+		if (SweepSphereTriangle(sweep.end, sweep.radius, d, best, pTriangle, faceNormal, doubleSided, &t, &contact)) { best = t; *pOutContactPoint = contact; found = true; }
+
+		// corners running into the side, seen from the capsule that is the corner moving backwards into a cylinder
+		for (int i = 0; i < 3; ++i)
+		{
+			float along;
+			if (RayCylinderSide(*pCorners[i], -d, sweep.start, sweep.end, sweep.radius, best, &t, &along)) { best = t; *pOutContactPoint = *pCorners[i]; found = true; }
+		}
+
+		// edges crossing the side, the distance between the two lines changes linearly as the capsule moves
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vec3& edgeStart = *pCorners[i];
+			const Vec3& edgeEnd = *pCorners[(i + 1) % 3];
+			Vec3 between = axis.Cross(edgeEnd - edgeStart);
+			if (!(between.LengthSquared() > 0.000001f * axis.LengthSquared() * (edgeEnd - edgeStart).LengthSquared())) { continue; }
+			between = between.Normalize();
+
+			float gap = (edgeStart - sweep.start).Dot(between);
+			float closing = d.Dot(between);
+			if (fabsf(gap) <= sweep.radius || !(gap * closing > 0.0f)) { continue; }
+
+			t = (gap - ((gap > 0.0f) ? sweep.radius : -sweep.radius)) / closing;
+			if (t < 0.0f || !(t < best)) { continue; }
+
+			// only a touch if the closest points of the lines are on both segments
+			float s, u;
+			float distanceSquared = MathUtility::ClosestPointsOnSegments(sweep.start + d * t, sweep.end + d * t, edgeStart, edgeEnd, &s, &u);
+			if (distanceSquared > sweep.radius * sweep.radius * 1.0001f) { continue; }
+
+			best = t;
+			*pOutContactPoint = edgeStart + (edgeEnd - edgeStart) * u;
+			found = true;
+		}
+
+		if (found) { *pOutDistance = best; }
+		return found;
+	}
+
+	bool CollisionTester::SweepSphereTriangle(const Vec3 & center, float radius, const Vec3 & direction, float maxDist, const SpatialTriangleData * pTriangle, const Vec3 & faceNormal, bool doubleSided, float * pOutDistance, Vec3 * pOutContactPoint)
+	{
+		// face the normal toward the sphere, a single sided triangle seen from behind cannot be touched
+		Vec3 n = faceNormal;
+		float height = (center - pTriangle->p0).Dot(n);
+		if (doubleSided && height < 0.0f) { n = -n; height = -height; }
+		if (height < 0.0f) { return false; }
+
+		// the face first, if the sphere lands inside the triangle nothing else can be touched sooner
+		float approach = direction.Dot(n);
+		if (approach < 0.0f && height > radius)
+		{
+			float t = (height - radius) / -approach;
+			if (!(t < maxDist)) { return false; }
+
+			Vec3 onPlane = center + direction * t - n * radius;
+			if ((MathUtility::ClosestPointOnTriangle(onPlane, pTriangle->p0, pTriangle->p1, pTriangle->p2) - onPlane).LengthSquared() <= 0.000001f * radius * radius)
 			{
-				if (j == jEnd) { break; }
-				tz += dz;
-				j += deltaJ;
+				*pOutDistance = t;
+				*pOutContactPoint = onPlane;
+				return true;
 			}
 		}
 
-		return finalOutput;
+		bool found = false;
+		float best = maxDist;
+		float t;
+		const Vec3 *pCorners[3]{ &pTriangle->p0, &pTriangle->p1, &pTriangle->p2 };
+
+		for (int i = 0; i < 3; ++i)
+		{
+			// the edges as cylinders
+			float along;
+			const Vec3& edgeStart = *pCorners[i];
+			const Vec3& edgeEnd = *pCorners[(i + 1) % 3];
+			if (RayCylinderSide(center, direction, edgeStart, edgeEnd, radius, best, &t, &along)) { best = t; *pOutContactPoint = edgeStart + (edgeEnd - edgeStart) * along; found = true; }
+
+			// the corners as spheres
+			Vec3 m = center - *pCorners[i];
+			float b = m.Dot(direction);
+			float c = m.Dot(m) - radius * radius;
+			float discriminant = b * b - c;
+			if (c <= 0.0f || b >= 0.0f || discriminant < 0.0f) { continue; }
+
+			t = -b - sqrtf(discriminant);
+			if (t >= 0.0f && t < best) { best = t; *pOutContactPoint = *pCorners[i]; found = true; }
+		}
+
+		if (found) { *pOutDistance = best; }
+		return found;
 	}
 
-	RayCastingOutput CollisionTester::FindWall(Entity * pEntity, float checkDist, CollisionLayer layer)
+	// the side of the cylinder of the given radius around cylinderStart to cylinderEnd, no caps, starting inside never hits
+	bool CollisionTester::RayCylinderSide(const Vec3 & rayPosition, const Vec3 & rayDirection, const Vec3 & cylinderStart, const Vec3 & cylinderEnd, float radius, float maxDist, float * pOutDistance, float * pOutAlong)
 	{
-		if (!pEntity) { GameLogger::Log(MessageType::cError, "Failed to find wall for entity! Entity passed was nullptr!\n"); return RayCastingOutput(); }
+		Vec3 axis = cylinderEnd - cylinderStart;
+		Vec3 m = rayPosition - cylinderStart;
+		float axisDotAxis = axis.Dot(axis);
+		if (!(axisDotAxis > 0.0f)) { return false; }
 
-		SpatialComponent *pSpatial = pEntity->GetComponentByType<SpatialComponent>();
-		if (!pSpatial) { GameLogger::Log(MessageType::cError, "Failed to find wall for entity! Entity has no spatial component!\n"); return RayCastingOutput(); }
+		float mDotAxis = m.Dot(axis);
+		float dDotAxis = rayDirection.Dot(axis);
+		float a = axisDotAxis - dDotAxis * dDotAxis;
+		float b = axisDotAxis * m.Dot(rayDirection) - dDotAxis * mDotAxis;
+		float c = axisDotAxis * (m.Dot(m) - radius * radius) - mDotAxis * mDotAxis;
 
-		return FindWall(pSpatial->GetPosition(), pSpatial->GetForward(), checkDist, layer);
+		// running parallel to the axis only ever touches the ends, which the caller handles as spheres
+		if (!(a > 0.000001f * axisDotAxis) || c <= 0.0f) { return false; }
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f) { return false; }
+
+		float t = (-b - sqrtf(discriminant)) / a;
+		if (t < 0.0f || !(t < maxDist)) { return false; }
+
+		float along = (mDotAxis + t * dDotAxis) / axisDotAxis;
+		if (along < 0.0f || along > 1.0f) { return false; }
+
+		*pOutDistance = t;
+		*pOutAlong = along;
+		return true;
+	}
+
+	bool CollisionTester::InitializeRayWorkers(int workerThreadCount)
+	{
+		return s_rayWorkers.Initialize(workerThreadCount);
+	}
+
+	bool CollisionTester::ShutdownRayWorkers()
+	{
+		return s_rayWorkers.Shutdown();
+	}
+
+	unsigned CollisionTester::LayerBit(CollisionLayer layer)
+	{
+		return (layer == CollisionLayer::NUM_LAYERS) ? ALL_COLLISION_LAYERS_MASK : (1u << (unsigned)layer);
+	}
+
+	// grids with the same scale, origin and dimensions share cell indices, so one walk can serve all of them
+	bool CollisionTester::DoGridsLineUp(CollisionLayer first, CollisionLayer second)
+	{
+		SpatialGrid& a = s_spatialGrids[(unsigned)first];
+		SpatialGrid& b = s_spatialGrids[(unsigned)second];
+		Vec3 originA = a.GetGridOrigin();
+		Vec3 originB = b.GetGridOrigin();
+		return a.GetGridScale() == b.GetGridScale() && a.GetGridWidth() == b.GetGridWidth() && a.GetGridHeight() == b.GetGridHeight() && a.GetGridDepth() == b.GetGridDepth()
+			&& originA.GetX() == originB.GetX() && originA.GetY() == originB.GetY() && originA.GetZ() == originB.GetZ();
+	}
+
+	void CollisionTester::FindWallsJobPassThrough(int jobIndex, void * pJobData)
+	{
+		RayBatch *pBatch = reinterpret_cast<RayBatch *>(pJobData);
+		const char *pWorkerTag = CollisionQueryStats::SetQueryTag(pBatch->pQueryTag);
+
+		int start = jobIndex * RAYS_PER_BATCH_JOB;
+		int end = (start + RAYS_PER_BATCH_JOB < pBatch->rayCount) ? start + RAYS_PER_BATCH_JOB : pBatch->rayCount;
+		for (int i = start; i < end; ++i)
+		{
+			const RayCastingInput& ray = pBatch->pRays[i];
+			pBatch->pOutputs[i] = FindWallInLayers(ray.m_rayPosition, ray.m_rayDirection, ray.m_checkDist, ray.m_layerMask);
+		}
+
+		CollisionQueryStats::SetQueryTag(pWorkerTag);
+	}
+
+	void CollisionTester::FindOcclusionsJobPassThrough(int jobIndex, void * pJobData)
+	{
+		RayBatch *pBatch = reinterpret_cast<RayBatch *>(pJobData);
+		const char *pWorkerTag = CollisionQueryStats::SetQueryTag(pBatch->pQueryTag);
+
+		int start = jobIndex * RAYS_PER_BATCH_JOB;
+		int end = (start + RAYS_PER_BATCH_JOB < pBatch->rayCount) ? start + RAYS_PER_BATCH_JOB : pBatch->rayCount;
+		for (int i = start; i < end; ++i)
+		{
+			const RayCastingInput& ray = pBatch->pRays[i];
+			pBatch->pOccluded[i] = IsRayOccluded(ray.m_rayPosition, ray.m_rayDirection, ray.m_checkDist, ray.m_layerMask, ray.m_pIgnoredObject);
+		}
+
+		CollisionQueryStats::SetQueryTag(pWorkerTag);
 	}
 
-	RayCastingOutput CollisionTester::FindFloor(Entity * pEntity, float checkDist, CollisionLayer layer)
+	RayCastingOutput CollisionTester::FindFloor(Entity * pEntity, float checkDist, CollisionLayer layer, RayProbeCache * pCache)
 	{
 		if (!pEntity) { GameLogger::Log(MessageType::cError, "Failed to find floor for entity! Entity passed was nullptr!\n"); return RayCastingOutput(); }
 
 		SpatialComponent *pSpatial = pEntity->GetComponentByType<SpatialComponent>();
 		if (!pSpatial) { GameLogger::Log(MessageType::cError, "Failed to find floor for entity! Entity has no spatial component!\n"); return RayCastingOutput(); }
 
-		return FindWall(pSpatial->GetPosition(), Vec3(0.0f, -1.0f, 0.0f), checkDist, layer);
+		return FindWall(pSpatial->GetPosition(), Vec3(0.0f, -1.0f, 0.0f), checkDist, layer, pCache);
 	}
 
-	RayCastingOutput CollisionTester::FindCeiling(Entity * pEntity, float checkDist, CollisionLayer layer)
+	RayCastingOutput CollisionTester::FindCeiling(Entity * pEntity, float checkDist, CollisionLayer layer, RayProbeCache * pCache)
 	{
 		if (!pEntity) { GameLogger::Log(MessageType::cError, "Failed to find ceiling for entity! Entity passed was nullptr!\n"); return RayCastingOutput(); }
 
 		SpatialComponent *pSpatial = pEntity->GetComponentByType<SpatialComponent>();
 		if (!pSpatial) { GameLogger::Log(MessageType::cError, "Failed to find ceiling for entity! Entity has no spatial component!\n"); return RayCastingOutput(); }
 
-		return FindWall(pSpatial->GetPosition(), Vec3(0.0f, 1.0f, 0.0f), checkDist, layer);
+		return FindWall(pSpatial->GetPosition(), Vec3(0.0f, 1.0f, 0.0f), checkDist, layer, pCache);
 	}
 
 	RayCastingOutput CollisionTester::RayTriangleIntersect(const Vec3 & rayPosition, const Vec3 & rayDirection, const Vec3 & p0, const Vec3 & p1, const Vec3 & p2, float currentClosest)
@@ -345,6 +1592,188 @@ namespace Engine
 		return output;
 	}
 
+	// moller-trumbore on a packed triangle, the same test and the same outputs as one lane of RayTriangleBlockIntersect
+	bool CollisionTester::RayCollisionTriangleIntersect(const Vec3 & rayPosition, const Vec3 & rayDirection, const CollisionTriangle * pTriangle, GraphicalObject * pOwner, RayCastingOutput * pClosest)
+	{
+		// the plane says which side the ray comes from before any of the real work, back faces only count without culling
+		float facing = rayDirection.Dot(pTriangle->normal);
+		if (!(facing < 0.0f) && !pTriangle->IsDoubleSided()) { return false; }
+
+		Vec3 p = rayDirection.Cross(pTriangle->e2);
+		float det = pTriangle->e1.Dot(p);
+		if (!(det > 0.0f) && !(det < 0.0f && pTriangle->IsDoubleSided())) { return false; }
+
+		float inverseDet = 1.0f / det;
+		Vec3 toRay = rayPosition - pTriangle->p0;
+		float u = toRay.Dot(p) * inverseDet;
+		if (!(u >= 0.0f && u <= 1.0f)) { return false; }
+
+		Vec3 q = toRay.Cross(pTriangle->e1);
+		float v = rayDirection.Dot(q) * inverseDet;
+		if (!(v >= 0.0f && u + v <= 1.0f)) { return false; }
+
+		float t = pTriangle->e2.Dot(q) * inverseDet;
+		if (!(t >= 0.0f && t < pClosest->m_distance)) { return false; }
+
+		pClosest->m_didIntersect = true;
+		pClosest->m_distance = t;
+		pClosest->m_intersectionPoint = rayPosition + rayDirection * t;
+		pClosest->m_belongsTo = pOwner;
+		pClosest->m_vertexIndex = pTriangle->vertexIndex;
+
+		// a back face hit reports the reversed winding, the same as RayTriangleIntersect with (p2, p1, p0)
+		if (det > 0.0f) { pClosest->m_triangleNormal = pTriangle->normal; pClosest->m_alphaBetaGamma = Vec3(u, v, 1.0f - u - v); }
+		else { pClosest->m_triangleNormal = -pTriangle->normal; pClosest->m_alphaBetaGamma = Vec3(u, 1.0f - u - v, v); }
+		return true;
+	}
+
+	bool CollisionTester::RayCollisionTriangleOccluded(const Vec3 & rayPosition, const Vec3 & rayDirection, const CollisionTriangle * pTriangle, float checkDist)
+	{
+		// nudged out so a triangle sitting exactly at the end of the segment still counts
+		RayCastingOutput closest;
+		closest.m_distance = checkDist * 1.000001f;
+		return RayCollisionTriangleIntersect(rayPosition, rayDirection, pTriangle, nullptr, &closest);
+	}
+
+	// moller-trumbore on all four lanes at once, u and v weight p1 and p2, t is the distance along the ray, returns a bit per lane hit before maxDist
+	int CollisionTester::RayTriangleBlockLanes(const Vec3 & rayPosition, const Vec3 & rayDirection, const SpatialTriangleBlock * pBlock, float maxDist, float * t, float * u, float * v, float * det)
+	{
+		int hitMask = 0;
+
+#ifdef COLLISION_TESTER_USE_SSE
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 dx = _mm_set1_ps(rayDirection.GetX()), dy = _mm_set1_ps(rayDirection.GetY()), dz = _mm_set1_ps(rayDirection.GetZ());
+
+		const __m128 e1x = _mm_loadu_ps(pBlock->e1x), e1y = _mm_loadu_ps(pBlock->e1y), e1z = _mm_loadu_ps(pBlock->e1z);
+		const __m128 e2x = _mm_loadu_ps(pBlock->e2x), e2y = _mm_loadu_ps(pBlock->e2y), e2z = _mm_loadu_ps(pBlock->e2z);
+
+		// p = d x e2, det = e1 . p
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+		// front faces have a positive determinant, back faces only count for double sided lanes
+		__m128 faceMask = _mm_or_ps(_mm_cmpgt_ps(determinant, zero), _mm_and_ps(_mm_cmplt_ps(determinant, zero), _mm_cmpgt_ps(_mm_loadu_ps(pBlock->doubleSided), zero)));
+		if (!_mm_movemask_ps(faceMask)) { return 0; }
+
+		__m128 inverseDet = _mm_div_ps(one, determinant);
+
+		// s = o - p0, u = (s . p) / det
+		__m128 sx = _mm_sub_ps(_mm_set1_ps(rayPosition.GetX()), _mm_loadu_ps(pBlock->p0x));
+		__m128 sy = _mm_sub_ps(_mm_set1_ps(rayPosition.GetY()), _mm_loadu_ps(pBlock->p0y));
+		__m128 sz = _mm_sub_ps(_mm_set1_ps(rayPosition.GetZ()), _mm_loadu_ps(pBlock->p0z));
+		__m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+
+		// q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+		__m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+		// ordered compares are false for nans, so degenerate lanes drop out here
+		__m128 hit = _mm_and_ps(faceMask, _mm_cmpge_ps(uu, zero));
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(vv, zero));
+		hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(uu, vv), one));
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(tt, zero));
+		hit = _mm_and_ps(hit, _mm_cmplt_ps(tt, _mm_set1_ps(maxDist)));
+
+		hitMask = _mm_movemask_ps(hit);
+		if (!hitMask) { return 0; }
+
+		_mm_storeu_ps(t, tt);
+		_mm_storeu_ps(u, uu);
+		_mm_storeu_ps(v, vv);
+		_mm_storeu_ps(det, determinant);
+#else
+		for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+		{
+			float px = rayDirection.GetY() * pBlock->e2z[lane] - rayDirection.GetZ() * pBlock->e2y[lane];
+			float py = rayDirection.GetZ() * pBlock->e2x[lane] - rayDirection.GetX() * pBlock->e2z[lane];
+			float pz = rayDirection.GetX() * pBlock->e2y[lane] - rayDirection.GetY() * pBlock->e2x[lane];
+			det[lane] = pBlock->e1x[lane] * px + pBlock->e1y[lane] * py + pBlock->e1z[lane] * pz;
+			if (!(det[lane] > 0.0f) && !(det[lane] < 0.0f && pBlock->doubleSided[lane] > 0.0f)) { continue; }
+
+			float inverseDet = 1.0f / det[lane];
+			float sx = rayPosition.GetX() - pBlock->p0x[lane];
+			float sy = rayPosition.GetY() - pBlock->p0y[lane];
+			float sz = rayPosition.GetZ() - pBlock->p0z[lane];
+			u[lane] = (sx * px + sy * py + sz * pz) * inverseDet;
+
+			float qx = sy * pBlock->e1z[lane] - sz * pBlock->e1y[lane];
+			float qy = sz * pBlock->e1x[lane] - sx * pBlock->e1z[lane];
+			float qz = sx * pBlock->e1y[lane] - sy * pBlock->e1x[lane];
+			v[lane] = (rayDirection.GetX() * qx + rayDirection.GetY() * qy + rayDirection.GetZ() * qz) * inverseDet;
+			t[lane] = (pBlock->e2x[lane] * qx + pBlock->e2y[lane] * qy + pBlock->e2z[lane] * qz) * inverseDet;
+
+			if (u[lane] >= 0.0f && v[lane] >= 0.0f && u[lane] + v[lane] <= 1.0f && t[lane] >= 0.0f && t[lane] < maxDist) { hitMask |= (1 << lane); }
+		}
+#endif
+
+		return hitMask;
+	}
+
+	// only lanes set in laneMask can be hit, the caller leaves out lanes that are disabled or were already tested by this query
+	bool CollisionTester::RayTriangleBlockIntersect(const Vec3 & rayPosition, const Vec3 & rayDirection, const SpatialTriangleBlock * pBlock, GraphicalObject * const * pOwners, RayCastingOutput * pClosest, int laneMask)
+	{
+		float t[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float u[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float v[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float det[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		int hitMask = RayTriangleBlockLanes(rayPosition, rayDirection, pBlock, pClosest->m_distance, t, u, v, det) & laneMask;
+		if (!hitMask) { return false; }
+
+		// lanes are resolved in order so ties go to the earlier triangle, same as testing them one by one
+		bool closer = false;
+		for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+		{
+			if (!(hitMask & (1 << lane))) { continue; }
+			if (!(t[lane] < pClosest->m_distance)) { continue; }
+
+			Vec3 e1(pBlock->e1x[lane], pBlock->e1y[lane], pBlock->e1z[lane]);
+			Vec3 e2(pBlock->e2x[lane], pBlock->e2y[lane], pBlock->e2z[lane]);
+			Vec3 n = e1.Cross(e2).Normalize();
+
+			pClosest->m_didIntersect = true;
+			pClosest->m_distance = t[lane];
+			pClosest->m_intersectionPoint = rayPosition + rayDirection * t[lane];
+			pClosest->m_belongsTo = pOwners[pBlock->ownerIndex[lane]];
+			pClosest->m_vertexIndex = pBlock->vertexIndex[lane];
+
+			// a back face hit reports the reversed winding, the same as RayTriangleIntersect with (p2, p1, p0)
+			if (det[lane] > 0.0f) { pClosest->m_triangleNormal = n; pClosest->m_alphaBetaGamma = Vec3(u[lane], v[lane], 1.0f - u[lane] - v[lane]); }
+			else { pClosest->m_triangleNormal = -n; pClosest->m_alphaBetaGamma = Vec3(u[lane], 1.0f - u[lane] - v[lane], v[lane]); }
+
+			closer = true;
+		}
+
+		return closer;
+	}
+
+	bool CollisionTester::RayTriangleBlockOccluded(const Vec3 & rayPosition, const Vec3 & rayDirection, const SpatialTriangleBlock * pBlock, GraphicalObject * const * pOwners, float checkDist, const GraphicalObject * pIgnoredObject, int laneMask)
+	{
+		float t[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float u[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float v[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		float det[SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+
+		// nudged out so a triangle sitting exactly at the end of the segment still counts, as it would with RayTriangleIntersect
+		int hitMask = RayTriangleBlockLanes(rayPosition, rayDirection, pBlock, checkDist * 1.000001f, t, u, v, det) & laneMask;
+		if (!hitMask) { return false; }
+
+		for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+		{
+			if (!(hitMask & (1 << lane))) { continue; }
+
+			// the owner table is read, never the object itself
+			if (pOwners[pBlock->ownerIndex[lane]] != pIgnoredObject) { return true; }
+		}
+
+		return false;
+	}
+
 	bool CollisionTester::AddGraphicalObjectToLayer(GraphicalObject * pGraphicalObjectToAdd, CollisionLayer layer)
 	{
 		if (!pGraphicalObjectToAdd) { GameLogger::Log(MessageType::cError, "Failed to AddGraphicalObject to CollisionTester! GraphicalObject to-be-added was nullptr!\n"); return false; }
@@ -368,8 +1797,38 @@ namespace Engine
 		}
 		else
 		{
+			bool wasInLayer = s_spatialGrids[(unsigned)layer].ContainsObj(pGobToRemove);
 			s_spatialGrids[(unsigned)layer].RemoveGraphicalObject(pGobToRemove);
+
+			// the bvh keeps the triangles but forgets the object, so it stops pointing at it without a build
+			if (wasInLayer && s_layerBackends[(unsigned)layer] == CollisionBackend::BVH) { s_bvhs[(unsigned)layer].RemoveObject(pGobToRemove); }
+		}
+	}
+
+	// use after moving, rotating or scaling an object (or adding one) instead of CalculateGrid for the whole layer
+	bool CollisionTester::UpdateGraphicalObjectInLayer(GraphicalObject * pGobToUpdate, CollisionLayer layer)
+	{
+		if (!pGobToUpdate) { GameLogger::Log(MessageType::cError, "Failed to UpdateGraphicalObjectInLayer for CollisionTester! GraphicalObject to-be-updated was nullptr!\n"); return false; }
+
+		if (layer == CollisionLayer::NUM_LAYERS)
+		{
+			bool success = true;
+			for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i)
+			{
+				if (IsInLayer(pGobToUpdate, (CollisionLayer)i) && !UpdateGraphicalObjectInLayer(pGobToUpdate, (CollisionLayer)i)) { success = false; }
+			}
+
+			return success;
+		}
+
+		if (s_layerBackends[(unsigned)layer] == CollisionBackend::BVH)
+		{
+			// an object the bvh was never built with, or one refit too far, waits for the next query to build the layer once
+			if (!s_bvhs[(unsigned)layer].RefitObject(pGobToUpdate) || s_bvhs[(unsigned)layer].NeedsRebuild()) { s_pendingBVHBuilds |= LayerBit(layer); }
+			return true;
 		}
+
+		return s_spatialGrids[(unsigned)layer].UpdateGraphicalObject(pGobToUpdate);
 	}
 
 	int CollisionTester::GetTriangleCountForSpace(float xPos, float yPos, float zPos, CollisionLayer layer)
@@ -412,16 +1871,38 @@ namespace Engine
 		return FindWall(MousePicker::GetOrigin(pixelX, pixelY), MousePicker::GetDirection(pixelX, pixelY), checkDist, layer);
 	}
 
-	bool CollisionTester::CalculateGrid(CollisionLayer layer)
+	RayCastingOutput CollisionTester::FindFromMousePosInLayers(int pixelX, int pixelY, float checkDist, unsigned layerMask)
+	{
+		return FindWallInLayers(MousePicker::GetOrigin(pixelX, pixelY), MousePicker::GetDirection(pixelX, pixelY), checkDist, layerMask);
+	}
+
+	bool CollisionTester::CalculateGrid(CollisionLayer layer, const char * const cacheBaseName)
 	{
 		if (layer == CollisionLayer::NUM_LAYERS)
 		{
-			for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i) { if (!CalculateGrid((CollisionLayer)i)) { return false; } }
+			for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i) { if (!CalculateGrid((CollisionLayer)i, cacheBaseName)) { return false; } }
 			return true; 
 		}
+		else if (s_layerBackends[(unsigned)layer] == CollisionBackend::BVH)
+		{
+			// the grid still owns the object list, but its partitions are not needed
+			s_spatialGrids[(unsigned)layer].ClearPartitions();
+			s_pendingBVHBuilds &= ~LayerBit(layer);
+			return s_bvhs[(unsigned)layer].Build(s_spatialGrids[(unsigned)layer].GetObjectList());
+		}
 		else
 		{
-			return s_spatialGrids[(unsigned)layer].AddTrianglesToPartitions();
+			s_bvhs[(unsigned)layer].CleanUp();
+
+			// the grid build shares the ray casting workers
+			if (!s_rayWorkers.IsInitialized()) { InitializeRayWorkers(); }
+			s_spatialGrids[(unsigned)layer].SetWorkerPool(&s_rayWorkers);
+			if (!cacheBaseName) { return s_spatialGrids[(unsigned)layer].AddTrianglesToPartitions(); }
+			if (strlen(cacheBaseName) >= MAX_GRID_CACHE_NAME_LENGTH) { GameLogger::Log(MessageType::cWarning, "Grid cache base name [%s] is too long, grid will not be cached!\n", cacheBaseName); return s_spatialGrids[(unsigned)layer].AddTrianglesToPartitions(); }
+
+			char cacheFileName[MAX_GRID_CACHE_NAME_LENGTH + 32]{ '\0' };
+			sprintf_s(cacheFileName, sizeof(cacheFileName), "%s.%s.gridcache", cacheBaseName, LayerString(layer));
+			return s_spatialGrids[(unsigned)layer].CalculateFromCache(cacheFileName);
 		}
 	}
 
@@ -461,6 +1942,51 @@ namespace Engine
 		}
 	}
 
+	void CollisionTester::SetSparseGrids(bool useSparseCells)
+	{
+		for (CollisionLayer c = CollisionLayer::STATIC_GEOMETRY; c != CollisionLayer::NUM_LAYERS; c = (CollisionLayer)((unsigned)c + 1))
+		{
+			s_spatialGrids[(unsigned)c].SetSparseCells(useSparseCells);
+		}
+	}
+
+	// on places and sizes each grid around its own objects when it is built, off uses the fixed grid centered on the world origin
+	void CollisionTester::SetAutoFitGrids(bool autoFit)
+	{
+		for (CollisionLayer c = CollisionLayer::STATIC_GEOMETRY; c != CollisionLayer::NUM_LAYERS; c = (CollisionLayer)((unsigned)c + 1))
+		{
+			s_spatialGrids[(unsigned)c].SetAutoFit(autoFit);
+		}
+	}
+
+	// off bins each triangle into every cell its bounding box touches, which is cheaper to build but tests more triangles per ray
+	void CollisionTester::SetExactGridBinning(bool exactBinning)
+	{
+		for (CollisionLayer c = CollisionLayer::STATIC_GEOMETRY; c != CollisionLayer::NUM_LAYERS; c = (CollisionLayer)((unsigned)c + 1))
+		{
+			s_spatialGrids[(unsigned)c].SetExactTriangleBinning(exactBinning);
+		}
+	}
+
+	// CalculateGrid must be called for the layer afterwards so the chosen backend gets built
+	void CollisionTester::SetLayerBackend(CollisionLayer layer, CollisionBackend backend)
+	{
+		if (layer == CollisionLayer::NUM_LAYERS)
+		{
+			for (unsigned int i = 0; i < (unsigned)CollisionLayer::NUM_LAYERS; ++i) { s_layerBackends[i] = backend; }
+		}
+		else
+		{
+			s_layerBackends[(unsigned)layer] = backend;
+		}
+	}
+
+	CollisionBackend CollisionTester::GetLayerBackend(CollisionLayer layer)
+	{
+		if (layer == CollisionLayer::NUM_LAYERS) { GameLogger::Log(MessageType::cWarning, "Tried to GetLayerBackend for NUM_LAYERS!\n"); return CollisionBackend::SPATIAL_GRID; }
+		return s_layerBackends[(unsigned)layer];
+	}
+
 	bool CollisionTester::IsInLayer(GraphicalObject *pOBJToCheck, CollisionLayer layerToCheck)
 	{
 		return s_spatialGrids[(unsigned)layerToCheck].ContainsObj(pOBJToCheck);
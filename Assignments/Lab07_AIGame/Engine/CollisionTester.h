@@ -2,6 +2,9 @@
 #define COLLISIONTESTER_H
 
 #include "SpatialGrid.h"
+#include "TriangleBVH.h"
+#include "WorkerPool.h"
+#include "CollisionQueryStats.h"
 #include "Vec3.h"
 #include "ExportHeader.h"
 
@@ -42,6 +45,39 @@ namespace Engine
 		NUM_LAYERS // LAST ON PURPOSE
 	};
 
+	enum class ENGINE_SHARED CollisionBackend
+	{
+		SPATIAL_GRID = 0,
+		BVH
+	};
+
+	// one bit per CollisionLayer, see CollisionTester::LayerBit
+	const unsigned ALL_COLLISION_LAYERS_MASK = (1u << (unsigned)CollisionLayer::NUM_LAYERS) - 1u;
+
+	struct ENGINE_SHARED RayCastingInput
+	{
+		Vec3 m_rayPosition{ 0.0f, 0.0f, 0.0f };
+		Vec3 m_rayDirection{ 0.0f, 0.0f, 0.0f };
+		float m_checkDist{ 0.0f };
+		unsigned m_layerMask{ ALL_COLLISION_LAYERS_MASK };
+
+		// only occlusion queries look at this, its triangles never block the ray
+		const GraphicalObject *m_pIgnoredObject{ nullptr };
+	};
+
+	// where one caller's last probe stopped, for callers casting nearly the same ray every frame, one per caller and never shared between threads
+	// a query handed one first tests the cells from the ray start to the cell that point is in, and only walks the grid when what it found there cannot be proven nearest
+	struct ENGINE_SHARED RayProbeCache
+	{
+		bool m_hasProbeEnd{ false };
+		Vec3 m_probeEnd{ 0.0f, 0.0f, 0.0f };
+		unsigned m_layerMask{ 0 };
+
+		// how often the cached cells were enough and how often the grid was walked anyway
+		int m_provenCount{ 0 };
+		int m_fallbackCount{ 0 };
+	};
+
 	class ENGINE_SHARED CollisionTester
 	{
 	public:
@@ -49,27 +85,200 @@ namespace Engine
 		static bool InitializeGridDebugShapes(CollisionLayer gridLayer, Vec3 color, void *pCamMat, void *pPerspMat, int tintIntensityLoc, int tintColorLoc, int modelToWorldMatLoc, int worldToViewMatLoc, int perspectiveMatLoc, unsigned pShaderId);
 		static void DrawGrid(CollisionLayer gridLayer, const Vec3& centerPos);
 		static void ConsoleLogOutput();
-		static RayCastingOutput FindWall(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
+		static RayCastingOutput FindWall(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS, RayProbeCache *pCache = nullptr);
 		static RayCastingOutput FindWall(Entity *pEntity, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
-		static RayCastingOutput FindFloor(Entity *pEntity, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
-		static RayCastingOutput FindCeiling(Entity *pEntity, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
+		static RayCastingOutput FindWallInLayers(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, unsigned layerMask, RayProbeCache *pCache = nullptr);
+		static bool FindWalls(const RayCastingInput *pRays, RayCastingOutput *pOutputs, int rayCount);
+		static int CheckGridTraversal(const RayCastingInput *pRays, int rayCount);
+		static bool IsSegmentOccluded(const Vec3& segmentStart, const Vec3& segmentEnd, unsigned layerMask = ALL_COLLISION_LAYERS_MASK, const GraphicalObject *pIgnoredObject = nullptr);
+		static bool IsRayOccluded(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, unsigned layerMask = ALL_COLLISION_LAYERS_MASK, const GraphicalObject *pIgnoredObject = nullptr);
+		static bool FindOcclusions(const RayCastingInput *pRays, bool *pOutOccluded, int rayCount);
+		static RayCastingOutput SphereCast(const Vec3& sphereCenter, float radius, const Vec3& direction, float checkDist, unsigned layerMask = ALL_COLLISION_LAYERS_MASK);
+		static RayCastingOutput CapsuleCast(const Vec3& capsuleStart, const Vec3& capsuleEnd, float radius, const Vec3& direction, float checkDist, unsigned layerMask = ALL_COLLISION_LAYERS_MASK);
+		static int QueryAABB(const Vec3& boxMin, const Vec3& boxMax, GraphicalObject **outObjects, int maxObjects, unsigned layerMask = ALL_COLLISION_LAYERS_MASK);
+		static int QuerySphere(const Vec3& sphereCenter, float radius, GraphicalObject **outObjects, int maxObjects, unsigned layerMask = ALL_COLLISION_LAYERS_MASK);
+		static Vec3 SlideSphere(const Vec3& sphereCenter, float radius, const Vec3& movement, unsigned layerMask = ALL_COLLISION_LAYERS_MASK, int maxSlides = 4);
+		static Vec3 SlideCapsule(const Vec3& capsuleStart, const Vec3& capsuleEnd, float radius, const Vec3& movement, unsigned layerMask = ALL_COLLISION_LAYERS_MASK, int maxSlides = 4);
+		static bool InitializeRayWorkers(int workerThreadCount = -1);
+		static bool ShutdownRayWorkers();
+		static unsigned LayerBit(CollisionLayer layer);
+		static RayCastingOutput FindFloor(Entity *pEntity, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS, RayProbeCache *pCache = nullptr);
+		static RayCastingOutput FindCeiling(Entity *pEntity, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS, RayProbeCache *pCache = nullptr);
 		static RayCastingOutput RayTriangleIntersect(const Vec3& rayPosition, const Vec3& rayDirection, const Vec3& p0, const Vec3& p1, const Vec3& p2, float currentClosest);
+		static bool RayCollisionTriangleIntersect(const Vec3& rayPosition, const Vec3& rayDirection, const CollisionTriangle *pTriangle, GraphicalObject *pOwner, RayCastingOutput *pClosest);
+		static bool RayTriangleBlockIntersect(const Vec3& rayPosition, const Vec3& rayDirection, const SpatialTriangleBlock *pBlock, GraphicalObject *const *pOwners, RayCastingOutput *pClosest, int laneMask);
+		static bool RayCollisionTriangleOccluded(const Vec3& rayPosition, const Vec3& rayDirection, const CollisionTriangle *pTriangle, float checkDist);
+		static bool RayTriangleBlockOccluded(const Vec3& rayPosition, const Vec3& rayDirection, const SpatialTriangleBlock *pBlock, GraphicalObject *const *pOwners, float checkDist, const GraphicalObject *pIgnoredObject, int laneMask);
 		static bool AddGraphicalObjectToLayer(GraphicalObject *pGraphicalObjectToAdd, CollisionLayer layer);
 		static bool DoesFitInGrid(GraphicalObject *pGraphicalObjectToTest, CollisionLayer layer);
 		static void RemoveGraphicalObjectFromLayer(GraphicalObject *pGobToRemove, CollisionLayer layer);
+		static bool UpdateGraphicalObjectInLayer(GraphicalObject *pGobToUpdate, CollisionLayer layer);
 		static int GetTriangleCountForSpace(float xPos, float yPos, float zPos, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
 		static int GetGridIndexFromPosX(float xPos, CollisionLayer layer);
 		static int GetGridIndexFromPosY(float yPos, CollisionLayer layer);
 		static int GetGridIndexFromPosZ(float zPos, CollisionLayer layer);
 		static RayCastingOutput FindFromMousePos(int pixelX, int pixelY, float checkDist, CollisionLayer layer = CollisionLayer::NUM_LAYERS);
-		static bool CalculateGrid(CollisionLayer layer = CollisionLayer::NUM_LAYERS);
+		static RayCastingOutput FindFromMousePosInLayers(int pixelX, int pixelY, float checkDist, unsigned layerMask);
+
+		// grid layers are loaded from, or saved to, one cache file each named after cacheBaseName when one is given, usually the world file they came from
+		static bool CalculateGrid(CollisionLayer layer = CollisionLayer::NUM_LAYERS, const char *const cacheBaseName = nullptr);
+		static const int MAX_GRID_CACHE_NAME_LENGTH = 256;
 		static void OnlyShowLayer(CollisionLayer layer = CollisionLayer::NUM_LAYERS);
 		static bool DrawRay(const Vec3& rayPosition, const Vec3& rayDirection, float rayLength, UniformData uniformData[3]);
 		static void SetGridScale(float newScale);
+		static void SetSparseGrids(bool useSparseCells);
+		static void SetAutoFitGrids(bool autoFit);
+		static void SetExactGridBinning(bool exactBinning);
+		static void SetLayerBackend(CollisionLayer layer, CollisionBackend backend);
+		static CollisionBackend GetLayerBackend(CollisionLayer layer);
 		static bool IsInLayer(GraphicalObject *pOBJToCheck, CollisionLayer layerToCheck);
+		static void GetMailboxStats(long long *pOutTrianglesTested, long long *pOutTestsSkipped);
+		static void ResetMailboxStats();
+		static void SyncEnabledOwners();
 
 	private:
+		// a probe cache only covers a ray start and its cached cell this far apart, 2x2x2 cells at most
+		static const int MAX_PROBE_CACHE_CELLS = 8;
+
+		struct RayBatch
+		{
+			const RayCastingInput *pRays;
+			RayCastingOutput *pOutputs;
+			bool *pOccluded;
+			int rayCount;
+
+			// the tag of whoever asked, so the rays count against them on whichever thread runs them
+			const char *pQueryTag;
+		};
+
+		// the triangles one query has already tested, so a triangle binned into several cells is only tested the first time the query reaches it
+		// lives on the stack of the query so concurrent queries never share one, once it fills up the rest of the triangles are just tested again
+		struct TriangleMailbox
+		{
+			static const int SLOT_COUNT = 128;
+			unsigned ownerKeys[SLOT_COUNT]{};
+			int vertexIndices[SLOT_COUNT]{};
+			int used{ 0 };
+			int tested{ 0 };
+			int skipped{ 0 };
+		};
+
+		// the objects one ray has checked against their bounds and how far along it enters each, so an object the ray misses, or only reaches
+		// beyond the closest hit so far, has all its triangles skipped without testing any of them
+		struct OwnerBroadphase
+		{
+			static const int SLOT_COUNT = 32;
+			unsigned ownerKeys[SLOT_COUNT]{};
+			float entryDistances[SLOT_COUNT]{};
+		};
+
+		// what a walk through the grid cells is looking for, filled in by WalkGridCells and read by the cell callback
+		struct GridWalk
+		{
+			const Vec3 *pRayPosition{ nullptr };
+			const Vec3 *pRayDirection{ nullptr };
+			float checkDist{ 0.0f };
+			SpatialGrid *pGrids[(unsigned)CollisionLayer::NUM_LAYERS];
+			int gridCount{ 0 };
+			RayCastingOutput *pClosest{ nullptr };
+			bool stopAtNearestHit{ true };
+			const GraphicalObject *pIgnoredObject{ nullptr };
+			bool occluded{ false };
+			Vec3 inverseDirection{ 0.0f, 0.0f, 0.0f };
+			TriangleMailbox mailbox;
+			OwnerBroadphase broadphase;
+			CollisionQueryCounts counts;
+		};
+
+		// one axis of a walk through the cells: the cell the ray is in, which way it steps, the cell it stops in,
+		// and how far along the walk the next boundary is, with the distance between boundaries
+		struct GridWalkAxis
+		{
+			int cell{ 0 };
+			int step{ 0 };
+			int end{ 0 };
+			float nextBoundary{ 0.0f };
+			float boundaryStep{ 0.0f };
+		};
+
+		// a sphere or capsule moving in a straight line, start == end for a sphere
+		struct ShapeSweep
+		{
+			Vec3 start{ 0.0f, 0.0f, 0.0f };
+			Vec3 end{ 0.0f, 0.0f, 0.0f };
+			float radius{ 0.0f };
+			Vec3 direction{ 0.0f, 0.0f, 0.0f };
+			float checkDist{ 0.0f };
+			Vec3 sweptMin{ 0.0f, 0.0f, 0.0f };
+			Vec3 sweptMax{ 0.0f, 0.0f, 0.0f };
+			RayCastingOutput *pClosest{ nullptr };
+			CollisionQueryCounts counts;
+		};
+
+		// the enabled objects found so far by a box or sphere query, each one only once
+		// the objects one box or sphere query has already checked, so an object with triangles in many cells is only checked the first time
+		// lives on the stack of the query, once it fills up repeats are found by looking through the objects already written out
+		struct OwnerMailbox
+		{
+			static const int SLOT_COUNT = 256;
+			const GraphicalObject *pOwners[SLOT_COUNT]{};
+			int used{ 0 };
+		};
+
+		struct ObjectQuery
+		{
+			Vec3 boxMin{ 0.0f, 0.0f, 0.0f };
+			Vec3 boxMax{ 0.0f, 0.0f, 0.0f };
+			bool isSphere{ false };
+			Vec3 sphereCenter{ 0.0f, 0.0f, 0.0f };
+			float radiusSquared{ 0.0f };
+			GraphicalObject **outObjects{ nullptr };
+			int maxObjects{ 0 };
+			int count{ 0 };
+			OwnerMailbox mailbox;
+			CollisionQueryCounts counts;
+		};
+
+		// returns false to stop the walk
+		typedef bool(*GridCellCallback)(int gridX, int gridY, int gridZ, float cellExitDistance, GridWalk *pWalk);
+
+		static void FindWallsJobPassThrough(int jobIndex, void *pJobData);
+		static void FindOcclusionsJobPassThrough(int jobIndex, void *pJobData);
+		static void WalkGridCells(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, unsigned layerMask, GridCellCallback callback, GridWalk *pWalk);
+		static void InitWalkAxis(GridWalkAxis *pAxis, float start, float end, float gridScale);
+		static int NextWalkAxis(const GridWalkAxis *pAxes);
+		static bool StepWalkAxis(GridWalkAxis *pAxis);
+		static bool SkipEmptyBrick(GridWalkAxis *pAxes);
+		static bool ClosestHitCellCallback(int gridX, int gridY, int gridZ, float cellExitDistance, GridWalk *pWalk);
+		static bool OcclusionCellCallback(int gridX, int gridY, int gridZ, float cellExitDistance, GridWalk *pWalk);
+		static bool ProbeCachedCells(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, unsigned layerMask, const RayProbeCache& cache, RayCastingOutput *pOutput, CollisionQueryCounts *pCounts);
+		static bool ProbeCellRange(const Vec3& rayPosition, const Vec3& rayDirection, float checkDist, unsigned walkMask, const Vec3& cachedEnd, RayCastingOutput *pOutput, CollisionQueryCounts *pCounts, Vec3 *pOutBoxMin, Vec3 *pOutBoxMax);
+		static bool MarkTriangleTested(TriangleMailbox *pMailbox, unsigned ownerKey, int vertexIndex);
+		static int MarkBlockTested(TriangleMailbox *pMailbox, const SpatialTriangleBlock *pBlock, int triangleCount, const unsigned *pEnabledOwnerBits, unsigned gridKey, int candidateLanes = ~0);
+		static int BroadphaseBlockLanes(GridWalk *pWalk, const SpatialTriangleBlock *pBlock, const SpatialGrid::OwnerBounds *pOwnerBounds, unsigned gridKey, float reachDistance);
+		static int OverlappingBlockLanes(const SpatialTriangleBlock *pBlock, const SpatialGrid::OwnerBounds *pOwnerBounds, const Vec3& boxMin, const Vec3& boxMax);
+		static unsigned GridMailboxKey(int gridSlot);
+		static void RecordMailboxStats(const TriangleMailbox& mailbox);
+		static void AddQueryCounts(CollisionQueryCounts *pTotal, const CollisionQueryCounts& counts);
+		static int QueryObjects(ObjectQuery *pQuery, unsigned layerMask);
+		static void QueryGridCells(ObjectQuery *pQuery, SpatialGrid *pGrid);
+		static bool QueryTrianglePassThrough(const SpatialTriangleData *pTriangle, bool doubleSided, void *pQueryData);
+		static bool MarkOwnerQueried(ObjectQuery *pQuery, const GraphicalObject *pObj);
+		static bool AddQueriedObject(ObjectQuery *pQuery, GraphicalObject *pObj, const Vec3& boundsMin, const Vec3& boundsMax);
+		static void SweepGridCells(ShapeSweep *pSweep, SpatialGrid *pGrid, unsigned gridKey, TriangleMailbox *pMailbox);
+		static bool ClipSweptArea(const ShapeSweep& sweep, int axis, float planeMin, float planeMax, Vec3 *pOutMin, Vec3 *pOutMax);
+		static float SweptAreaDistanceSquared(const ShapeSweep& sweep, const Vec3& point);
+		static bool SweepTrianglePassThrough(const SpatialTriangleData *pTriangle, bool doubleSided, void *pSweepData);
+		static bool SweepCapsuleTriangle(const ShapeSweep& sweep, const SpatialTriangleData *pTriangle, bool doubleSided, float maxDist, float *pOutDistance, Vec3 *pOutContactPoint);
+		static bool SweepSphereTriangle(const Vec3& center, float radius, const Vec3& direction, float maxDist, const SpatialTriangleData *pTriangle, const Vec3& faceNormal, bool doubleSided, float *pOutDistance, Vec3 *pOutContactPoint);
+		static bool RayCylinderSide(const Vec3& rayPosition, const Vec3& rayDirection, const Vec3& cylinderStart, const Vec3& cylinderEnd, float radius, float maxDist, float *pOutDistance, float *pOutAlong);
+		static int RayTriangleBlockLanes(const Vec3& rayPosition, const Vec3& rayDirection, const SpatialTriangleBlock *pBlock, float maxDist, float *t, float *u, float *v, float *det);
+		static bool DoGridsLineUp(CollisionLayer first, CollisionLayer second);
+
 		static SpatialGrid s_spatialGrids[(unsigned)CollisionLayer::NUM_LAYERS];
+		static TriangleBVH s_bvhs[(unsigned)CollisionLayer::NUM_LAYERS];
+		static CollisionBackend s_layerBackends[(unsigned)CollisionLayer::NUM_LAYERS];
+		static WorkerPool s_rayWorkers;
 
 	};
 }
@@ -0,0 +1,54 @@
+#ifndef COLLISIONTRIANGLE_H
+#define COLLISIONTRIANGLE_H
+
+// agent
+// 10/17/2026
+// CollisionTriangle.h
+// A world space triangle packed for ray tests, with everything that does not change between rays worked out when it is stored
+
+#include "Vec3.h"
+
+namespace Engine
+{
+	struct CollisionTriangle
+	{
+	public:
+		static const unsigned short DOUBLE_SIDED = 0x1;
+
+		// the largest owner index a triangle can hold
+		static const int MAX_OWNERS = 0xFFFF;
+
+		CollisionTriangle()
+			: vertexIndex(-1), ownerIndex(0), flags(0) {}
+
+		void Set(const Vec3& p0In, const Vec3& p1, const Vec3& p2, int ownerIndexIn, int vertexIndexIn, bool isDoubleSided)
+		{
+			p0 = p0In;
+			e1 = p1 - p0In;
+			e2 = p2 - p0In;
+			normal = e1.Cross(e2).Normalize();
+			vertexIndex = vertexIndexIn;
+			ownerIndex = (unsigned short)ownerIndexIn;
+			flags = isDoubleSided ? DOUBLE_SIDED : 0;
+		}
+
+		// rebuilt from the edges, so they match exactly what the ray test sees
+		Vec3 GetP1() const { return p0 + e1; }
+		Vec3 GetP2() const { return p0 + e2; }
+		bool IsDoubleSided() const { return (flags & DOUBLE_SIDED) != 0; }
+
+		// vertex zero and the two edges leaving it, ready for Moller-Trumbore
+		Vec3 p0, e1, e2;
+
+		// unit normal of the front face, the plane is every x with normal . x == normal . p0
+		Vec3 normal;
+
+		int vertexIndex;
+
+		// into the owner table of whatever stores the triangle, so the object itself is only touched on a hit
+		unsigned short ownerIndex;
+		unsigned short flags;
+	};
+}
+
+#endif // ifndef COLLISIONTRIANGLE_H
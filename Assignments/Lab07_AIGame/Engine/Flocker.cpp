@@ -10,16 +10,23 @@ namespace Engine
 	LinkedList<Engine::SpatialComponent*> Flocker::s_flock;
 	Vec3 Flocker::s_workVec;
 	int Flocker::s_workCount;
+	SpatialHash Flocker::s_neighbourHash;
+	unsigned Flocker::s_flocksSinceRefresh;
+
+	const float range = 500.0f;
 
 	void Flocker::AddToFlock(SpatialComponent * pSpatial)
 	{
 		s_flock.AddToListFront(pSpatial);
+		RefreshNeighbourHash();
 	}
 
 	void Flocker::Flock(SpatialComponent * pSpatial, float cohesionWeight, float alignmentWeight, float separationWeight, float speed)
 	{
-		Vec3 pos = pSpatial->GetPosition();
-		
+		// every member flocks once a frame, so once they all have the hash gets everyone's new position
+		if (s_flocksSinceRefresh >= s_flock.GetCount()) { RefreshNeighbourHash(); }
+		s_flocksSinceRefresh++;
+
 		Vec3 vel = (cohesionWeight * CalculateCohesion(pSpatial))
 			     + (alignmentWeight * CalculateAlignment(pSpatial))
 			     + (separationWeight * CalculateSeparation(pSpatial));
@@ -30,6 +37,7 @@ namespace Engine
 	void Flocker::RemoveFromFlock(SpatialComponent * pSpatial)
 	{
 		s_flock.RemoveFirstFromList(pSpatial);
+		RefreshNeighbourHash();
 	}
 
 	bool Flocker::CalculateCohesion(SpatialComponent * pSpatial, void * pData)
@@ -55,7 +63,7 @@ namespace Engine
 		Engine::Vec3 p = pSpatial->GetPosition();
 		s_workVec = Engine::Vec3(0.0f);
 		s_workCount = 0;
-		s_flock.WalkListWhere(Flocker::IsInRange, &p, Flocker::CalculateCohesion, pSpatial);
+		s_neighbourHash.WalkSphere(p, range, Flocker::CalculateCohesion, pSpatial);
 
 		if (s_workCount > 0)
 		{
@@ -70,7 +78,7 @@ namespace Engine
 		Engine::Vec3 p = pSpatial->GetPosition();
 		s_workVec = Engine::Vec3(0.0f);
 		s_workCount = 0;
-		s_flock.WalkListWhere(Flocker::IsInRange, &p, Flocker::CalculateSeparation, pSpatial);
+		s_neighbourHash.WalkSphere(p, range, Flocker::CalculateSeparation, pSpatial);
 
 		if (s_workCount > 0)
 		{
@@ -85,7 +93,7 @@ namespace Engine
 		Engine::Vec3 p = pSpatial->GetPosition();
 		s_workVec = Engine::Vec3(0.0f);
 		s_workCount = 0;
-		s_flock.WalkListWhere(Flocker::IsInRange, &p, Flocker::CalculateAlignment, pSpatial);
+		s_neighbourHash.WalkSphere(p, range, Flocker::CalculateAlignment, pSpatial);
 
 		if (s_workCount > 0)
 		{
@@ -95,11 +103,17 @@ namespace Engine
 		return s_workVec;
 	}
 
-	const float range = 500.0f;
-	const float rangeSquared = range * range;
-	bool Flocker::IsInRange(SpatialComponent * pSpatial, void * pData)
+	// neighbours are found by where they were at the start of the frame, one cell per range keeps each lookup to the cells around it
+	void Flocker::RefreshNeighbourHash()
+	{
+		s_neighbourHash.SetCellSize(range);
+		s_flock.WalkList(Flocker::InsertIntoNeighbourHash, nullptr);
+		s_flocksSinceRefresh = 0;
+	}
+
+	bool Flocker::InsertIntoNeighbourHash(SpatialComponent * pSpatial, void * /*pData*/)
 	{
-		return (pSpatial->GetPosition() - *reinterpret_cast<Vec3*>(pData)).LengthSquared() < rangeSquared;
+		return s_neighbourHash.Insert(pSpatial);
 	}
 
 }
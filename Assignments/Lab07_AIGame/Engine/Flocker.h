@@ -9,6 +9,7 @@
 #include "ExportHeader.h"
 #include "SpatialComponent.h"
 #include "LinkedList.h"
+#include "SpatialHash.h"
 
 namespace Engine
 {
@@ -27,12 +28,15 @@ namespace Engine
 		static Vec3 CalculateCohesion(SpatialComponent *pSpatial);
 		static Vec3 CalculateSeparation(SpatialComponent *pSpatial);
 		static Vec3 CalculateAlignment(SpatialComponent *pSpatial);
-		static bool IsInRange(SpatialComponent *pSpatial, void *pData);
+		static void RefreshNeighbourHash();
+		static bool InsertIntoNeighbourHash(SpatialComponent *pSpatial, void *pData);
 
 		// data
 		static Engine::LinkedList<Engine::SpatialComponent *> s_flock;
 		static Engine::Vec3 s_workVec;
 		static int s_workCount;
+		static Engine::SpatialHash s_neighbourHash;
+		static unsigned s_flocksSinceRefresh;
 	};
 
 }
@@ -1,6 +1,10 @@
 #include "GraphicalObject.h"
 #include "GameLogger.h"
 #include "MyGL.h"
+#include "Mesh.h"
+#include "MathUtility.h"
+#include <atomic>
+#include <cfloat>
 
 // Justin Furtado
 // 7/6/2016
@@ -9,6 +13,12 @@
 
 namespace Engine
 {
+	// bumped whenever any object is enabled or disabled, so anything caching enabled state knows to look again
+	std::atomic<unsigned> s_enabledStateVersion{ 0 };
+
+	// relative to the size of the coordinates, far bigger than float rounding and far smaller than anything in a world
+	const float WORLD_BOUNDS_PADDING = 1e-5f;
+
 	GraphicalObject::GraphicalObject()
 		: m_pMesh(nullptr), m_rotation(0.0f), m_rotationAxis(Vec3(0.0f, 1.0f, 0.0f)), m_rotationMatrix(Mat4()),
 		m_scaleMatrix(Mat4()), m_rotationRate(0.0f), m_scaleRate(0.0f), m_translationMatrix(Mat4()), m_velocity(Vec3()),
@@ -180,6 +190,7 @@ namespace Engine
 	{
 		if (!pMesh) { GameLogger::Log(MessageType::cWarning, "Invalid mesh pointer passed in for graphical object, ignoring!\n"); return; }
 		m_pMesh = pMesh;
+		m_worldBoundsDirty = true;
 	}
 
 	void GraphicalObject::SetW(float w)
@@ -210,7 +221,14 @@ namespace Engine
 
 	void GraphicalObject::SetEnabled(bool visible)
 	{
+		if (m_enabled == visible) { return; }
 		m_enabled = visible;
+		s_enabledStateVersion++;
+	}
+
+	unsigned GraphicalObject::GetEnabledStateVersion()
+	{
+		return s_enabledStateVersion.load();
 	}
 	
 	UniformData GraphicalObject::GetUniformData(int index)
@@ -226,11 +244,47 @@ namespace Engine
 	void GraphicalObject::CalcFullTransform()
 	{
 		m_fullTransform = m_translationMatrix * (m_rotationMatrix * m_scaleMatrix);
+		m_worldBoundsDirty = true;
 	}
 
 	Mat4 * GraphicalObject::GetFullTransformPtr()
 	{
 		return &m_fullTransform;
 	}
+
+	// transforms the corners of the mesh's box rather than every vertex, so it may be a little loose under rotation but never too small
+	void GraphicalObject::GetWorldBounds(Vec3 * pOutMin, Vec3 * pOutMax)
+	{
+		if (m_worldBoundsDirty && m_pMesh)
+		{
+			Vec3 localMin, localMax;
+			m_pMesh->GetLocalBounds(&localMin, &localMax);
+
+			// an empty mesh keeps an inside out box that nothing can overlap
+			if (localMin.GetX() > localMax.GetX()) { m_worldBoundsMin = localMin; m_worldBoundsMax = localMax; }
+			else
+			{
+				m_worldBoundsMin = Vec3(FLT_MAX);
+				m_worldBoundsMax = Vec3(-FLT_MAX);
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					Vec3 localCorner((corner & 1) ? localMax.GetX() : localMin.GetX(), (corner & 2) ? localMax.GetY() : localMin.GetY(), (corner & 4) ? localMax.GetZ() : localMin.GetZ());
+					Vec3 worldCorner = m_fullTransform * localCorner;
+					m_worldBoundsMin = MathUtility::Min(m_worldBoundsMin, worldCorner);
+					m_worldBoundsMax = MathUtility::Max(m_worldBoundsMax, worldCorner);
+				}
+
+				// transforming single vertices rounds differently than transforming corners, a hair of padding covers it
+				Vec3 padding((fabsf(m_worldBoundsMin.GetX()) + fabsf(m_worldBoundsMax.GetX()) + 1.0f) * WORLD_BOUNDS_PADDING, (fabsf(m_worldBoundsMin.GetY()) + fabsf(m_worldBoundsMax.GetY()) + 1.0f) * WORLD_BOUNDS_PADDING, (fabsf(m_worldBoundsMin.GetZ()) + fabsf(m_worldBoundsMax.GetZ()) + 1.0f) * WORLD_BOUNDS_PADDING);
+				m_worldBoundsMin = m_worldBoundsMin - padding;
+				m_worldBoundsMax = m_worldBoundsMax + padding;
+			}
+
+			m_worldBoundsDirty = false;
+		}
+
+		*pOutMin = m_worldBoundsMin;
+		*pOutMax = m_worldBoundsMax;
+	}
 }
 
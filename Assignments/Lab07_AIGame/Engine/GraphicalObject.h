@@ -62,10 +62,12 @@ namespace Engine
 			int camPosLoc, void *camPosPtr, int lightPosLoc, void *lightPosPtr);
 
 		void SetEnabled(bool visible);
+		static unsigned GetEnabledStateVersion();
 		UniformData GetUniformData(int index);
 		void SetMaterial(Material mat);
 		void CalcFullTransform();
 		Mat4 *GetFullTransformPtr();
+		void GetWorldBounds(Vec3 *pOutMin, Vec3 *pOutMax);
 		
 		// its ugly but force something to work for now
 		int fromTempDeleteMeLater;
@@ -90,6 +92,11 @@ namespace Engine
 		GLfloat m_scaleRate;
 		Mesh *m_pMesh;
 		bool m_enabled;
+
+		// the mesh's box under m_fullTransform, recalculated on the next GetWorldBounds after either changes
+		Vec3 m_worldBoundsMin;
+		Vec3 m_worldBoundsMax;
+		bool m_worldBoundsDirty{ true };
 		void *m_classInstance{ nullptr };
 		GraphicalObjectCallback m_callback{ nullptr };
 	};
@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+#include "GameLogger.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// agent
+// 10/17/2026
+// MappedFile.cpp
+// Maps a whole file into memory copy on write, so it can be used in place and changed without touching the file
+
+namespace Engine
+{
+	MappedFile::MappedFile()
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const char * const fileName)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (file == INVALID_HANDLE_VALUE) { return false; }
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) { CloseHandle(file); return false; }
+
+		// a write copy mapping of a read only handle, pages only get copied once something writes to them
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!mapping) { GameLogger::Log(MessageType::cError, "Failed to map file [%s]! CreateFileMapping error [%u]!\n", fileName, (unsigned)GetLastError()); CloseHandle(file); return false; }
+
+		void *pView = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		if (!pView) { GameLogger::Log(MessageType::cError, "Failed to map file [%s]! MapViewOfFile error [%u]!\n", fileName, (unsigned)GetLastError()); CloseHandle(mapping); CloseHandle(file); return false; }
+
+		m_fileHandle = file;
+		m_mappingHandle = mapping;
+		m_pData = pView;
+		m_size = (size_t)fileSize.QuadPart;
+#else
+		int file = open(fileName, O_RDONLY);
+		if (file < 0) { return false; }
+
+		struct stat fileStats;
+		if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0) { close(file); return false; }
+
+		void *pView = mmap(nullptr, (size_t)fileStats.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+		if (pView == MAP_FAILED) { GameLogger::Log(MessageType::cError, "Failed to map file [%s]!\n", fileName); return false; }
+
+		m_pData = pView;
+		m_size = (size_t)fileStats.st_size;
+#endif
+
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (!m_pData) { return; }
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_pData);
+		CloseHandle((HANDLE)m_mappingHandle);
+		CloseHandle((HANDLE)m_fileHandle);
+#else
+		munmap(m_pData, m_size);
+#endif
+
+		m_pData = nullptr;
+		m_size = 0;
+		m_fileHandle = nullptr;
+		m_mappingHandle = nullptr;
+	}
+
+	bool MappedFile::IsOpen() const
+	{
+		return m_pData != nullptr;
+	}
+
+	void * MappedFile::GetData() const
+	{
+		return m_pData;
+	}
+
+	size_t MappedFile::GetSize() const
+	{
+		return m_size;
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+// agent
+// 10/17/2026
+// MappedFile.h
+// Maps a whole file into memory copy on write, so it can be used in place and changed without touching the file
+
+#include "ExportHeader.h"
+#include <cstddef>
+
+namespace Engine
+{
+	class ENGINE_SHARED MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool Open(const char *const fileName);
+		void Close();
+		bool IsOpen() const;
+
+		// writes go to private pages, never back to the file
+		void *GetData() const;
+		size_t GetSize() const;
+
+	private:
+		void *m_pData{ nullptr };
+		size_t m_size{ 0 };
+		void *m_fileHandle{ nullptr };
+		void *m_mappingHandle{ nullptr };
+	};
+}
+
+#endif // ifndef MAPPEDFILE_H
@@ -1,6 +1,7 @@
 #include "MathUtility.h"
 #include "MathUtility.h"
 #include <random>
+#include <cfloat>
 #include "Vertex.h"
 #include "GraphicalObject.h"
 #include "Mat4.h"
@@ -150,6 +151,205 @@ namespace Engine
 	{
 		return TriangleLerp(p1, p2, p3, Rand(0.0f, 1.0f), Rand(0.0f, 1.0f), Rand(0.0f, 1.0f));
 	}
+
+	// checks which voronoi region of the triangle the point is in, so only the one closest feature is projected onto
+	Vec3 MathUtility::ClosestPointOnTriangle(const Vec3 & point, const Vec3 & p1, const Vec3 & p2, const Vec3 & p3)
+	{
+		Vec3 e1 = p2 - p1;
+		Vec3 e2 = p3 - p1;
+
+		// vertex one
+		Vec3 toPoint = point - p1;
+		float d1 = e1.Dot(toPoint);
+		float d2 = e2.Dot(toPoint);
+		if (d1 <= 0.0f && d2 <= 0.0f) { return p1; }
+
+		// vertex two
+		Vec3 toPoint2 = point - p2;
+		float d3 = e1.Dot(toPoint2);
+		float d4 = e2.Dot(toPoint2);
+		if (d3 >= 0.0f && d4 <= d3) { return p2; }
+
+		// edge one two
+		float vc = d1*d4 - d3*d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) { return p1 + e1 * (d1 / (d1 - d3)); }
+
+		// vertex three
+		Vec3 toPoint3 = point - p3;
+		float d5 = e1.Dot(toPoint3);
+		float d6 = e2.Dot(toPoint3);
+		if (d6 >= 0.0f && d5 <= d6) { return p3; }
+
+		// edge one three
+		float vb = d5*d2 - d1*d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) { return p1 + e2 * (d2 / (d2 - d6)); }
+
+		// edge two three
+		float va = d3*d6 - d5*d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) { return p2 + (p3 - p2) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))); }
+
+		// inside the face
+		float denom = 1.0f / (va + vb + vc);
+		return p1 + e1 * (vb * denom) + e2 * (vc * denom);
+	}
+
+	// returns the squared distance between the segments, the outputs are how far along each segment the closest points are
+	float MathUtility::ClosestPointsOnSegments(const Vec3 & start1, const Vec3 & end1, const Vec3 & start2, const Vec3 & end2, float * pOutT1, float * pOutT2)
+	{
+		const float EPSILON = 0.000001f;
+		Vec3 d1 = end1 - start1;
+		Vec3 d2 = end2 - start2;
+		Vec3 r = start1 - start2;
+		float a = d1.Dot(d1);
+		float e = d2.Dot(d2);
+		float f = d2.Dot(r);
+		float s = 0.0f;
+		float t = 0.0f;
+
+		if (a <= EPSILON && e <= EPSILON)
+		{
+			// both are points
+		}
+		else if (a <= EPSILON)
+		{
+			t = Clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			float c = d1.Dot(r);
+			if (e <= EPSILON)
+			{
+				s = Clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				// parallel segments pick s = 0 and let t sort it out
+				float b = d1.Dot(d2);
+				float denom = a*e - b*b;
+				s = (denom != 0.0f) ? Clamp((b*f - c*e) / denom, 0.0f, 1.0f) : 0.0f;
+				t = (b*s + f) / e;
+
+				if (t < 0.0f) { t = 0.0f; s = Clamp(-c / a, 0.0f, 1.0f); }
+				else if (t > 1.0f) { t = 1.0f; s = Clamp((b - c) / a, 0.0f, 1.0f); }
+			}
+		}
+
+		if (pOutT1) { *pOutT1 = s; }
+		if (pOutT2) { *pOutT2 = t; }
+		Vec3 between = (start1 + d1*s) - (start2 + d2*t);
+		return between.Dot(between);
+	}
+
+	// returns the squared distance, zero when the segment passes through the triangle
+	float MathUtility::ClosestPointsSegmentTriangle(const Vec3 & segmentStart, const Vec3 & segmentEnd, const Vec3 & p1, const Vec3 & p2, const Vec3 & p3, Vec3 * pOutSegmentPoint, Vec3 * pOutTrianglePoint)
+	{
+		// a segment crossing the plane inside the triangle touches it
+		Vec3 n = (p2 - p1).Cross(p3 - p1);
+		float startSide = n.Dot(segmentStart - p1);
+		float endSide = n.Dot(segmentEnd - p1);
+		if (startSide * endSide <= 0.0f && startSide != endSide)
+		{
+			Vec3 crossing = segmentStart + (segmentEnd - segmentStart) * (startSide / (startSide - endSide));
+			Vec3 onTriangle = ClosestPointOnTriangle(crossing, p1, p2, p3);
+			if ((onTriangle - crossing).LengthSquared() <= 0.000001f * n.Length())
+			{
+				*pOutSegmentPoint = crossing;
+				*pOutTrianglePoint = crossing;
+				return 0.0f;
+			}
+		}
+
+		// otherwise the closest points involve one of the segment's ends or one of the triangle's edges
+		*pOutSegmentPoint = segmentStart;
+		*pOutTrianglePoint = ClosestPointOnTriangle(segmentStart, p1, p2, p3);
+		float best = (*pOutTrianglePoint - segmentStart).LengthSquared();
+
+		Vec3 endPoint = ClosestPointOnTriangle(segmentEnd, p1, p2, p3);
+		float endDist = (endPoint - segmentEnd).LengthSquared();
+		if (endDist < best) { best = endDist; *pOutSegmentPoint = segmentEnd; *pOutTrianglePoint = endPoint; }
+
+		const Vec3 *pCorners[3]{ &p1, &p2, &p3 };
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vec3& edgeStart = *pCorners[i];
+			const Vec3& edgeEnd = *pCorners[(i + 1) % 3];
+			float s, t;
+			float edgeDist = ClosestPointsOnSegments(segmentStart, segmentEnd, edgeStart, edgeEnd, &s, &t);
+			if (edgeDist < best)
+			{
+				best = edgeDist;
+				*pOutSegmentPoint = segmentStart + (segmentEnd - segmentStart) * s;
+				*pOutTrianglePoint = edgeStart + (edgeEnd - edgeStart) * t;
+			}
+		}
+
+		return best;
+	}
+
+	// slab test, returns how far along the ray it enters the box (zero when it starts inside) or FLT_MAX when it misses or enters beyond maxDist
+	float MathUtility::RayBoxEntryDistance(const Vec3 & rayPosition, const Vec3 & inverseRayDirection, const Vec3 & boxMin, const Vec3 & boxMax, float maxDist)
+	{
+		float tx1 = (boxMin.GetX() - rayPosition.GetX()) * inverseRayDirection.GetX();
+		float tx2 = (boxMax.GetX() - rayPosition.GetX()) * inverseRayDirection.GetX();
+		float tMin = fminf(tx1, tx2);
+		float tMax = fmaxf(tx1, tx2);
+
+		float ty1 = (boxMin.GetY() - rayPosition.GetY()) * inverseRayDirection.GetY();
+		float ty2 = (boxMax.GetY() - rayPosition.GetY()) * inverseRayDirection.GetY();
+		tMin = fmaxf(tMin, fminf(ty1, ty2));
+		tMax = fminf(tMax, fmaxf(ty1, ty2));
+
+		float tz1 = (boxMin.GetZ() - rayPosition.GetZ()) * inverseRayDirection.GetZ();
+		float tz2 = (boxMax.GetZ() - rayPosition.GetZ()) * inverseRayDirection.GetZ();
+		tMin = fmaxf(tMin, fminf(tz1, tz2));
+		tMax = fminf(tMax, fmaxf(tz1, tz2));
+
+		// a ray lying in a slab plane makes a nan there, which fminf and fmaxf skip, so it counts as inside that slab
+		if (!(tMax >= tMin) || !(tMax >= 0.0f) || !(tMin <= maxDist)) { return FLT_MAX; }
+		return fmaxf(tMin, 0.0f);
+	}
+
+	// separating axis test: the box axes, the triangle normal and the nine edge/axis cross products
+	bool MathUtility::TriangleOverlapsBox(const Vec3 & p1, const Vec3 & p2, const Vec3 & p3, const Vec3 & boxCenter, const Vec3 & boxHalfExtents)
+	{
+		// work relative to the box so it is centered on the origin
+		Vec3 v[3]{ p1 - boxCenter, p2 - boxCenter, p3 - boxCenter };
+		float h[3]{ boxHalfExtents.GetX(), boxHalfExtents.GetY(), boxHalfExtents.GetZ() };
+
+		// box face normals, which is just the triangle's bounding box against the box
+		for (int a = 0; a < 3; ++a)
+		{
+			float minV = fminf(fminf(v[0][a], v[1][a]), v[2][a]);
+			float maxV = fmaxf(fmaxf(v[0][a], v[1][a]), v[2][a]);
+			if (minV > h[a] || maxV < -h[a]) { return false; }
+		}
+
+		// the edges crossed with each box axis
+		Vec3 e[3]{ v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int a = 0; a < 3; ++a)
+			{
+				// axis = unit(a) x e[i], only the two components off of axis a are non zero
+				int b = (a + 1) % 3;
+				int c = (a + 2) % 3;
+				float axisB = -e[i][c];
+				float axisC = e[i][b];
+
+				float d0 = axisB * v[0][b] + axisC * v[0][c];
+				float d1 = axisB * v[1][b] + axisC * v[1][c];
+				float d2 = axisB * v[2][b] + axisC * v[2][c];
+				float radius = h[b] * fabsf(axisB) + h[c] * fabsf(axisC);
+				if (fminf(fminf(d0, d1), d2) > radius || fmaxf(fmaxf(d0, d1), d2) < -radius) { return false; }
+			}
+		}
+
+		// the triangle's plane against the box
+		Vec3 n = e[0].Cross(e[1]);
+		float radius = h[0] * fabsf(n.GetX()) + h[1] * fabsf(n.GetY()) + h[2] * fabsf(n.GetZ());
+		float d = n.Dot(v[0]);
+		return fabsf(d) <= radius;
+	}
 	
 	
 
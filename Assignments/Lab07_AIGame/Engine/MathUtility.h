@@ -35,6 +35,11 @@ namespace Engine
 		static ENGINE_SHARED Vec3 GetRandSphereEdgeVec(float radius);
 		static ENGINE_SHARED Vec3 TriangleLerp(const Vec3& p1, const Vec3& p2, const Vec3& p3, float alpha, float beta, float gamma);
 		static ENGINE_SHARED Vec3 RandTriangleLerp(const Vec3& p1, const Vec3& p2, const Vec3& p3);
+		static ENGINE_SHARED Vec3 ClosestPointOnTriangle(const Vec3& point, const Vec3& p1, const Vec3& p2, const Vec3& p3);
+		static ENGINE_SHARED float ClosestPointsOnSegments(const Vec3& start1, const Vec3& end1, const Vec3& start2, const Vec3& end2, float *pOutT1, float *pOutT2);
+		static ENGINE_SHARED float ClosestPointsSegmentTriangle(const Vec3& segmentStart, const Vec3& segmentEnd, const Vec3& p1, const Vec3& p2, const Vec3& p3, Vec3 *pOutSegmentPoint, Vec3 *pOutTrianglePoint);
+		static ENGINE_SHARED bool TriangleOverlapsBox(const Vec3& p1, const Vec3& p2, const Vec3& p3, const Vec3& boxCenter, const Vec3& boxHalfExtents);
+		static ENGINE_SHARED float RayBoxEntryDistance(const Vec3& rayPosition, const Vec3& inverseRayDirection, const Vec3& boxMin, const Vec3& boxMax, float maxDist);
 	};
 }
 
@@ -12,6 +12,8 @@
 #include "RenderInfo.h"
 #include "VertexFormat.h"
 #include "GameLogger.h"
+#include "Vec3.h"
+#include <cfloat>
 
 namespace Engine
 {
@@ -56,6 +58,7 @@ namespace Engine
 		IndexSizeInBytes GetIndexSize() { return m_indexSize; }
 		GLuint GetSizeOfVertex() { return VertexFormatSize(m_vertexFormat); }
 		bool IsCullingEnabledForObject() { return m_isCullingEnabledForObject; }
+		GLuint GetTriangleCount() { return (m_indexed ? m_indexCount : m_vertexCount) / 3; }
 		GLuint GetTextureID() { return m_textureID; }
 		GLuint *GetTextureIDPtr() { return &m_textureID; }
 
@@ -95,6 +98,26 @@ namespace Engine
 			}
 		}
 		
+		// same as WalkTriangles, but only for triangles [firstTriangle, firstTriangle + triangleCount)
+		void WalkTriangleRange(unsigned int firstTriangle, unsigned int triangleCount, TriangleIterationCallback callback, void *pClassInstance, void *pPassThroughData)
+		{
+			unsigned int end = 3 * (firstTriangle + triangleCount);
+			if (m_indexed)
+			{
+				for (unsigned int i = 3 * firstTriangle; i < end && i < m_indexCount; i += 3)
+				{
+					if (!callback(GetIndexAt(i), GetPointerToVertexAt(GetIndexAt(i)), GetPointerToVertexAt(GetIndexAt(i + 1)), GetPointerToVertexAt(GetIndexAt(i + 2)), pClassInstance, pPassThroughData)) { break; }
+				}
+			}
+			else
+			{
+				for (unsigned int i = 3 * firstTriangle; i < end && i < m_vertexCount; i += 3)
+				{
+					if (!callback(i, GetPointerToVertexAt(i), GetPointerToVertexAt(i + 1), GetPointerToVertexAt(i + 2), pClassInstance, pPassThroughData)) { break; }
+				}
+			}
+		}
+
 		int GetIndexAt(unsigned int indexIndex)
 		{
 			if (indexIndex > m_indexCount) { GameLogger::Log(MessageType::cWarning, "Tried to GetIndexAt [%d] but it was out of range!\n", indexIndex); return 0; }
@@ -116,6 +139,21 @@ namespace Engine
 			return reinterpret_cast<char *>(GetPointerToVertexAt(index)) + (GetSizeOfVertex() - NORMAL_BYTES);
 		}
 
+		// the box around every vertex a triangle uses, worked out the first time it is asked for since vertices never move
+		void GetLocalBounds(Vec3 *pOutMin, Vec3 *pOutMax)
+		{
+			if (!m_localBoundsValid)
+			{
+				m_localBoundsMin = Vec3(FLT_MAX);
+				m_localBoundsMax = Vec3(-FLT_MAX);
+				WalkVertices(Mesh::GrowLocalBoundsPassThrough, this, nullptr);
+				m_localBoundsValid = true;
+			}
+
+			*pOutMin = m_localBoundsMin;
+			*pOutMax = m_localBoundsMax;
+		}
+
 		// setters
 		void SetRenderInfo(RenderInfo *renderInfo)
 		{
@@ -149,6 +187,15 @@ namespace Engine
 		}
 
 	private:
+		static bool GrowLocalBoundsPassThrough(int /*index*/, const void *pVertex, void *pClassInstance, void * /*pPassThroughData*/)
+		{
+			Mesh *pMesh = reinterpret_cast<Mesh *>(pClassInstance);
+			const Vec3& position = *reinterpret_cast<const Vec3 *>(pVertex);
+			pMesh->m_localBoundsMin = Vec3(fminf(pMesh->m_localBoundsMin.GetX(), position.GetX()), fminf(pMesh->m_localBoundsMin.GetY(), position.GetY()), fminf(pMesh->m_localBoundsMin.GetZ(), position.GetZ()));
+			pMesh->m_localBoundsMax = Vec3(fmaxf(pMesh->m_localBoundsMax.GetX(), position.GetX()), fmaxf(pMesh->m_localBoundsMax.GetY(), position.GetY()), fmaxf(pMesh->m_localBoundsMax.GetZ(), position.GetZ()));
+			return true;
+		}
+
 		void *m_pVertices;
 		void *m_pIndices;
 		GLuint m_vertexCount;
@@ -161,6 +208,9 @@ namespace Engine
 		VertexFormat m_vertexFormat;
 		GLuint m_shaderProgramID;
 		bool m_isCullingEnabledForObject;
+		bool m_localBoundsValid{ false };
+		Vec3 m_localBoundsMin;
+		Vec3 m_localBoundsMax;
 	};
 }
 
@@ -13,6 +13,7 @@
 #include "GameLogger.h"
 #include "GameTime.h"
 #include "MouseManager.h"
+#include "CollisionQueryStats.h"
 
 // Justin Furtado
 // 6/21/2016
@@ -112,6 +113,7 @@ namespace Engine
 			m_gameUpdate(m_pGame, dt);
 		}
 		if (!isShutdown && m_gameDraw) { m_gameDraw(m_pGame); }
+		CollisionQueryStats::EndFrame();
 		this->repaint();
 	}
 }
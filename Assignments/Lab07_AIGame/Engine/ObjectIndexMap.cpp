@@ -0,0 +1,124 @@
+#include "ObjectIndexMap.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// ObjectIndexMap.cpp
+// Looks up the slot an object was given in some table by its address, so updating one object does not mean scanning them all
+
+namespace Engine
+{
+	const int INITIAL_OBJECT_INDEX_MAP_CAPACITY = 64;
+
+	ObjectIndexMap::ObjectIndexMap()
+	{
+	}
+
+	ObjectIndexMap::~ObjectIndexMap()
+	{
+		CleanUp();
+	}
+
+	int ObjectIndexMap::Find(const void * pObject) const
+	{
+		if (!pObject || m_count == 0) { return -1; }
+
+		for (int slot = GetHomeSlot(pObject); m_pSlots[slot].pObject; slot = (slot + 1) & (m_capacity - 1))
+		{
+			if (m_pSlots[slot].pObject == pObject) { return m_pSlots[slot].index; }
+		}
+
+		return -1;
+	}
+
+	bool ObjectIndexMap::Set(const void * pObject, int index)
+	{
+		if (!pObject) { GameLogger::Log(MessageType::cError, "Failed to Set index [%d] in ObjectIndexMap! Object was nullptr!\n", index); return false; }
+		if (2 * (m_count + 1) > m_capacity && !Grow(2 * (m_count + 1))) { return false; }
+
+		int slot = GetHomeSlot(pObject);
+		while (m_pSlots[slot].pObject && m_pSlots[slot].pObject != pObject) { slot = (slot + 1) & (m_capacity - 1); }
+
+		if (!m_pSlots[slot].pObject) { m_count++; }
+		m_pSlots[slot].pObject = pObject;
+		m_pSlots[slot].index = index;
+		return true;
+	}
+
+	// shifts the rest of the probe run back so a later Find never stops early on the hole
+	void ObjectIndexMap::Remove(const void * pObject)
+	{
+		if (!pObject || m_count == 0) { return; }
+
+		int slot = GetHomeSlot(pObject);
+		while (m_pSlots[slot].pObject != pObject)
+		{
+			if (!m_pSlots[slot].pObject) { return; }
+			slot = (slot + 1) & (m_capacity - 1);
+		}
+
+		int hole = slot;
+		for (int next = (hole + 1) & (m_capacity - 1); m_pSlots[next].pObject; next = (next + 1) & (m_capacity - 1))
+		{
+			// an entry can only move back to the hole if the hole is between its home slot and where it is now
+			int home = GetHomeSlot(m_pSlots[next].pObject);
+			if (((next - home) & (m_capacity - 1)) < ((next - hole) & (m_capacity - 1))) { continue; }
+
+			m_pSlots[hole] = m_pSlots[next];
+			hole = next;
+		}
+
+		m_pSlots[hole] = Slot();
+		m_count--;
+	}
+
+	void ObjectIndexMap::Clear()
+	{
+		for (int i = 0; i < m_capacity; ++i) { m_pSlots[i] = Slot(); }
+		m_count = 0;
+	}
+
+	int ObjectIndexMap::GetCount() const
+	{
+		return m_count;
+	}
+
+	void ObjectIndexMap::CleanUp()
+	{
+		delete[] m_pSlots;
+		m_pSlots = nullptr;
+		m_capacity = 0;
+		m_count = 0;
+	}
+
+	int ObjectIndexMap::GetHomeSlot(const void * pObject) const
+	{
+		// objects are at least pointer aligned, so the low bits say nothing
+		unsigned long long address = (unsigned long long)pObject;
+		unsigned long long hash = (address >> 3) * 11400714819323198485ULL;
+		return (int)(hash >> 32) & (m_capacity - 1);
+	}
+
+	bool ObjectIndexMap::Grow(int minimumCapacity)
+	{
+		int newCapacity = (m_capacity > 0) ? m_capacity : INITIAL_OBJECT_INDEX_MAP_CAPACITY;
+		while (newCapacity < minimumCapacity) { newCapacity *= 2; }
+
+		Slot *pNewSlots = new Slot[newCapacity];
+		if (!pNewSlots) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] object index slots!\n", newCapacity); return false; }
+
+		Slot *pOldSlots = m_pSlots;
+		int oldCapacity = m_capacity;
+		m_pSlots = pNewSlots;
+		m_capacity = newCapacity;
+		m_count = 0;
+
+		for (int i = 0; i < oldCapacity; ++i)
+		{
+			if (pOldSlots[i].pObject) { Set(pOldSlots[i].pObject, pOldSlots[i].index); }
+		}
+
+		delete[] pOldSlots;
+		return true;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef OBJECTINDEXMAP_H
+#define OBJECTINDEXMAP_H
+
+// agent
+// 10/17/2026
+// ObjectIndexMap.h
+// Looks up the slot an object was given in some table by its address, so updating one object does not mean scanning them all
+
+#include "ExportHeader.h"
+
+namespace Engine
+{
+	class ENGINE_SHARED ObjectIndexMap
+	{
+	public:
+		ObjectIndexMap();
+		~ObjectIndexMap();
+
+		// returns -1 when the object was never given an index
+		int Find(const void *pObject) const;
+
+		// replaces whatever index the object had
+		bool Set(const void *pObject, int index);
+		void Remove(const void *pObject);
+		void Clear();
+		int GetCount() const;
+		void CleanUp();
+
+	private:
+		struct Slot
+		{
+			const void *pObject{ nullptr };
+			int index{ -1 };
+		};
+
+		int GetHomeSlot(const void *pObject) const;
+		bool Grow(int minimumCapacity);
+
+		// open addressed with linear probing, kept at most half full
+		Slot *m_pSlots{ nullptr };
+		int m_capacity{ 0 };
+		int m_count{ 0 };
+	};
+}
+
+#endif // ifndef OBJECTINDEXMAP_H
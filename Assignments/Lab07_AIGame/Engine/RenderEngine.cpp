@@ -15,6 +15,7 @@ namespace Engine
 {
 	ShaderProgram RenderEngine::s_shaderPrograms[MAX_SHADER_PROGRAMS];
 	GLuint RenderEngine::s_nextShaderProgram = 0;
+	bool RenderEngine::s_headless = false;
 
 	bool RenderEngine::Initialize(ShaderProgram *pPrograms, GLint shaderProgramCount)
 	{
@@ -44,6 +45,8 @@ namespace Engine
 
 	bool RenderEngine::AddMesh(Mesh * pMeshToAdd)
 	{
+		if (s_headless) { return true; }
+
 		if (!BufferManager::AddMesh(pMeshToAdd))
 		{
 			GameLogger::Log(MessageType::cError, "RenderEngine could not add mesh! BufferManager failed to add mesh!\n");
@@ -56,6 +59,8 @@ namespace Engine
 
 	bool RenderEngine::AddGraphicalObject(GraphicalObject * pGraphicalObjectToAdd)
 	{
+		if (s_headless) { return true; }
+
 		if (!BufferManager::AddGraphicalObject(pGraphicalObjectToAdd))
 		{
 			GameLogger::Log(MessageType::cError, "RenderEngine could not add graphical object! BufferManager failed to add graphical object!\n");
@@ -68,6 +73,8 @@ namespace Engine
 
 	void RenderEngine::RemoveGraphicalObject(GraphicalObject * pGraphicalObjectToRemove)
 	{
+		if (s_headless) { return; }
+
 		BufferManager::RemoveGraphicalObject(pGraphicalObjectToRemove);
 	}
 
@@ -487,6 +494,16 @@ namespace Engine
 		return true;
 	}
 
+	void RenderEngine::SetHeadless(bool headless)
+	{
+		s_headless = headless;
+	}
+
+	bool RenderEngine::IsHeadless()
+	{
+		return s_headless;
+	}
+
 	void RenderEngine::LogStats()
 	{
 		BufferManager::ConsoleLogStats();
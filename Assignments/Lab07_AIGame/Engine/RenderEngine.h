@@ -31,6 +31,10 @@ namespace Engine
 		static bool DrawInstanced(GraphicalObject *pGob, InstanceBuffer *pInstanceBuffer);
 		static bool DrawInstanced(GraphicalObject *pGob, int count);
 
+		// for tools with no window or gl context, meshes and objects are kept on the cpu and never handed to the BufferManager
+		static void SetHeadless(bool headless);
+		static bool IsHeadless();
+
 		static void LogStats();
 
 	private:
@@ -43,6 +47,7 @@ namespace Engine
 		static ShaderProgram *GetShaderProgramByID(GLint shaderProgramID);
 		static ShaderProgram s_shaderPrograms[MAX_SHADER_PROGRAMS];
 		static GLuint s_nextShaderProgram;
+		static bool s_headless;
 	};
 }
 
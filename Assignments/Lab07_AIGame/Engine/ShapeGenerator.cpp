@@ -984,8 +984,8 @@ namespace Engine
 		// TODO: remove hard coded ColorVertex*s here!!!!!!
 		*pSceneMesh = Mesh(pSceneMesh->GetVertexCount(), pSceneMesh->GetIndexCount(), pVertices, pIndices, pSceneMesh->GetMeshMode(), IndexSizeInBytes::Uint, shaderProgramID, pSceneMesh->GetVertexFormat(), cull);
 
-		// if the mesh should be textured texture it
-		if (pSceneMesh->GetVertexFormat() & VertexFormat::HasTexture && texturePath)
+		// if the mesh should be textured texture it, headless runs have no gl context to upload it to
+		if (pSceneMesh->GetVertexFormat() & VertexFormat::HasTexture && texturePath && !RenderEngine::IsHeadless())
 		{
 			// if missing path fail
 			//if (!texturePath)
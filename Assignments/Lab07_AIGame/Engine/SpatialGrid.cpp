@@ -7,6 +7,11 @@
 #include "ShapeGenerator.h"
 #include "RenderEngine.h"
 #include "MathUtility.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
 
 // Justin Furtado
 // SpatialGrid.h
@@ -18,9 +23,134 @@
 namespace Engine
 {
 	const float DEFAULT_SPATIAL_GRID_SIZE = 50.0f;
+	const int INITIAL_SPARSE_CELL_CAPACITY = 1024;
+	const int INITIAL_OBJECT_BOUNDS_CAPACITY = 64;
+	const int DEFAULT_GRID_SECTIONS = 85;
+
+	// auto fitting keeps the dense arrays about as big as the old fixed grid, and estimates from at most this many triangles
+	const int MAX_AUTO_FIT_CELLS = 1 << 20;
+	const int AUTO_FIT_SAMPLE_TRIANGLES = 16384;
+
+	// stepping a ray into a cell costs about as much as testing one triangle, and each candidate cell size is this much smaller than the last
+	const float AUTO_FIT_CELL_STEP_COST = 1.0f;
+	const float AUTO_FIT_SIZE_STEP = 0.85f;
+
+	// room left around the objects so small moves do not need a refit, as a fraction of the largest extent
+	const float AUTO_FIT_PADDING = 0.05f;
+
+	// sizes of the pieces a grid build is split into for the worker threads
+	const int TRIANGLES_PER_BUILD_JOB = 2048;
+	const int CELLS_PER_BUILD_JOB = 16384;
+
+	struct SpatialGrid::BuildData
+	{
+		~BuildData()
+		{
+			delete[] pObjects;
+			delete[] pJobs;
+			delete[] pWorldTriangles;
+			delete[] pTriangleObjects;
+			delete[] pCellCounters;
+			delete[] pChunkSums;
+			delete[] pSlotTriangles;
+			delete[] pCellPairs;
+			delete[] pCellFirstPairs;
+			if (ownsCellArrays) { delete[] pCellStarts; delete[] pCellCounts; }
+		}
+
+		SpatialGrid *pGrid{ nullptr };
+		BuildObject *pObjects{ nullptr };
+		int objectCount{ 0 };
+		BuildJob *pJobs{ nullptr };
+		int jobCount{ 0 };
+
+		// every triangle transformed to world space once, shared by the count and scatter passes
+		SpatialTriangleData *pWorldTriangles{ nullptr };
+		int *pTriangleObjects{ nullptr };
+		int triangleCount{ 0 };
+
+		// dense builds only, one counter per cell, counts during the first pass and write cursors during the scatter
+		std::atomic<int> *pCellCounters{ nullptr };
+		int *pChunkSums{ nullptr };
+
+		// where each cell's span starts and how many triangles it holds, indexed by dense cell or, in sparse builds, by occupied cell
+		int *pCellStarts{ nullptr };
+		int *pCellCounts{ nullptr };
+		bool ownsCellArrays{ false };
+		int chunkCount{ 0 };
+
+		// dense builds only, which cached triangle went into each data slot
+		int *pSlotTriangles{ nullptr };
+
+		// sparse builds only, every (cell, triangle) pair with the cell in the high bits so sorting groups each cell's triangles in object list order,
+		// and where each occupied cell's run of pairs starts
+		unsigned long long *pCellPairs{ nullptr };
+		int pairCount{ 0 };
+		int *pCellFirstPairs{ nullptr };
+		int occupiedCount{ 0 };
+	};
+
+	// bump the version whenever anything written to a cache file changes layout
+	const unsigned GRID_CACHE_MAGIC = 0x44524753; // "SGRD"
+	const unsigned GRID_CACHE_VERSION = 3;
+
+	// every section starts on a cache line, so mapped blocks are aligned as well as allocated ones
+	const int GRID_CACHE_SECTION_ALIGNMENT = 64;
+
+	const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+	// sections follow in the order of their offsets, the header is written last so a file cut short never looks valid
+	struct SpatialGrid::CacheHeader
+	{
+		unsigned magic;
+		unsigned version;
+		unsigned long long sourceHash;
+		unsigned long long fileSize;
+		int blockSize, triangleSize, sparseCellSize;
+		int width, depth, height;
+		float scale;
+		float origin[3];
+		int useSparseCells, exactTriangleBinning;
+		int ownerCount, objectBoundsCount;
+		int dataCapacity, dataUsed, wastedSlots;
+		int sparseCellCapacity, occupiedCellCount;
+		unsigned long long ownersOffset, boundsOffset, cellsOffset, trianglesOffset, blocksOffset;
+	};
+
+	// a SpatialTriangleData with the owner pointer swapped for its slot in the owner table
+	struct SpatialGrid::CacheTriangle
+	{
+		float p0[3], p1[3], p2[3];
+		int vertexIndex;
+		int ownerIndex;
+	};
+
+	struct SpatialGrid::CacheObjectBounds
+	{
+		int ownerIndex;
+		int minX, minY, minZ;
+		int maxX, maxY, maxZ;
+	};
+
+	// the object list flattened in walk order, which is what owners are saved against
+	struct SpatialGrid::ObjectArray
+	{
+		GraphicalObject **pObjects{ nullptr };
+		int count{ 0 };
+	};
+
+	// meshes are usually shared by many objects, each one's buffers are only read the first time it comes up
+	struct SpatialGrid::SourceHash
+	{
+		unsigned long long hash{ 0 };
+		ObjectIndexMap meshOrdinals;
+	};
+
 	SpatialGrid::SpatialGrid()
 		: m_gridScale(DEFAULT_SPATIAL_GRID_SIZE)
 	{
+		CenterGridOnOrigin();
 	}
 
 	SpatialGrid::~SpatialGrid()
@@ -81,7 +211,8 @@ namespace Engine
 		Vec3 halfDirVec(-floorf(0.5f * (m_gridSectionsWidth - SECTIONS_PER_DIRECTION)),
 					-floorf(0.5f * (m_gridSectionsDepth - SECTIONS_PER_DIRECTION)),
 					-floorf(0.5f * (m_gridSectionsHeight - SECTIONS_PER_DIRECTION)));
-		m_gridDisplayObject.SetTransMat(Mat4::Translation(m_gridScale * MathUtility::Clamp(indexVec, halfDirVec, -halfDirVec)));
+		Vec3 gridCenter = m_gridOrigin + 0.5f * m_gridScale * Vec3((float)m_gridSectionsWidth, (float)m_gridSectionsDepth, (float)m_gridSectionsHeight);
+		m_gridDisplayObject.SetTransMat(Mat4::Translation(gridCenter + m_gridScale * MathUtility::Clamp(indexVec, halfDirVec, -halfDirVec)));
 		m_gridDisplayObject.CalcFullTransform();
 		m_gridDisplayObject.SetEnabled(true);
 		Engine::RenderEngine::DrawInstanced(&m_gridDisplayObject, &m_gridInstanceBuffer);
@@ -93,6 +224,15 @@ namespace Engine
 		if (!AreGridIndicesValid(gridX, gridY, gridZ)) { return nullptr; }
 		int i = GetArrayIndexFromXYZIndices(gridX, gridY, gridZ);
 
+		if (!m_pData) { return nullptr; } // not calculated yet, or calculated by another backend
+
+		if (m_useSparseCells)
+		{
+			// empty cells are not stored in sparse mode, so there is no data to return for them
+			SparseCell *pCell = FindSparseCell(i);
+			return pCell ? &m_pData[pCell->m_startIndex] : nullptr;
+		}
+
 		//GameLogger::Log(MessageType::ConsoleOnly, "i = %d\n", i);
 		return &m_pData[m_pGridStartIndices[i]];
 	}
@@ -102,8 +242,42 @@ namespace Engine
 		return GetTriangleDataByGrid(GetGridIndexFromXPos(worldX), GetGridIndexFromYPos(worldY), GetGridIndexFromZPos(worldZ));
 	}
 
+	// the blocks of a cell line up with its triangle data, lane j of block b is triangle (4 * b + j)
+	SpatialTriangleBlock * SpatialGrid::GetTriangleBlocksByGrid(int gridX, int gridY, int gridZ)
+	{
+		SpatialTriangleData *pFirst = GetTriangleDataByGrid(gridX, gridY, gridZ);
+		if (!pFirst || !m_pBlocks) { return nullptr; }
+		return &m_pBlocks[(pFirst - m_pData) / SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+	}
+
+	// the blocks and triangle count of a cell from one index check and one lookup, nullptr for empty or invalid cells
+	SpatialTriangleBlock * SpatialGrid::GetTriangleBlocksByGrid(int gridX, int gridY, int gridZ, int * pOutTriangleCount)
+	{
+		*pOutTriangleCount = 0;
+		int i = GetArrayIndexFromXYZIndices(gridX, gridY, gridZ);
+		if (i < 0 || !m_pData || !m_pBlocks) { return nullptr; }
+
+		int startIndex = 0;
+		if (m_useSparseCells)
+		{
+			SparseCell *pCell = FindSparseCell(i);
+			if (!pCell || pCell->m_count == 0) { return nullptr; }
+			startIndex = pCell->m_startIndex;
+			*pOutTriangleCount = pCell->m_count;
+		}
+		else
+		{
+			if (m_pGridTriangleCounts[i] == 0) { return nullptr; }
+			startIndex = m_pGridStartIndices[i];
+			*pOutTriangleCount = m_pGridTriangleCounts[i];
+		}
+
+		return &m_pBlocks[startIndex / SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+	}
+
 	bool SpatialGrid::AddGraphicalObject(GraphicalObject * pGraphicalObjectToAdd)
 	{
+		m_sourceHash = 0;
 		m_totalTriangleCount += pGraphicalObjectToAdd->GetMeshPointer()->GetVertexCount() / 3;
 		m_objectList.AddToListFront(pGraphicalObjectToAdd);
 		return true;
@@ -111,17 +285,17 @@ namespace Engine
 
 	int SpatialGrid::GetGridIndexFromXPos(float xPos)
 	{
-		return (int)floorf((xPos / m_gridScale) + (m_gridSectionsWidth*0.5f));
+		return (int)floorf((xPos - m_gridOrigin.GetX()) / m_gridScale);
 	}
 
 	int SpatialGrid::GetGridIndexFromYPos(float yPos)
 	{
-		return (int)floorf((yPos / m_gridScale) + (m_gridSectionsDepth*0.5f));
+		return (int)floorf((yPos - m_gridOrigin.GetY()) / m_gridScale);
 	}
 
 	int SpatialGrid::GetGridIndexFromZPos(float zPos)
 	{
-		return (int)floorf((zPos / m_gridScale) + (m_gridSectionsHeight*0.5f));
+		return (int)floorf((zPos - m_gridOrigin.GetZ()) / m_gridScale);
 	}
 
 	int SpatialGrid::GetGridTriangleCount(int gridX, int gridY, int gridZ)
@@ -129,6 +303,14 @@ namespace Engine
 		if (!AreGridIndicesValid(gridX, gridY, gridZ)) { return -1; }
 		int i = GetArrayIndexFromXYZIndices(gridX, gridY, gridZ);
 
+		if (!m_pData) { return 0; } // not calculated yet, or calculated by another backend
+
+		if (m_useSparseCells)
+		{
+			SparseCell *pCell = FindSparseCell(i);
+			return pCell ? pCell->m_count : 0;
+		}
+
 		return m_pGridTriangleCounts[i];
 	}
 
@@ -143,6 +325,27 @@ namespace Engine
 		m_minGridTriangleCount = -1;
 		m_maxGridTriangleCount = -1;
 
+		if (!m_pSparseCells && !m_pGridTriangleCounts) { m_avgGridTriangleCount = 0.0f; return; }
+
+		if (m_useSparseCells)
+		{
+			// any cell not in the table is empty, so the minimum is zero unless every cell is occupied
+			if (m_occupiedCellCount < m_totalGridSections) { m_minGridTriangleCount = 0; }
+
+			for (int i = 0; i < m_sparseCellCapacity; ++i)
+			{
+				if (m_pSparseCells[i].m_key < 0) { continue; }
+
+				int count = m_pSparseCells[i].m_count;
+				if (count < m_minGridTriangleCount || m_minGridTriangleCount < 0) { m_minGridTriangleCount = count; }
+				if (count > m_maxGridTriangleCount || m_maxGridTriangleCount < 0) { m_maxGridTriangleCount = count; }
+				m_totalTriangleCount += count;
+			}
+
+			m_avgGridTriangleCount = (float)m_totalTriangleCount / (float)m_totalGridSections;
+			return;
+		}
+
 		for (int i = 0; i < m_totalGridSections; ++i)
 		{
 			if (m_pGridTriangleCounts[i] < m_minGridTriangleCount || m_minGridTriangleCount < 0)
@@ -163,9 +366,41 @@ namespace Engine
 
 	void SpatialGrid::RemoveGraphicalObject(GraphicalObject * pGobToRemove)
 	{
+		if (!m_objectList.Contains(pGobToRemove)) { return; }
+
+		// take its triangles out too, otherwise they would point at an object the grid no longer knows about
+		m_sourceHash = 0;
+		RemoveObjectTriangles(pGobToRemove);
+		RemoveOwner(pGobToRemove);
 		m_objectList.RemoveFirstFromList(pGobToRemove);
 	}
 
+	// re-bins a single object that was moved, rotated, scaled or just added, only touching the cells its old and new triangles are in
+	bool SpatialGrid::UpdateGraphicalObject(GraphicalObject * pGobToUpdate)
+	{
+		if (!pGobToUpdate) { GameLogger::Log(MessageType::cError, "Failed to UpdateGraphicalObject in SpatialGrid! GraphicalObject was nullptr!\n"); return false; }
+		if (!m_objectList.Contains(pGobToUpdate)) { GameLogger::Log(MessageType::cError, "Failed to UpdateGraphicalObject in SpatialGrid! GraphicalObject was never added to the grid!\n"); return false; }
+
+		// nothing has been binned yet, so there is nothing to update
+		if (!m_pData) { return AddTrianglesToPartitions(); }
+
+		m_sourceHash = 0;
+		if (!RemoveObjectTriangles(pGobToUpdate)) { return false; }
+
+		// cells that outgrew their span leave holes behind, once there are too many a full rebuild packs everything again
+		if (m_wastedSlots * 2 > m_dataUsed) { return AddTrianglesToPartitions(); }
+
+		if (!DoesFitInCells(pGobToUpdate))
+		{
+			// a fitted grid grows to wherever the object went
+			if (m_autoFitGrid) { return AddTrianglesToPartitions(); }
+			GameLogger::Log(MessageType::cWarning, "Tried to UpdateGraphicalObject in SpatialGrid but some triangles were out of grid range!\n");
+			return false;
+		}
+
+		return InsertObjectTriangles(pGobToUpdate);
+	}
+
 	int SpatialGrid::GetGridWidth()
 	{
 		return m_gridSectionsWidth;
@@ -188,31 +423,146 @@ namespace Engine
 		GameLogger::Log(MessageType::cDebug, "Average triangle count for grid cells is [%.3f]\n", m_avgGridTriangleCount);
 		GameLogger::Log(MessageType::cDebug, "Min triangle count for grid is [%d]\n", m_minGridTriangleCount);
 		GameLogger::Log(MessageType::cDebug, "Max triangle count for grid is [%d]\n", m_maxGridTriangleCount);
+		if (m_useSparseCells) { GameLogger::Log(MessageType::cDebug, "Sparse grid is storing [%d] occupied cells of [%d] in [%d] slots\n", m_occupiedCellCount, m_totalGridSections, m_sparseCellCapacity); }
+
+		// how many cells each triangle is copied into, binning by bounding box versus what is actually stored
+		m_uniqueTriangleCount = 0;
+		m_boundingBoxCellCount = 0;
+		m_objectList.WalkList(SpatialGrid::CountBinningPassThrough, this);
+		if (m_uniqueTriangleCount > 0)
+		{
+			GameLogger::Log(MessageType::cDebug, "Exact triangle binning is [%s]\n", m_exactTriangleBinning ? "on" : "off");
+			GameLogger::Log(MessageType::cDebug, "Duplication factor is [%.3f] by bounding box and [%.3f] stored for [%d] triangles\n", (float)m_boundingBoxCellCount / (float)m_uniqueTriangleCount, (float)m_totalTriangleCount / (float)m_uniqueTriangleCount, m_uniqueTriangleCount);
+		}
+	}
+
+	bool SpatialGrid::CountBinningPassThrough(GraphicalObject * pObj, void * pClassInstance)
+	{
+		SpatialGrid *pInstance = reinterpret_cast<SpatialGrid *>(pClassInstance);
+
+		// no callback, so this only walks the cell ranges
+		SpatialCallbackPassData data;
+		data.modelToWorld = *pObj->GetFullTransformPtr();
+		data.callback = nullptr;
+		data.pObj = pObj;
+		pObj->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, pInstance, &data);
+
+		pInstance->m_uniqueTriangleCount += data.m_triangleCount;
+		pInstance->m_boundingBoxCellCount += data.m_boundingBoxCellCount;
+		return true;
 	}
 
+	// count, prefix sum and scatter, each pass split into independent jobs so the worker pool can share them
 	bool SpatialGrid::AddTrianglesToPartitions()
 	{
 		// allow method to be called repeatedly
 		if (!m_firstCalculation) { CleanUp(); }
 		else { m_firstCalculation = false; }
 
-		m_pGridStartIndices = new int[m_totalGridSections] {0};
-		m_pGridTriangleCounts = new int[m_totalGridSections] {0};
-		if (!m_pGridStartIndices) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_totalGridSections); return false; }
-		if (!m_pGridTriangleCounts) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_totalGridSections); return false; }
+		if (!FitGridToObjects()) { return false; }
 
-		if (!SetGridStartIndices()) { GameLogger::Log(MessageType::cFatal_Error, "Failed to set grid start indices!\n"); return false; }
+		BuildData build;
+		build.pGrid = this;
+		if (!PrepareBuild(&build)) { return false; }
+		if (build.objectCount > MAX_OWNERS) { GameLogger::Log(MessageType::cError, "Failed to AddTrianglesToPartitions! [%d] objects is more than the [%d] a grid can hold!\n", build.objectCount, MAX_OWNERS); return false; }
 
-		CalculateStatisticsFromCounts();
-		m_pData = new SpatialTriangleData[m_totalTriangleCount];
-		if (!m_pData) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] triangles!\n", m_totalTriangleCount); return false; }
+		// every object gets the owner slot matching its place in the build
+		if (!GrowOwners(build.objectCount)) { return false; }
+		for (int i = 0; i < build.objectCount; ++i)
+		{
+			SetOwner(i, build.pObjects[i].pObj);
+		}
+		m_ownerCount = build.objectCount;
 
-		for (int i = 0; i < m_totalGridSections; ++i)
+		// pass one: transform every triangle into the cache and count how many land in each cell, sparse grids count per job instead so nothing is sized by the whole grid
+		RunBuildJobs(build.jobCount, SpatialGrid::TransformAndCountJob, &build);
+		for (int i = 0; i < build.jobCount; ++i)
+		{
+			if (!build.pJobs[i].success) { GameLogger::Log(MessageType::cWarning, "Tried to AddGraphicalObject to SpatialGrid but some triangles were out of grid range!\n"); return false; }
+		}
+
+		if (m_useSparseCells)
+		{
+			// pair every triangle with the cells it touches and sort, each occupied cell is then one run of pairs
+			for (int i = 0; i < build.jobCount; ++i)
+			{
+				build.pJobs[i].firstPair = build.pairCount;
+				build.pairCount += build.pJobs[i].pairCount;
+			}
+
+			build.pCellPairs = new unsigned long long[build.pairCount > 0 ? build.pairCount : 1];
+			if (!build.pCellPairs) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] cell pairs!\n", build.pairCount); return false; }
+			RunBuildJobs(build.jobCount, SpatialGrid::PairCellsJob, &build);
+			std::sort(build.pCellPairs, build.pCellPairs + build.pairCount);
+
+			if (!BuildSparseCellsFromPairs(&build)) { return false; }
+		}
+		else
+		{
+			m_pGridStartIndices = new int[m_totalGridSections];
+			m_pGridTriangleCounts = new int[m_totalGridSections];
+			m_pGridTriangleCapacities = new int[m_totalGridSections];
+			if (!m_pGridStartIndices) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_totalGridSections); return false; }
+			if (!m_pGridTriangleCounts) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_totalGridSections); return false; }
+			if (!m_pGridTriangleCapacities) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_totalGridSections); return false; }
+			build.pCellStarts = m_pGridStartIndices;
+			build.pCellCounts = m_pGridTriangleCounts;
+
+			// prefix sum over the block padded cell sizes: total each chunk, scan the chunk totals, then fill in each chunk
+			build.chunkCount = (m_totalGridSections + CELLS_PER_BUILD_JOB - 1) / CELLS_PER_BUILD_JOB;
+			build.pChunkSums = new int[build.chunkCount];
+			if (!build.pChunkSums) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", build.chunkCount); return false; }
+			RunBuildJobs(build.chunkCount, SpatialGrid::SumCellChunkJob, &build);
+
+			int c = 0;
+			for (int i = 0; i < build.chunkCount; ++i)
+			{
+				int chunkSum = build.pChunkSums[i];
+				build.pChunkSums[i] = c;
+				c += chunkSum;
+			}
+
+			RunBuildJobs(build.chunkCount, SpatialGrid::WriteCellStartsJob, &build);
+			m_dataCapacity = c;
+		}
+
+		// every cell starts on a block boundary, the gaps hold empty triangles that are never counted
+		m_dataUsed = m_dataCapacity;
+		m_wastedSlots = 0;
+
+		m_pData = new SpatialTriangleData[m_dataCapacity];
+		m_pBlocks = new SpatialTriangleBlock[m_dataCapacity / SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		if (!m_pData || !m_pBlocks) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] triangles!\n", m_dataCapacity); return false; }
+
+		// pass two: copy the cached triangles into each cell's span, dense grids hand out the slots first
+		if (m_useSparseCells) { RunBuildJobs(build.chunkCount, SpatialGrid::GatherSparseCellChunkJob, &build); }
+		else
+		{
+			build.pSlotTriangles = new int[m_dataCapacity];
+			if (!build.pSlotTriangles) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] ints!\n", m_dataCapacity); return false; }
+			RunBuildJobs(build.jobCount, SpatialGrid::ScatterJob, &build);
+			RunBuildJobs(build.chunkCount, SpatialGrid::GatherCellChunkJob, &build);
+		}
+
+		// remember which cells each object landed in for incremental updates
+		for (int i = 0; i < build.jobCount; ++i)
 		{
-			m_pGridTriangleCounts[i] = 0;
+			GrowCellBounds(&build.pObjects[build.pJobs[i].objectIndex].bounds, build.pJobs[i].bounds);
 		}
 
-		if (!m_objectList.WalkList(SpatialGrid::AddGraphicalObjectToGridPassThrough, this)) { return false; }
+		m_objectBoundsCapacity = (build.objectCount > 0) ? build.objectCount : INITIAL_OBJECT_BOUNDS_CAPACITY;
+		m_pObjectBounds = new ObjectCellBounds[m_objectBoundsCapacity];
+		if (!m_pObjectBounds) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] object cell bounds!\n", m_objectBoundsCapacity); return false; }
+		for (int i = 0; i < build.objectCount; ++i)
+		{
+			m_pObjectBounds[i] = build.pObjects[i].bounds;
+			m_pObjectBounds[i].m_pObj = build.pObjects[i].pObj;
+			if (!m_objectBoundsIndices.Set(build.pObjects[i].pObj, i)) { return false; }
+		}
+		m_objectBoundsCount = build.objectCount;
+
+		if (!BuildOccupancy()) { return false; }
+		CalculateStatisticsFromCounts();
 
 		GameLogger::Log(MessageType::Process, "Successfully re-calculated spatial grid!\n");
 		return true;
@@ -240,50 +590,293 @@ namespace Engine
 		return true;
 	}
 
-	bool SpatialGrid::SetGridStartIndices()
+	int SpatialGrid::RoundUpToBlock(int triangleCount)
 	{
-		if (!m_objectList.WalkList(SpatialGrid::SetGridStartIndicesForObjectPassThrough, this)) {
-			return false;
+		return ((triangleCount + SpatialTriangleBlock::TRIANGLES_PER_BLOCK - 1) / SpatialTriangleBlock::TRIANGLES_PER_BLOCK) * SpatialTriangleBlock::TRIANGLES_PER_BLOCK;
+	}
+
+	bool SpatialGrid::AddBuildObjectPassThrough(GraphicalObject * pObj, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		BuildObject& object = pBuild->pObjects[pBuild->objectCount++];
+		object.pObj = pObj;
+		object.modelToWorld = *pObj->GetFullTransformPtr();
+		object.firstTriangle = pBuild->triangleCount;
+		object.triangleCount = (int)pObj->GetMeshPointer()->GetTriangleCount();
+		pBuild->triangleCount += object.triangleCount;
+		pBuild->jobCount += (object.triangleCount + TRIANGLES_PER_BUILD_JOB - 1) / TRIANGLES_PER_BUILD_JOB;
+		return true;
+	}
+
+	bool SpatialGrid::PrepareBuild(BuildData * pBuild)
+	{
+		// flatten the object list so jobs can index into it
+		pBuild->pObjects = new BuildObject[m_objectList.GetCount() > 0 ? m_objectList.GetCount() : 1];
+		if (!pBuild->pObjects) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] build objects!\n", m_objectList.GetCount()); return false; }
+		m_objectList.WalkList(SpatialGrid::AddBuildObjectPassThrough, pBuild);
+
+		// big objects are split into several jobs, small ones get one each
+		pBuild->pJobs = new BuildJob[pBuild->jobCount > 0 ? pBuild->jobCount : 1];
+		pBuild->pWorldTriangles = new SpatialTriangleData[pBuild->triangleCount > 0 ? pBuild->triangleCount : 1];
+		pBuild->pTriangleObjects = new int[pBuild->triangleCount > 0 ? pBuild->triangleCount : 1];
+		pBuild->pCellCounters = m_useSparseCells ? nullptr : new std::atomic<int>[m_totalGridSections];
+		if (!pBuild->pJobs || !pBuild->pWorldTriangles || !pBuild->pTriangleObjects || (!m_useSparseCells && !pBuild->pCellCounters)) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory to build grid of [%d] triangles!\n", pBuild->triangleCount); return false; }
+
+		int j = 0;
+		for (int i = 0; i < pBuild->objectCount; ++i)
+		{
+			for (int first = 0; first < pBuild->pObjects[i].triangleCount; first += TRIANGLES_PER_BUILD_JOB)
+			{
+				pBuild->pJobs[j].objectIndex = i;
+				pBuild->pJobs[j].firstTriangle = first;
+				pBuild->pJobs[j].triangleCount = (pBuild->pObjects[i].triangleCount - first < TRIANGLES_PER_BUILD_JOB) ? pBuild->pObjects[i].triangleCount - first : TRIANGLES_PER_BUILD_JOB;
+				j++;
+			}
+		}
+
+		if (!m_useSparseCells)
+		{
+			for (int i = 0; i < m_totalGridSections; ++i) { pBuild->pCellCounters[i].store(0, std::memory_order_relaxed); }
+		}
+
+		return true;
+	}
+
+	// the pairs are sorted, so every run of one cell is an occupied cell and nothing is ever looked at for the empty ones
+	bool SpatialGrid::BuildSparseCellsFromPairs(BuildData * pBuild)
+	{
+		int occupied = 0;
+		for (int i = 0; i < pBuild->pairCount; ++i)
+		{
+			if (i == 0 || (pBuild->pCellPairs[i] >> 32) != (pBuild->pCellPairs[i - 1] >> 32)) { occupied++; }
 		}
 
+		pBuild->pCellStarts = new int[occupied > 0 ? occupied : 1];
+		pBuild->pCellCounts = new int[occupied > 0 ? occupied : 1];
+		pBuild->pCellFirstPairs = new int[occupied > 0 ? occupied : 1];
+		pBuild->ownsCellArrays = true;
+		if (!pBuild->pCellStarts || !pBuild->pCellCounts || !pBuild->pCellFirstPairs) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] occupied cells!\n", occupied); return false; }
+
+		// sized up front so the table never has to grow while it is filled
+		m_sparseCellCapacity = INITIAL_SPARSE_CELL_CAPACITY;
+		while (m_sparseCellCapacity < 2 * (occupied + 1)) { m_sparseCellCapacity *= 2; }
+		m_occupiedCellCount = 0;
+		m_pSparseCells = new SparseCell[m_sparseCellCapacity];
+		if (!m_pSparseCells) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] sparse cells!\n", m_sparseCellCapacity); return false; }
+
 		int c = 0;
-		for (int x = 0; x < m_gridSectionsWidth; ++x)
+		for (int first = 0; first < pBuild->pairCount;)
+		{
+			int arrayIndex = (int)(pBuild->pCellPairs[first] >> 32);
+			int end = first + 1;
+			while (end < pBuild->pairCount && (int)(pBuild->pCellPairs[end] >> 32) == arrayIndex) { ++end; }
+
+			SparseCell *pCell = FindOrAddSparseCell(arrayIndex);
+			if (!pCell) { return false; }
+			pCell->m_startIndex = c;
+			pCell->m_count = end - first;
+			pCell->m_capacity = RoundUpToBlock(pCell->m_count);
+
+			pBuild->pCellStarts[pBuild->occupiedCount] = c;
+			pBuild->pCellCounts[pBuild->occupiedCount] = end - first;
+			pBuild->pCellFirstPairs[pBuild->occupiedCount] = first;
+			pBuild->occupiedCount++;
+
+			c += pCell->m_capacity;
+			first = end;
+		}
+
+		m_dataCapacity = c;
+		pBuild->chunkCount = (pBuild->occupiedCount + CELLS_PER_BUILD_JOB - 1) / CELLS_PER_BUILD_JOB;
+		return true;
+	}
+
+	void SpatialGrid::RunBuildJobs(int jobCount, void(*job)(int, void *), BuildData * pBuild)
+	{
+		if (m_pWorkers && m_pWorkers->IsInitialized()) { m_pWorkers->RunJobs(jobCount, job, pBuild); return; }
+
+		for (int i = 0; i < jobCount; ++i) { job(i, pBuild); }
+	}
+
+	void SpatialGrid::TransformAndCountJob(int jobIndex, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		BuildJob& job = pBuild->pJobs[jobIndex];
+		BuildObject& object = pBuild->pObjects[job.objectIndex];
+
+		SpatialTriangleData *pFirst = &pBuild->pWorldTriangles[object.firstTriangle + job.firstTriangle];
+		WorldTriangleStore store{ object.modelToWorld, object.pObj, pFirst };
+		object.pObj->GetMeshPointer()->WalkTriangleRange(job.firstTriangle, job.triangleCount, SpatialGrid::StoreWorldTrianglePassThrough, pGrid, &store);
+
+		for (int t = 0; t < job.triangleCount; ++t)
 		{
-			for (int y = 0; y < m_gridSectionsDepth; ++y)
+			// objects are the owner table of the finished grid in the same order
+			pBuild->pTriangleObjects[object.firstTriangle + job.firstTriangle + t] = job.objectIndex;
+
+			ObjectCellBounds range;
+			if (!pGrid->GetTriangleCellRange(pFirst[t].p0, pFirst[t].p1, pFirst[t].p2, &range)) { job.success = false; return; }
+			GrowCellBounds(&job.bounds, range);
+
+			for (int x = range.m_minX; x <= range.m_maxX; ++x)
 			{
-				for (int z = 0; z < m_gridSectionsHeight; ++z)
+				for (int y = range.m_minY; y <= range.m_maxY; ++y)
 				{
-					int i = GetArrayIndexFromXYZIndices(x, y, z);
-					m_pGridStartIndices[i] = c;
-					c += m_pGridTriangleCounts[i];
+					for (int z = range.m_minZ; z <= range.m_maxZ; ++z)
+					{
+						if (!pGrid->DoesTriangleTouchCell(x, y, z, pFirst[t].p0, pFirst[t].p1, pFirst[t].p2)) { continue; }
+						if (pGrid->m_useSparseCells) { job.pairCount++; continue; }
+						pBuild->pCellCounters[pGrid->GetArrayIndexFromXYZIndices(x, y, z)].fetch_add(1, std::memory_order_relaxed);
+					}
 				}
 			}
 		}
 
-		// indicate success
-		GameLogger::Log(MessageType::Process, "Successfully added GraphicalObject to SpatialGrid!\n");
+		job.success = true;
+	}
+
+	bool SpatialGrid::StoreWorldTrianglePassThrough(int index, const void * pVert1, const void * pVert2, const void * pVert3, void * /*pClassInstance*/, void * pPassThroughData)
+	{
+		WorldTriangleStore *pStore = reinterpret_cast<WorldTriangleStore *>(pPassThroughData);
+
+		// grab the vertex positions regardless of format
+		SpatialTriangleData *pTriangle = pStore->pNext++;
+		pTriangle->p0 = pStore->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert1)));
+		pTriangle->p1 = pStore->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert2)));
+		pTriangle->p2 = pStore->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert3)));
+		pTriangle->m_pTriangleOwner = pStore->pObj;
+		pTriangle->m_triangleVertexZeroIndex = index;
 		return true;
 	}
 
-	bool SpatialGrid::SetGridStartIndicesForObjectPassThrough(GraphicalObject * pGraphicalObjectToAdd, void * pClassInstance)
+	void SpatialGrid::SumCellChunkJob(int chunkIndex, void * pBuildData)
 	{
-		SpatialGrid *pSpatialGrid = reinterpret_cast<SpatialGrid*>(pClassInstance);
-		return pSpatialGrid->SetGridStartIndicesForObject(pGraphicalObjectToAdd);
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		int start = chunkIndex * CELLS_PER_BUILD_JOB;
+		int end = (start + CELLS_PER_BUILD_JOB < pBuild->pGrid->m_totalGridSections) ? start + CELLS_PER_BUILD_JOB : pBuild->pGrid->m_totalGridSections;
+
+		int sum = 0;
+		for (int i = start; i < end; ++i) { sum += RoundUpToBlock(pBuild->pCellCounters[i].load(std::memory_order_relaxed)); }
+		pBuild->pChunkSums[chunkIndex] = sum;
 	}
 
-	bool SpatialGrid::SetGridStartIndicesForObject(GraphicalObject * pCurrent)
+	void SpatialGrid::WriteCellStartsJob(int chunkIndex, void * pBuildData)
 	{
-		// model to world matrix
-		Mat4 modelToWorld = *pCurrent->GetFullTransformPtr();
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		int start = chunkIndex * CELLS_PER_BUILD_JOB;
+		int end = (start + CELLS_PER_BUILD_JOB < pGrid->m_totalGridSections) ? start + CELLS_PER_BUILD_JOB : pGrid->m_totalGridSections;
+
+		// the counters become write cursors for the scatter
+		int c = pBuild->pChunkSums[chunkIndex];
+		for (int i = start; i < end; ++i)
+		{
+			int count = pBuild->pCellCounters[i].load(std::memory_order_relaxed);
+			pBuild->pCellCounts[i] = count;
+			pBuild->pCellStarts[i] = c;
+			if (!pGrid->m_useSparseCells) { pGrid->m_pGridTriangleCapacities[i] = RoundUpToBlock(count); }
+			pBuild->pCellCounters[i].store(c, std::memory_order_relaxed);
+			c += RoundUpToBlock(count);
+		}
+	}
 
-		SpatialCallbackPassData data;
-		data.modelToWorld = modelToWorld;
-		data.callback = SpatialGrid::SetTriangleIndexPassThrough;
-		data.pObj = pCurrent;
+	void SpatialGrid::ScatterJob(int jobIndex, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		BuildJob& job = pBuild->pJobs[jobIndex];
+		int firstTriangle = pBuild->pObjects[job.objectIndex].firstTriangle + job.firstTriangle;
 
-		pCurrent->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, this, &data);
+		for (int t = firstTriangle; t < firstTriangle + job.triangleCount; ++t)
+		{
+			const SpatialTriangleData& triangle = pBuild->pWorldTriangles[t];
+			ObjectCellBounds range;
+			pGrid->GetTriangleCellRange(triangle.p0, triangle.p1, triangle.p2, &range);
 
-		return data.m_success;
+			for (int x = range.m_minX; x <= range.m_maxX; ++x)
+			{
+				for (int y = range.m_minY; y <= range.m_maxY; ++y)
+				{
+					for (int z = range.m_minZ; z <= range.m_maxZ; ++z)
+					{
+						if (!pGrid->DoesTriangleTouchCell(x, y, z, triangle.p0, triangle.p1, triangle.p2)) { continue; }
+						int slot = pBuild->pCellCounters[pGrid->GetArrayIndexFromXYZIndices(x, y, z)].fetch_add(1, std::memory_order_relaxed);
+						pBuild->pSlotTriangles[slot] = t;
+					}
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::GatherCellChunkJob(int chunkIndex, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		int start = chunkIndex * CELLS_PER_BUILD_JOB;
+		int end = (start + CELLS_PER_BUILD_JOB < pGrid->m_totalGridSections) ? start + CELLS_PER_BUILD_JOB : pGrid->m_totalGridSections;
+
+		for (int i = start; i < end; ++i)
+		{
+			int count = pBuild->pCellCounts[i];
+			if (count == 0) { continue; }
+
+			// threads raced for the slots, sorting puts each cell back in object list order so every build is identical
+			int *pSlots = &pBuild->pSlotTriangles[pBuild->pCellStarts[i]];
+			std::sort(pSlots, pSlots + count);
+
+			for (int s = 0; s < count; ++s)
+			{
+				pGrid->WriteTriangle(pBuild->pCellStarts[i] + s, pBuild->pWorldTriangles[pSlots[s]], pBuild->pTriangleObjects[pSlots[s]]);
+			}
+		}
+	}
+
+	void SpatialGrid::PairCellsJob(int jobIndex, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		BuildJob& job = pBuild->pJobs[jobIndex];
+		int firstTriangle = pBuild->pObjects[job.objectIndex].firstTriangle + job.firstTriangle;
+
+		// every job writes only its own run of pairs, sized by the count pass
+		unsigned long long *pPair = &pBuild->pCellPairs[job.firstPair];
+		for (int t = firstTriangle; t < firstTriangle + job.triangleCount; ++t)
+		{
+			const SpatialTriangleData& triangle = pBuild->pWorldTriangles[t];
+			ObjectCellBounds range;
+			pGrid->GetTriangleCellRange(triangle.p0, triangle.p1, triangle.p2, &range);
+
+			for (int x = range.m_minX; x <= range.m_maxX; ++x)
+			{
+				for (int y = range.m_minY; y <= range.m_maxY; ++y)
+				{
+					for (int z = range.m_minZ; z <= range.m_maxZ; ++z)
+					{
+						if (!pGrid->DoesTriangleTouchCell(x, y, z, triangle.p0, triangle.p1, triangle.p2)) { continue; }
+						*pPair++ = ((unsigned long long)pGrid->GetArrayIndexFromXYZIndices(x, y, z) << 32) | (unsigned)t;
+					}
+				}
+			}
+		}
+	}
+
+	void SpatialGrid::GatherSparseCellChunkJob(int chunkIndex, void * pBuildData)
+	{
+		BuildData *pBuild = reinterpret_cast<BuildData *>(pBuildData);
+		SpatialGrid *pGrid = pBuild->pGrid;
+		int start = chunkIndex * CELLS_PER_BUILD_JOB;
+		int end = (start + CELLS_PER_BUILD_JOB < pBuild->occupiedCount) ? start + CELLS_PER_BUILD_JOB : pBuild->occupiedCount;
+
+		// the sort already put each cell's triangles in object list order
+		for (int i = start; i < end; ++i)
+		{
+			const unsigned long long *pPairs = &pBuild->pCellPairs[pBuild->pCellFirstPairs[i]];
+			for (int s = 0; s < pBuild->pCellCounts[i]; ++s)
+			{
+				int t = (int)(pPairs[s] & 0xFFFFFFFFull);
+				pGrid->WriteTriangle(pBuild->pCellStarts[i] + s, pBuild->pWorldTriangles[t], pBuild->pTriangleObjects[t]);
+			}
+		}
 	}
 
 	bool SpatialGrid::AreGridIndicesValid(int gridX, int gridY, int gridZ)
@@ -299,29 +892,6 @@ namespace Engine
 		return (gridZ * (m_gridSectionsWidth * m_gridSectionsDepth)) + (gridY * (m_gridSectionsWidth)) + (gridX);
 	}
 	
-	bool SpatialGrid::AddGraphicalObjectToGridPassThrough(GraphicalObject * pGraphicalObjectToAdd, void * pClassInstance)
-	{
-		SpatialGrid	*pInstance = reinterpret_cast<SpatialGrid*>(pClassInstance);
-		return pInstance->AddGraphicalObjectToGrid(pGraphicalObjectToAdd);
-	}
-
-	bool SpatialGrid::AddGraphicalObjectToGrid(GraphicalObject * pGraphicalObjectToAdd)
-	{
-		// model to world matrix
-		Mat4 modelToWorld = *pGraphicalObjectToAdd->GetFullTransformPtr();
-
-		SpatialCallbackPassData data;
-		data.modelToWorld = modelToWorld;
-		data.callback = SpatialGrid::AddSpatialTrianglePassThrough;
-		data.pObj = pGraphicalObjectToAdd;
-
-		pGraphicalObjectToAdd->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, this, &data);
-
-		// indicate success
-		GameLogger::Log(MessageType::Process, "Successfully added GraphicalObject to SpatialGrid!\n");
-		return data.m_success;
-	}
-
 	bool SpatialGrid::ProcessTrianglesPassThrough(int index, const void * pVert1, const void * pVert2, const void * pVert3, void * pClassInstance, void * pPassThroughData)
 	{
 		SpatialGrid *pInstance = reinterpret_cast<SpatialGrid *>(pClassInstance);
@@ -337,37 +907,30 @@ namespace Engine
 		Vec3 p1 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert2)));
 		Vec3 p2 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert3)));
 
-		// extract the leftmost, upmost, downmost, rightmost grid indices for which the bounding box of the triangle enters
-		// TODO: investigate the case where a triangle is added to a grid in which the bounding quad intersects but the triangle does not
-		// NOTE: if the grid size is larger than the triangle size, the triangle can be in at most four grid spaces, and the above would only have a small effect
-		float offsetX = 0.5f*m_gridSectionsWidth;
-		float offsetY = 0.5f*m_gridSectionsDepth;
-		float offsetZ = 0.5f*m_gridSectionsHeight;
-		int minGridX = (int)fminf(fminf(p0.GetX() / m_gridScale + offsetX, p1.GetX() / m_gridScale + offsetX), p2.GetX() / m_gridScale + offsetX);
-		int minGridY = (int)fminf(fminf(p0.GetY() / m_gridScale + offsetY, p1.GetY() / m_gridScale + offsetY), p2.GetY() / m_gridScale + offsetY);
-		int minGridZ = (int)fminf(fminf(p0.GetZ() / m_gridScale + offsetZ, p1.GetZ() / m_gridScale + offsetZ), p2.GetZ() / m_gridScale + offsetZ);
-		int maxGridX = (int)fmaxf(fmaxf(p0.GetX() / m_gridScale + offsetX, p1.GetX() / m_gridScale + offsetX), p2.GetX() / m_gridScale + offsetX);
-		int maxGridY = (int)fmaxf(fmaxf(p0.GetY() / m_gridScale + offsetY, p1.GetY() / m_gridScale + offsetY), p2.GetY() / m_gridScale + offsetY);
-		int maxGridZ = (int)fmaxf(fmaxf(p0.GetZ() / m_gridScale + offsetZ, p1.GetZ() / m_gridScale + offsetZ), p2.GetZ() / m_gridScale + offsetZ);
-
-		// error checking
-		if (!AreGridIndicesValid(minGridX, minGridY, minGridZ) || !AreGridIndicesValid(maxGridX, maxGridY, maxGridZ))
+		ObjectCellBounds range;
+		if (!GetTriangleCellRange(p0, p1, p2, &range))
 		{
 			if (pData->callback) { GameLogger::Log(MessageType::cWarning, "Tried to AddGraphicalObject to SpatialGrid but some triangles were out of grid range!\n"); }
 			pData->m_success = false;
 			return false;
 		}
 
+		// grow the cell range covered by the whole object
+		GrowCellBounds(&pData->m_bounds, range);
+		pData->m_triangleCount++;
+		pData->m_boundingBoxCellCount += (range.m_maxX - range.m_minX + 1) * (range.m_maxY - range.m_minY + 1) * (range.m_maxZ - range.m_minZ + 1);
+
 		if (pData->callback)
 		{
 			// add to all grid cells in range
-			for (int x = minGridX; x <= maxGridX; ++x)
+			for (int x = range.m_minX; x <= range.m_maxX; ++x)
 			{
-				for (int y = minGridY; y <= maxGridY; ++y)
+				for (int y = range.m_minY; y <= range.m_maxY; ++y)
 				{
-					for (int z = minGridZ; z <= maxGridZ; ++z)
+					for (int z = range.m_minZ; z <= range.m_maxZ; ++z)
 					{
-						pData->callback(x, y, z, pData->pObj, index, p0, p1, p2, this);
+						if (!DoesTriangleTouchCell(x, y, z, p0, p1, p2)) { continue; }
+						if (!pData->callback(x, y, z, pData->pObj, pData->ownerIndex, index, p0, p1, p2, this)) { pData->m_success = false; return false; }
 					}
 				}
 			}
@@ -377,68 +940,1196 @@ namespace Engine
 		return true;
 	}
 
-	bool SpatialGrid::SetTriangleIndexPassThrough(int x, int y, int z, GraphicalObject * pObj, int index, const Vec3& /*p0*/, const Vec3& /*p1*/, const Vec3& /*p2*/, void *pClassInstance)
+	bool SpatialGrid::GetTriangleCellRange(const Vec3 & p0, const Vec3 & p1, const Vec3 & p2, ObjectCellBounds * pOutRange)
 	{
-		SpatialGrid *pInstance = reinterpret_cast<SpatialGrid *>(pClassInstance);
-		return pInstance->SetTriangleIndex(x, y, z, pObj, index);
+		// the cells the bounding box of the triangle enters, the ones the triangle itself misses are filtered out by DoesTriangleTouchCell
+		return GetBoxCellRange(MathUtility::Min(MathUtility::Min(p0, p1), p2), MathUtility::Max(MathUtility::Max(p0, p1), p2), pOutRange);
 	}
 
-	bool SpatialGrid::SetTriangleIndex(int x, int y, int z, GraphicalObject * /*pObj*/, int /*index*/)
+	bool SpatialGrid::GetBoxCellRange(const Vec3 & boxMin, const Vec3 & boxMax, ObjectCellBounds * pOutRange)
 	{
-		m_pGridTriangleCounts[GetArrayIndexFromXYZIndices(x, y, z)]++;
-		return true;
+		// extract the leftmost, upmost, downmost, rightmost grid indices for which the box enters
+		pOutRange->m_minX = (int)((boxMin.GetX() - m_gridOrigin.GetX()) / m_gridScale);
+		pOutRange->m_minY = (int)((boxMin.GetY() - m_gridOrigin.GetY()) / m_gridScale);
+		pOutRange->m_minZ = (int)((boxMin.GetZ() - m_gridOrigin.GetZ()) / m_gridScale);
+		pOutRange->m_maxX = (int)((boxMax.GetX() - m_gridOrigin.GetX()) / m_gridScale);
+		pOutRange->m_maxY = (int)((boxMax.GetY() - m_gridOrigin.GetY()) / m_gridScale);
+		pOutRange->m_maxZ = (int)((boxMax.GetZ() - m_gridOrigin.GetZ()) / m_gridScale);
+
+		// error checking
+		return AreGridIndicesValid(pOutRange->m_minX, pOutRange->m_minY, pOutRange->m_minZ) && AreGridIndicesValid(pOutRange->m_maxX, pOutRange->m_maxY, pOutRange->m_maxZ);
 	}
 
-	bool SpatialGrid::AddSpatialTrianglePassThrough(int x, int y, int z, GraphicalObject * pObj, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance)
+	bool SpatialGrid::DoesTriangleTouchCell(int gridX, int gridY, int gridZ, const Vec3 & p0, const Vec3 & p1, const Vec3 & p2)
 	{
-		SpatialGrid *pInstance = reinterpret_cast<SpatialGrid *>(pClassInstance);
-		return pInstance->AddSpatialTriangle(x, y, z, pObj, p0, p1, p2, index);
+		if (!m_exactTriangleBinning) { return true; }
+
+		// the cell is grown a hair so triangles lying on a shared face still land on both sides of it
+		float halfSize = 0.5f * m_gridScale * 1.001f;
+		Vec3 cellCenter = m_gridOrigin + m_gridScale * Vec3(gridX + 0.5f, gridY + 0.5f, gridZ + 0.5f);
+		return MathUtility::TriangleOverlapsBox(p0, p1, p2, cellCenter, Vec3(halfSize, halfSize, halfSize));
 	}
 
-	bool SpatialGrid::AddSpatialTriangle(int x, int y, int z, GraphicalObject * pObj, const Vec3& p0, const Vec3& p1, const Vec3& p2, int index)
+	void SpatialGrid::GrowCellBounds(ObjectCellBounds * pBounds, const ObjectCellBounds & range)
 	{
-		int arrayIndex = GetArrayIndexFromXYZIndices(x, y, z);
-		SpatialTriangleData newData;
-		newData.p0 = p0;
-		newData.p1 = p1;
-		newData.p2 = p2;
-		newData.m_pTriangleOwner = pObj;
-		newData.m_triangleVertexZeroIndex = index; // pIndices[i] is index of p0
-		int w = m_pGridStartIndices[arrayIndex] + m_pGridTriangleCounts[arrayIndex];
-		m_pData[w] = newData;
-		m_pGridTriangleCounts[arrayIndex]++;
-		return true;
+		if (pBounds->m_maxX < pBounds->m_minX)
+		{
+			pBounds->m_minX = range.m_minX; pBounds->m_minY = range.m_minY; pBounds->m_minZ = range.m_minZ;
+			pBounds->m_maxX = range.m_maxX; pBounds->m_maxY = range.m_maxY; pBounds->m_maxZ = range.m_maxZ;
+			return;
+		}
+
+		if (range.m_minX < pBounds->m_minX) { pBounds->m_minX = range.m_minX; }
+		if (range.m_minY < pBounds->m_minY) { pBounds->m_minY = range.m_minY; }
+		if (range.m_minZ < pBounds->m_minZ) { pBounds->m_minZ = range.m_minZ; }
+		if (range.m_maxX > pBounds->m_maxX) { pBounds->m_maxX = range.m_maxX; }
+		if (range.m_maxY > pBounds->m_maxY) { pBounds->m_maxY = range.m_maxY; }
+		if (range.m_maxZ > pBounds->m_maxZ) { pBounds->m_maxZ = range.m_maxZ; }
 	}
 
-	void SpatialGrid::CleanUp()
+	bool SpatialGrid::GetCellSpan(int arrayIndex, bool addIfMissing, CellSpan * pOutSpan)
 	{
-		if (m_pData) { delete[] m_pData; m_pData = nullptr; }
-		if (m_pGridStartIndices) { delete[] m_pGridStartIndices; m_pGridStartIndices = nullptr; }
-		if (m_pGridTriangleCounts) { delete[] m_pGridTriangleCounts; m_pGridTriangleCounts = nullptr; }
+		if (arrayIndex < 0) { return false; }
+
+		if (m_useSparseCells)
+		{
+			SparseCell *pCell = addIfMissing ? FindOrAddSparseCell(arrayIndex) : FindSparseCell(arrayIndex);
+			if (!pCell) { return false; }
+
+			pOutSpan->pStart = &pCell->m_startIndex;
+			pOutSpan->pCount = &pCell->m_count;
+			pOutSpan->pCapacity = &pCell->m_capacity;
+			return true;
+		}
+
+		if (!m_pGridStartIndices) { return false; }
+		pOutSpan->pStart = &m_pGridStartIndices[arrayIndex];
+		pOutSpan->pCount = &m_pGridTriangleCounts[arrayIndex];
+		pOutSpan->pCapacity = &m_pGridTriangleCapacities[arrayIndex];
+		return true;
 	}
 
-	bool SpatialGrid::DoesFitInGrid(GraphicalObject * pGraphicalObjectToTest)
+	bool SpatialGrid::RemoveObjectTriangles(GraphicalObject * pObj)
 	{
-		// model to world matrix
-		Mat4 modelToWorld = *pGraphicalObjectToTest->GetFullTransformPtr();
+		// objects added since the last calculation were never binned
+		ObjectCellBounds *pBounds = FindObjectBounds(pObj);
+		if (!pBounds) { return true; }
 
-		SpatialCallbackPassData data;
-		data.modelToWorld = modelToWorld;
-		data.callback = nullptr;
-		data.pObj = pGraphicalObjectToTest;
+		for (int x = pBounds->m_minX; x <= pBounds->m_maxX; ++x)
+		{
+			for (int y = pBounds->m_minY; y <= pBounds->m_maxY; ++y)
+			{
+				for (int z = pBounds->m_minZ; z <= pBounds->m_maxZ; ++z)
+				{
+					CellSpan span;
+					if (!GetCellSpan(GetArrayIndexFromXYZIndices(x, y, z), false, &span)) { continue; }
 
-		pGraphicalObjectToTest->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, this, &data);
-		return data.m_success;
+					// fill each hole with the cell's last triangle so the span stays packed
+					int start = *span.pStart;
+					for (int c = 0; c < *span.pCount;)
+					{
+						if (m_pData[start + c].m_pTriangleOwner != pObj) { ++c; continue; }
+
+						int last = start + *span.pCount - 1;
+						if (start + c != last) { WriteTriangle(start + c, m_pData[last], GetOwnerIndexAt(last)); }
+						ClearTriangle(last);
+						(*span.pCount)--;
+					}
+
+					if (*span.pCount == 0) { SetCellOccupied(x, y, z, false); }
+				}
+			}
+		}
+
+		RemoveObjectBounds(pObj);
+		return true;
 	}
 
-	void SpatialGrid::SetGridScale(float newScale)
+	bool SpatialGrid::InsertObjectTriangles(GraphicalObject * pObj)
 	{
-		if (newScale <= 0.0f) { return; }
-		m_gridScale = newScale;
+		// an object being moved keeps its slot, a new one takes the first free one
+		int ownerIndex = FindOwnerIndex(pObj);
+		if (ownerIndex < 0) { ownerIndex = AddOwner(pObj); }
+		if (ownerIndex < 0) { return false; }
+		SetOwner(ownerIndex, pObj);
+
+		SpatialCallbackPassData data;
+		data.modelToWorld = *pObj->GetFullTransformPtr();
+		data.callback = SpatialGrid::InsertSpatialTrianglePassThrough;
+		data.pObj = pObj;
+		data.ownerIndex = ownerIndex;
+
+		pObj->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, this, &data);
+		if (!data.m_success) { GameLogger::Log(MessageType::cError, "Failed to insert GraphicalObject triangles into SpatialGrid!\n"); return false; }
+
+		data.m_bounds.m_pObj = pObj;
+		return SetObjectBounds(data.m_bounds);
+	}
+
+	bool SpatialGrid::InsertSpatialTrianglePassThrough(int x, int y, int z, GraphicalObject * pObj, int ownerIndex, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance)
+	{
+		SpatialGrid *pInstance = reinterpret_cast<SpatialGrid *>(pClassInstance);
+		return pInstance->InsertSpatialTriangle(x, y, z, pObj, ownerIndex, p0, p1, p2, index);
+	}
+
+	bool SpatialGrid::InsertSpatialTriangle(int x, int y, int z, GraphicalObject * pObj, int ownerIndex, const Vec3& p0, const Vec3& p1, const Vec3& p2, int index)
+	{
+		CellSpan span;
+		if (!GetCellSpan(GetArrayIndexFromXYZIndices(x, y, z), true, &span)) { GameLogger::Log(MessageType::cError, "Failed to find cell [%d, %d, %d] to insert triangle into!\n", x, y, z); return false; }
+
+		// a full cell moves to the end of the data with twice the room, so repeated inserts stay cheap
+		if (*span.pCount == *span.pCapacity)
+		{
+			int newCapacity = (*span.pCapacity > 0) ? 2 * (*span.pCapacity) : SpatialTriangleBlock::TRIANGLES_PER_BLOCK;
+			if (!RelocateCell(&span, newCapacity)) { return false; }
+		}
+
+		SpatialTriangleData newData;
+		newData.p0 = p0;
+		newData.p1 = p1;
+		newData.p2 = p2;
+		newData.m_pTriangleOwner = pObj;
+		newData.m_triangleVertexZeroIndex = index;
+
+		WriteTriangle(*span.pStart + *span.pCount, newData, ownerIndex);
+		(*span.pCount)++;
+		SetCellOccupied(x, y, z, true);
+		return true;
+	}
+
+	bool SpatialGrid::RelocateCell(CellSpan * pSpan, int newCapacity)
+	{
+		if (m_dataUsed + newCapacity > m_dataCapacity && !GrowData(m_dataUsed + newCapacity)) { return false; }
+
+		int oldStart = *pSpan->pStart;
+		int newStart = m_dataUsed;
+		for (int c = 0; c < *pSpan->pCount; ++c)
+		{
+			WriteTriangle(newStart + c, m_pData[oldStart + c], GetOwnerIndexAt(oldStart + c));
+			ClearTriangle(oldStart + c);
+		}
+
+		// the old span is dead space until the next full calculation
+		m_wastedSlots += *pSpan->pCapacity;
+		m_dataUsed += newCapacity;
+		*pSpan->pStart = newStart;
+		*pSpan->pCapacity = newCapacity;
+		return true;
+	}
+
+	bool SpatialGrid::GrowData(int minimumCapacity)
+	{
+		int newCapacity = m_dataCapacity + m_dataCapacity / 2;
+		if (newCapacity < minimumCapacity) { newCapacity = minimumCapacity; }
+		newCapacity = RoundUpToBlock(newCapacity);
+
+		SpatialTriangleData *pNewData = new SpatialTriangleData[newCapacity];
+		SpatialTriangleBlock *pNewBlocks = new SpatialTriangleBlock[newCapacity / SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+		if (!pNewData || !pNewBlocks) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] triangles!\n", newCapacity); delete[] pNewData; delete[] pNewBlocks; return false; }
+
+		for (int i = 0; i < m_dataUsed; ++i) { pNewData[i] = m_pData[i]; }
+		if (m_pBlocks)
+		{
+			for (int i = 0; i < m_dataUsed / SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++i) { pNewBlocks[i] = m_pBlocks[i]; }
+		}
+
+		delete[] m_pData;
+		ReleaseBlocks();
+		m_pData = pNewData;
+		m_pBlocks = pNewBlocks;
+		m_dataCapacity = newCapacity;
+		return true;
+	}
+
+	// keeps the block lanes in step with the triangle data
+	void SpatialGrid::WriteTriangle(int dataIndex, const SpatialTriangleData & triangle, int ownerIndex)
+	{
+		m_pData[dataIndex] = triangle;
+		bool doubleSided = !triangle.m_pTriangleOwner->GetMeshPointer()->IsCullingEnabledForObject();
+		m_pBlocks[dataIndex / SpatialTriangleBlock::TRIANGLES_PER_BLOCK].SetLane(dataIndex % SpatialTriangleBlock::TRIANGLES_PER_BLOCK, m_pData[dataIndex], ownerIndex, doubleSided);
+	}
+
+	void SpatialGrid::ClearTriangle(int dataIndex)
+	{
+		m_pData[dataIndex] = SpatialTriangleData();
+		m_pBlocks[dataIndex / SpatialTriangleBlock::TRIANGLES_PER_BLOCK].ClearLane(dataIndex % SpatialTriangleBlock::TRIANGLES_PER_BLOCK);
+	}
+
+	int SpatialGrid::GetOwnerIndexAt(int dataIndex)
+	{
+		return m_pBlocks[dataIndex / SpatialTriangleBlock::TRIANGLES_PER_BLOCK].ownerIndex[dataIndex % SpatialTriangleBlock::TRIANGLES_PER_BLOCK];
+	}
+
+	int SpatialGrid::FindOwnerIndex(GraphicalObject * pObj)
+	{
+		return m_ownerIndices.Find(pObj);
+	}
+
+	// reuses the slot of a removed object when there is one, so the indices already in the blocks never move
+	int SpatialGrid::AddOwner(GraphicalObject * pObj)
+	{
+		int ownerIndex = (m_freeOwnerSlotCount > 0) ? m_pFreeOwnerSlots[--m_freeOwnerSlotCount] : -1;
+		if (ownerIndex < 0)
+		{
+			if (m_ownerCount >= MAX_OWNERS) { GameLogger::Log(MessageType::cError, "Failed to add owner to SpatialGrid! Grid already holds [%d] objects!\n", MAX_OWNERS); return -1; }
+			if (m_ownerCount == m_ownerCapacity && !GrowOwners((m_ownerCapacity > 0) ? 2 * m_ownerCapacity : INITIAL_OBJECT_BOUNDS_CAPACITY)) { return -1; }
+			ownerIndex = m_ownerCount++;
+		}
+
+		SetOwner(ownerIndex, pObj);
+		return ownerIndex;
+	}
+
+	void SpatialGrid::RemoveOwner(GraphicalObject * pObj)
+	{
+		int ownerIndex = FindOwnerIndex(pObj);
+		if (ownerIndex < 0) { return; }
+
+		SetOwner(ownerIndex, nullptr);
+		m_pFreeOwnerSlots[m_freeOwnerSlotCount++] = ownerIndex;
+	}
+
+	bool SpatialGrid::GrowOwners(int minimumCapacity)
+	{
+		if (minimumCapacity <= m_ownerCapacity) { return true; }
+
+		GraphicalObject **pNewOwners = new GraphicalObject*[minimumCapacity];
+		unsigned *pNewBits = new unsigned[(minimumCapacity + 31) / 32];
+		OwnerBounds *pNewBounds = new OwnerBounds[minimumCapacity];
+		int *pNewFreeSlots = new int[minimumCapacity];
+		if (!pNewOwners || !pNewBits || !pNewBounds || !pNewFreeSlots) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] grid owners!\n", minimumCapacity); delete[] pNewOwners; delete[] pNewBits; delete[] pNewBounds; delete[] pNewFreeSlots; return false; }
+
+		for (int i = 0; i < minimumCapacity; ++i) { pNewOwners[i] = (i < m_ownerCount) ? m_pOwners[i] : nullptr; }
+		for (int i = 0; i < (minimumCapacity + 31) / 32; ++i) { pNewBits[i] = (i < (m_ownerCapacity + 31) / 32) ? m_pEnabledOwnerBits[i] : 0u; }
+		for (int i = 0; i < m_ownerCount; ++i) { pNewBounds[i] = m_pOwnerBounds[i]; }
+		for (int i = 0; i < m_freeOwnerSlotCount; ++i) { pNewFreeSlots[i] = m_pFreeOwnerSlots[i]; }
+
+		delete[] m_pOwners;
+		delete[] m_pEnabledOwnerBits;
+		delete[] m_pOwnerBounds;
+		delete[] m_pFreeOwnerSlots;
+		m_pOwners = pNewOwners;
+		m_pEnabledOwnerBits = pNewBits;
+		m_pOwnerBounds = pNewBounds;
+		m_pFreeOwnerSlots = pNewFreeSlots;
+		m_ownerCapacity = minimumCapacity;
+		return true;
+	}
+
+	// everything the queries read about an owner is copied in here, so they never have to touch the object itself until a hit
+	void SpatialGrid::SetOwner(int ownerIndex, GraphicalObject * pObj)
+	{
+		if (m_pOwners[ownerIndex] && m_pOwners[ownerIndex] != pObj) { m_ownerIndices.Remove(m_pOwners[ownerIndex]); }
+		if (pObj) { m_ownerIndices.Set(pObj, ownerIndex); }
+		m_pOwners[ownerIndex] = pObj;
+		SetOwnerEnabledBit(ownerIndex, pObj && pObj->IsEnabled());
+
+		if (pObj) { pObj->GetWorldBounds(&m_pOwnerBounds[ownerIndex].m_min, &m_pOwnerBounds[ownerIndex].m_max); }
+		else { m_pOwnerBounds[ownerIndex] = OwnerBounds(); }
+	}
+
+	void SpatialGrid::SetOwnerEnabledBit(int ownerIndex, bool enabled)
+	{
+		if (enabled) { m_pEnabledOwnerBits[ownerIndex >> 5] |= (1u << (ownerIndex & 31)); }
+		else { m_pEnabledOwnerBits[ownerIndex >> 5] &= ~(1u << (ownerIndex & 31)); }
+	}
+
+	SpatialGrid::ObjectCellBounds * SpatialGrid::FindObjectBounds(GraphicalObject * pObj)
+	{
+		int boundsIndex = m_objectBoundsIndices.Find(pObj);
+		return (boundsIndex >= 0) ? &m_pObjectBounds[boundsIndex] : nullptr;
+	}
+
+	bool SpatialGrid::SetObjectBounds(const ObjectCellBounds & bounds)
+	{
+		ObjectCellBounds *pExisting = FindObjectBounds(bounds.m_pObj);
+		if (pExisting) { *pExisting = bounds; return true; }
+
+		if (m_objectBoundsCount == m_objectBoundsCapacity)
+		{
+			int newCapacity = (m_objectBoundsCapacity > 0) ? 2 * m_objectBoundsCapacity : INITIAL_OBJECT_BOUNDS_CAPACITY;
+			ObjectCellBounds *pNewBounds = new ObjectCellBounds[newCapacity];
+			if (!pNewBounds) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] object cell bounds!\n", newCapacity); return false; }
+
+			for (int i = 0; i < m_objectBoundsCount; ++i) { pNewBounds[i] = m_pObjectBounds[i]; }
+			delete[] m_pObjectBounds;
+			m_pObjectBounds = pNewBounds;
+			m_objectBoundsCapacity = newCapacity;
+		}
+
+		if (!m_objectBoundsIndices.Set(bounds.m_pObj, m_objectBoundsCount)) { return false; }
+		m_pObjectBounds[m_objectBoundsCount++] = bounds;
+		return true;
+	}
+
+	void SpatialGrid::RemoveObjectBounds(GraphicalObject * pObj)
+	{
+		ObjectCellBounds *pBounds = FindObjectBounds(pObj);
+		if (!pBounds) { return; }
+
+		// order does not matter, so the last one fills the hole
+		m_objectBoundsIndices.Remove(pObj);
+		*pBounds = m_pObjectBounds[--m_objectBoundsCount];
+		if (pBounds != &m_pObjectBounds[m_objectBoundsCount]) { m_objectBoundsIndices.Set(pBounds->m_pObj, (int)(pBounds - m_pObjectBounds)); }
+	}
+
+	void SpatialGrid::CleanUp()
+	{
+		if (m_pData) { delete[] m_pData; m_pData = nullptr; }
+		ReleaseBlocks();
+		m_sourceHash = 0;
+		m_dataCapacity = 0;
+		if (m_pGridStartIndices) { delete[] m_pGridStartIndices; m_pGridStartIndices = nullptr; }
+		if (m_pGridTriangleCounts) { delete[] m_pGridTriangleCounts; m_pGridTriangleCounts = nullptr; }
+		if (m_pGridTriangleCapacities) { delete[] m_pGridTriangleCapacities; m_pGridTriangleCapacities = nullptr; }
+		if (m_pObjectBounds) { delete[] m_pObjectBounds; m_pObjectBounds = nullptr; }
+		m_objectBoundsCount = 0;
+		m_objectBoundsIndices.Clear();
+		if (m_pOwners) { delete[] m_pOwners; m_pOwners = nullptr; }
+		if (m_pEnabledOwnerBits) { delete[] m_pEnabledOwnerBits; m_pEnabledOwnerBits = nullptr; }
+		if (m_pOwnerBounds) { delete[] m_pOwnerBounds; m_pOwnerBounds = nullptr; }
+		if (m_pFreeOwnerSlots) { delete[] m_pFreeOwnerSlots; m_pFreeOwnerSlots = nullptr; }
+		m_freeOwnerSlotCount = 0;
+		m_ownerIndices.Clear();
+		m_ownerCount = 0;
+		m_ownerCapacity = 0;
+		m_objectBoundsCapacity = 0;
+		m_dataUsed = 0;
+		m_wastedSlots = 0;
+		if (m_pSparseCells) { delete[] m_pSparseCells; m_pSparseCells = nullptr; }
+		m_sparseCellCapacity = 0;
+		m_occupiedCellCount = 0;
+		if (m_pOccupancy) { delete[] m_pOccupancy; m_pOccupancy = nullptr; }
+		m_occupancyWidth = 0;
+		m_occupancyDepth = 0;
+		m_occupancyHeight = 0;
+	}
+
+	// a fitted grid grows to take in anything outside its cells, so for one of those the only limit is how many cells that would take
+	bool SpatialGrid::DoesFitInGrid(GraphicalObject * pGraphicalObjectToTest)
+	{
+		if (DoesFitInCells(pGraphicalObjectToTest)) { return true; }
+		if (!m_autoFitGrid) { return false; }
+
+		Vec3 boundsMin, boundsMax;
+		pGraphicalObjectToTest->GetWorldBounds(&boundsMin, &boundsMax);
+		if (!(boundsMin.GetX() <= boundsMax.GetX())) { return false; }
+
+		// a cell size left to the fit always has one that stays under the budget
+		if (m_autoFitScale) { return true; }
+
+		// the current cells already cover every other object, so covering them and this one is never smaller than the refit
+		Vec3 gridMax = m_gridOrigin + m_gridScale * Vec3((float)m_gridSectionsWidth, (float)m_gridSectionsDepth, (float)m_gridSectionsHeight);
+		Vec3 fitMin = MathUtility::Min(m_gridOrigin, boundsMin);
+		Vec3 fitMax = MathUtility::Max(gridMax, boundsMax);
+		long long cellCount = 1;
+		for (int a = 0; a < 3; ++a)
+		{
+			float extent = fitMax[a] - fitMin[a];
+			cellCount *= (long long)ceilf(extent * (1.0f + 2.0f * AUTO_FIT_PADDING) / m_gridScale) + 2;
+		}
+
+		return cellCount <= MAX_AUTO_FIT_CELLS;
+	}
+
+	// whether the object's triangles all land in the cells the grid has now
+	bool SpatialGrid::DoesFitInCells(GraphicalObject * pGraphicalObjectToTest)
+	{
+		// every triangle is inside the object's box, so if the box fits they all do
+		Vec3 boundsMin, boundsMax;
+		pGraphicalObjectToTest->GetWorldBounds(&boundsMin, &boundsMax);
+		ObjectCellBounds boxRange;
+		if (boundsMin.GetX() <= boundsMax.GetX() && GetBoxCellRange(boundsMin, boundsMax, &boxRange)) { return true; }
+
+		// the box is looser than the mesh under rotation, so only the triangles can say no
+		// model to world matrix
+		Mat4 modelToWorld = *pGraphicalObjectToTest->GetFullTransformPtr();
+
+		SpatialCallbackPassData data;
+		data.modelToWorld = modelToWorld;
+		data.callback = nullptr;
+		data.pObj = pGraphicalObjectToTest;
+
+		pGraphicalObjectToTest->GetMeshPointer()->WalkTriangles(SpatialGrid::ProcessTrianglesPassThrough, this, &data);
+		return data.m_success;
+	}
+
+	// a scale set by hand is kept, auto fitting then only places and sizes the grid around the objects
+	// zero or less hands the cell size back to FitGridToObjects to pick
+	void SpatialGrid::SetGridScale(float newScale)
+	{
+		if (newScale <= 0.0f) { m_autoFitScale = true; return; }
+		m_gridScale = newScale;
+		m_autoFitScale = false;
+		if (!m_autoFitGrid) { CenterGridOnOrigin(); }
+	}
+
+	Vec3 SpatialGrid::GetGridOrigin()
+	{
+		return m_gridOrigin;
+	}
+
+	// takes effect on the next AddTrianglesToPartitions, off goes back to the fixed grid centered on the world origin
+	void SpatialGrid::SetAutoFit(bool autoFit)
+	{
+		if (autoFit == m_autoFitGrid) { return; }
+
+		m_autoFitGrid = autoFit;
+		if (!autoFit)
+		{
+			CleanUp();
+			m_gridSectionsWidth = DEFAULT_GRID_SECTIONS;
+			m_gridSectionsDepth = DEFAULT_GRID_SECTIONS;
+			m_gridSectionsHeight = DEFAULT_GRID_SECTIONS;
+			m_totalGridSections = m_gridSectionsWidth * m_gridSectionsDepth * m_gridSectionsHeight;
+			CenterGridOnOrigin();
+		}
+	}
+
+	bool SpatialGrid::IsAutoFitting()
+	{
+		return m_autoFitGrid;
+	}
+
+	// places the grid around the objects' world bounds and, unless a scale was set, picks the cell size the cost estimate likes best
+	bool SpatialGrid::FitGridToObjects()
+	{
+		if (!m_autoFitGrid || m_objectList.GetCount() == 0) { return true; }
+
+		FitSample sample;
+		m_objectList.WalkList(SpatialGrid::GrowFitBoundsPassThrough, &sample);
+		if (sample.totalTriangles == 0 || !(sample.boundsMin.GetX() <= sample.boundsMax.GetX())) { return true; }
+
+		Vec3 extent = sample.boundsMax - sample.boundsMin;
+		float largestExtent = MathUtility::Max(MathUtility::Max(extent.GetX(), extent.GetY()), extent.GetZ());
+		if (!(largestExtent > 0.0f)) { largestExtent = m_gridScale; }
+		Vec3 fitMin = sample.boundsMin - Vec3(AUTO_FIT_PADDING * largestExtent);
+		Vec3 fitMax = sample.boundsMax + Vec3(AUTO_FIT_PADDING * largestExtent);
+
+		float cellSize = m_gridScale;
+		float averageCount = 0.0f;
+		if (m_autoFitScale)
+		{
+			sample.capacity = (sample.totalTriangles < AUTO_FIT_SAMPLE_TRIANGLES) ? sample.totalTriangles : AUTO_FIT_SAMPLE_TRIANGLES;
+			sample.stride = (sample.totalTriangles + sample.capacity - 1) / sample.capacity;
+			sample.pMins = new Vec3[sample.capacity];
+			sample.pMaxs = new Vec3[sample.capacity];
+			if (!sample.pMins || !sample.pMaxs) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] sampled triangles!\n", sample.capacity); delete[] sample.pMins; delete[] sample.pMaxs; return false; }
+			m_objectList.WalkList(SpatialGrid::SampleObjectPassThrough, &sample);
+
+			// from one cell across the whole layer down to the smallest size that still fits the cell budget
+			float bestCost = FLT_MAX;
+			for (float candidate = largestExtent + 2.0f * AUTO_FIT_PADDING * largestExtent; ; candidate *= AUTO_FIT_SIZE_STEP)
+			{
+				float candidateAverage;
+				float cost = EstimateCellSizeCost(sample, sample.totalTriangles, candidate, fitMin, fitMax, &candidateAverage);
+				if (cost < 0.0f) { break; }
+				if (cost < bestCost) { bestCost = cost; cellSize = candidate; averageCount = candidateAverage; }
+			}
+
+			delete[] sample.pMins;
+			delete[] sample.pMaxs;
+		}
+
+		// one spare cell on each side as well, so the padding is never lost to rounding
+		int width = (int)ceilf((fitMax.GetX() - fitMin.GetX()) / cellSize) + 2;
+		int depth = (int)ceilf((fitMax.GetY() - fitMin.GetY()) / cellSize) + 2;
+		int height = (int)ceilf((fitMax.GetZ() - fitMin.GetZ()) / cellSize) + 2;
+		if ((long long)width * depth * height > MAX_AUTO_FIT_CELLS)
+		{
+			GameLogger::Log(MessageType::cWarning, "Spatial grid of [%d x %d x %d] cells of size [%.3f] is too big to fit, keeping the old grid!\n", width, depth, height, cellSize);
+			return true;
+		}
+
+		Vec3 origin = fitMin - Vec3(cellSize);
+		if (width == m_gridSectionsWidth && depth == m_gridSectionsDepth && height == m_gridSectionsHeight && cellSize == m_gridScale
+			&& origin.GetX() == m_gridOrigin.GetX() && origin.GetY() == m_gridOrigin.GetY() && origin.GetZ() == m_gridOrigin.GetZ()) { return true; }
+
+		// the old partitions were binned with the old cells
+		if (m_pData) { CleanUp(); }
+		m_gridScale = cellSize;
+		m_gridOrigin = origin;
+		m_gridSectionsWidth = width;
+		m_gridSectionsDepth = depth;
+		m_gridSectionsHeight = height;
+		m_totalGridSections = width * depth * height;
+
+		GameLogger::Log(MessageType::Process, "Fitted spatial grid to [%d] objects: origin (%.3f, %.3f, %.3f), [%d x %d x %d] cells of size [%.3f]%s\n",
+			m_objectList.GetCount(), origin.GetX(), origin.GetY(), origin.GetZ(), width, depth, height, cellSize, m_autoFitScale ? "" : " (scale set by hand)");
+		if (m_autoFitScale) { GameLogger::Log(MessageType::Process, "Estimated [%.3f] triangles per cell for [%d] triangles\n", averageCount, sample.totalTriangles); }
+		return true;
+	}
+
+	bool SpatialGrid::GrowFitBoundsPassThrough(GraphicalObject * pObj, void * pFitSample)
+	{
+		FitSample *pSample = reinterpret_cast<FitSample *>(pFitSample);
+
+		// empty meshes have an inside out box, which min and max leave alone
+		Vec3 boundsMin, boundsMax;
+		pObj->GetWorldBounds(&boundsMin, &boundsMax);
+		pSample->boundsMin = MathUtility::Min(pSample->boundsMin, boundsMin);
+		pSample->boundsMax = MathUtility::Max(pSample->boundsMax, boundsMax);
+		pSample->totalTriangles += (int)pObj->GetMeshPointer()->GetTriangleCount();
+		return true;
+	}
+
+	bool SpatialGrid::SampleObjectPassThrough(GraphicalObject * pObj, void * pFitSample)
+	{
+		FitSample *pSample = reinterpret_cast<FitSample *>(pFitSample);
+		pSample->modelToWorld = *pObj->GetFullTransformPtr();
+		pObj->GetMeshPointer()->WalkTriangles(SpatialGrid::SampleTrianglePassThrough, nullptr, pSample);
+		return pSample->count < pSample->capacity;
+	}
+
+	bool SpatialGrid::SampleTrianglePassThrough(int /*index*/, const void * pVert1, const void * pVert2, const void * pVert3, void * /*pClassInstance*/, void * pPassThroughData)
+	{
+		FitSample *pSample = reinterpret_cast<FitSample *>(pPassThroughData);
+		if (pSample->seen++ % pSample->stride != 0) { return true; }
+
+		Vec3 p0 = pSample->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert1)));
+		Vec3 p1 = pSample->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert2)));
+		Vec3 p2 = pSample->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert3)));
+		pSample->pMins[pSample->count] = MathUtility::Min(MathUtility::Min(p0, p1), p2);
+		pSample->pMaxs[pSample->count] = MathUtility::Max(MathUtility::Max(p0, p1), p2);
+		return ++pSample->count < pSample->capacity;
+	}
+
+	// cells a ray crosses times what each one costs, the step plus the average triangles per cell as CalculateStatisticsFromCounts would report
+	// them, returns less than zero once the cell size is too small for the cell budget
+	float SpatialGrid::EstimateCellSizeCost(const FitSample & sample, int totalTriangles, float cellSize, const Vec3 & fitMin, const Vec3 & fitMax, float * pOutAverage)
+	{
+		long long width = (long long)ceilf((fitMax.GetX() - fitMin.GetX()) / cellSize) + 2;
+		long long depth = (long long)ceilf((fitMax.GetY() - fitMin.GetY()) / cellSize) + 2;
+		long long height = (long long)ceilf((fitMax.GetZ() - fitMin.GetZ()) / cellSize) + 2;
+		long long cellCount = width * depth * height;
+		if (cellCount > MAX_AUTO_FIT_CELLS) { return -1.0f; }
+
+		// binned by bounding box, a little more than exact binning stores but close enough to compare sizes with
+		double binnedCount = 0.0;
+		for (int i = 0; i < sample.count; ++i)
+		{
+			Vec3 spanMin = (sample.pMins[i] - fitMin) / cellSize;
+			Vec3 spanMax = (sample.pMaxs[i] - fitMin) / cellSize;
+			binnedCount += (double)((int)spanMax.GetX() - (int)spanMin.GetX() + 1) * ((int)spanMax.GetY() - (int)spanMin.GetY() + 1) * ((int)spanMax.GetZ() - (int)spanMin.GetZ() + 1);
+		}
+
+		float averageCount = (float)(binnedCount * totalTriangles / (sample.count > 0 ? sample.count : 1) / cellCount);
+		float cellsCrossed = (width + depth + height) / 3.0f;
+		*pOutAverage = averageCount;
+		return cellsCrossed * (AUTO_FIT_CELL_STEP_COST + averageCount);
+	}
+
+	// the fixed grid, with the world origin in the middle of it
+	void SpatialGrid::CenterGridOnOrigin()
+	{
+		m_gridOrigin = -0.5f * m_gridScale * Vec3((float)m_gridSectionsWidth, (float)m_gridSectionsDepth, (float)m_gridSectionsHeight);
 	}
 
 	bool SpatialGrid::ContainsObj(GraphicalObject * pObjToCheck)
 	{
 		return m_objectList.Contains(pObjToCheck);
 	}
+
+	// takes effect on the next AddTrianglesToPartitions
+	void SpatialGrid::SetSparseCells(bool useSparseCells)
+	{
+		if (useSparseCells == m_useSparseCells) { return; }
+
+		// the arrays of the old mode are useless to the new one
+		CleanUp();
+		m_useSparseCells = useSparseCells;
+	}
+
+	bool SpatialGrid::IsUsingSparseCells()
+	{
+		return m_useSparseCells;
+	}
+
+	// takes effect for triangles binned from now on, call AddTrianglesToPartitions to rebin everything
+	void SpatialGrid::SetExactTriangleBinning(bool exactBinning)
+	{
+		m_exactTriangleBinning = exactBinning;
+	}
+
+	bool SpatialGrid::IsUsingExactTriangleBinning()
+	{
+		return m_exactTriangleBinning;
+	}
+
+	void SpatialGrid::ClearPartitions()
+	{
+		CleanUp();
+	}
+
+	LinkedList<GraphicalObject*>* SpatialGrid::GetObjectList()
+	{
+		return &m_objectList;
+	}
+
+	// without a pool (or before it is initialized) builds run on the calling thread
+	void SpatialGrid::SetWorkerPool(WorkerPool * pWorkers)
+	{
+		m_pWorkers = pWorkers;
+	}
+
+	// indexed by the ownerIndex of each block lane
+	GraphicalObject ** SpatialGrid::GetOwners()
+	{
+		return m_pOwners;
+	}
+
+	const SpatialGrid::OwnerBounds * SpatialGrid::GetOwnerBounds()
+	{
+		return m_pOwnerBounds;
+	}
+
+	// bit (i & 31) of word (i >> 5) is set when owner i is enabled
+	const unsigned * SpatialGrid::GetEnabledOwnerBits()
+	{
+		return m_pEnabledOwnerBits;
+	}
+
+	// enabled state lives on each object, this copies it into the bits after objects are enabled or disabled
+	void SpatialGrid::RefreshEnabledOwners()
+	{
+		for (int i = 0; i < m_ownerCount; ++i)
+		{
+			SetOwnerEnabledBit(i, m_pOwners[i] && m_pOwners[i]->IsEnabled());
+		}
+	}
+
+	// multiplicative hash of the dense index, capacity is always a power of two
+	inline int SparseSlotFor(int arrayIndex, int capacity)
+	{
+		return (int)(((unsigned)arrayIndex * 2654435761u) & (unsigned)(capacity - 1));
+	}
+
+	bool SpatialGrid::CalculateFromCache(const char * const cacheFileName)
+	{
+		// nothing worth caching, and an empty build is instant anyway
+		if (m_objectList.GetCount() == 0) { return AddTrianglesToPartitions(); }
+
+		// the hash covers where the grid is, so it has to be placed first
+		if (!FitGridToObjects()) { return false; }
+		unsigned long long sourceHash = CalculateSourceHash();
+
+		// the same objects as the partitions already hold
+		if (m_pData && m_sourceHash == sourceHash) { return true; }
+
+		if (LoadFromCache(cacheFileName, sourceHash)) { return true; }
+
+		if (!AddTrianglesToPartitions()) { return false; }
+		m_sourceHash = sourceHash;
+
+		// failing to write only costs the next startup a rebuild
+		if (!SaveToCache(cacheFileName, sourceHash)) { GameLogger::Log(MessageType::cWarning, "Failed to write spatial grid cache [%s]! Grid will be rebuilt next time!\n", cacheFileName); }
+		return true;
+	}
+
+	// the grid settings and every object's transform, culling and mesh size in list order, cheap enough to check on every load
+	// the vertices themselves are not read, a cache is only kept for a world loaded from the same file every run
+	unsigned long long SpatialGrid::CalculateSourceHash()
+	{
+		int settings[7] = { (int)GRID_CACHE_VERSION, m_gridSectionsWidth, m_gridSectionsDepth, m_gridSectionsHeight, m_useSparseCells ? 1 : 0, m_exactTriangleBinning ? 1 : 0, (int)m_objectList.GetCount() };
+		SourceHash sourceHash;
+		sourceHash.hash = HashWords(FNV_OFFSET_BASIS, settings, sizeof(settings));
+		float origin[3] = { m_gridOrigin.GetX(), m_gridOrigin.GetY(), m_gridOrigin.GetZ() };
+		sourceHash.hash = HashWords(sourceHash.hash, &m_gridScale, sizeof(m_gridScale));
+		sourceHash.hash = HashWords(sourceHash.hash, origin, sizeof(origin));
+		m_objectList.WalkList(SpatialGrid::HashObjectPassThrough, &sourceHash);
+
+		// zero means unknown
+		return sourceHash.hash ? sourceHash.hash : 1;
+	}
+
+	bool SpatialGrid::HashObjectPassThrough(GraphicalObject * pObj, void * pSourceHash)
+	{
+		SourceHash *pSource = reinterpret_cast<SourceHash *>(pSourceHash);
+		Mesh *pMesh = pObj->GetMeshPointer();
+
+		// mesh addresses change every run, the order each mesh first comes up in stands in for which mesh it is
+		int meshOrdinal = pSource->meshOrdinals.Find(pMesh);
+		if (meshOrdinal < 0)
+		{
+			meshOrdinal = pSource->meshOrdinals.GetCount();
+			pSource->meshOrdinals.Set(pMesh, meshOrdinal);
+
+			// the buffers themselves, so an edited model means a rebuild even when its counts stay the same
+			int meshSizes[3] = { (int)pMesh->GetVertexCount(), (int)pMesh->GetIndexCount(), (int)pMesh->GetIndexSize() };
+			pSource->hash = HashWords(pSource->hash, meshSizes, sizeof(meshSizes));
+			if (pMesh->GetVertexPointer()) { pSource->hash = HashWords(pSource->hash, pMesh->GetVertexPointer(), (int)pMesh->GetVertexSizeInBytes()); }
+			if (pMesh->GetIndexPointer()) { pSource->hash = HashWords(pSource->hash, pMesh->GetIndexPointer(), (int)pMesh->GetIndexSizeInBytes()); }
+		}
+
+		int meshInfo[2] = { meshOrdinal, pMesh->IsCullingEnabledForObject() ? 1 : 0 };
+		pSource->hash = HashWords(pSource->hash, pObj->GetFullTransformPtr()->GetAddress(), 16 * sizeof(float));
+		pSource->hash = HashWords(pSource->hash, meshInfo, sizeof(meshInfo));
+		return true;
+	}
+
+	// fnv-1a a word at a time, it only has to notice changes
+	unsigned long long SpatialGrid::HashWords(unsigned long long hash, const void * pData, int byteCount)
+	{
+		const unsigned *pWords = reinterpret_cast<const unsigned *>(pData);
+		for (int i = 0; i < byteCount / (int)sizeof(unsigned); ++i) { hash = (hash ^ pWords[i]) * FNV_PRIME; }
+
+		// 8 and 16 bit index buffers can end partway through a word
+		const unsigned char *pTail = reinterpret_cast<const unsigned char *>(pData) + byteCount / sizeof(unsigned) * sizeof(unsigned);
+		for (int i = 0; i < byteCount % (int)sizeof(unsigned); ++i) { hash = (hash ^ pTail[i]) * FNV_PRIME; }
+		return hash;
+	}
+
+	bool SpatialGrid::CollectObjectPassThrough(GraphicalObject * pObj, void * pObjectArray)
+	{
+		ObjectArray *pArray = reinterpret_cast<ObjectArray *>(pObjectArray);
+		pArray->pObjects[pArray->count++] = pObj;
+		return true;
+	}
+
+	unsigned long long SpatialGrid::WriteCacheSection(std::ofstream & out, const void * pData, unsigned long long byteCount)
+	{
+		static const char padding[GRID_CACHE_SECTION_ALIGNMENT] = { 0 };
+
+		unsigned long long offset = (unsigned long long)out.tellp();
+		unsigned long long alignedOffset = (offset + GRID_CACHE_SECTION_ALIGNMENT - 1) / GRID_CACHE_SECTION_ALIGNMENT * GRID_CACHE_SECTION_ALIGNMENT;
+		out.write(padding, (std::streamsize)(alignedOffset - offset));
+		if (byteCount > 0) { out.write(reinterpret_cast<const char *>(pData), (std::streamsize)byteCount); }
+		return alignedOffset;
+	}
+
+	bool SpatialGrid::SaveToCache(const char * const cacheFileName, unsigned long long sourceHash)
+	{
+		if (!m_pData || !m_pBlocks) { GameLogger::Log(MessageType::cError, "Failed to SaveToCache [%s]! SpatialGrid has not been calculated!\n", cacheFileName); return false; }
+
+		// owners are saved as places in the object list, the hash is what ties a file to the same list
+		ObjectArray objects;
+		objects.pObjects = new GraphicalObject*[m_objectList.GetCount() > 0 ? m_objectList.GetCount() : 1];
+		int *pOwnerPositions = new int[m_ownerCount > 0 ? m_ownerCount : 1];
+		CacheTriangle *pTriangles = new CacheTriangle[m_dataCapacity > 0 ? m_dataCapacity : 1];
+		CacheObjectBounds *pBounds = new CacheObjectBounds[m_objectBoundsCount > 0 ? m_objectBoundsCount : 1];
+		if (!objects.pObjects || !pOwnerPositions || !pTriangles || !pBounds) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory to save grid of [%d] triangles!\n", m_dataCapacity); delete[] objects.pObjects; delete[] pOwnerPositions; delete[] pTriangles; delete[] pBounds; return false; }
+		m_objectList.WalkList(SpatialGrid::CollectObjectPassThrough, &objects);
+
+		for (int i = 0; i < m_ownerCount; ++i) { pOwnerPositions[i] = -1; }
+		for (int j = 0; j < objects.count; ++j)
+		{
+			int ownerIndex = FindOwnerIndex(objects.pObjects[j]);
+			if (ownerIndex >= 0) { pOwnerPositions[ownerIndex] = j; }
+		}
+
+		for (int i = 0; i < m_dataCapacity; ++i)
+		{
+			const SpatialTriangleData& triangle = m_pData[i];
+			for (int c = 0; c < 3; ++c)
+			{
+				pTriangles[i].p0[c] = triangle.p0[c];
+				pTriangles[i].p1[c] = triangle.p1[c];
+				pTriangles[i].p2[c] = triangle.p2[c];
+			}
+			pTriangles[i].vertexIndex = triangle.m_triangleVertexZeroIndex;
+			pTriangles[i].ownerIndex = triangle.m_pTriangleOwner ? GetOwnerIndexAt(i) : -1;
+		}
+
+		for (int i = 0; i < m_objectBoundsCount; ++i)
+		{
+			const ObjectCellBounds& bounds = m_pObjectBounds[i];
+			pBounds[i].ownerIndex = FindOwnerIndex(bounds.m_pObj);
+			pBounds[i].minX = bounds.m_minX; pBounds[i].minY = bounds.m_minY; pBounds[i].minZ = bounds.m_minZ;
+			pBounds[i].maxX = bounds.m_maxX; pBounds[i].maxY = bounds.m_maxY; pBounds[i].maxZ = bounds.m_maxZ;
+		}
+
+		CacheHeader header{};
+		header.magic = GRID_CACHE_MAGIC;
+		header.version = GRID_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.blockSize = (int)sizeof(SpatialTriangleBlock);
+		header.triangleSize = (int)sizeof(CacheTriangle);
+		header.sparseCellSize = (int)sizeof(SparseCell);
+		header.width = m_gridSectionsWidth;
+		header.depth = m_gridSectionsDepth;
+		header.height = m_gridSectionsHeight;
+		header.scale = m_gridScale;
+		header.origin[0] = m_gridOrigin.GetX();
+		header.origin[1] = m_gridOrigin.GetY();
+		header.origin[2] = m_gridOrigin.GetZ();
+		header.useSparseCells = m_useSparseCells ? 1 : 0;
+		header.exactTriangleBinning = m_exactTriangleBinning ? 1 : 0;
+		header.ownerCount = m_ownerCount;
+		header.objectBoundsCount = m_objectBoundsCount;
+		header.dataCapacity = m_dataCapacity;
+		header.dataUsed = m_dataUsed;
+		header.wastedSlots = m_wastedSlots;
+		header.sparseCellCapacity = m_sparseCellCapacity;
+		header.occupiedCellCount = m_occupiedCellCount;
+
+		std::ofstream outFile(cacheFileName, std::ios::binary | std::ios::out | std::ios::trunc);
+		bool success = outFile.good();
+		if (success)
+		{
+			// zeroes hold the header's place until everything else is down
+			CacheHeader blankHeader{};
+			outFile.write(reinterpret_cast<const char *>(&blankHeader), sizeof(blankHeader));
+
+			header.ownersOffset = WriteCacheSection(outFile, pOwnerPositions, (unsigned long long)m_ownerCount * sizeof(int));
+			header.boundsOffset = WriteCacheSection(outFile, pBounds, (unsigned long long)m_objectBoundsCount * sizeof(CacheObjectBounds));
+			if (m_useSparseCells)
+			{
+				header.cellsOffset = WriteCacheSection(outFile, m_pSparseCells, (unsigned long long)m_sparseCellCapacity * sizeof(SparseCell));
+			}
+			else
+			{
+				// starts, counts and capacities back to back
+				header.cellsOffset = WriteCacheSection(outFile, m_pGridStartIndices, (unsigned long long)m_totalGridSections * sizeof(int));
+				outFile.write(reinterpret_cast<const char *>(m_pGridTriangleCounts), (std::streamsize)m_totalGridSections * sizeof(int));
+				outFile.write(reinterpret_cast<const char *>(m_pGridTriangleCapacities), (std::streamsize)m_totalGridSections * sizeof(int));
+			}
+			header.trianglesOffset = WriteCacheSection(outFile, pTriangles, (unsigned long long)m_dataCapacity * sizeof(CacheTriangle));
+			header.blocksOffset = WriteCacheSection(outFile, m_pBlocks, (unsigned long long)(m_dataCapacity / SpatialTriangleBlock::TRIANGLES_PER_BLOCK) * sizeof(SpatialTriangleBlock));
+			header.fileSize = (unsigned long long)outFile.tellp();
+
+			outFile.seekp(0);
+			outFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			success = outFile.good();
+			outFile.close();
+		}
+
+		delete[] objects.pObjects;
+		delete[] pOwnerPositions;
+		delete[] pTriangles;
+		delete[] pBounds;
+
+		if (!success) { GameLogger::Log(MessageType::cWarning, "Failed to write spatial grid cache file [%s]!\n", cacheFileName); return false; }
+		GameLogger::Log(MessageType::Process, "Wrote spatial grid cache [%s] of [%d] triangle slots!\n", cacheFileName, m_dataCapacity);
+		return true;
+	}
+
+	bool SpatialGrid::IsCacheHeaderValid(const CacheHeader & header, unsigned long long sourceHash, const char * const cacheFileName)
+	{
+		if (header.magic != GRID_CACHE_MAGIC || header.version != GRID_CACHE_VERSION || header.blockSize != (int)sizeof(SpatialTriangleBlock) || header.triangleSize != (int)sizeof(CacheTriangle) || header.sparseCellSize != (int)sizeof(SparseCell))
+		{
+			GameLogger::Log(MessageType::Process, "Spatial grid cache [%s] is from another version, rebuilding!\n", cacheFileName);
+			return false;
+		}
+
+		if (header.sourceHash != sourceHash)
+		{
+			GameLogger::Log(MessageType::Process, "Spatial grid cache [%s] is out of date, rebuilding!\n", cacheFileName);
+			return false;
+		}
+
+		// the hash covers these too, a mismatch here means the file was damaged
+		bool settingsMatch = header.width == m_gridSectionsWidth && header.depth == m_gridSectionsDepth && header.height == m_gridSectionsHeight && header.scale == m_gridScale
+			&& header.origin[0] == m_gridOrigin.GetX() && header.origin[1] == m_gridOrigin.GetY() && header.origin[2] == m_gridOrigin.GetZ()
+			&& header.useSparseCells == (m_useSparseCells ? 1 : 0) && header.exactTriangleBinning == (m_exactTriangleBinning ? 1 : 0);
+		bool countsValid = header.ownerCount >= 0 && header.ownerCount <= MAX_OWNERS && header.objectBoundsCount >= 0 && header.dataCapacity >= 0
+			&& header.dataCapacity % SpatialTriangleBlock::TRIANGLES_PER_BLOCK == 0 && header.dataUsed >= 0 && header.dataUsed <= header.dataCapacity
+			&& header.wastedSlots >= 0 && header.occupiedCellCount >= 0;
+
+		// probes wrap with a mask and stop at an empty slot, so the table has to be a power of two with room to spare or a lookup never ends
+		bool sparseValid = !m_useSparseCells || (header.sparseCellCapacity > 0 && (header.sparseCellCapacity & (header.sparseCellCapacity - 1)) == 0 && header.occupiedCellCount < header.sparseCellCapacity);
+
+		unsigned long long cellBytes = m_useSparseCells ? (unsigned long long)header.sparseCellCapacity * sizeof(SparseCell) : 3ULL * m_totalGridSections * sizeof(int);
+		unsigned long long blockBytes = (unsigned long long)(header.dataCapacity / SpatialTriangleBlock::TRIANGLES_PER_BLOCK) * sizeof(SpatialTriangleBlock);
+		bool sectionsValid = header.fileSize == (unsigned long long)m_cacheFile.GetSize()
+			&& header.ownersOffset + (unsigned long long)header.ownerCount * sizeof(int) <= header.fileSize
+			&& header.boundsOffset + (unsigned long long)header.objectBoundsCount * sizeof(CacheObjectBounds) <= header.fileSize
+			&& header.cellsOffset + cellBytes <= header.fileSize
+			&& header.trianglesOffset + (unsigned long long)header.dataCapacity * sizeof(CacheTriangle) <= header.fileSize
+			&& header.blocksOffset + blockBytes <= header.fileSize
+			&& header.ownersOffset % GRID_CACHE_SECTION_ALIGNMENT == 0 && header.boundsOffset % GRID_CACHE_SECTION_ALIGNMENT == 0 && header.cellsOffset % GRID_CACHE_SECTION_ALIGNMENT == 0
+			&& header.trianglesOffset % GRID_CACHE_SECTION_ALIGNMENT == 0 && header.blocksOffset % GRID_CACHE_SECTION_ALIGNMENT == 0;
+
+		if (!settingsMatch || !countsValid || !sparseValid || !sectionsValid)
+		{
+			GameLogger::Log(MessageType::cWarning, "Spatial grid cache [%s] is damaged, rebuilding!\n", cacheFileName);
+			return false;
+		}
+
+		return true;
+	}
+
+	// the blocks stay in the mapped file, everything small or holding pointers is copied out
+	bool SpatialGrid::LoadFromCache(const char * const cacheFileName, unsigned long long sourceHash)
+	{
+		// allow method to be called repeatedly
+		if (!m_firstCalculation) { CleanUp(); }
+		else { m_firstCalculation = false; }
+
+		// no file is the normal first run
+		if (!m_cacheFile.Open(cacheFileName)) { GameLogger::Log(MessageType::Process, "No spatial grid cache [%s] yet, building!\n", cacheFileName); return false; }
+
+		const char *pFile = reinterpret_cast<const char *>(m_cacheFile.GetData());
+		CacheHeader header{};
+		if (m_cacheFile.GetSize() >= sizeof(header)) { memcpy(&header, pFile, sizeof(header)); }
+		if (!IsCacheHeaderValid(header, sourceHash, cacheFileName)) { m_cacheFile.Close(); return false; }
+
+		ObjectArray objects;
+		objects.pObjects = new GraphicalObject*[m_objectList.GetCount() > 0 ? m_objectList.GetCount() : 1];
+		if (!objects.pObjects) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] objects!\n", m_objectList.GetCount()); m_cacheFile.Close(); return false; }
+		m_objectList.WalkList(SpatialGrid::CollectObjectPassThrough, &objects);
+
+		bool success = GrowOwners(header.ownerCount);
+		const int *pOwnerPositions = reinterpret_cast<const int *>(pFile + header.ownersOffset);
+		for (int i = 0; success && i < header.ownerCount; ++i)
+		{
+			if (pOwnerPositions[i] >= objects.count) { success = false; break; }
+			SetOwner(i, (pOwnerPositions[i] >= 0) ? objects.pObjects[pOwnerPositions[i]] : nullptr);
+			if (pOwnerPositions[i] < 0) { m_pFreeOwnerSlots[m_freeOwnerSlotCount++] = i; }
+		}
+		m_ownerCount = success ? header.ownerCount : 0;
+		delete[] objects.pObjects;
+
+		if (success && m_useSparseCells)
+		{
+			m_pSparseCells = new SparseCell[header.sparseCellCapacity];
+			success = m_pSparseCells != nullptr;
+			if (success)
+			{
+				memcpy(m_pSparseCells, pFile + header.cellsOffset, header.sparseCellCapacity * sizeof(SparseCell));
+				m_sparseCellCapacity = header.sparseCellCapacity;
+				m_occupiedCellCount = header.occupiedCellCount;
+			}
+
+			int keyedCells = 0;
+			for (int i = 0; success && i < m_sparseCellCapacity; ++i)
+			{
+				const SparseCell& cell = m_pSparseCells[i];
+				if (cell.m_key >= m_totalGridSections || (cell.m_key >= 0 && (cell.m_startIndex < 0 || cell.m_count < 0 || cell.m_count > cell.m_capacity || cell.m_startIndex + cell.m_capacity > header.dataCapacity))) { success = false; }
+				if (cell.m_key >= 0) { keyedCells++; }
+			}
+
+			// the header's count is what keeps an empty slot in the table, it has to be the real one
+			if (keyedCells != m_occupiedCellCount) { success = false; }
+		}
+		else if (success)
+		{
+			m_pGridStartIndices = new int[m_totalGridSections];
+			m_pGridTriangleCounts = new int[m_totalGridSections];
+			m_pGridTriangleCapacities = new int[m_totalGridSections];
+			success = m_pGridStartIndices && m_pGridTriangleCounts && m_pGridTriangleCapacities;
+			if (success)
+			{
+				const int *pCells = reinterpret_cast<const int *>(pFile + header.cellsOffset);
+				memcpy(m_pGridStartIndices, pCells, m_totalGridSections * sizeof(int));
+				memcpy(m_pGridTriangleCounts, pCells + m_totalGridSections, m_totalGridSections * sizeof(int));
+				memcpy(m_pGridTriangleCapacities, pCells + 2 * m_totalGridSections, m_totalGridSections * sizeof(int));
+			}
+
+			for (int i = 0; success && i < m_totalGridSections; ++i)
+			{
+				if (m_pGridStartIndices[i] < 0 || m_pGridTriangleCounts[i] < 0 || m_pGridTriangleCounts[i] > m_pGridTriangleCapacities[i] || m_pGridStartIndices[i] + m_pGridTriangleCapacities[i] > header.dataCapacity) { success = false; }
+			}
+		}
+
+		if (success)
+		{
+			m_pData = new SpatialTriangleData[header.dataCapacity > 0 ? header.dataCapacity : 1];
+			success = m_pData != nullptr;
+			const CacheTriangle *pTriangles = reinterpret_cast<const CacheTriangle *>(pFile + header.trianglesOffset);
+			for (int i = 0; success && i < header.dataCapacity; ++i)
+			{
+				if (!IsCachedTriangleValid(pTriangles[i].ownerIndex, pTriangles[i].vertexIndex)) { success = false; break; }
+				if (pTriangles[i].ownerIndex < 0) { continue; }
+
+				m_pData[i].p0 = Vec3(pTriangles[i].p0[0], pTriangles[i].p0[1], pTriangles[i].p0[2]);
+				m_pData[i].p1 = Vec3(pTriangles[i].p1[0], pTriangles[i].p1[1], pTriangles[i].p1[2]);
+				m_pData[i].p2 = Vec3(pTriangles[i].p2[0], pTriangles[i].p2[1], pTriangles[i].p2[2]);
+				m_pData[i].m_pTriangleOwner = m_pOwners[pTriangles[i].ownerIndex];
+				m_pData[i].m_triangleVertexZeroIndex = pTriangles[i].vertexIndex;
+			}
+		}
+
+		if (success)
+		{
+			m_objectBoundsCapacity = (header.objectBoundsCount > 0) ? header.objectBoundsCount : INITIAL_OBJECT_BOUNDS_CAPACITY;
+			m_pObjectBounds = new ObjectCellBounds[m_objectBoundsCapacity];
+			success = m_pObjectBounds != nullptr;
+			const CacheObjectBounds *pBounds = reinterpret_cast<const CacheObjectBounds *>(pFile + header.boundsOffset);
+			for (int i = 0; success && i < header.objectBoundsCount; ++i)
+			{
+				if (pBounds[i].ownerIndex < 0 || pBounds[i].ownerIndex >= header.ownerCount || !m_pOwners[pBounds[i].ownerIndex]) { continue; }
+
+				if (!m_objectBoundsIndices.Set(m_pOwners[pBounds[i].ownerIndex], m_objectBoundsCount)) { success = false; break; }
+				ObjectCellBounds& bounds = m_pObjectBounds[m_objectBoundsCount++];
+				bounds.m_pObj = m_pOwners[pBounds[i].ownerIndex];
+				bounds.m_minX = pBounds[i].minX; bounds.m_minY = pBounds[i].minY; bounds.m_minZ = pBounds[i].minZ;
+				bounds.m_maxX = pBounds[i].maxX; bounds.m_maxY = pBounds[i].maxY; bounds.m_maxZ = pBounds[i].maxZ;
+			}
+		}
+
+		// the blocks stay mapped, but their lanes are read as owner table indices and vertex indices just the same
+		const SpatialTriangleBlock *pBlocks = reinterpret_cast<const SpatialTriangleBlock *>(pFile + header.blocksOffset);
+		for (int b = 0; success && b < header.dataCapacity / SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++b)
+		{
+			for (int lane = 0; lane < SpatialTriangleBlock::TRIANGLES_PER_BLOCK; ++lane)
+			{
+				if (!IsCachedTriangleValid(pBlocks[b].ownerIndex[lane], pBlocks[b].vertexIndex[lane])) { success = false; break; }
+			}
+		}
+
+		if (success && !BuildOccupancy())
+		{
+			CleanUp();
+			m_cacheFile.Close();
+			return false;
+		}
+
+		if (!success)
+		{
+			GameLogger::Log(MessageType::cWarning, "Spatial grid cache [%s] is damaged, rebuilding!\n", cacheFileName);
+			CleanUp();
+			m_cacheFile.Close();
+			return false;
+		}
+
+		m_pBlocks = reinterpret_cast<SpatialTriangleBlock *>(const_cast<char *>(pFile) + header.blocksOffset);
+		m_blocksMapped = true;
+		m_dataCapacity = header.dataCapacity;
+		m_dataUsed = header.dataUsed;
+		m_wastedSlots = header.wastedSlots;
+		m_sourceHash = sourceHash;
+
+		CalculateStatisticsFromCounts();
+
+		GameLogger::Log(MessageType::Process, "Successfully loaded spatial grid from cache [%s]!\n", cacheFileName);
+		return true;
+	}
+
+	// -1 is an empty slot, anything else has to name an owner that is still here and a vertex its mesh has
+	bool SpatialGrid::IsCachedTriangleValid(int ownerIndex, int vertexIndex)
+	{
+		if (ownerIndex == -1) { return true; }
+		if (ownerIndex < 0 || ownerIndex >= m_ownerCount || !m_pOwners[ownerIndex]) { return false; }
+
+		Mesh *pMesh = m_pOwners[ownerIndex]->GetMeshPointer();
+		return pMesh && vertexIndex >= 0 && vertexIndex < (int)pMesh->GetVertexCount();
+	}
+
+	// blocks loaded from a cache belong to the mapping rather than the heap
+	void SpatialGrid::ReleaseBlocks()
+	{
+		if (m_blocksMapped) { m_cacheFile.Close(); m_blocksMapped = false; }
+		else { delete[] m_pBlocks; }
+		m_pBlocks = nullptr;
+	}
+
+	SpatialGrid::SparseCell * SpatialGrid::FindSparseCell(int arrayIndex)
+	{
+		if (!m_pSparseCells || arrayIndex < 0) { return nullptr; }
+
+		// linear probe until the key or an empty slot is found, the table is never full
+		for (int slot = SparseSlotFor(arrayIndex, m_sparseCellCapacity); ; slot = (slot + 1) & (m_sparseCellCapacity - 1))
+		{
+			if (m_pSparseCells[slot].m_key == arrayIndex) { return &m_pSparseCells[slot]; }
+			if (m_pSparseCells[slot].m_key < 0) { return nullptr; }
+		}
+	}
+
+	SpatialGrid::SparseCell * SpatialGrid::FindOrAddSparseCell(int arrayIndex)
+	{
+		if (!m_pSparseCells || arrayIndex < 0) { return nullptr; }
+
+		// keep the load factor at or below one half so probes stay short
+		if ((m_occupiedCellCount + 1) * 2 > m_sparseCellCapacity && !GrowSparseCells()) { return nullptr; }
+
+		for (int slot = SparseSlotFor(arrayIndex, m_sparseCellCapacity); ; slot = (slot + 1) & (m_sparseCellCapacity - 1))
+		{
+			if (m_pSparseCells[slot].m_key == arrayIndex) { return &m_pSparseCells[slot]; }
+			if (m_pSparseCells[slot].m_key < 0)
+			{
+				m_pSparseCells[slot].m_key = arrayIndex;
+				m_occupiedCellCount++;
+				return &m_pSparseCells[slot];
+			}
+		}
+	}
+
+	bool SpatialGrid::GrowSparseCells()
+	{
+		int oldCapacity = m_sparseCellCapacity;
+		SparseCell *pOldCells = m_pSparseCells;
+
+		m_sparseCellCapacity = oldCapacity * 2;
+		m_pSparseCells = new SparseCell[m_sparseCellCapacity];
+		if (!m_pSparseCells) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] sparse cells!\n", m_sparseCellCapacity); m_pSparseCells = pOldCells; m_sparseCellCapacity = oldCapacity; return false; }
+
+		// re-insert every occupied cell with its data into the bigger table
+		for (int i = 0; i < oldCapacity; ++i)
+		{
+			if (pOldCells[i].m_key < 0) { continue; }
+
+			int slot = SparseSlotFor(pOldCells[i].m_key, m_sparseCellCapacity);
+			while (m_pSparseCells[slot].m_key >= 0) { slot = (slot + 1) & (m_sparseCellCapacity - 1); }
+			m_pSparseCells[slot] = pOldCells[i];
+		}
+
+		delete[] pOldCells;
+		return true;
+	}
+
+	unsigned long long SpatialGrid::GetOccupancyMask(int brickX, int brickY, int brickZ)
+	{
+		if (!m_pOccupancy) { return 0; }
+		if (brickX < 0 || brickX >= m_occupancyWidth || brickY < 0 || brickY >= m_occupancyDepth || brickZ < 0 || brickZ >= m_occupancyHeight) { return 0; }
+		return m_pOccupancy[(brickZ * m_occupancyDepth + brickY) * m_occupancyWidth + brickX];
+	}
+
+	// the cell's bit within its brick's mask, x varies fastest the same as the cell arrays
+	unsigned long long SpatialGrid::GetOccupancyBit(int gridX, int gridY, int gridZ)
+	{
+		const int cellMask = OCCUPANCY_BRICK_SIZE - 1;
+		int bit = (gridX & cellMask) | ((gridY & cellMask) << OCCUPANCY_BRICK_SHIFT) | ((gridZ & cellMask) << (2 * OCCUPANCY_BRICK_SHIFT));
+		return 1ull << bit;
+	}
+
+	// marks every cell holding triangles, after a build or a load
+	bool SpatialGrid::BuildOccupancy()
+	{
+		if (m_pOccupancy) { delete[] m_pOccupancy; m_pOccupancy = nullptr; }
+
+		m_occupancyWidth = (m_gridSectionsWidth + OCCUPANCY_BRICK_SIZE - 1) >> OCCUPANCY_BRICK_SHIFT;
+		m_occupancyDepth = (m_gridSectionsDepth + OCCUPANCY_BRICK_SIZE - 1) >> OCCUPANCY_BRICK_SHIFT;
+		m_occupancyHeight = (m_gridSectionsHeight + OCCUPANCY_BRICK_SIZE - 1) >> OCCUPANCY_BRICK_SHIFT;
+		int brickCount = m_occupancyWidth * m_occupancyDepth * m_occupancyHeight;
+		m_pOccupancy = new unsigned long long[brickCount];
+		if (!m_pOccupancy) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for [%d] occupancy bricks!\n", brickCount); return false; }
+		memset(m_pOccupancy, 0, brickCount * sizeof(unsigned long long));
+
+		int cellsPerLayer = m_gridSectionsWidth * m_gridSectionsDepth;
+		if (m_useSparseCells)
+		{
+			for (int i = 0; i < m_sparseCellCapacity; ++i)
+			{
+				const SparseCell& cell = m_pSparseCells[i];
+				if (cell.m_key < 0 || cell.m_count == 0) { continue; }
+
+				int z = cell.m_key / cellsPerLayer;
+				int y = (cell.m_key % cellsPerLayer) / m_gridSectionsWidth;
+				SetCellOccupied(cell.m_key % m_gridSectionsWidth, y, z, true);
+			}
+
+			return true;
+		}
+
+		if (!m_pGridTriangleCounts) { return true; }
+		for (int i = 0; i < m_totalGridSections; ++i)
+		{
+			if (m_pGridTriangleCounts[i] == 0) { continue; }
+
+			int z = i / cellsPerLayer;
+			int y = (i % cellsPerLayer) / m_gridSectionsWidth;
+			SetCellOccupied(i % m_gridSectionsWidth, y, z, true);
+		}
+
+		return true;
+	}
+
+	void SpatialGrid::SetCellOccupied(int gridX, int gridY, int gridZ, bool occupied)
+	{
+		if (!m_pOccupancy) { return; }
+
+		unsigned long long& mask = m_pOccupancy[((gridZ >> OCCUPANCY_BRICK_SHIFT) * m_occupancyDepth + (gridY >> OCCUPANCY_BRICK_SHIFT)) * m_occupancyWidth + (gridX >> OCCUPANCY_BRICK_SHIFT)];
+		if (occupied) { mask |= GetOccupancyBit(gridX, gridY, gridZ); }
+		else { mask &= ~GetOccupancyBit(gridX, gridY, gridZ); }
+	}
 }
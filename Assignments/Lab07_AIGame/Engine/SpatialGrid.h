@@ -7,13 +7,20 @@
 // Holds an array of linked lists of SpatialTriangleData used for spatial partitioning
 
 #include "SpatialTriangleData.h"
+#include "SpatialTriangleBlock.h"
 #include "ExportHeader.h"
 #include "LinkedList.h"
 #include "InstanceBuffer.h"
 #include "GraphicalObject.h"
+#include "MappedFile.h"
+#include "ObjectIndexMap.h"
+#include <iosfwd>
+#include <cfloat>
 
 namespace Engine
 {
+	class WorkerPool;
+
 	class ENGINE_SHARED SpatialGrid
 	{
 	public:
@@ -24,6 +31,8 @@ namespace Engine
 		void DrawDebugShapes(const Vec3& centerPos);
 		SpatialTriangleData *GetTriangleDataByGrid(int gridX, int gridY, int gridZ);
 		SpatialTriangleData *GetTriangleDataByGridAtPosition(float worldX, float worldY, float worldZ);
+		SpatialTriangleBlock *GetTriangleBlocksByGrid(int gridX, int gridY, int gridZ);
+		SpatialTriangleBlock *GetTriangleBlocksByGrid(int gridX, int gridY, int gridZ, int *pOutTriangleCount);
 		bool AddGraphicalObject(GraphicalObject *pGraphicalObjectToAdd);
 		int GetGridIndexFromXPos(float xPos);
 		int GetGridIndexFromYPos(float yPos);
@@ -32,6 +41,7 @@ namespace Engine
 		float GetGridScale();
 		void CalculateStatisticsFromCounts();
 		void RemoveGraphicalObject(GraphicalObject *pGobToRemove);
+		bool UpdateGraphicalObject(GraphicalObject *pGobToUpdate);
 		int GetGridWidth();
 		int GetGridHeight();
 		int GetGridDepth();
@@ -43,42 +53,253 @@ namespace Engine
 		static bool DisableObject(GraphicalObject *pGob, void *pInstance);
 		bool DoesFitInGrid(GraphicalObject *pGraphicalObjectToTest);
 		void SetGridScale(float newScale);
+		Vec3 GetGridOrigin();
+		void SetAutoFit(bool autoFit);
+		bool IsAutoFitting();
+		bool FitGridToObjects();
 		bool ContainsObj(GraphicalObject *pObjToCheck);
+		void SetSparseCells(bool useSparseCells);
+		bool IsUsingSparseCells();
+		void SetExactTriangleBinning(bool exactBinning);
+		bool IsUsingExactTriangleBinning();
+		void ClearPartitions();
+		LinkedList<GraphicalObject*> *GetObjectList();
+		void SetWorkerPool(WorkerPool *pWorkers);
+		GraphicalObject **GetOwners();
+
+		// world space box around an owner's mesh, inside out for empty slots so nothing can hit it
+		struct OwnerBounds
+		{
+			Vec3 m_min{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vec3 m_max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		};
+		const OwnerBounds *GetOwnerBounds();
+		const unsigned *GetEnabledOwnerBits();
+		void RefreshEnabledOwners();
+
+		// loads the partitions from a cache file written by an earlier run when it was built from the same objects, otherwise rebuilds and rewrites it
+		bool CalculateFromCache(const char *const cacheFileName);
+		unsigned long long CalculateSourceHash();
+		bool SaveToCache(const char *const cacheFileName, unsigned long long sourceHash);
+		bool LoadFromCache(const char *const cacheFileName, unsigned long long sourceHash);
+
+		// cells are grouped into bricks of 4x4x4 with one bit per cell for whether it holds any triangles, so a walk can step over an empty brick at once
+		static const int OCCUPANCY_BRICK_SHIFT = 2;
+		static const int OCCUPANCY_BRICK_SIZE = 1 << OCCUPANCY_BRICK_SHIFT;
+		unsigned long long GetOccupancyMask(int brickX, int brickY, int brickZ);
+		static unsigned long long GetOccupancyBit(int gridX, int gridY, int gridZ);
+
+		// owner indices are kept below this so a query can pack one into a key with room to spare
+		static const int MAX_OWNERS = 1 << 24;
 
 		// TODO: Move!??!?!?!
 
 	private:
-		typedef bool(*TriangleProcessingCallback)(int x, int y, int z, GraphicalObject *pObj, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance);
+		typedef bool(*TriangleProcessingCallback)(int x, int y, int z, GraphicalObject *pObj, int ownerIndex, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance);
+
+		// an occupied cell in sparse mode, stored in an open addressed hash table keyed by the dense cell index
+		struct SparseCell
+		{
+			int m_key{ -1 };
+			int m_startIndex{ 0 };
+			int m_count{ 0 };
+			int m_capacity{ 0 };
+		};
+
+		// where one cell's triangles live in m_pData, points into either the sparse table or the dense arrays
+		struct CellSpan
+		{
+			int *pStart{ nullptr };
+			int *pCount{ nullptr };
+			int *pCapacity{ nullptr };
+		};
+
+		// the range of cells an object's triangles were binned into, so it can be pulled back out without a rebuild
+		struct ObjectCellBounds
+		{
+			GraphicalObject *m_pObj{ nullptr };
+			int m_minX{ 0 }, m_minY{ 0 }, m_minZ{ 0 };
+			int m_maxX{ -1 }, m_maxY{ -1 }, m_maxZ{ -1 };
+		};
 
 		struct SpatialCallbackPassData
 		{
 			Mat4 modelToWorld;
 			TriangleProcessingCallback callback;
 			GraphicalObject *pObj;
+			int ownerIndex{ -1 };
 			bool m_success{ true };
+			ObjectCellBounds m_bounds;
+			int m_triangleCount{ 0 };
+			int m_boundingBoxCellCount{ 0 };
+		};
+
+		// an object and where its triangles start in the world space triangle cache of a build
+		struct BuildObject
+		{
+			GraphicalObject *pObj{ nullptr };
+			Mat4 modelToWorld;
+			int firstTriangle{ 0 };
+			int triangleCount{ 0 };
+			ObjectCellBounds bounds;
 		};
 
-		static bool AddGraphicalObjectToGridPassThrough(GraphicalObject *pGraphicalObjectToAdd, void *pClassInstance);
-		bool AddGraphicalObjectToGrid(GraphicalObject *pGraphicalObjectToAdd);
+		// a range of one object's triangles handed to one worker during a build
+		struct BuildJob
+		{
+			int objectIndex{ 0 };
+			int firstTriangle{ 0 };
+			int triangleCount{ 0 };
+			ObjectCellBounds bounds;
+			bool success{ true };
+
+			// sparse builds only, how many (cell, triangle) pairs the job's triangles make and where they go in the pair array
+			int pairCount{ 0 };
+			int firstPair{ 0 };
+		};
+
+		struct WorldTriangleStore
+		{
+			Mat4 modelToWorld;
+			GraphicalObject *pObj;
+			SpatialTriangleData *pNext;
+		};
+
+		// scratch shared by every job of one AddTrianglesToPartitions, defined in the cpp so the atomics stay out of the header
+		struct BuildData;
+
+		// the layout of a cache file, defined in the cpp next to the code that reads and writes it
+		struct CacheHeader;
+		struct CacheTriangle;
+		struct CacheObjectBounds;
+		struct ObjectArray;
+		struct SourceHash;
+
+		// a strided sample of the triangles' world space boxes, enough to estimate how a cell size would bin the whole layer
+		struct FitSample
+		{
+			Vec3 *pMins{ nullptr };
+			Vec3 *pMaxs{ nullptr };
+			int count{ 0 };
+			int capacity{ 0 };
+			int stride{ 1 };
+			int seen{ 0 };
+			int totalTriangles{ 0 };
+			Mat4 modelToWorld;
+			Vec3 boundsMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vec3 boundsMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		};
+
+		static bool GrowFitBoundsPassThrough(GraphicalObject *pObj, void *pFitSample);
+		static bool SampleObjectPassThrough(GraphicalObject *pObj, void *pFitSample);
+		static bool SampleTrianglePassThrough(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pClassInstance, void *pPassThroughData);
+		static float EstimateCellSizeCost(const FitSample& sample, int totalTriangles, float cellSize, const Vec3& fitMin, const Vec3& fitMax, float *pOutAverage);
+		void CenterGridOnOrigin();
+		static bool HashObjectPassThrough(GraphicalObject *pObj, void *pSourceHash);
+		static bool CollectObjectPassThrough(GraphicalObject *pObj, void *pObjectArray);
+		static unsigned long long HashWords(unsigned long long hash, const void *pData, int byteCount);
+		static unsigned long long WriteCacheSection(std::ofstream& out, const void *pData, unsigned long long byteCount);
+		bool IsCacheHeaderValid(const CacheHeader& header, unsigned long long sourceHash, const char *const cacheFileName);
+		bool IsCachedTriangleValid(int ownerIndex, int vertexIndex);
+		void ReleaseBlocks();
+		static bool AddBuildObjectPassThrough(GraphicalObject *pObj, void *pBuildData);
+		bool PrepareBuild(BuildData *pBuild);
+		bool BuildSparseCellsFromPairs(BuildData *pBuild);
+		void RunBuildJobs(int jobCount, void(*job)(int, void *), BuildData *pBuild);
+		static void TransformAndCountJob(int jobIndex, void *pBuildData);
+		static bool StoreWorldTrianglePassThrough(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pClassInstance, void *pPassThroughData);
+		static void SumCellChunkJob(int chunkIndex, void *pBuildData);
+		static void WriteCellStartsJob(int chunkIndex, void *pBuildData);
+		static void ScatterJob(int jobIndex, void *pBuildData);
+		static void GatherCellChunkJob(int chunkIndex, void *pBuildData);
+		static void PairCellsJob(int jobIndex, void *pBuildData);
+		static void GatherSparseCellChunkJob(int chunkIndex, void *pBuildData);
 		static bool ProcessTrianglesPassThrough(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pClassInstance, void *pPassThroughData);
 		bool ProcessTriangles(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pPassThroughData);
-		static bool SetTriangleIndexPassThrough(int x, int y, int z, GraphicalObject *pObj, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance);
-		bool SetTriangleIndex(int x, int y, int z, GraphicalObject *pObj, int index);
-		static bool AddSpatialTrianglePassThrough(int x, int y, int z, GraphicalObject *pObj, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance);
-		bool AddSpatialTriangle(int x, int y, int z, GraphicalObject *pObj, const Vec3& p0, const Vec3& p1, const Vec3& p2, int index);
-		bool SetGridStartIndices();
-		static bool SetGridStartIndicesForObjectPassThrough(GraphicalObject *pGraphicalObjectToAdd, void *pClassInstance);
-		bool SetGridStartIndicesForObject(GraphicalObject *pCurrent);
+		bool GetTriangleCellRange(const Vec3& p0, const Vec3& p1, const Vec3& p2, ObjectCellBounds *pOutRange);
+		bool GetBoxCellRange(const Vec3& boxMin, const Vec3& boxMax, ObjectCellBounds *pOutRange);
+		bool DoesFitInCells(GraphicalObject *pGraphicalObjectToTest);
+		static void GrowCellBounds(ObjectCellBounds *pBounds, const ObjectCellBounds& range);
+		bool DoesTriangleTouchCell(int gridX, int gridY, int gridZ, const Vec3& p0, const Vec3& p1, const Vec3& p2);
+		static bool CountBinningPassThrough(GraphicalObject *pObj, void *pClassInstance);
+		bool GetCellSpan(int arrayIndex, bool addIfMissing, CellSpan *pOutSpan);
+		bool RemoveObjectTriangles(GraphicalObject *pObj);
+		bool InsertObjectTriangles(GraphicalObject *pObj);
+		static bool InsertSpatialTrianglePassThrough(int x, int y, int z, GraphicalObject *pObj, int ownerIndex, int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, void *pClassInstance);
+		bool InsertSpatialTriangle(int x, int y, int z, GraphicalObject *pObj, int ownerIndex, const Vec3& p0, const Vec3& p1, const Vec3& p2, int index);
+		bool RelocateCell(CellSpan *pSpan, int newCapacity);
+		bool GrowData(int minimumCapacity);
+		void WriteTriangle(int dataIndex, const SpatialTriangleData& triangle, int ownerIndex);
+		void ClearTriangle(int dataIndex);
+		int GetOwnerIndexAt(int dataIndex);
+		int FindOwnerIndex(GraphicalObject *pObj);
+		int AddOwner(GraphicalObject *pObj);
+		void RemoveOwner(GraphicalObject *pObj);
+		bool GrowOwners(int minimumCapacity);
+		void SetOwner(int ownerIndex, GraphicalObject *pObj);
+		void SetOwnerEnabledBit(int ownerIndex, bool enabled);
+		ObjectCellBounds *FindObjectBounds(GraphicalObject *pObj);
+		bool SetObjectBounds(const ObjectCellBounds& bounds);
+		void RemoveObjectBounds(GraphicalObject *pObj);
+		static int RoundUpToBlock(int triangleCount);
 		int GetArrayIndexFromXYZIndices(int gridX, int gridY, int gridZ);
 		bool AreGridIndicesValid(int gridX, int gridY, int gridZ);
+		SparseCell *FindSparseCell(int arrayIndex);
+		SparseCell *FindOrAddSparseCell(int arrayIndex);
+		bool GrowSparseCells();
+		bool BuildOccupancy();
+		void SetCellOccupied(int gridX, int gridY, int gridZ, bool occupied);
 		void CleanUp();
 
 		bool m_firstCalculation{ true };
+		WorkerPool *m_pWorkers{ nullptr };
 		float m_gridScale;
+
+		// world position of the low corner of cell (0, 0, 0)
+		Vec3 m_gridOrigin;
+		bool m_autoFitGrid{ true };
+		bool m_autoFitScale{ true };
 		SpatialTriangleData *m_pData{ nullptr };
+		SpatialTriangleBlock *m_pBlocks{ nullptr };
+
+		// m_pBlocks points into this when the partitions came from a cache file, the mapping is copy on write so updates still work
+		MappedFile m_cacheFile;
+		bool m_blocksMapped{ false };
+
+		// what the partitions were built from, zero when unknown or changed since
+		unsigned long long m_sourceHash{ 0 };
+		int m_dataCapacity{ 0 };
+		int m_dataUsed{ 0 };
+		int m_wastedSlots{ 0 };
+		ObjectCellBounds *m_pObjectBounds{ nullptr };
+		int m_objectBoundsCount{ 0 };
+		int m_objectBoundsCapacity{ 0 };
+		ObjectIndexMap m_objectBoundsIndices;
 		LinkedList<GraphicalObject*> m_objectList;
+
+		// every object with triangles binned, indexed by the block lanes, with a bit per slot for whether it is enabled and the box around it
+		GraphicalObject **m_pOwners{ nullptr };
+		unsigned *m_pEnabledOwnerBits{ nullptr };
+		OwnerBounds *m_pOwnerBounds{ nullptr };
+		int m_ownerCount{ 0 };
+		int m_ownerCapacity{ 0 };
+		ObjectIndexMap m_ownerIndices;
+
+		// slots below m_ownerCount whose object was removed, handed out again before the table grows
+		int *m_pFreeOwnerSlots{ nullptr };
+		int m_freeOwnerSlotCount{ 0 };
 		int *m_pGridStartIndices{ nullptr };
 		int *m_pGridTriangleCounts{ nullptr };
+		int *m_pGridTriangleCapacities{ nullptr };
+		bool m_useSparseCells{ true };
+		bool m_exactTriangleBinning{ true };
+		SparseCell *m_pSparseCells{ nullptr };
+		int m_sparseCellCapacity{ 0 };
+		int m_occupiedCellCount{ 0 };
+		unsigned long long *m_pOccupancy{ nullptr };
+		int m_occupancyWidth{ 0 };
+		int m_occupancyDepth{ 0 };
+		int m_occupancyHeight{ 0 };
 		int m_gridSectionsWidth{ 85 };
 		int m_gridSectionsDepth{ 85 };
 		int m_gridSectionsHeight{ 85 };
@@ -86,6 +307,8 @@ namespace Engine
 		int m_minGridTriangleCount{ -1 };
 		int m_maxGridTriangleCount{ -1 };
 		int m_totalTriangleCount{ -1 };
+		int m_uniqueTriangleCount{ 0 };
+		int m_boundingBoxCellCount{ 0 };
 		float m_avgGridTriangleCount{ -1.0f };
 		InstanceBuffer m_gridInstanceBuffer;
 		GraphicalObject m_gridDisplayObject;
@@ -0,0 +1,177 @@
+#include "SpatialHash.h"
+#include "GameLogger.h"
+#include <cmath>
+
+// agent
+// 10/17/2026
+// SpatialHash.cpp
+// Bins moving agents into hashed cells so range queries only look at the agents nearby
+
+namespace Engine
+{
+	SpatialHash::SpatialHash()
+	{
+		Clear();
+	}
+
+	SpatialHash::~SpatialHash()
+	{
+		CleanUp();
+	}
+
+	void SpatialHash::SetCellSize(float cellSize)
+	{
+		if (!(cellSize > 0.0f)) { GameLogger::Log(MessageType::cWarning, "Tried to SetCellSize of SpatialHash to [%.3f]! Cell size must be positive!\n", cellSize); return; }
+
+		// the agents already in were binned with the old size
+		m_cellSize = cellSize;
+		Clear();
+	}
+
+	void SpatialHash::Clear()
+	{
+		m_count = 0;
+		for (int i = 0; i < BUCKET_COUNT; ++i) { m_bucketHeads[i] = -1; }
+	}
+
+	bool SpatialHash::Insert(SpatialComponent * pSpatial)
+	{
+		if (!pSpatial) { GameLogger::Log(MessageType::cError, "Failed to Insert into SpatialHash! SpatialComponent was nullptr!\n"); return false; }
+		if (m_count == m_capacity && !GrowEntries(m_count + 1)) { return false; }
+
+		Entry& entry = m_pEntries[m_count];
+		entry.pSpatial = pSpatial;
+		entry.position = pSpatial->GetPosition();
+		entry.cellX = GetCellIndex(entry.position.GetX());
+		entry.cellY = GetCellIndex(entry.position.GetY());
+		entry.cellZ = GetCellIndex(entry.position.GetZ());
+
+		int bucket = GetBucketIndex(entry.cellX, entry.cellY, entry.cellZ);
+		entry.next = m_bucketHeads[bucket];
+		m_bucketHeads[bucket] = m_count++;
+		return true;
+	}
+
+	int SpatialHash::GetCount() const
+	{
+		return m_count;
+	}
+
+	void SpatialHash::CleanUp()
+	{
+		delete[] m_pEntries;
+		m_pEntries = nullptr;
+		m_capacity = 0;
+		Clear();
+	}
+
+	int SpatialHash::QuerySphere(const Vec3 & sphereCenter, float radius, SpatialComponent ** outAgents, int maxAgents)
+	{
+		AgentOutput output;
+		output.outAgents = outAgents;
+		output.maxAgents = maxAgents;
+		if (outAgents && maxAgents > 0) { WalkSphere(sphereCenter, radius, SpatialHash::CollectAgentPassThrough, &output); }
+		return output.count;
+	}
+
+	int SpatialHash::QueryAABB(const Vec3 & boxMin, const Vec3 & boxMax, SpatialComponent ** outAgents, int maxAgents)
+	{
+		AgentOutput output;
+		output.outAgents = outAgents;
+		output.maxAgents = maxAgents;
+		if (outAgents && maxAgents > 0) { WalkAABB(boxMin, boxMax, SpatialHash::CollectAgentPassThrough, &output); }
+		return output.count;
+	}
+
+	// agents strictly closer than radius to the center
+	void SpatialHash::WalkSphere(const Vec3 & sphereCenter, float radius, AgentCallback callback, void * pClassInstance)
+	{
+		Walk(sphereCenter - Vec3(radius), sphereCenter + Vec3(radius), &sphereCenter, radius * radius, callback, pClassInstance);
+	}
+
+	void SpatialHash::WalkAABB(const Vec3 & boxMin, const Vec3 & boxMax, AgentCallback callback, void * pClassInstance)
+	{
+		Walk(boxMin, boxMax, nullptr, 0.0f, callback, pClassInstance);
+	}
+
+	bool SpatialHash::CollectAgentPassThrough(SpatialComponent * pSpatial, void * pClassInstance)
+	{
+		AgentOutput *pOutput = reinterpret_cast<AgentOutput *>(pClassInstance);
+		pOutput->outAgents[pOutput->count++] = pSpatial;
+		return pOutput->count < pOutput->maxAgents;
+	}
+
+	void SpatialHash::Walk(const Vec3 & boxMin, const Vec3 & boxMax, const Vec3 * pSphereCenter, float radiusSquared, AgentCallback callback, void * pClassInstance)
+	{
+		if (!callback || m_count == 0) { return; }
+
+		int minX = GetCellIndex(boxMin.GetX()), maxX = GetCellIndex(boxMax.GetX());
+		int minY = GetCellIndex(boxMin.GetY()), maxY = GetCellIndex(boxMax.GetY());
+		int minZ = GetCellIndex(boxMin.GetZ()), maxZ = GetCellIndex(boxMax.GetZ());
+		if (minX > maxX || minY > maxY || minZ > maxZ) { return; }
+
+		// a box covering more cells than there are agents is cheaper to answer by checking every agent
+		long long cellCount = (long long)(maxX - minX + 1) * (maxY - minY + 1) * (maxZ - minZ + 1);
+		if (cellCount > m_count)
+		{
+			for (int i = 0; i < m_count; ++i)
+			{
+				if (IsInside(m_pEntries[i], boxMin, boxMax, pSphereCenter, radiusSquared) && !callback(m_pEntries[i].pSpatial, pClassInstance)) { return; }
+			}
+
+			return;
+		}
+
+		for (int x = minX; x <= maxX; ++x)
+		{
+			for (int y = minY; y <= maxY; ++y)
+			{
+				for (int z = minZ; z <= maxZ; ++z)
+				{
+					// several cells can share a bucket, each agent only belongs to the cell it was binned in
+					for (int i = m_bucketHeads[GetBucketIndex(x, y, z)]; i >= 0; i = m_pEntries[i].next)
+					{
+						const Entry& entry = m_pEntries[i];
+						if (entry.cellX != x || entry.cellY != y || entry.cellZ != z) { continue; }
+						if (IsInside(entry, boxMin, boxMax, pSphereCenter, radiusSquared) && !callback(entry.pSpatial, pClassInstance)) { return; }
+					}
+				}
+			}
+		}
+	}
+
+	bool SpatialHash::IsInside(const Entry & entry, const Vec3 & boxMin, const Vec3 & boxMax, const Vec3 * pSphereCenter, float radiusSquared) const
+	{
+		if (pSphereCenter) { return (entry.position - *pSphereCenter).LengthSquared() < radiusSquared; }
+
+		return entry.position.GetX() >= boxMin.GetX() && entry.position.GetX() <= boxMax.GetX()
+			&& entry.position.GetY() >= boxMin.GetY() && entry.position.GetY() <= boxMax.GetY()
+			&& entry.position.GetZ() >= boxMin.GetZ() && entry.position.GetZ() <= boxMax.GetZ();
+	}
+
+	int SpatialHash::GetCellIndex(float position) const
+	{
+		return (int)floorf(position / m_cellSize);
+	}
+
+	int SpatialHash::GetBucketIndex(int cellX, int cellY, int cellZ)
+	{
+		unsigned hash = ((unsigned)cellX * 73856093u) ^ ((unsigned)cellY * 19349663u) ^ ((unsigned)cellZ * 83492791u);
+		return (int)(hash & (BUCKET_COUNT - 1));
+	}
+
+	bool SpatialHash::GrowEntries(int minimumCapacity)
+	{
+		int newCapacity = m_capacity ? m_capacity * 2 : 64;
+		while (newCapacity < minimumCapacity) { newCapacity *= 2; }
+
+		Entry *pNewEntries = new Entry[newCapacity];
+		if (!pNewEntries) { GameLogger::Log(MessageType::cError, "Failed to grow SpatialHash to [%d] entries! Out of memory!\n", newCapacity); return false; }
+
+		for (int i = 0; i < m_count; ++i) { pNewEntries[i] = m_pEntries[i]; }
+		delete[] m_pEntries;
+		m_pEntries = pNewEntries;
+		m_capacity = newCapacity;
+		return true;
+	}
+}
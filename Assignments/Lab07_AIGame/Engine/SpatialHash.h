@@ -0,0 +1,73 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+// agent
+// 10/17/2026
+// SpatialHash.h
+// Bins moving agents into hashed cells so range queries only look at the agents nearby
+
+#include "ExportHeader.h"
+#include "SpatialComponent.h"
+#include "Vec3.h"
+
+namespace Engine
+{
+	class ENGINE_SHARED SpatialHash
+	{
+	public:
+		typedef bool(*AgentCallback)(SpatialComponent *pSpatial, void *pClassInstance);
+
+		SpatialHash();
+		~SpatialHash();
+
+		// agents are binned by where they were when inserted, call Clear and insert them again once they have moved
+		void SetCellSize(float cellSize);
+		void Clear();
+		bool Insert(SpatialComponent *pSpatial);
+		int GetCount() const;
+		void CleanUp();
+
+		// returns how many agents were written, each agent at most once
+		int QuerySphere(const Vec3& sphereCenter, float radius, SpatialComponent **outAgents, int maxAgents);
+		int QueryAABB(const Vec3& boxMin, const Vec3& boxMax, SpatialComponent **outAgents, int maxAgents);
+
+		// callback returns false to stop the walk
+		void WalkSphere(const Vec3& sphereCenter, float radius, AgentCallback callback, void *pClassInstance);
+		void WalkAABB(const Vec3& boxMin, const Vec3& boxMax, AgentCallback callback, void *pClassInstance);
+
+	private:
+		static const int BUCKET_COUNT = 1024;
+
+		struct Entry
+		{
+			SpatialComponent *pSpatial{ nullptr };
+			Vec3 position{ 0.0f, 0.0f, 0.0f };
+			int cellX{ 0 };
+			int cellY{ 0 };
+			int cellZ{ 0 };
+			int next{ -1 };
+		};
+
+		struct AgentOutput
+		{
+			SpatialComponent **outAgents{ nullptr };
+			int maxAgents{ 0 };
+			int count{ 0 };
+		};
+
+		static bool CollectAgentPassThrough(SpatialComponent *pSpatial, void *pClassInstance);
+		void Walk(const Vec3& boxMin, const Vec3& boxMax, const Vec3 *pSphereCenter, float radiusSquared, AgentCallback callback, void *pClassInstance);
+		bool IsInside(const Entry& entry, const Vec3& boxMin, const Vec3& boxMax, const Vec3 *pSphereCenter, float radiusSquared) const;
+		int GetCellIndex(float position) const;
+		static int GetBucketIndex(int cellX, int cellY, int cellZ);
+		bool GrowEntries(int minimumCapacity);
+
+		float m_cellSize{ 50.0f };
+		Entry *m_pEntries{ nullptr };
+		int m_count{ 0 };
+		int m_capacity{ 0 };
+		int m_bucketHeads[BUCKET_COUNT];
+	};
+}
+
+#endif // ifndef SPATIALHASH_H
@@ -0,0 +1,56 @@
+#ifndef SPATIALTRIANGLEBLOCK_H
+#define SPATIALTRIANGLEBLOCK_H
+
+// agent
+// 10/17/2026
+// SpatialTriangleBlock.h
+// Four grid cell triangles stored as structure of arrays so one ray can be tested against all of them at once
+
+#include "SpatialTriangleData.h"
+
+namespace Engine
+{
+	struct SpatialTriangleBlock
+	{
+	public:
+		static const int TRIANGLES_PER_BLOCK = 4;
+
+		// unused lanes keep zero edges, which can never be hit
+		SpatialTriangleBlock()
+			: p0x{ 0.0f }, p0y{ 0.0f }, p0z{ 0.0f }, e1x{ 0.0f }, e1y{ 0.0f }, e1z{ 0.0f }, e2x{ 0.0f }, e2y{ 0.0f }, e2z{ 0.0f }, doubleSided{ 0.0f }, ownerIndex{ -1, -1, -1, -1 }, vertexIndex{ -1, -1, -1, -1 } {}
+
+		void SetLane(int lane, const SpatialTriangleData& triangle, int ownerIndexIn, bool isDoubleSided)
+		{
+			p0x[lane] = triangle.p0.GetX(); p0y[lane] = triangle.p0.GetY(); p0z[lane] = triangle.p0.GetZ();
+			e1x[lane] = triangle.p1.GetX() - triangle.p0.GetX(); e1y[lane] = triangle.p1.GetY() - triangle.p0.GetY(); e1z[lane] = triangle.p1.GetZ() - triangle.p0.GetZ();
+			e2x[lane] = triangle.p2.GetX() - triangle.p0.GetX(); e2y[lane] = triangle.p2.GetY() - triangle.p0.GetY(); e2z[lane] = triangle.p2.GetZ() - triangle.p0.GetZ();
+			doubleSided[lane] = isDoubleSided ? 1.0f : 0.0f;
+			ownerIndex[lane] = ownerIndexIn;
+			vertexIndex[lane] = triangle.m_triangleVertexZeroIndex;
+		}
+
+		void ClearLane(int lane)
+		{
+			p0x[lane] = p0y[lane] = p0z[lane] = 0.0f;
+			e1x[lane] = e1y[lane] = e1z[lane] = 0.0f;
+			e2x[lane] = e2y[lane] = e2z[lane] = 0.0f;
+			doubleSided[lane] = 0.0f;
+			ownerIndex[lane] = -1;
+			vertexIndex[lane] = -1;
+		}
+
+		// vertex zero and the two edges leaving it, ready for Moller-Trumbore
+		float p0x[TRIANGLES_PER_BLOCK], p0y[TRIANGLES_PER_BLOCK], p0z[TRIANGLES_PER_BLOCK];
+		float e1x[TRIANGLES_PER_BLOCK], e1y[TRIANGLES_PER_BLOCK], e1z[TRIANGLES_PER_BLOCK];
+		float e2x[TRIANGLES_PER_BLOCK], e2y[TRIANGLES_PER_BLOCK], e2z[TRIANGLES_PER_BLOCK];
+
+		// 1.0f when the owner's mesh has culling disabled, so the back face counts too
+		float doubleSided[TRIANGLES_PER_BLOCK];
+
+		// which object in the grid's owner table each lane came from and its vertex zero, -1 for empty lanes
+		int ownerIndex[TRIANGLES_PER_BLOCK];
+		int vertexIndex[TRIANGLES_PER_BLOCK];
+	};
+}
+
+#endif // ifndef SPATIALTRIANGLEBLOCK_H
@@ -1,6 +1,8 @@
 #include "SteeringBehaviors.h"
 #include "MathUtility.h"
 #include "Mesh.h"
+#include "CollisionTester.h"
+#include "CollisionQueryStats.h"
 
 // Justin Furtado
 // 6/2/2017
@@ -81,7 +83,30 @@ namespace Engine
 
 		// calculates the closest collectible in the list and stores the ptr
 		pResources->WalkListWhere(IsCollectible, nullptr, CalcClosest, &pos);
+		SteerToClosestResource(pEntitySpatial, speed, wanderRadius, slowRadius, seeRadius, offset);
+	}
+
+	// only looks at the resources in the given collision layers that are within seeRadius, instead of every resource there is
+	void SteeringBehaviors::ForageInLayers(SpatialComponent * const pEntitySpatial, float speed, float wanderRadius, float slowRadius, float seeRadius, float offset, unsigned resourceLayerMask)
+	{
+		s_pClosestResource = nullptr;
+		Vec3 pos = pEntitySpatial->GetPosition();
+
+		GraphicalObject *nearby[MAX_FORAGE_CANDIDATES];
+		const char *pPreviousTag = CollisionQueryStats::SetQueryTag("forage");
+		int nearbyCount = CollisionTester::QuerySphere(pos, seeRadius, &nearby[0], MAX_FORAGE_CANDIDATES, resourceLayerMask);
+		CollisionQueryStats::SetQueryTag(pPreviousTag);
+		for (int i = 0; i < nearbyCount; ++i)
+		{
+			if (IsCollectible(nearby[i], nullptr)) { CalcClosest(nearby[i], &pos); }
+		}
+
+		SteerToClosestResource(pEntitySpatial, speed, wanderRadius, slowRadius, seeRadius, offset);
+	}
 
+	void SteeringBehaviors::SteerToClosestResource(SpatialComponent * const pEntitySpatial, float speed, float wanderRadius, float slowRadius, float seeRadius, float offset)
+	{
+		Vec3 pos = pEntitySpatial->GetPosition();
 		Vec3 vel;
 		if (s_pClosestResource && (s_pClosestResource->GetPos() - pos).LengthSquared() < seeRadius * seeRadius)
 		{
@@ -25,8 +25,11 @@ namespace Engine
 		static void Arrival(SpatialComponent *const pEntitySpatial, const SpatialComponent *const pTargetSpatial, float speed, float slowRadius);
 		static void Wander(SpatialComponent *const pEntitySpatial, float speed, float radius, float offset);
 		static void Forage(SpatialComponent *const pEntitySpatial, float speed,  float wanderRadius, float slowRadius, float seeRadius, float offset, LinkedList<GraphicalObject*> *pResources);
+		static void ForageInLayers(SpatialComponent *const pEntitySpatial, float speed, float wanderRadius, float slowRadius, float seeRadius, float offset, unsigned resourceLayerMask);
 
 	private:
+		static const int MAX_FORAGE_CANDIDATES = 64;
+		static void SteerToClosestResource(SpatialComponent *const pEntitySpatial, float speed, float wanderRadius, float slowRadius, float seeRadius, float offset);
 		static bool IsCollectible(GraphicalObject *pObj, void *pData);
 		static bool CalcClosest(GraphicalObject *pObj, void *pData);
 		static GraphicalObject *s_pClosestResource;
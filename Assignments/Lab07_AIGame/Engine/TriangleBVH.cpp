@@ -0,0 +1,567 @@
+#include "TriangleBVH.h"
+#include "CollisionTester.h"
+#include "GameLogger.h"
+#include "Mesh.h"
+#include "MathUtility.h"
+
+// agent
+// 10/17/2026
+// TriangleBVH.cpp
+// Bounding volume hierarchy over world space triangles, built with the surface area heuristic
+
+namespace Engine
+{
+	const int BVH_BIN_COUNT = 12;
+	const int BVH_MAX_LEAF_TRIANGLES = 4;
+	const int BVH_MAX_DEPTH = 60;
+	const int BVH_TRAVERSAL_STACK_SIZE = 64; // must be larger than BVH_MAX_DEPTH + 1
+	const float BVH_NO_HIT = 1e30f;
+	const float BVH_REBUILD_AREA_GROWTH = 2.0f; // how much bigger refits may make the boxes before a build is asked for
+
+	TriangleBVH::TriangleBVH()
+	{
+	}
+
+	TriangleBVH::~TriangleBVH()
+	{
+		CleanUp();
+	}
+
+	bool TriangleBVH::Build(LinkedList<GraphicalObject*> *pObjects)
+	{
+		// allow method to be called repeatedly
+		CleanUp();
+
+		// first pass just counts so that everything can be allocated up front
+		if (!pObjects->WalkList(TriangleBVH::CountObjectTrianglesPassThrough, this)) { return false; }
+		if (m_triangleCapacity == 0) { GameLogger::Log(MessageType::Process, "Built empty BVH!\n"); return true; }
+		if (m_ownerCapacity > CollisionTriangle::MAX_OWNERS) { GameLogger::Log(MessageType::cError, "Failed to build BVH! [%d] objects is more than the [%d] a BVH can hold!\n", m_ownerCapacity, CollisionTriangle::MAX_OWNERS); CleanUp(); return false; }
+
+		m_pTriangles = new CollisionTriangle[m_triangleCapacity];
+		m_pCentroids = new Vec3[m_triangleCapacity];
+		m_pNodes = new BVHNode[2 * m_triangleCapacity]; // a binary tree with n leaves never has more than 2n - 1 nodes
+		m_pOwners = new GraphicalObject*[m_ownerCapacity];
+		m_pEnabledOwnerBits = new unsigned[(m_ownerCapacity + 31) / 32]{ 0u };
+		m_pOwnerFirstTriangles = new int[m_ownerCapacity + 1];
+		m_pTriangleSlots = new int[m_triangleCapacity];
+		m_pTriangleLeaves = new int[m_triangleCapacity];
+		m_pNodeParents = new int[2 * m_triangleCapacity];
+		m_pBuildOrder = new int[m_triangleCapacity];
+		if (!m_pTriangles || !m_pCentroids || !m_pNodes || !m_pOwners || !m_pEnabledOwnerBits || !m_pOwnerFirstTriangles || !m_pTriangleSlots || !m_pTriangleLeaves || !m_pNodeParents || !m_pBuildOrder) { GameLogger::Log(MessageType::cFatal_Error, "Failed to allocate memory for BVH of [%d] triangles!\n", m_triangleCapacity); CleanUp(); return false; }
+
+		// second pass transforms the triangles into world space
+		if (!pObjects->WalkList(TriangleBVH::AddObjectTrianglesPassThrough, this)) { CleanUp(); return false; }
+		m_pOwnerFirstTriangles[m_ownerCount] = m_triangleCount;
+
+		// everything starts in the root, then gets split
+		m_pNodes[0].m_leftOrFirst = 0;
+		m_pNodes[0].m_triangleCount = m_triangleCount;
+		m_pNodeParents[0] = -1;
+		m_nodeCount = 1;
+		UpdateNodeBounds(0);
+		Subdivide(0, 0);
+
+		// refits look triangles up by the order they were added in, not where partitioning left them
+		for (int slot = 0; slot < m_triangleCount; ++slot) { m_pTriangleSlots[m_pBuildOrder[slot]] = slot; }
+
+		m_builtNodeArea = 0.0f;
+		for (int i = 0; i < m_nodeCount; ++i) { m_builtNodeArea += SurfaceArea(m_pNodes[i].m_min, m_pNodes[i].m_max); }
+		m_nodeArea = m_builtNodeArea;
+
+		// centroids and the build order are only needed for building
+		delete[] m_pCentroids; m_pCentroids = nullptr;
+		delete[] m_pBuildOrder; m_pBuildOrder = nullptr;
+
+		GameLogger::Log(MessageType::Process, "Successfully built BVH with [%d] nodes over [%d] triangles!\n", m_nodeCount, m_triangleCount);
+		return true;
+	}
+
+	// pCounts, when given, is added to with the nodes visited and triangles tested
+	void TriangleBVH::RayCast(const Vec3 & rayPosition, const Vec3 & normalizedRayDirection, float checkDist, RayCastingOutput * pOutput, CollisionQueryCounts * pCounts)
+	{
+		if (m_nodeCount == 0) { return; }
+
+		// divide by zero gives infinity, which the slab test handles
+		Vec3 inverseDirection(1.0f / normalizedRayDirection.GetX(), 1.0f / normalizedRayDirection.GetY(), 1.0f / normalizedRayDirection.GetZ());
+
+		int stack[BVH_TRAVERSAL_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const BVHNode& node = m_pNodes[stack[--stackSize]];
+			if (pCounts) { pCounts->m_cellsVisited++; }
+
+			// the closest hit so far shrinks the range worth looking in
+			float maxDist = fminf(checkDist, pOutput->m_distance);
+			if (MathUtility::RayBoxEntryDistance(rayPosition, inverseDirection, node.m_min, node.m_max, maxDist) == FLT_MAX) { continue; }
+
+			if (node.m_triangleCount > 0)
+			{
+				for (int i = 0; i < node.m_triangleCount; ++i)
+				{
+					const CollisionTriangle& triangle = m_pTriangles[node.m_leftOrFirst + i];
+					if (!IsOwnerEnabled(triangle.ownerIndex)) { continue; }
+					if (pCounts) { pCounts->m_trianglesTested++; }
+					CollisionTester::RayCollisionTriangleIntersect(rayPosition, normalizedRayDirection, &triangle, m_pOwners[triangle.ownerIndex], pOutput);
+				}
+
+				continue;
+			}
+
+			// visit the nearer child first so that its hits can cull the farther one
+			float leftDist = MathUtility::RayBoxEntryDistance(rayPosition, inverseDirection, m_pNodes[node.m_leftOrFirst].m_min, m_pNodes[node.m_leftOrFirst].m_max, maxDist);
+			float rightDist = MathUtility::RayBoxEntryDistance(rayPosition, inverseDirection, m_pNodes[node.m_leftOrFirst + 1].m_min, m_pNodes[node.m_leftOrFirst + 1].m_max, maxDist);
+			int nearChild = (leftDist <= rightDist) ? node.m_leftOrFirst : node.m_leftOrFirst + 1;
+			int farChild = (leftDist <= rightDist) ? node.m_leftOrFirst + 1 : node.m_leftOrFirst;
+			float nearDist = fminf(leftDist, rightDist);
+			float farDist = fmaxf(leftDist, rightDist);
+
+			if (farDist < FLT_MAX) { stack[stackSize++] = farChild; }
+			if (nearDist < FLT_MAX) { stack[stackSize++] = nearChild; }
+		}
+	}
+
+	// any triangle within checkDist will do, so children are visited in whatever order and the first hit returns
+	bool TriangleBVH::IsOccluded(const Vec3 & rayPosition, const Vec3 & normalizedRayDirection, float checkDist, const GraphicalObject * pIgnoredObject, CollisionQueryCounts * pCounts)
+	{
+		if (m_nodeCount == 0) { return false; }
+
+		Vec3 inverseDirection(1.0f / normalizedRayDirection.GetX(), 1.0f / normalizedRayDirection.GetY(), 1.0f / normalizedRayDirection.GetZ());
+
+		int stack[BVH_TRAVERSAL_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const BVHNode& node = m_pNodes[stack[--stackSize]];
+			if (pCounts) { pCounts->m_cellsVisited++; }
+			if (MathUtility::RayBoxEntryDistance(rayPosition, inverseDirection, node.m_min, node.m_max, checkDist) == FLT_MAX) { continue; }
+
+			if (node.m_triangleCount > 0)
+			{
+				for (int i = 0; i < node.m_triangleCount; ++i)
+				{
+					const CollisionTriangle& triangle = m_pTriangles[node.m_leftOrFirst + i];
+					if (!IsOwnerEnabled(triangle.ownerIndex) || m_pOwners[triangle.ownerIndex] == pIgnoredObject) { continue; }
+					if (pCounts) { pCounts->m_trianglesTested++; }
+					if (CollisionTester::RayCollisionTriangleOccluded(rayPosition, normalizedRayDirection, &triangle, checkDist)) { return true; }
+				}
+
+				continue;
+			}
+
+			stack[stackSize++] = node.m_leftOrFirst + 1;
+			stack[stackSize++] = node.m_leftOrFirst;
+		}
+
+		return false;
+	}
+
+	// visits every triangle in a leaf whose box overlaps the given one, the callback does any finer testing
+	void TriangleBVH::WalkTrianglesInBox(const Vec3 & boxMin, const Vec3 & boxMax, BVHTriangleCallback callback, void * pClassInstance)
+	{
+		if (m_nodeCount == 0) { return; }
+
+		int stack[BVH_TRAVERSAL_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const BVHNode& node = m_pNodes[stack[--stackSize]];
+			if (node.m_min.GetX() > boxMax.GetX() || node.m_max.GetX() < boxMin.GetX()) { continue; }
+			if (node.m_min.GetY() > boxMax.GetY() || node.m_max.GetY() < boxMin.GetY()) { continue; }
+			if (node.m_min.GetZ() > boxMax.GetZ() || node.m_max.GetZ() < boxMin.GetZ()) { continue; }
+
+			if (node.m_triangleCount > 0)
+			{
+				for (int i = 0; i < node.m_triangleCount; ++i)
+				{
+					const CollisionTriangle& triangle = m_pTriangles[node.m_leftOrFirst + i];
+					if (!IsOwnerEnabled(triangle.ownerIndex)) { continue; }
+
+					// unpacked for the callback, box queries are not hot enough to need the packed form
+					SpatialTriangleData unpacked;
+					unpacked.p0 = triangle.p0;
+					unpacked.p1 = triangle.GetP1();
+					unpacked.p2 = triangle.GetP2();
+					unpacked.m_pTriangleOwner = m_pOwners[triangle.ownerIndex];
+					unpacked.m_triangleVertexZeroIndex = triangle.vertexIndex;
+					if (!callback(&unpacked, triangle.IsDoubleSided(), pClassInstance)) { return; }
+				}
+
+				continue;
+			}
+
+			stack[stackSize++] = node.m_leftOrFirst + 1;
+			stack[stackSize++] = node.m_leftOrFirst;
+		}
+	}
+
+	// enabled state lives on each object, this copies it into the bits after objects are enabled or disabled
+	void TriangleBVH::RefreshEnabledOwners()
+	{
+		for (int i = 0; i < m_ownerCount; ++i)
+		{
+			if (m_pOwners[i] && m_pOwners[i]->IsEnabled()) { m_pEnabledOwnerBits[i >> 5] |= (1u << (i & 31)); }
+			else { m_pEnabledOwnerBits[i >> 5] &= ~(1u << (i & 31)); }
+		}
+	}
+
+	bool TriangleBVH::RefitObject(GraphicalObject * pObj)
+	{
+		int ownerIndex = m_ownerIndices.Find(pObj);
+		if (ownerIndex < 0) { return false; }
+
+		// the triangles come back in the same order the build added them in, so the k-th one walked is the k-th one added
+		RefitPassData data;
+		data.modelToWorld = *pObj->GetFullTransformPtr();
+		data.ownerIndex = ownerIndex;
+		data.doubleSided = !pObj->GetMeshPointer()->IsCullingEnabledForObject();
+		data.firstTriangle = m_pOwnerFirstTriangles[ownerIndex];
+		data.triangleCount = m_pOwnerFirstTriangles[ownerIndex + 1] - data.firstTriangle;
+		data.walkedCount = 0;
+		pObj->GetMeshPointer()->WalkTriangles(TriangleBVH::RefitTrianglePassThrough, this, &data);
+		if (data.walkedCount != data.triangleCount) { return false; }
+
+		// a box that comes out the same leaves everything above it the same too
+		for (int i = 0; i < data.triangleCount; ++i)
+		{
+			for (int node = m_pTriangleLeaves[m_pTriangleSlots[data.firstTriangle + i]]; node >= 0 && RefitNodeBounds(node); node = m_pNodeParents[node]) {}
+		}
+
+		return true;
+	}
+
+	bool TriangleBVH::RemoveObject(GraphicalObject * pObj)
+	{
+		int ownerIndex = m_ownerIndices.Find(pObj);
+		if (ownerIndex < 0) { return false; }
+
+		m_pOwners[ownerIndex] = nullptr;
+		m_pEnabledOwnerBits[ownerIndex >> 5] &= ~(1u << (ownerIndex & 31));
+		m_ownerIndices.Remove(pObj);
+		return true;
+	}
+
+	bool TriangleBVH::NeedsRebuild()
+	{
+		return m_nodeArea > BVH_REBUILD_AREA_GROWTH * m_builtNodeArea;
+	}
+
+	bool TriangleBVH::IsOwnerEnabled(int ownerIndex)
+	{
+		return (m_pEnabledOwnerBits[ownerIndex >> 5] & (1u << (ownerIndex & 31))) != 0;
+	}
+
+	int TriangleBVH::GetTriangleCount()
+	{
+		return m_triangleCount;
+	}
+
+	int TriangleBVH::GetNodeCount()
+	{
+		return m_nodeCount;
+	}
+
+	void TriangleBVH::ConsoleLogStats()
+	{
+		GameLogger::Log(MessageType::cDebug, "Total triangle count for BVH is [%d]\n", m_triangleCount);
+		GameLogger::Log(MessageType::cDebug, "Node count for BVH is [%d] with [%d] leaves\n", m_nodeCount, m_leafCount);
+		GameLogger::Log(MessageType::cDebug, "Max depth for BVH is [%d]\n", m_maxDepth);
+		GameLogger::Log(MessageType::cDebug, "Average triangle count for BVH leaves is [%.3f]\n", m_leafCount > 0 ? (float)m_triangleCount / (float)m_leafCount : 0.0f);
+	}
+
+	void TriangleBVH::CleanUp()
+	{
+		if (m_pTriangles) { delete[] m_pTriangles; m_pTriangles = nullptr; }
+		if (m_pCentroids) { delete[] m_pCentroids; m_pCentroids = nullptr; }
+		if (m_pNodes) { delete[] m_pNodes; m_pNodes = nullptr; }
+		if (m_pOwners) { delete[] m_pOwners; m_pOwners = nullptr; }
+		if (m_pEnabledOwnerBits) { delete[] m_pEnabledOwnerBits; m_pEnabledOwnerBits = nullptr; }
+		if (m_pOwnerFirstTriangles) { delete[] m_pOwnerFirstTriangles; m_pOwnerFirstTriangles = nullptr; }
+		if (m_pTriangleSlots) { delete[] m_pTriangleSlots; m_pTriangleSlots = nullptr; }
+		if (m_pTriangleLeaves) { delete[] m_pTriangleLeaves; m_pTriangleLeaves = nullptr; }
+		if (m_pNodeParents) { delete[] m_pNodeParents; m_pNodeParents = nullptr; }
+		if (m_pBuildOrder) { delete[] m_pBuildOrder; m_pBuildOrder = nullptr; }
+		m_ownerIndices.Clear();
+		m_builtNodeArea = 0.0f;
+		m_nodeArea = 0.0f;
+		m_ownerCount = 0;
+		m_ownerCapacity = 0;
+		m_triangleCount = 0;
+		m_triangleCapacity = 0;
+		m_nodeCount = 0;
+		m_maxDepth = 0;
+		m_leafCount = 0;
+	}
+
+	bool TriangleBVH::CountObjectTrianglesPassThrough(GraphicalObject * pObj, void * pClassInstance)
+	{
+		TriangleBVH *pInstance = reinterpret_cast<TriangleBVH*>(pClassInstance);
+		Mesh *pMesh = pObj->GetMeshPointer();
+		pInstance->m_triangleCapacity += (pMesh->IsIndexed() ? pMesh->GetIndexCount() : pMesh->GetVertexCount()) / 3;
+		pInstance->m_ownerCapacity++;
+		return true;
+	}
+
+	bool TriangleBVH::AddObjectTrianglesPassThrough(GraphicalObject * pObj, void * pClassInstance)
+	{
+		TriangleBVH *pInstance = reinterpret_cast<TriangleBVH*>(pClassInstance);
+
+		// culling and enabled state are looked up once per object here instead of once per triangle per ray
+		BuildPassData data;
+		data.modelToWorld = *pObj->GetFullTransformPtr();
+		data.ownerIndex = pInstance->m_ownerCount++;
+		data.doubleSided = !pObj->GetMeshPointer()->IsCullingEnabledForObject();
+		pInstance->m_pOwners[data.ownerIndex] = pObj;
+		pInstance->m_pOwnerFirstTriangles[data.ownerIndex] = pInstance->m_triangleCount;
+		if (!pInstance->m_ownerIndices.Set(pObj, data.ownerIndex)) { return false; }
+		if (pObj->IsEnabled()) { pInstance->m_pEnabledOwnerBits[data.ownerIndex >> 5] |= (1u << (data.ownerIndex & 31)); }
+
+		pObj->GetMeshPointer()->WalkTriangles(TriangleBVH::AddTrianglePassThrough, pClassInstance, &data);
+		return true;
+	}
+
+	bool TriangleBVH::AddTrianglePassThrough(int index, const void * pVert1, const void * pVert2, const void * pVert3, void * pClassInstance, void * pPassThroughData)
+	{
+		TriangleBVH *pInstance = reinterpret_cast<TriangleBVH*>(pClassInstance);
+		BuildPassData *pData = reinterpret_cast<BuildPassData*>(pPassThroughData);
+
+		// grab the vertex positions regardless of format
+		Vec3 p0 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert1)));
+		Vec3 p1 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert2)));
+		Vec3 p2 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert3)));
+
+		return pInstance->AddTriangle(index, p0, p1, p2, pData->ownerIndex, pData->doubleSided);
+	}
+
+	bool TriangleBVH::RefitTrianglePassThrough(int index, const void * pVert1, const void * pVert2, const void * pVert3, void * pClassInstance, void * pPassThroughData)
+	{
+		TriangleBVH *pInstance = reinterpret_cast<TriangleBVH*>(pClassInstance);
+		RefitPassData *pData = reinterpret_cast<RefitPassData*>(pPassThroughData);
+
+		// more triangles than were built means the mesh changed, the caller sees the count is off and builds again
+		if (pData->walkedCount >= pData->triangleCount) { pData->walkedCount++; return false; }
+
+		Vec3 p0 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert1)));
+		Vec3 p1 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert2)));
+		Vec3 p2 = pData->modelToWorld * (*(reinterpret_cast<const Vec3 *>(pVert3)));
+
+		int slot = pInstance->m_pTriangleSlots[pData->firstTriangle + pData->walkedCount++];
+		pInstance->m_pTriangles[slot].Set(p0, p1, p2, pData->ownerIndex, index, pData->doubleSided);
+		return true;
+	}
+
+	bool TriangleBVH::AddTriangle(int index, const Vec3 & p0, const Vec3 & p1, const Vec3 & p2, int ownerIndex, bool doubleSided)
+	{
+		if (m_triangleCount >= m_triangleCapacity) { GameLogger::Log(MessageType::cError, "Tried to add more than [%d] triangles to BVH!\n", m_triangleCapacity); return false; }
+
+		m_pTriangles[m_triangleCount].Set(p0, p1, p2, ownerIndex, index, doubleSided);
+		m_pCentroids[m_triangleCount] = (p0 + p1 + p2) / 3.0f;
+		m_pBuildOrder[m_triangleCount] = m_triangleCount;
+		m_triangleCount++;
+		return true;
+	}
+
+	void TriangleBVH::UpdateNodeBounds(int nodeIndex)
+	{
+		BVHNode& node = m_pNodes[nodeIndex];
+		Vec3 minBounds(BVH_NO_HIT);
+		Vec3 maxBounds(-BVH_NO_HIT);
+
+		int end = node.m_leftOrFirst + node.m_triangleCount;
+		for (int i = node.m_leftOrFirst; i < end; ++i)
+		{
+			// bounds come from the packed triangle so they contain exactly what the ray test hits
+			const CollisionTriangle& packed = m_pTriangles[i];
+			Vec3 p1 = packed.GetP1();
+			Vec3 p2 = packed.GetP2();
+			minBounds = Vec3(fminf(minBounds.GetX(), fminf(packed.p0.GetX(), fminf(p1.GetX(), p2.GetX()))),
+							 fminf(minBounds.GetY(), fminf(packed.p0.GetY(), fminf(p1.GetY(), p2.GetY()))),
+							 fminf(minBounds.GetZ(), fminf(packed.p0.GetZ(), fminf(p1.GetZ(), p2.GetZ()))));
+			maxBounds = Vec3(fmaxf(maxBounds.GetX(), fmaxf(packed.p0.GetX(), fmaxf(p1.GetX(), p2.GetX()))),
+							 fmaxf(maxBounds.GetY(), fmaxf(packed.p0.GetY(), fmaxf(p1.GetY(), p2.GetY()))),
+							 fmaxf(maxBounds.GetZ(), fmaxf(packed.p0.GetZ(), fmaxf(p1.GetZ(), p2.GetZ()))));
+		}
+
+		node.m_min = minBounds;
+		node.m_max = maxBounds;
+	}
+
+	// returns whether the box changed, a leaf from its triangles and anything else from its two children
+	bool TriangleBVH::RefitNodeBounds(int nodeIndex)
+	{
+		BVHNode& node = m_pNodes[nodeIndex];
+		Vec3 oldMin = node.m_min;
+		Vec3 oldMax = node.m_max;
+
+		if (node.m_triangleCount > 0) { UpdateNodeBounds(nodeIndex); }
+		else
+		{
+			node.m_min = MathUtility::Min(m_pNodes[node.m_leftOrFirst].m_min, m_pNodes[node.m_leftOrFirst + 1].m_min);
+			node.m_max = MathUtility::Max(m_pNodes[node.m_leftOrFirst].m_max, m_pNodes[node.m_leftOrFirst + 1].m_max);
+		}
+
+		if (node.m_min.GetX() == oldMin.GetX() && node.m_min.GetY() == oldMin.GetY() && node.m_min.GetZ() == oldMin.GetZ() &&
+			node.m_max.GetX() == oldMax.GetX() && node.m_max.GetY() == oldMax.GetY() && node.m_max.GetZ() == oldMax.GetZ()) { return false; }
+
+		m_nodeArea += SurfaceArea(node.m_min, node.m_max) - SurfaceArea(oldMin, oldMax);
+		return true;
+	}
+
+	void TriangleBVH::Subdivide(int nodeIndex, int depth)
+	{
+		if (depth > m_maxDepth) { m_maxDepth = depth; }
+
+		// copy, the node array is not reallocated but keeping a reference across the split is easy to get wrong
+		BVHNode node = m_pNodes[nodeIndex];
+
+		// compare the cost of splitting against the cost of testing every triangle here
+		int axis = 0;
+		float splitPos = 0.0f;
+		float splitCost = FindBestSplit(node, &axis, &splitPos);
+		float leafCost = node.m_triangleCount * SurfaceArea(node.m_min, node.m_max);
+		bool mustSplit = node.m_triangleCount > BVH_MAX_LEAF_TRIANGLES;
+		if (depth >= BVH_MAX_DEPTH || node.m_triangleCount <= 1 || splitCost >= BVH_NO_HIT || (splitCost >= leafCost && !mustSplit)) { MakeLeaf(nodeIndex); return; }
+
+		// partition the triangles in place around the split plane
+		int i = node.m_leftOrFirst;
+		int j = i + node.m_triangleCount - 1;
+		while (i <= j)
+		{
+			if (m_pCentroids[i][axis] < splitPos) { ++i; continue; }
+
+			CollisionTriangle tempTriangle = m_pTriangles[i];
+			m_pTriangles[i] = m_pTriangles[j];
+			m_pTriangles[j] = tempTriangle;
+
+			Vec3 tempCentroid = m_pCentroids[i];
+			m_pCentroids[i] = m_pCentroids[j];
+			m_pCentroids[j] = tempCentroid;
+
+			int tempOrder = m_pBuildOrder[i];
+			m_pBuildOrder[i] = m_pBuildOrder[j];
+			m_pBuildOrder[j] = tempOrder;
+			--j;
+		}
+
+		// a split that leaves one side empty would recurse forever
+		int leftCount = i - node.m_leftOrFirst;
+		if (leftCount == 0 || leftCount == node.m_triangleCount) { MakeLeaf(nodeIndex); return; }
+
+		// children are always allocated as a pair
+		int leftIndex = m_nodeCount;
+		m_nodeCount += 2;
+
+		m_pNodes[leftIndex].m_leftOrFirst = node.m_leftOrFirst;
+		m_pNodes[leftIndex].m_triangleCount = leftCount;
+		m_pNodes[leftIndex + 1].m_leftOrFirst = i;
+		m_pNodes[leftIndex + 1].m_triangleCount = node.m_triangleCount - leftCount;
+		m_pNodes[nodeIndex].m_leftOrFirst = leftIndex;
+		m_pNodes[nodeIndex].m_triangleCount = 0;
+		m_pNodeParents[leftIndex] = nodeIndex;
+		m_pNodeParents[leftIndex + 1] = nodeIndex;
+
+		UpdateNodeBounds(leftIndex);
+		UpdateNodeBounds(leftIndex + 1);
+		Subdivide(leftIndex, depth + 1);
+		Subdivide(leftIndex + 1, depth + 1);
+	}
+
+	void TriangleBVH::MakeLeaf(int nodeIndex)
+	{
+		m_leafCount++;
+
+		const BVHNode& node = m_pNodes[nodeIndex];
+		for (int i = node.m_leftOrFirst; i < node.m_leftOrFirst + node.m_triangleCount; ++i) { m_pTriangleLeaves[i] = nodeIndex; }
+	}
+
+	float TriangleBVH::FindBestSplit(const BVHNode & node, int * outAxis, float * outSplitPos)
+	{
+		float bestCost = BVH_NO_HIT;
+		int end = node.m_leftOrFirst + node.m_triangleCount;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// bin by centroid, so the bounds of the centroids are what get divided up
+			float centroidMin = BVH_NO_HIT;
+			float centroidMax = -BVH_NO_HIT;
+			for (int i = node.m_leftOrFirst; i < end; ++i)
+			{
+				centroidMin = fminf(centroidMin, m_pCentroids[i][axis]);
+				centroidMax = fmaxf(centroidMax, m_pCentroids[i][axis]);
+			}
+
+			// every centroid on this axis is in the same place, nothing to split
+			if (centroidMin == centroidMax) { continue; }
+
+			Vec3 binMin[BVH_BIN_COUNT];
+			Vec3 binMax[BVH_BIN_COUNT];
+			int binCount[BVH_BIN_COUNT]{ 0 };
+			for (int b = 0; b < BVH_BIN_COUNT; ++b) { binMin[b] = Vec3(BVH_NO_HIT); binMax[b] = Vec3(-BVH_NO_HIT); }
+
+			float scale = BVH_BIN_COUNT / (centroidMax - centroidMin);
+			for (int i = node.m_leftOrFirst; i < end; ++i)
+			{
+				int b = (int)((m_pCentroids[i][axis] - centroidMin) * scale);
+				if (b >= BVH_BIN_COUNT) { b = BVH_BIN_COUNT - 1; }
+
+				const CollisionTriangle& packed = m_pTriangles[i];
+				Vec3 p1 = packed.GetP1();
+				Vec3 p2 = packed.GetP2();
+				binCount[b]++;
+				binMin[b] = Vec3(fminf(binMin[b].GetX(), fminf(packed.p0.GetX(), fminf(p1.GetX(), p2.GetX()))),
+								 fminf(binMin[b].GetY(), fminf(packed.p0.GetY(), fminf(p1.GetY(), p2.GetY()))),
+								 fminf(binMin[b].GetZ(), fminf(packed.p0.GetZ(), fminf(p1.GetZ(), p2.GetZ()))));
+				binMax[b] = Vec3(fmaxf(binMax[b].GetX(), fmaxf(packed.p0.GetX(), fmaxf(p1.GetX(), p2.GetX()))),
+								 fmaxf(binMax[b].GetY(), fmaxf(packed.p0.GetY(), fmaxf(p1.GetY(), p2.GetY()))),
+								 fmaxf(binMax[b].GetZ(), fmaxf(packed.p0.GetZ(), fmaxf(p1.GetZ(), p2.GetZ()))));
+			}
+
+			// sweep from the left to get the area and count on the left of every plane between bins
+			float leftArea[BVH_BIN_COUNT - 1];
+			int leftCount[BVH_BIN_COUNT - 1];
+			Vec3 sweepMin(BVH_NO_HIT);
+			Vec3 sweepMax(-BVH_NO_HIT);
+			int sweepCount = 0;
+			for (int b = 0; b < BVH_BIN_COUNT - 1; ++b)
+			{
+				sweepCount += binCount[b];
+				if (binCount[b] > 0) { sweepMin = MathUtility::Min(sweepMin, binMin[b]); sweepMax = MathUtility::Max(sweepMax, binMax[b]); }
+				leftCount[b] = sweepCount;
+				leftArea[b] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+			}
+
+			// then from the right, evaluating the cost of each plane as we go
+			sweepMin = Vec3(BVH_NO_HIT);
+			sweepMax = Vec3(-BVH_NO_HIT);
+			sweepCount = 0;
+			for (int b = BVH_BIN_COUNT - 1; b > 0; --b)
+			{
+				sweepCount += binCount[b];
+				if (binCount[b] > 0) { sweepMin = MathUtility::Min(sweepMin, binMin[b]); sweepMax = MathUtility::Max(sweepMax, binMax[b]); }
+
+				float rightArea = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+				float cost = leftCount[b - 1] * leftArea[b - 1] + sweepCount * rightArea;
+				if (leftCount[b - 1] > 0 && sweepCount > 0 && cost < bestCost)
+				{
+					bestCost = cost;
+					*outAxis = axis;
+					*outSplitPos = centroidMin + b / scale;
+				}
+			}
+		}
+
+		return bestCost;
+	}
+
+	float TriangleBVH::SurfaceArea(const Vec3 & min, const Vec3 & max)
+	{
+		Vec3 extent = max - min;
+		return 2.0f * (extent.GetX() * extent.GetY() + extent.GetY() * extent.GetZ() + extent.GetZ() * extent.GetX());
+	}
+}
@@ -0,0 +1,122 @@
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+// agent
+// 10/17/2026
+// TriangleBVH.h
+// Bounding volume hierarchy over world space triangles, built with the surface area heuristic
+
+#include "ExportHeader.h"
+#include "SpatialTriangleData.h"
+#include "CollisionTriangle.h"
+#include "LinkedList.h"
+#include "GraphicalObject.h"
+#include "CollisionQueryStats.h"
+#include "ObjectIndexMap.h"
+
+namespace Engine
+{
+	struct RayCastingOutput;
+
+	// returns false to stop the walk
+	typedef bool(*BVHTriangleCallback)(const SpatialTriangleData *pTriangle, bool doubleSided, void *pClassInstance);
+
+	class ENGINE_SHARED TriangleBVH
+	{
+	public:
+		TriangleBVH();
+		~TriangleBVH();
+
+		bool Build(LinkedList<GraphicalObject*> *pObjects);
+		void RayCast(const Vec3& rayPosition, const Vec3& normalizedRayDirection, float checkDist, RayCastingOutput *pOutput, CollisionQueryCounts *pCounts = nullptr);
+		bool IsOccluded(const Vec3& rayPosition, const Vec3& normalizedRayDirection, float checkDist, const GraphicalObject *pIgnoredObject, CollisionQueryCounts *pCounts = nullptr);
+		void WalkTrianglesInBox(const Vec3& boxMin, const Vec3& boxMax, BVHTriangleCallback callback, void *pClassInstance);
+		void RefreshEnabledOwners();
+
+		// moves the triangles of an object already in the bvh and grows or shrinks the boxes above them instead of building again
+		// false when the object was never built in or its mesh changed, only a build can take it then
+		bool RefitObject(GraphicalObject *pObj);
+
+		// its triangles stay in the leaves but are never hit again, false when the object was never built in
+		bool RemoveObject(GraphicalObject *pObj);
+
+		// true once refits have stretched the boxes far enough that a fresh build would be worth it
+		bool NeedsRebuild();
+		int GetTriangleCount();
+		int GetNodeCount();
+		void ConsoleLogStats();
+		void CleanUp();
+
+	private:
+		// leaf when m_triangleCount > 0 (m_leftOrFirst is the first triangle), otherwise children are at m_leftOrFirst and m_leftOrFirst + 1
+		struct BVHNode
+		{
+			Vec3 m_min;
+			Vec3 m_max;
+			int m_leftOrFirst{ 0 };
+			int m_triangleCount{ 0 };
+		};
+
+		struct BuildPassData
+		{
+			Mat4 modelToWorld;
+			int ownerIndex;
+			bool doubleSided;
+		};
+
+		struct RefitPassData
+		{
+			Mat4 modelToWorld;
+			int ownerIndex;
+			bool doubleSided;
+			int firstTriangle;
+			int triangleCount;
+			int walkedCount;
+		};
+
+		static bool CountObjectTrianglesPassThrough(GraphicalObject *pObj, void *pClassInstance);
+		static bool AddObjectTrianglesPassThrough(GraphicalObject *pObj, void *pClassInstance);
+		static bool AddTrianglePassThrough(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pClassInstance, void *pPassThroughData);
+		static bool RefitTrianglePassThrough(int index, const void *pVert1, const void *pVert2, const void *pVert3, void *pClassInstance, void *pPassThroughData);
+		bool AddTriangle(int index, const Vec3& p0, const Vec3& p1, const Vec3& p2, int ownerIndex, bool doubleSided);
+		bool IsOwnerEnabled(int ownerIndex);
+		void UpdateNodeBounds(int nodeIndex);
+		bool RefitNodeBounds(int nodeIndex);
+		void Subdivide(int nodeIndex, int depth);
+		void MakeLeaf(int nodeIndex);
+		float FindBestSplit(const BVHNode& node, int *outAxis, float *outSplitPos);
+		static float SurfaceArea(const Vec3& min, const Vec3& max);
+
+		CollisionTriangle *m_pTriangles{ nullptr };
+
+		// every object the triangles came from, with a bit per object for whether it is enabled
+		GraphicalObject **m_pOwners{ nullptr };
+		unsigned *m_pEnabledOwnerBits{ nullptr };
+		int m_ownerCount{ 0 };
+		int m_ownerCapacity{ 0 };
+		ObjectIndexMap m_ownerIndices;
+
+		// what a refit needs to find an object's triangles: where each owner's run starts in the order they were added,
+		// which slot every added triangle was partitioned into, the leaf holding each slot and the parent of every node
+		int *m_pOwnerFirstTriangles{ nullptr };
+		int *m_pTriangleSlots{ nullptr };
+		int *m_pTriangleLeaves{ nullptr };
+		int *m_pNodeParents{ nullptr };
+
+		// the summed surface area of every box when built and now, moved objects stretch boxes a build would have kept tight
+		float m_builtNodeArea{ 0.0f };
+		float m_nodeArea{ 0.0f };
+
+		// only needed while building, m_pBuildOrder is the order each slot's triangle was added in
+		Vec3 *m_pCentroids{ nullptr };
+		int *m_pBuildOrder{ nullptr };
+		BVHNode *m_pNodes{ nullptr };
+		int m_triangleCount{ 0 };
+		int m_triangleCapacity{ 0 };
+		int m_nodeCount{ 0 };
+		int m_maxDepth{ 0 };
+		int m_leafCount{ 0 };
+	};
+}
+
+#endif // ifndef TRIANGLEBVH_H
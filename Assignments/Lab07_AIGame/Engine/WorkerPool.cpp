@@ -0,0 +1,146 @@
+#include "WorkerPool.h"
+#include "GameLogger.h"
+
+// agent
+// 10/17/2026
+// WorkerPool.cpp
+// A fixed set of threads that split a batch of independent jobs with the calling thread
+
+namespace Engine
+{
+	WorkerPool::WorkerPool()
+		: m_nextJob(0), m_jobsRemaining(0)
+	{
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		Shutdown();
+	}
+
+	bool WorkerPool::Initialize(int workerThreadCount)
+	{
+		if (m_initialized) { GameLogger::Log(MessageType::cWarning, "Tried to initialize WorkerPool that was already initialized!\n"); return true; }
+
+		// by default leave one core for the thread that calls RunJobs
+		if (workerThreadCount < 0) { workerThreadCount = (int)std::thread::hardware_concurrency() - 1; }
+		if (workerThreadCount <= 0) { m_threadCount = 0; m_initialized = true; return true; }
+
+		m_shuttingDown = false;
+		m_pThreads = new std::thread[workerThreadCount];
+		if (!m_pThreads) { GameLogger::Log(MessageType::cError, "Failed to allocate [%d] worker threads!\n", workerThreadCount); return false; }
+
+		m_threadCount = workerThreadCount;
+		for (int i = 0; i < m_threadCount; ++i)
+		{
+			m_pThreads[i] = std::thread(WorkerPool::WorkerThreadMain, this);
+		}
+
+		m_initialized = true;
+		GameLogger::Log(MessageType::Process, "WorkerPool started [%d] worker threads!\n", m_threadCount);
+		return true;
+	}
+
+	bool WorkerPool::Shutdown()
+	{
+		m_initialized = false;
+		if (!m_pThreads) { return true; }
+
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_shuttingDown = true;
+		}
+		m_wakeCondition.notify_all();
+
+		for (int i = 0; i < m_threadCount; ++i)
+		{
+			if (m_pThreads[i].joinable()) { m_pThreads[i].join(); }
+		}
+
+		delete[] m_pThreads;
+		m_pThreads = nullptr;
+		m_threadCount = 0;
+		return true;
+	}
+
+	bool WorkerPool::IsInitialized()
+	{
+		return m_initialized;
+	}
+
+	int WorkerPool::GetWorkerThreadCount()
+	{
+		return m_threadCount;
+	}
+
+	bool WorkerPool::RunJobs(int jobCount, WorkerJobCallback callback, void *pJobData)
+	{
+		if (!callback) { GameLogger::Log(MessageType::cError, "Failed to RunJobs on WorkerPool! Callback was nullptr!\n"); return false; }
+		if (jobCount <= 0) { return true; }
+
+		// no workers (or one job), nothing to gain from waking anyone up
+		if (m_threadCount == 0 || jobCount == 1)
+		{
+			for (int i = 0; i < jobCount; ++i) { callback(i, pJobData); }
+			return true;
+		}
+
+		std::lock_guard<std::mutex> batchLock(m_batchMutex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_wakeMutex);
+			m_callback = callback;
+			m_pJobData = pJobData;
+			m_jobCount = jobCount;
+			m_nextJob.store(0);
+			m_jobsRemaining.store(jobCount);
+			m_batchId++;
+		}
+		m_wakeCondition.notify_all();
+
+		RunAvailableJobs();
+
+		// wait for jobs other threads grabbed to finish, and for every worker to leave the batch so the next one starts clean
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_doneCondition.wait(lock, [this]() { return m_jobsRemaining.load() == 0 && m_activeWorkers == 0; });
+		m_callback = nullptr;
+		m_pJobData = nullptr;
+		m_jobCount = 0;
+		return true;
+	}
+
+	void WorkerPool::WorkerThreadMain(WorkerPool *pPool)
+	{
+		unsigned lastBatchId = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(pPool->m_wakeMutex);
+				pPool->m_wakeCondition.wait(lock, [pPool, lastBatchId]() { return pPool->m_shuttingDown || pPool->m_batchId != lastBatchId; });
+				if (pPool->m_shuttingDown) { return; }
+				lastBatchId = pPool->m_batchId;
+				pPool->m_activeWorkers++;
+			}
+
+			pPool->RunAvailableJobs();
+
+			{
+				std::lock_guard<std::mutex> lock(pPool->m_wakeMutex);
+				pPool->m_activeWorkers--;
+			}
+			pPool->m_doneCondition.notify_all();
+		}
+	}
+
+	void WorkerPool::RunAvailableJobs()
+	{
+		for (;;)
+		{
+			int jobIndex = m_nextJob.fetch_add(1);
+			if (jobIndex >= m_jobCount) { return; }
+
+			m_callback(jobIndex, m_pJobData);
+			m_jobsRemaining.fetch_sub(1);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+// agent
+// 10/17/2026
+// WorkerPool.h
+// A fixed set of threads that split a batch of independent jobs with the calling thread
+
+#include "ExportHeader.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace Engine
+{
+	typedef void(*WorkerJobCallback)(int jobIndex, void *pJobData);
+
+	class ENGINE_SHARED WorkerPool
+	{
+	public:
+		WorkerPool();
+		~WorkerPool();
+
+		bool Initialize(int workerThreadCount = -1);
+		bool Shutdown();
+		bool IsInitialized();
+		int GetWorkerThreadCount();
+
+		// blocks until every job index in [0, jobCount) has been run exactly once, the calling thread helps out
+		bool RunJobs(int jobCount, WorkerJobCallback callback, void *pJobData);
+
+	private:
+		static void WorkerThreadMain(WorkerPool *pPool);
+		void RunAvailableJobs();
+
+		std::thread *m_pThreads{ nullptr };
+		int m_threadCount{ 0 };
+		bool m_initialized{ false };
+
+		// one batch at a time, m_batchId tells sleeping workers a new one has started
+		std::mutex m_batchMutex;
+		std::mutex m_wakeMutex;
+		std::condition_variable m_wakeCondition;
+		std::condition_variable m_doneCondition;
+		unsigned m_batchId{ 0 };
+		int m_activeWorkers{ 0 };
+		bool m_shuttingDown{ false };
+
+		WorkerJobCallback m_callback{ nullptr };
+		void *m_pJobData{ nullptr };
+		int m_jobCount{ 0 };
+		std::atomic<int> m_nextJob;
+		std::atomic<int> m_jobsRemaining;
+	};
+}
+
+#endif // ifndef WORKERPOOL_H
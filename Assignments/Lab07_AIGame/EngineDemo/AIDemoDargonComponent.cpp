@@ -125,9 +125,9 @@ void AIDemoDargonComponent::SetPlayerRef(Engine::SpatialComponent * pPlayerSpati
 	m_pPlayerSpatial = pPlayerSpatial;
 }
 
-void AIDemoDargonComponent::SetPCollectibles(Engine::LinkedList<Engine::GraphicalObject*>* pCollectibles)
+void AIDemoDargonComponent::SetCollectibleLayers(unsigned collectibleLayerMask)
 {
-	m_pCollectibles = pCollectibles;
+	m_collectibleLayerMask = collectibleLayerMask;
 }
 
 void AIDemoDargonComponent::SetFormationGobPtr(Engine::GraphicalObject * pFormationGob)
@@ -308,7 +308,7 @@ void AIDemoDargonComponent::ForageEnter(void * pData)
 void AIDemoDargonComponent::ForageUpdate(float /*dt*/, void * pData)
 {
 	AIDemoDargonComponent *pComp = reinterpret_cast<AIDemoDargonComponent *>(pData);
-	Engine::SteeringBehaviors::Forage(pComp->m_pSpatial, pComp->m_speed, 1.0f, 25.0f, 100.0f, 5.0f, pComp->m_pCollectibles);
+	Engine::SteeringBehaviors::ForageInLayers(pComp->m_pSpatial, pComp->m_speed, 1.0f, 25.0f, 100.0f, 5.0f, pComp->m_collectibleLayerMask);
 	pComp->FaceMoveDir();
 }
 
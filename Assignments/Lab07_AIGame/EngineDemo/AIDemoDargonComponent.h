@@ -19,7 +19,7 @@ public:
 	bool Initialize() override;
 	bool Update(float dt) override;
 	void SetPlayerRef(Engine::SpatialComponent *pPlayerSpatial);
-	void SetPCollectibles(Engine::LinkedList<Engine::GraphicalObject*> *pCollectibles);
+	void SetCollectibleLayers(unsigned collectibleLayerMask);
 	void SetFormationGobPtr(Engine::GraphicalObject *pFormationGob);
 
 private:
@@ -81,7 +81,7 @@ private:
 	static const int NUM_FLOCK = 1;
 	static const int NUM_FUNCS = NUM_STEERS + NUM_ASTARS + NUM_FLOCK;
 	static Engine::FSMPair s_AIFuncs[NUM_FUNCS];
-	Engine::LinkedList<Engine::GraphicalObject*> *m_pCollectibles{ nullptr };
+	unsigned m_collectibleLayerMask{ 0 };
 	Engine::Vec3 m_flockWeights;
 	float m_speed;
 	Engine::GraphicalObject *m_pFormationGob{ nullptr };
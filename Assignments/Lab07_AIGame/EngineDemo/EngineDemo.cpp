@@ -12,6 +12,7 @@
 #include "MyGL.h"
 #include "ChaseCameraComponent.h"
 #include "CollisionTester.h"
+#include "CollisionQueryStats.h"
 #include "MyFiles.h"
 #include "ShaderProgram.h"
 #include "BitmapLoader.h"
@@ -26,6 +27,7 @@
 
 #include "ShapeGenerator.h"
 #include "AStarPathFollowComponent.h"
+#include "AStarPathRequests.h"
 #include "RenderEngine.h"
 #include "ConfigReader.h"
 #include "MathUtility.h"
@@ -122,7 +124,7 @@ bool EngineDemo::Initialize(Engine::MyWindow *window)
 	}
 
 	// ` for numpad 0
-	if (!keyboardManager.AddKeys("XTWASDRFLGCM QEOZ012345678`9iKNJBU")
+	if (!keyboardManager.AddKeys("XTWASDRFLGCM QEOZ012345678`9iKNJBUH")
 		|| !keyboardManager.AddKey(VK_OEM_4) || !keyboardManager.AddKey(VK_OEM_6) || !keyboardManager.AddKey(VK_OEM_5)
 		|| !keyboardManager.AddKey(VK_PRIOR) || !keyboardManager.AddKey(VK_NEXT)
 		|| !keyboardManager.AddKey(VK_OEM_PERIOD) || !keyboardManager.AddKey(VK_SHIFT)
@@ -157,6 +159,7 @@ bool EngineDemo::Shutdown()
 {
 	// Display some info on shutdown
 	Engine::RenderEngine::LogStats();
+	Engine::AStarPathRequests::GetPathCache()->LogStats();
 
 	if (!m_pWindow->Shutdown()) { return false; }
 
@@ -172,6 +175,8 @@ bool EngineDemo::Shutdown()
 	if (!Engine::TextObject::Shutdown()) { return false; }
 	if (!Engine::RenderEngine::Shutdown()) { return false; }
 	if (!Engine::ShapeGenerator::Shutdown()) { return false; }
+	if (!Engine::CollisionTester::ShutdownRayWorkers()) { return false; }
+	if (!Engine::AStarPathRequests::ShutdownPathWorkers()) { return false; }
 	
 	player.Shutdown();
 
@@ -280,6 +285,9 @@ void EngineDemo::Update(float dt)
 
 	lastCollisionLayer = currentCollisionLayer;
 
+	// paths the dargons asked for last frame are searched together here, before any of them look for theirs
+	Engine::AStarPathRequests::DeliverResults();
+
 	for (int i = 0; i < lastDargon; ++i)
 	{
 		s_NPCS[i].Update(dt);
@@ -479,9 +487,10 @@ bool EngineDemo::ProcessInput(float /*dt*/)
 	//int multiKeyTest[]{ 'J', 'K', VK_OEM_PERIOD };
 	//if (keyboardManager.KeysArePressed(&multiKeyTest[0], 3)) { Engine::GameLogger::Log(Engine::MessageType::ConsoleOnly, "3 keys pressed!\n"); }
 	if (keyboardManager.KeyWasReleased('C')) { Engine::CollisionTester::ConsoleLogOutput(); }
+	if (keyboardManager.KeyWasPressed('H')) { Engine::CollisionQueryStats::SetEnabled(!Engine::CollisionQueryStats::IsEnabled()); }
 	if (keyboardManager.KeyWasPressed('`')) { Engine::ConfigReader::pReader->ProcessConfigFile(); }
 	if (keyboardManager.KeyWasPressed('I')) { Engine::GameLogger::Log(Engine::MessageType::ConsoleOnly, "(%.3f, %.3f, %.3f)\n", playerGraphicalObject.GetPos().GetX(), playerGraphicalObject.GetPos().GetY(), playerGraphicalObject.GetPos().GetZ()); }
-	if (keyboardManager.KeyWasPressed('L')) { Engine::RenderEngine::LogStats(); }
+	if (keyboardManager.KeyWasPressed('L')) { Engine::RenderEngine::LogStats(); Engine::AStarPathRequests::GetPathCache()->LogStats(); }
 	if (keyboardManager.KeyWasPressed('G')) { drawGrid = !drawGrid; }
 	if (keyboardManager.KeyWasPressed('N'))
 	{
@@ -650,7 +659,8 @@ bool EngineDemo::InitDargon(int index)
 	s_NPCFollows[index].SetCheckLayer(Engine::CollisionLayer::LAYER_2);
 
 	s_NPCBrains[index].SetPlayerRef(&playerSpatial);
-	s_NPCBrains[index].SetPCollectibles(&m_fromWorldEditorOBJs);
+	// everything read from the editor files is collision tested in one of these layers
+	s_NPCBrains[index].SetCollectibleLayers(Engine::CollisionTester::LayerBit(Engine::CollisionLayer::LAYER_2) | Engine::CollisionTester::LayerBit(NODE_LAYER) | Engine::CollisionTester::LayerBit(CONNECTION_LAYER));
 	s_NPCBrains[index].SetFormationGobPtr(&s_dargonInstanceObj);
 
 	s_NPCS[index].SetName(&nameBuffer[0]);
@@ -677,6 +687,13 @@ void EngineDemo::InitIndicesForMeshNames(const char *const meshNames, int *indic
 
 void EngineDemo::LoadWorldFileAndApplyPCUniforms()
 {
+	// long sight lines across the world are cheaper through a bvh than a grid walk
+	bool useBVH = false;
+	if (Engine::ConfigReader::pReader->GetBoolForKey("EngineDemo.World.UseBVH", useBVH) && useBVH)
+	{
+		Engine::CollisionTester::SetLayerBackend(Engine::CollisionLayer::LAYER_2, Engine::CollisionBackend::BVH);
+	}
+
 	char buffer[256]{ '\0' };
 	if (Engine::ConfigReader::pReader->GetStringForKey("EngineDemo.World.InputFileName", buffer))
 	{
@@ -684,7 +701,8 @@ void EngineDemo::LoadWorldFileAndApplyPCUniforms()
 		// read file
 		Engine::WorldFileIO::ReadGobFile(&buffer[0], &m_fromWorldEditorOBJs, m_shaderPrograms[0].GetProgramId(), InitEditorObj, this);
 
-		Engine::CollisionTester::CalculateGrid(Engine::CollisionLayer::NUM_LAYERS);
+		// the world never changes between runs, so its grids are saved next to it and mapped back in on later startups
+		Engine::CollisionTester::CalculateGrid(Engine::CollisionLayer::NUM_LAYERS, &buffer[0]);
 	}
 
 	if (Engine::ConfigReader::pReader->GetStringForKey("EngineDemo.World.InputNodeFileName", buffer))
@@ -12,6 +12,7 @@
 #include "MousePicker.h"
 #include "MathUtility.h"
 #include "MouseManager.h"
+#include "CollisionQueryStats.h"
 #include "AStarNode.h"
 
 // Justin Furtado
@@ -55,6 +56,11 @@ const Engine::CollisionLayer NODE_LAYER = Engine::CollisionLayer::LAYER_2; // TO
 const Engine::CollisionLayer CONNECTION_LAYER = Engine::CollisionLayer::LAYER_3; // TODO: IMPORTANT, make sure connections go in this layer
 // TODO: IMPORTANT, make sure raycasts check correct layers and correct layers are recalculated at correct times
 
+// the callers the collision query stats file the editor's ray casts under
+const char *const ARROW_QUERY_TAG = "editor arrow pick";
+const char *const HOVER_QUERY_TAG = "editor hover";
+const char *const WALK_QUERY_TAG = "editor walk";
+
 const float RENDER_DISTANCE = 2500.0f;
 bool WorldEditor::InitializeCallback(void * game, Engine::MyWindow * pWindow)
 {
@@ -145,28 +151,19 @@ void WorldEditor::RemoveObject(WorldEditor *pEditor)
 {
 	// show which object will be acted upon
 	pEditor->DoMouseOverHighlight();
-	Engine::CollisionLayer c;
 
 	if (Engine::MouseManager::IsLeftMouseClicked() && pEditor->m_rco.m_didIntersect && pEditor->m_objs.Contains(pEditor->m_rco.m_belongsTo))
 	{
 		pEditor->DeMouseOver();
 		Engine::CollisionLayer cl = CONNECTION_LAYER;
 
-		// slightly uglier, but faster - only recalculate the layer the object was removed from
-		for (c = Engine::CollisionLayer::STATIC_GEOMETRY; c != Engine::CollisionLayer::NUM_LAYERS; c = (Engine::CollisionLayer)(((unsigned)c) + 1))
-		{
-			if (Engine::AStarNodeMap::IsObjInLayer(pEditor->m_rco.m_belongsTo, &c)) { break; }
-		}
-
+		// removing the object from its layer takes its triangles out of the grid, so nothing needs recalculating
 		if (Engine::AStarNodeMap::IsObjInLayer(pEditor->m_rco.m_belongsTo, &cl)) { pEditor->m_nodeMap.RemoveConnection(&pEditor->m_objs, pEditor->m_rco.m_belongsTo, WorldEditor::DestroyObjsCallback, pEditor, &pEditor->m_objCount); }
 		else
 		{
 			DestroyObjsCallback(pEditor->m_rco.m_belongsTo, pEditor);
 			pEditor->m_objs.RemoveFirstFromList(pEditor->m_rco.m_belongsTo);
 		}
-
-
-		Engine::CollisionTester::CalculateGrid(c);
 	}
 }
 
@@ -185,7 +182,9 @@ void WorldEditor::TranslateObject(WorldEditor *pEditor)
 	{
 		if (!Engine::AStarNodeMap::IsObjInLayer(pEditor->m_pSelected, &checkLayer))
 		{
+			const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(ARROW_QUERY_TAG);
 			Engine::RayCastingOutput arrowCheck = Engine::CollisionTester::FindFromMousePos(Engine::MouseManager::GetMouseX(), Engine::MouseManager::GetMouseY(), RENDER_DISTANCE, EDITOR_ITEMS);
+			Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 			if (arrowCheck.m_didIntersect && Engine::MouseManager::IsLeftMouseClicked())
 			{
@@ -220,7 +219,6 @@ void WorldEditor::TranslateObject(WorldEditor *pEditor)
 			{
 				arrowClicked = false;
 				pEditor->HandleOutsideGrid(pEditor->m_pSelected);
-				Engine::CollisionTester::CalculateGrid(EDITOR_ITEMS);
 			}
 		}
 	}
@@ -249,7 +247,9 @@ void WorldEditor::RotateObject(WorldEditor *pEditor)
 	{
 		if (!Engine::AStarNodeMap::IsObjInLayer(pEditor->m_pSelected, &checkLayer))
 		{
+			const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(ARROW_QUERY_TAG);
 			Engine::RayCastingOutput arrowCheck = Engine::CollisionTester::FindFromMousePos(Engine::MouseManager::GetMouseX(), Engine::MouseManager::GetMouseY(), RENDER_DISTANCE, EDITOR_ITEMS);
+			Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 			if (arrowCheck.m_didIntersect && Engine::MouseManager::IsLeftMouseClicked())
 			{
@@ -288,7 +288,6 @@ void WorldEditor::RotateObject(WorldEditor *pEditor)
 			{
 				arrowClicked = false;
 				pEditor->HandleOutsideGrid(pEditor->m_pSelected);
-				Engine::CollisionTester::CalculateGrid(EDITOR_ITEMS);
 			}
 		}
 	}
@@ -313,7 +312,9 @@ void WorldEditor::ScaleObject(WorldEditor *pEditor)
 	{
 		if (!Engine::AStarNodeMap::IsObjInLayer(pEditor->m_pSelected, &checkLayer)) 
 		{ 
+			const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(ARROW_QUERY_TAG);
 			Engine::RayCastingOutput arrowCheck = Engine::CollisionTester::FindFromMousePos(Engine::MouseManager::GetMouseX(), Engine::MouseManager::GetMouseY(), RENDER_DISTANCE, EDITOR_ITEMS);
+			Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 			if (arrowCheck.m_didIntersect && Engine::MouseManager::IsLeftMouseClicked())
 			{
@@ -359,7 +360,6 @@ void WorldEditor::ScaleObject(WorldEditor *pEditor)
 			{
 				arrowClicked = false;
 				pEditor->HandleOutsideGrid(pEditor->m_pSelected);
-				Engine::CollisionTester::CalculateGrid(EDITOR_ITEMS);
 			}
 		}
 	}
@@ -426,7 +426,7 @@ bool WorldEditor::Initialize(Engine::MyWindow * pWindow)
 	}
 
 	// setup keys for the world editor
-	if (!keyboardManager.AddKeys("XWASD1234567890MNKU ") || !keyboardManager.AddKey(VK_SHIFT)
+	if (!keyboardManager.AddKeys("XWASD1234567890MNKUQ ") || !keyboardManager.AddKey(VK_SHIFT)
 		|| !keyboardManager.AddToggle('G', &drawGrid))
 	{
 		Engine::GameLogger::Log(Engine::MessageType::cFatal_Error, "Failed to add keys for WorldEditor!\n");
@@ -466,6 +466,7 @@ bool WorldEditor::Shutdown()
 	if (!Engine::TextObject::Shutdown()) { return false; }
 	if (!Engine::RenderEngine::Shutdown()) { return false; }
 	if (!Engine::ShapeGenerator::Shutdown()) { return false; }
+	if (!Engine::CollisionTester::ShutdownRayWorkers()) { return false; }
 
 	Engine::GameLogger::Log(Engine::MessageType::cProcess, "Game Shutdown Successfully!!!\n");
 	return true;
@@ -484,7 +485,9 @@ void WorldEditor::Update(float dt)
 	
 	if (m_walkEnabled)
 	{
-		Engine::RayCastingOutput groundRCO = Engine::CollisionTester::FindWall(m_camera.GetPosition() + (DOWN_CHECK - DOWN_OFFSET) * PLUS_Y, -PLUS_Y, CHECK_DIST, EDITOR_LIST_OBJS);
+		const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(WALK_QUERY_TAG);
+		Engine::RayCastingOutput groundRCO = Engine::CollisionTester::FindWall(m_camera.GetPosition() + (DOWN_CHECK - DOWN_OFFSET) * PLUS_Y, -PLUS_Y, CHECK_DIST, EDITOR_LIST_OBJS, &m_walkProbeCache);
+		Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 		if (groundRCO.m_didIntersect)
 		{
@@ -521,7 +524,9 @@ void WorldEditor::Update(float dt)
 
 	Engine::MousePicker::SetCameraInfo(m_camera.GetPosition(), m_camera.GetViewDir(), m_camera.GetUp());
 
+	const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(HOVER_QUERY_TAG);
 	m_rco = Engine::CollisionTester::FindFromMousePos(Engine::MouseManager::GetMouseX(), Engine::MouseManager::GetMouseY(), RENDER_DISTANCE);
+	Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 
 	m_currentMode(this);
 }
@@ -663,13 +668,18 @@ bool WorldEditor::InitializeGL()
 	return true;
 }
 
-const float moveCheckOffset = 2.0f;
-const float moveCheckDist = 2.0f;
+const float walkSphereRadius = 0.75f;
 bool WorldEditor::ProcessInput(float dt)
 {
 	char buffer[256]{ '\0' };
 
 	if (keyboardManager.KeyWasPressed('X')) { Shutdown(); return false; }
+	if (keyboardManager.KeyWasPressed('Q'))
+	{
+		// shift dumps the last frame's query stats, plain Q turns collecting them on or off
+		if (keyboardManager.KeyIsDown(VK_SHIFT)) { Engine::CollisionQueryStats::LogLastFrame(); }
+		else { Engine::CollisionQueryStats::SetEnabled(!Engine::CollisionQueryStats::IsEnabled()); }
+	}
 
 	Engine::Vec3 movementVector(0.0f);
 
@@ -680,13 +690,9 @@ bool WorldEditor::ProcessInput(float dt)
 
 	if (m_walkEnabled)
 	{
-		Engine::RayCastingOutput moveRCO = Engine::CollisionTester::FindWall(m_camera.GetPosition() - (moveCheckOffset * movementVector.Normalize()), movementVector.Normalize(), moveCheckOffset + moveCheckDist + 1.0f, EDITOR_LIST_OBJS);
-		while (moveRCO.m_didIntersect && moveRCO.m_distance < (moveCheckOffset + moveCheckDist))
-		{
-			movementVector = movementVector - movementVector.ProjectOnto(moveRCO.m_triangleNormal);
-
-			moveRCO = Engine::CollisionTester::FindWall(m_camera.GetPosition() - (moveCheckOffset * movementVector.Normalize()), movementVector.Normalize(), moveCheckOffset + moveCheckDist + 1.0f, EDITOR_LIST_OBJS);
-		}
+		const char *pPreviousTag = Engine::CollisionQueryStats::SetQueryTag(WALK_QUERY_TAG);
+		movementVector = Engine::CollisionTester::SlideSphere(m_camera.GetPosition(), walkSphereRadius, movementVector, Engine::CollisionTester::LayerBit(EDITOR_LIST_OBJS));
+		Engine::CollisionQueryStats::SetQueryTag(pPreviousTag);
 	}
 
 	if (movementVector.LengthSquared() > 0.0f)
@@ -909,6 +915,11 @@ void WorldEditor::AttachArrowsTo(Engine::GraphicalObject *pObj)
 	m_zArrow.SetRotMat(pObj->GetRotMat() * Engine::Mat4::RotationToFace(BASE_ARROW_DIR, PLUS_Z));
 	m_zArrow.SetTransMat(Engine::Mat4::Translation(m_zArrow.GetRotMat() * X_ARROW_OFFSET + pObj->GetPos()));
 	m_zArrow.CalcFullTransform();
+
+	// only the arrows moved, so only their triangles are re-binned
+	Engine::CollisionTester::UpdateGraphicalObjectInLayer(&m_xArrow, EDITOR_ITEMS);
+	Engine::CollisionTester::UpdateGraphicalObjectInLayer(&m_yArrow, EDITOR_ITEMS);
+	Engine::CollisionTester::UpdateGraphicalObjectInLayer(&m_zArrow, EDITOR_ITEMS);
 }
 
 void WorldEditor::SelectedObjectChanged()
@@ -999,17 +1010,13 @@ void WorldEditor::HandleOutsideGrid(Engine::GraphicalObject * pObjToCheck)
 		m_objs.RemoveFirstFromList(pObjToCheck);
 		SetArrowEnabled(false);
 		AttachArrowsTo(&m_grid);
-	}
-
 
-	// slightly uglier, but faster - only recalculate the layer the object was added to from
-	for (Engine::CollisionLayer c = Engine::CollisionLayer::STATIC_GEOMETRY; c != Engine::CollisionLayer::NUM_LAYERS; c = (Engine::CollisionLayer)(((unsigned)c) + 1))
-	{
-		if (Engine::AStarNodeMap::IsObjInLayer(pObjToCheck, &c))
-		{
-			Engine::CollisionTester::CalculateGrid(c);
-		}
+		// destroying it already took its triangles out of the grid
+		return;
 	}
+
+	// only re-bin the object itself, in whichever layer it was added to
+	Engine::CollisionTester::UpdateGraphicalObjectInLayer(pObjToCheck, Engine::CollisionLayer::NUM_LAYERS);
 }
 
 Engine::Vec3 WorldEditor::GetArrowDir(Engine::GraphicalObject * pArrow)
@@ -143,6 +143,7 @@ private:
 	Engine::GraphicalObject m_grid;
 	Engine::GraphicalObject m_originMarker;
 	bool m_walkEnabled{ false };
+	Engine::RayProbeCache m_walkProbeCache;
 	Engine::Vec3 GetArrowDir(Engine::GraphicalObject *pArrow);
 	ActionCallback m_currentMode{ WorldEditor::PlaceObject };
 	int m_currentPlacement{ 0 };